@@ -59,6 +59,8 @@ namespace CoreArray
 	extern COREARRAY_DLL_LOCAL void RegisterClass_PackedReal();
 	extern COREARRAY_DLL_LOCAL void RegisterClass_String();
 	extern COREARRAY_DLL_LOCAL void RegisterClass_Sparse();
+	extern COREARRAY_DLL_LOCAL void RegisterClass_Tiled();
+	extern COREARRAY_DLL_LOCAL void RegisterClass_Virtual();
 
 
 	COREARRAY_DLL_DEFAULT void RegisterClass()
@@ -99,6 +101,12 @@ namespace CoreArray
 		// sparse array
 		RegisterClass_Sparse();
 
+		// tiled array
+		RegisterClass_Tiled();
+
+		// virtual array concatenating nodes of linked files
+		RegisterClass_Virtual();
+
 		// fixed-length strings
 		// variable-length null-terminated strings
 		// variable-length strings allowing null character
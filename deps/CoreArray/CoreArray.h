@@ -55,6 +55,8 @@
 #include "dStrGDS.h"
 #include "dVLIntGDS.h"
 #include "dSparse.h"
+#include "dTiledGDS.h"
+#include "dVirtualGDS.h"
 
 
 namespace CoreArray
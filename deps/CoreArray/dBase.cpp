@@ -353,6 +353,159 @@ void CdMemory::SetPosition(const SIZE64 pos)
 }
 
 
+// CdMemGovernor
+
+CdMemGovernor::CdMemGovernor(C_Int64 Budget)
+{
+	fBudget = (Budget > 0) ? Budget : 0;
+	fReserved = 0;
+	fNextID = 1;
+	fEpoch = 0;
+}
+
+CdMemGovernor &CdMemGovernor::Global()
+{
+	static CdMemGovernor Governor(1024*1024*1024);
+	return Governor;
+}
+
+C_Int64 CdMemGovernor::Budget()
+{
+	TdAutoMutex _M(&fMutex);
+	return fBudget;
+}
+
+void CdMemGovernor::SetBudget(C_Int64 Budget)
+{
+	TdAutoMutex _M(&fMutex);
+	fBudget = (Budget > 0) ? Budget : 0;
+	_Update();
+}
+
+int CdMemGovernor::Register(C_Int64 Want)
+{
+	TdAutoMutex _M(&fMutex);
+	int ID = fNextID ++;
+	if (fNextID <= 0) fNextID = 1;
+	TReader &R = fReader[ID];
+	R.Want = (Want > 0) ? Want : 0;
+	R.Quota = R.Used = 0;
+	_Update();
+	return ID;
+}
+
+void CdMemGovernor::Unregister(int ID)
+{
+	TdAutoMutex _M(&fMutex);
+	if (fReader.erase(ID) > 0)
+		_Update();
+}
+
+void CdMemGovernor::SetWant(int ID, C_Int64 Want)
+{
+	TdAutoMutex _M(&fMutex);
+	map<int, TReader>::iterator it = fReader.find(ID);
+	if (it != fReader.end())
+	{
+		if (Want < 0) Want = 0;
+		if (it->second.Want != Want)
+		{
+			it->second.Want = Want;
+			_Update();
+		}
+	}
+}
+
+C_Int64 CdMemGovernor::Quota(int ID)
+{
+	TdAutoMutex _M(&fMutex);
+	map<int, TReader>::iterator it = fReader.find(ID);
+	return (it != fReader.end()) ? it->second.Quota : 0;
+}
+
+C_Int64 CdMemGovernor::Grant(int ID, C_Int64 Unit)
+{
+	TdAutoMutex _M(&fMutex);
+	map<int, TReader>::iterator it = fReader.find(ID);
+	if ((it == fReader.end()) || (Unit <= 0)) return 0;
+	// the memory not allocated by caches and other readers
+	C_Int64 Free = fBudget - fReserved;
+	map<int, TReader>::iterator p;
+	for (p=fReader.begin(); p != fReader.end(); p++)
+		if (p != it) Free -= p->second.Used;
+	C_Int64 n = it->second.Quota;
+	if (n > Free) n = Free;
+	n = (n > 0) ? (n / Unit * Unit) : 0;
+	// others may grow into the released memory
+	if (n < it->second.Used)
+		AtomicAdd(&fEpoch, 1);
+	it->second.Used = n;
+	return n;
+}
+
+bool CdMemGovernor::Reserve(C_Int64 Size, C_Int64 Replaced)
+{
+	TdAutoMutex _M(&fMutex);
+	if (fReserved - Replaced + Size > fBudget)
+		return false;
+	fReserved += Size - Replaced;
+	_Update();
+	return true;
+}
+
+void CdMemGovernor::Release(C_Int64 Size)
+{
+	TdAutoMutex _M(&fMutex);
+	fReserved -= Size;
+	if (fReserved < 0) fReserved = 0;
+	_Update();
+}
+
+C_Int64 CdMemGovernor::Reserved()
+{
+	TdAutoMutex _M(&fMutex);
+	return fReserved;
+}
+
+C_Int64 CdMemGovernor::Used()
+{
+	TdAutoMutex _M(&fMutex);
+	C_Int64 n = 0;
+	map<int, TReader>::iterator it;
+	for (it=fReader.begin(); it != fReader.end(); it++)
+		n += it->second.Used;
+	return n;
+}
+
+int CdMemGovernor::NumReader()
+{
+	TdAutoMutex _M(&fMutex);
+	return fReader.size();
+}
+
+void CdMemGovernor::_Update()
+{
+	// max-min fair share, in ascending order of wanted sizes
+	vector< pair<C_Int64, int> > lst;
+	map<int, TReader>::iterator it;
+	for (it=fReader.begin(); it != fReader.end(); it++)
+		lst.push_back(pair<C_Int64, int>(it->second.Want, it->first));
+	sort(lst.begin(), lst.end());
+
+	C_Int64 Avail = fBudget - fReserved;
+	if (Avail < 0) Avail = 0;
+	const size_t n = lst.size();
+	for (size_t i=0; i < n; i++)
+	{
+		C_Int64 Share = Avail / (C_Int64)(n - i);
+		C_Int64 q = (lst[i].first < Share) ? lst[i].first : Share;
+		fReader[lst[i].second].Quota = q;
+		Avail -= q;
+	}
+	AtomicAdd(&fEpoch, 1);
+}
+
+
 
 // =====================================================================
 // CdStream
@@ -650,7 +803,16 @@ C_UInt64 CdBufStream::R64b()
 
 void CdBufStream::WriteData(const void *Buf, ssize_t Count)
 {
-	if (Count > 0)
+	if (Count >= _BufSize)
+	{
+		// write through, a large block is passed to the stream directly
+		FlushBuffer();
+		_Stream->SetPosition(_Position);
+		_Stream->WriteData(Buf, Count);
+		_Position += Count;
+		_BufStart = _BufEnd = _Position;
+		OnFlush.Notify(this);
+	} else if (Count > 0)
 	{
 		// Check in Range
 		if ((_Position<_BufStart) || (_Position>_BufEnd))
@@ -753,10 +915,11 @@ void CdBufStream::SetStream(CdStream *Value)
 
 void CdBufStream::SetBufSize(const ssize_t NewBufSize)
 {
-	if ((_BufSize!=NewBufSize) && (NewBufSize>=(1 << BufStreamAlign)))
+	const ssize_t Size = (NewBufSize >> BufStreamAlign) << BufStreamAlign;
+	if ((_BufSize!=Size) && (NewBufSize>=(1 << BufStreamAlign)))
 	{
 		FlushWrite();
-		_BufSize = (NewBufSize >> BufStreamAlign) << BufStreamAlign;
+		_BufSize = Size;
 		_Buffer = (C_UInt8*)realloc((void*)_Buffer, _BufSize);
 		COREARRAY_ALLOCCHECK(_Buffer);
     }
@@ -538,6 +538,76 @@ namespace CoreArray
 	};
 
 
+	/// Process-wide memory budget for reading buffers and caches
+	/** Readers register the buffer sizes they want and get quotas: the
+	 *  budget, less the fixed reservations of caches, is shared max-min
+	 *  fairly, so a small reader gets all it wants and the large ones
+	 *  split the rest evenly. Quotas are recomputed whenever a reader
+	 *  comes or goes, and the epoch is increased, so a reader resizes its
+	 *  buffer at the next safe point. A reader never allocates the memory
+	 *  still held by others, so the budget is not exceeded in between.
+	**/
+	class COREARRAY_DLL_DEFAULT CdMemGovernor
+	{
+	public:
+		/// constructor
+		CdMemGovernor(C_Int64 Budget);
+
+		/// the governor shared by the process
+		static CdMemGovernor &Global();
+
+		/// the total number of bytes for buffers and caches
+		C_Int64 Budget();
+		/// set the budget, and recompute quotas
+		void SetBudget(C_Int64 Budget);
+
+		/// register a reader wanting 'Want' bytes, and return its ID
+		int Register(C_Int64 Want);
+		/// remove a reader, and share its quota with others
+		void Unregister(int ID);
+		/// change the wanted size of a reader
+		void SetWant(int ID, C_Int64 Want);
+		/// the current quota of a reader, 0 if not registered
+		C_Int64 Quota(int ID);
+		/// grant a reader a buffer of whole units within its quota and the
+		/// memory not allocated by others, and record it as used
+		C_Int64 Grant(int ID, C_Int64 Unit);
+
+		/// reserve a fixed size for a cache in place of 'Replaced' bytes
+		/// reserved before, return false if over the budget
+		bool Reserve(C_Int64 Size, C_Int64 Replaced=0);
+		/// release a reservation
+		void Release(C_Int64 Size);
+
+		/// the number of bytes reserved by caches
+		C_Int64 Reserved();
+		/// the number of bytes allocated by readers
+		C_Int64 Used();
+		/// the number of registered readers
+		int NumReader();
+		/// increased whenever quotas change
+		COREARRAY_INLINE C_Int64 Epoch() { return AtomicGet(&fEpoch); }
+
+	protected:
+		struct TReader
+		{
+			C_Int64 Want;   ///< the wanted size
+			C_Int64 Quota;  ///< the granted size
+			C_Int64 Used;   ///< the allocated size
+		};
+
+		CdThreadMutex fMutex;
+		C_Int64 fBudget;
+		C_Int64 fReserved;
+		map<int, TReader> fReader;
+		int fNextID;
+		volatile C_Int64 fEpoch;
+
+	private:
+		void _Update();
+	};
+
+
 
 	// =====================================================================
 	// Stream Object
@@ -685,6 +755,7 @@ namespace CoreArray
 		C_UInt64 R64b();
 
 		/// Write block of data, or throw an exception if fail
+		/** a block not less than the buffer size bypasses the buffer **/
 		void WriteData(const void *Buffer, ssize_t Count);
 		/// Write a 8-bit integer with native endianness
 		void W8b(C_UInt8 val);
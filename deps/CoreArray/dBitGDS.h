@@ -198,6 +198,7 @@ namespace CoreArray
 				// Notify(mcDimChanged);
 
 				this->fChanged = true;
+				this->_SetDirty();
 				if (this->fGDSStream) this->SaveToBlockStream();
 			}
 		}
@@ -207,6 +208,7 @@ namespace CoreArray
 			if (Cnt <= 0) return Buffer;
 
 			// writing
+			this->_TransChanged();
 			this->_SetLargeBuffer();
 			CdIterator I = this->IterEnd();
 			switch (InSV)
@@ -259,6 +261,7 @@ namespace CoreArray
 				R.DimLen = this->fTotalCount / R.DimElmCnt;
 				this->_SetFlushEvent();
 				this->fNeedUpdate = true;
+				this->_SetDirty();
 			}
 			return Buffer;
 		}
@@ -304,6 +307,7 @@ namespace CoreArray
 
 					if (num_bit > 0)
 					{
+						this->_TransChanged();
 						CdBaseBit<BIT_TYPE> *Src = (CdBaseBit<BIT_TYPE> *)I.Handler;
 						Src->Allocator().BufStream()->FlushWrite();
 						this->fAllocator.BufStream()->CopyFrom(
@@ -326,6 +330,7 @@ namespace CoreArray
 						{
 							R.DimLen = this->fTotalCount / R.DimElmCnt;
 							this->fNeedUpdate = true;
+							this->_SetDirty();
 						}
 					}
 
@@ -0,0 +1,383 @@
+// ===========================================================
+//     _/_/_/   _/_/_/  _/_/_/_/    _/_/_/_/  _/_/_/   _/_/_/
+//      _/    _/       _/             _/    _/    _/   _/   _/
+//     _/    _/       _/_/_/_/       _/    _/    _/   _/_/_/
+//    _/    _/       _/             _/    _/    _/   _/
+// _/_/_/   _/_/_/  _/_/_/_/_/     _/     _/_/_/   _/_/
+// ===========================================================
+//
+// dBlockCache.cpp: Cache of decoded blocks shared by local processes
+//
+// Copyright (C) 2020    Xiuwen Zheng
+//
+// This file is part of CoreArray.
+//
+// CoreArray is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License Version 3 as
+// published by the Free Software Foundation.
+//
+// CoreArray is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with CoreArray.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#include "dBlockCache.h"
+#include <string.h>
+
+#ifdef COREARRAY_PLATFORM_UNIX
+#   include <cerrno>
+#   include <fcntl.h>
+#   include <sched.h>
+#   include <signal.h>
+#   include <unistd.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#endif
+
+
+using namespace std;
+using namespace CoreArray;
+
+
+static const C_Int64 CACHE_MAGIC = 0x4344534B43414348LL;  // "CDSKCACH"
+static const C_Int64 CACHE_VERSION = 1;
+/// the alignment of blocks in the ring buffer
+static const C_Int64 CACHE_ALIGN = 64;
+/// the number of hash entries probed for a key
+static const int CACHE_NUM_PROBE = 8;
+/// the minimum size of a cache
+static const C_Int64 CACHE_MIN_SIZE = 1024*1024;
+
+#ifndef COREARRAY_PLATFORM_UNIX
+static const char *ERR_CACHE_UNSUPPORT =
+	"The shared block cache is not supported on this platform.";
+#endif
+static const char *ERR_CACHE_OPEN = "Can not open the shared block cache '%s'. %s";
+static const char *ERR_CACHE_INVALID = "Invalid shared block cache '%s'.";
+static const char *ERR_CACHE_BUDGET =
+	"The shared block cache '%s' (%lld bytes) is over the memory budget.";
+
+/// the header of the shared segment
+struct CdBlockCache::THeader
+{
+	volatile C_Int64 Magic;    ///< set after initialization
+	C_Int64 Version;           ///< the version of layout
+	C_Int64 TotalSize;         ///< the size of the segment
+	C_Int64 DataSize;          ///< the size of the ring buffer
+	C_Int64 NumBucket;         ///< the size of the hash table, a power of 2
+	volatile C_Int64 Lock;     ///< the process ID of the writer, 0 if free
+	volatile C_Int64 Head;     ///< the end of the ring buffer in total bytes
+	volatile C_Int64 NumHit;   ///< the number of successful lookups
+	volatile C_Int64 NumMiss;  ///< the number of failed lookups
+	volatile C_Int64 NumAdd;   ///< the number of added blocks
+};
+
+/// an entry of the hash table
+struct CdBlockCache::TBucket
+{
+	volatile C_Int64 Seq;      ///< odd when being modified
+	volatile C_Int64 Key[5];   ///< the key of block
+	volatile C_Int64 Offset;   ///< the start of block in the ring buffer
+	volatile C_Int64 Size;     ///< the size of block, 0 for empty
+};
+
+static inline C_Int64 AlignUp(C_Int64 n)
+{
+	return (n + CACHE_ALIGN - 1) & ~(CACHE_ALIGN - 1);
+}
+
+static inline size_t KeyHash(const CdBlockCache::TKey &K)
+{
+	C_UInt64 h = (C_UInt64)K.Dev * 0x9E3779B97F4A7C15ULL;
+	h = (h ^ (C_UInt64)K.Inode) * 0xBF58476D1CE4E5B9ULL;
+	h = (h ^ (C_UInt64)K.MTime) * 0x94D049BB133111EBULL;
+	h = (h ^ (C_UInt64)K.Pos) * 0x9E3779B97F4A7C15ULL;
+	h = (h ^ (C_UInt64)K.CmpSize) * 0xBF58476D1CE4E5B9ULL;
+	return (size_t)(h ^ (h >> 31));
+}
+
+static inline bool KeyEqual(const volatile C_Int64 *p,
+	const CdBlockCache::TKey &K)
+{
+	return (p[0]==K.Dev) && (p[1]==K.Inode) && (p[2]==K.MTime) &&
+		(p[3]==K.Pos) && (p[4]==K.CmpSize);
+}
+
+
+CdBlockCache *CdBlockCache::fCurrent = NULL;
+
+CdBlockCache::CdBlockCache(const char *Name, C_Int64 Size)
+{
+	fMem = NULL; fMemSize = 0;
+	fCreator = false;
+	fHead = NULL; fBucket = NULL; fData = NULL;
+
+#ifdef COREARRAY_PLATFORM_UNIX
+	fName = Name;
+	if (fName.empty() || (fName[0] != '/'))
+		fName.insert(0, "/");
+	if (Size < CACHE_MIN_SIZE) Size = CACHE_MIN_SIZE;
+
+	// the layout
+	C_Int64 DataSize = Size & ~(CACHE_ALIGN - 1);
+	C_Int64 NumBucket = 1024;
+	while (NumBucket < DataSize / (64*1024)) NumBucket <<= 1;
+	const C_Int64 DataStart = AlignUp(sizeof(THeader)) +
+		NumBucket * (C_Int64)sizeof(TBucket);
+
+	bool Creator = true;
+	int fd = shm_open(fName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+	if ((fd < 0) && (errno == EEXIST))
+	{
+		Creator = false;
+		fd = shm_open(fName.c_str(), O_RDWR, 0600);
+	}
+	if (fd < 0)
+		throw ErrStream(ERR_CACHE_OPEN, Name, LastSysErrMsg().c_str());
+
+	C_Int64 Total = DataStart + DataSize;
+	if (Creator)
+	{
+		if (ftruncate(fd, Total) != 0)
+		{
+			string msg = LastSysErrMsg();
+			close(fd); shm_unlink(fName.c_str());
+			throw ErrStream(ERR_CACHE_OPEN, Name, msg.c_str());
+		}
+	} else {
+		// wait for the creator to set the size
+		struct stat st;
+		for (int i=0; i < 5000; i++)
+		{
+			if (fstat(fd, &st) != 0) { st.st_size = 0; break; }
+			if (st.st_size >= (off_t)sizeof(THeader)) break;
+			usleep(1000);
+		}
+		Total = st.st_size;
+		if (Total < (C_Int64)sizeof(THeader))
+		{
+			close(fd);
+			throw ErrStream(ERR_CACHE_INVALID, Name);
+		}
+	}
+
+	fMem = mmap(NULL, Total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (fMem == MAP_FAILED)
+	{
+		fMem = NULL;
+		throw ErrStream(ERR_CACHE_OPEN, Name, LastSysErrMsg().c_str());
+	}
+	fMemSize = Total;
+	fCreator = Creator;
+	fHead = (THeader*)fMem;
+
+	if (Creator)
+	{
+		// the segment is filled with zero
+		fHead->Version = CACHE_VERSION;
+		fHead->TotalSize = Total;
+		fHead->DataSize = DataSize;
+		fHead->NumBucket = NumBucket;
+		AtomicSet(&fHead->Magic, CACHE_MAGIC);
+	} else {
+		// wait for the creator to initialize the header
+		for (int i=0; (i < 5000) && (AtomicGet(&fHead->Magic) != CACHE_MAGIC); i++)
+			usleep(1000);
+		if ((AtomicGet(&fHead->Magic) != CACHE_MAGIC) ||
+			(fHead->Version != CACHE_VERSION) || (fHead->TotalSize != Total))
+		{
+			munmap(fMem, fMemSize);
+			fMem = NULL;
+			throw ErrStream(ERR_CACHE_INVALID, Name);
+		}
+	}
+
+	fBucket = (TBucket*)((C_UInt8*)fMem + AlignUp(sizeof(THeader)));
+	fData = (C_UInt8*)fMem + AlignUp(sizeof(THeader)) +
+		fHead->NumBucket * sizeof(TBucket);
+#else
+	throw ErrStream(ERR_CACHE_UNSUPPORT);
+#endif
+}
+
+CdBlockCache::~CdBlockCache()
+{
+#ifdef COREARRAY_PLATFORM_UNIX
+	if (fMem) munmap(fMem, fMemSize);
+#endif
+	fMem = NULL;
+}
+
+bool CdBlockCache::Find(const TKey &Key, void *Buffer, C_Int64 Size)
+{
+	const C_Int64 D = fHead->DataSize;
+	const size_t mask = fHead->NumBucket - 1;
+	size_t h = KeyHash(Key);
+	for (int k=0; k < CACHE_NUM_PROBE; k++)
+	{
+		TBucket &B = fBucket[(h + k) & mask];
+		C_Int64 s = AtomicGet(&B.Seq);
+		if ((s & 1) || (B.Size != Size) || !KeyEqual(B.Key, Key))
+			continue;
+		C_Int64 Off = B.Offset;
+		if (AtomicGet(&B.Seq) != s) continue;
+		// the block is overwritten if the head is beyond one round
+		if (AtomicGet(&fHead->Head) - Off > D) break;
+		memcpy(Buffer, fData + (Off % D), Size);
+		if (AtomicGet(&fHead->Head) - Off > D) break;
+		AtomicAdd(&fHead->NumHit, 1);
+		return true;
+	}
+	AtomicAdd(&fHead->NumMiss, 1);
+	return false;
+}
+
+void CdBlockCache::Add(const TKey &Key, const void *Buffer, C_Int64 Size)
+{
+	const C_Int64 D = fHead->DataSize;
+	// a large block should not flush the cache
+	if ((Size <= 0) || (Size > D/4)) return;
+
+	_Lock();
+	// reserve the space before writing, which invalidates the old blocks
+	C_Int64 Start = fHead->Head;
+	C_Int64 p = Start % D;
+	if (p + Size > D) Start += D - p;  // not across the end of ring
+	AtomicSet(&fHead->Head, Start + AlignUp(Size));
+	memcpy(fData + (Start % D), Buffer, Size);
+
+	// the same key, an empty or stale entry, or the oldest one
+	const size_t mask = fHead->NumBucket - 1;
+	size_t h = KeyHash(Key);
+	TBucket *Dst = NULL;
+	for (int k=0; k < CACHE_NUM_PROBE; k++)
+	{
+		TBucket &B = fBucket[(h + k) & mask];
+		if ((B.Size == 0) || KeyEqual(B.Key, Key) || (Start - B.Offset > D))
+			{ Dst = &B; break; }
+		if (!Dst || (B.Offset < Dst->Offset)) Dst = &B;
+	}
+	// odd sequence number while modifying, also for a dead writer
+	AtomicSet(&Dst->Seq, AtomicGet(&Dst->Seq) | 1);
+	Dst->Key[0] = Key.Dev;   Dst->Key[1] = Key.Inode;
+	Dst->Key[2] = Key.MTime; Dst->Key[3] = Key.Pos;
+	Dst->Key[4] = Key.CmpSize;
+	Dst->Offset = Start;
+	Dst->Size = Size;
+	AtomicAdd(&Dst->Seq, 1);
+	AtomicAdd(&fHead->NumAdd, 1);
+	_Unlock();
+}
+
+C_Int64 CdBlockCache::Size() const
+{
+	return fHead->DataSize;
+}
+
+C_Int64 CdBlockCache::NumHit() const
+{
+	return AtomicGet(&fHead->NumHit);
+}
+
+C_Int64 CdBlockCache::NumMiss() const
+{
+	return AtomicGet(&fHead->NumMiss);
+}
+
+C_Int64 CdBlockCache::NumAdd() const
+{
+	return AtomicGet(&fHead->NumAdd);
+}
+
+void CdBlockCache::_Lock()
+{
+#ifdef COREARRAY_PLATFORM_UNIX
+	const C_Int64 pid = getpid();
+	for (int n=1; !AtomicCAS(&fHead->Lock, 0, pid); n++)
+	{
+		if ((n & 0xFF) == 0)
+		{
+			// take over the lock of a dead process
+			C_Int64 Owner = AtomicGet(&fHead->Lock);
+			if ((Owner > 0) && (kill((pid_t)Owner, 0) != 0) && (errno == ESRCH))
+			{
+				if (AtomicCAS(&fHead->Lock, Owner, pid))
+					return;
+			}
+		}
+		sched_yield();
+	}
+#endif
+}
+
+void CdBlockCache::_Unlock()
+{
+	AtomicSet(&fHead->Lock, 0);
+}
+
+bool CdBlockCache::FileKey(TSysHandle Handle, TKey &Key)
+{
+#ifdef COREARRAY_PLATFORM_UNIX
+	struct stat st;
+	if (fstat(Handle, &st) != 0) return false;
+	Key.Dev = st.st_dev;
+	Key.Inode = st.st_ino;
+#   if defined(COREARRAY_PLATFORM_MACOS)
+	Key.MTime = (C_Int64)st.st_mtimespec.tv_sec * 1000000000 +
+		st.st_mtimespec.tv_nsec;
+#   else
+	Key.MTime = (C_Int64)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#   endif
+	Key.Pos = Key.CmpSize = 0;
+	return true;
+#else
+	return false;
+#endif
+}
+
+void CdBlockCache::Open(const char *Name, C_Int64 Size)
+{
+	CdBlockCache *C = new CdBlockCache(Name, Size);
+	// the mapped segment counts against the memory budget, and it replaces
+	// the reservation of the current cache which is kept on failure
+	C_Int64 Old = fCurrent ? fCurrent->Size() : 0;
+	if (!CdMemGovernor::Global().Reserve(C->Size(), Old))
+	{
+		C_Int64 n = C->Size();
+		// not to leave a new segment of this size to other processes
+		if (C->fCreator) Unlink(C->Name().c_str());
+		delete C;
+		throw ErrStream(ERR_CACHE_BUDGET, Name, (long long)n);
+	}
+	CdBlockCache *P = fCurrent;
+	fCurrent = C;
+	if (P) delete P;
+}
+
+void CdBlockCache::Close()
+{
+	if (fCurrent)
+	{
+		CdBlockCache *C = fCurrent;
+		fCurrent = NULL;
+		CdMemGovernor::Global().Release(C->Size());
+		delete C;
+	}
+}
+
+void CdBlockCache::Unlink(const char *Name)
+{
+#ifdef COREARRAY_PLATFORM_UNIX
+	string nm = Name;
+	if (nm.empty() || (nm[0] != '/'))
+		nm.insert(0, "/");
+	shm_unlink(nm.c_str());
+#else
+	throw ErrStream(ERR_CACHE_UNSUPPORT);
+#endif
+}
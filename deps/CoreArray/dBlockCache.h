@@ -0,0 +1,132 @@
+// ===========================================================
+//     _/_/_/   _/_/_/  _/_/_/_/    _/_/_/_/  _/_/_/   _/_/_/
+//      _/    _/       _/             _/    _/    _/   _/   _/
+//     _/    _/       _/_/_/_/       _/    _/    _/   _/_/_/
+//    _/    _/       _/             _/    _/    _/   _/
+// _/_/_/   _/_/_/  _/_/_/_/_/     _/     _/_/_/   _/_/
+// ===========================================================
+//
+// dBlockCache.h: Cache of decoded blocks shared by local processes
+//
+// Copyright (C) 2020    Xiuwen Zheng
+//
+// This file is part of CoreArray.
+//
+// CoreArray is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License Version 3 as
+// published by the Free Software Foundation.
+//
+// CoreArray is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with CoreArray.
+// If not, see <http://www.gnu.org/licenses/>.
+
+/**
+ *	\file     dBlockCache.h
+ *	\author   Xiuwen Zheng [zhengxwen@gmail.com]
+ *	\version  1.0
+ *	\date     2020
+ *	\brief    Cache of decoded blocks shared by local processes
+ *	\details  The decoded blocks of compressed streams with random access
+ *	          are kept in a named shared memory segment, so the processes
+ *	          reading the same file decompress each block only once.
+**/
+
+#ifndef _HEADER_COREARRAY_BLOCK_CACHE_
+#define _HEADER_COREARRAY_BLOCK_CACHE_
+
+#include "dBase.h"
+
+
+namespace CoreArray
+{
+	using namespace std;
+
+	// =====================================================================
+	// Shared cache of decoded blocks
+	// =====================================================================
+
+	/// Cache of decoded blocks in a shared memory segment
+	/** The segment consists of a hash table and a ring buffer, and its size
+	 *  is the memory budget of all processes mapping it: new blocks
+	 *  overwrite the oldest ones. Lookup is lock-free, a hash entry is
+	 *  validated by its sequence number and a block by the position of the
+	 *  ring head after copying. Adding a block is serialized by a spin lock
+	 *  in the segment, and the lock of a dead process is taken over.
+	**/
+	class COREARRAY_DLL_DEFAULT CdBlockCache
+	{
+	public:
+		/// the key of a decoded block
+		struct TKey
+		{
+			C_Int64 Dev;      ///< the device of the file
+			C_Int64 Inode;    ///< the inode of the file
+			C_Int64 MTime;    ///< the modification time of the file
+			C_Int64 Pos;      ///< the file position of the compressed block
+			C_Int64 CmpSize;  ///< the size of the compressed block
+		};
+
+		/// map the shared segment 'Name', and create it with 'Size' bytes
+		/// if not existing
+		CdBlockCache(const char *Name, C_Int64 Size);
+		/// destructor, the segment is unmapped but not removed
+		~CdBlockCache();
+
+		/// copy a cached block of 'Size' bytes to Buffer, return false if
+		/// the block is not found
+		bool Find(const TKey &Key, void *Buffer, C_Int64 Size);
+		/// add a decoded block of 'Size' bytes
+		void Add(const TKey &Key, const void *Buffer, C_Int64 Size);
+
+		/// the name of the shared segment
+		COREARRAY_INLINE const string &Name() const { return fName; }
+		/// the number of bytes for decoded blocks
+		C_Int64 Size() const;
+		/// the number of successful lookups by all processes
+		C_Int64 NumHit() const;
+		/// the number of failed lookups by all processes
+		C_Int64 NumMiss() const;
+		/// the number of blocks added by all processes
+		C_Int64 NumAdd() const;
+
+		/// get the key of an open file, return false if not supported
+		static bool FileKey(TSysHandle Handle, TKey &Key);
+
+		/// the cache used by the current process, or NULL
+		COREARRAY_INLINE static CdBlockCache *Current() { return fCurrent; }
+		/// use the shared segment 'Name' in the current process
+		/** it should not be called when other threads are reading **/
+		static void Open(const char *Name, C_Int64 Size);
+		/// stop using the shared cache in the current process
+		static void Close();
+		/// remove the name of a shared segment from the system, the
+		/// processes mapping it are not affected
+		static void Unlink(const char *Name);
+
+	protected:
+		struct THeader;
+		struct TBucket;
+
+		string fName;         ///< the name of the shared segment
+		void *fMem;           ///< the mapped segment
+		size_t fMemSize;      ///< the size of the mapped segment
+		bool fCreator;        ///< whether the segment is created by this object
+		THeader *fHead;       ///< the header in the segment
+		TBucket *fBucket;     ///< the hash table in the segment
+		C_UInt8 *fData;       ///< the ring buffer in the segment
+
+		static CdBlockCache *fCurrent;
+
+	private:
+		void _Lock();
+		void _Unlock();
+	};
+
+}
+
+#endif /* _HEADER_COREARRAY_BLOCK_CACHE_ */
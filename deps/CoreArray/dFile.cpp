@@ -54,6 +54,32 @@ static const char *ERR_ATTR_NAME = "No Attribute Name ('%s').";
 static const char *ERR_ATTR_NAME_EXIST = "Attribute '%s' has existed.";
 static const char *ERR_ATTR_INVALID_NAME = "Invalid zero-length name.";
 
+/// the minimum number of attributes to use the hash index
+static const size_t ATTR_HASH_MIN_COUNT = 8;
+
+/// FNV-1a hash of an attribute name
+static C_UInt32 AttrHash(const UTF8String &name)
+{
+	C_UInt32 h = 2166136261U;
+	const char *p = name.c_str();
+	for (size_t n = name.size(); n > 0; n--, p++)
+	{
+		h ^= (C_UInt8)(*p);
+		h *= 16777619U;
+	}
+	return h;
+}
+
+CdObjAttr::TdKey::TdKey(const char *name): Name(name)
+{
+	Hash = AttrHash(Name);
+}
+
+CdObjAttr::TdKey::TdKey(const UTF8String &name): Name(name)
+{
+	Hash = AttrHash(Name);
+}
+
 CdObjAttr::CdObjAttr(CdGDSObj &vOwner): CdObject(), fOwner(vOwner)
 { }
 
@@ -77,21 +103,25 @@ void CdObjAttr::Assign(CdObjAttr &Source)
 	{
 		TdPair *I = new TdPair;
 		I->name = Source.Names(i);
+		I->hash = Source.fList[i]->hash;
 		fList.push_back(I);
 		Changed();
 		I->val = Source[i];
 	}
+	fIndex.clear();
 }
 
 CdAny &CdObjAttr::Add(const UTF8String &Name)
 {
 	_ValidateName(Name);
-	vector<TdPair*>::iterator it = _Find(Name);
-	if (it == fList.end())
+	C_UInt32 h = AttrHash(Name);
+	if (_Find(Name, h) < 0)
 	{
 		TdPair *I = new TdPair;
 		I->name = Name;
+		I->hash = h;
 		fList.push_back(I);
+		fIndex.clear();
 		Changed();
 		return I->val;
 	} else
@@ -100,11 +130,14 @@ CdAny &CdObjAttr::Add(const UTF8String &Name)
 
 int CdObjAttr::IndexName(const UTF8String &Name)
 {
-	vector<TdPair*>::iterator it = _Find(Name);
-	if (it != fList.end())
-    	return it - fList.begin();
-	else
-		return -1;
+	if (fList.empty()) return -1;
+	return _Find(Name, AttrHash(Name));
+}
+
+int CdObjAttr::IndexName(const TdKey &Key)
+{
+	if (fList.empty()) return -1;
+	return _Find(Key.Name, Key.Hash);
 }
 
 bool CdObjAttr::HasName(const UTF8String &Name)
@@ -112,16 +145,17 @@ bool CdObjAttr::HasName(const UTF8String &Name)
 	return (IndexName(Name) >= 0);
 }
 
+bool CdObjAttr::HasName(const TdKey &Key)
+{
+	return (IndexName(Key) >= 0);
+}
+
 void CdObjAttr::Delete(const UTF8String &Name)
 {
-	vector<TdPair*>::iterator it = _Find(Name);
-	if (it == fList.end())
+	int i = IndexName(Name);
+	if (i < 0)
 		throw ErrGDSObj(ERR_ATTR_NAME, Name.c_str());
-	TdPair *p = *it;
-	*it = NULL;
-	fList.erase(it);
-	delete p;
-	Changed();
+	Delete(i);
 }
 
 void CdObjAttr::Delete(int Index)
@@ -130,6 +164,7 @@ void CdObjAttr::Delete(int Index)
 	TdPair *p = fList[Index];
 	fList[Index] = NULL;
     fList.erase(fList.begin() + Index);
+	fIndex.clear();
 	delete p;
 	Changed();
 }
@@ -146,6 +181,7 @@ void CdObjAttr::Clear()
 			delete p;
 		}
 		fList.clear();
+		fIndex.clear();
 		Changed();
 	}
 }
@@ -153,14 +189,23 @@ void CdObjAttr::Clear()
 void CdObjAttr::Changed()
 {
 	this->fOwner.fChanged = true;
+	this->fOwner._SetDirty();
 }
 
 CdAny & CdObjAttr::operator[](const UTF8String &Name)
 {
-	vector<TdPair*>::iterator it = _Find(Name);
-	if (it == fList.end())
+	int i = IndexName(Name);
+	if (i < 0)
 		throw ErrGDSObj(ERR_ATTR_NAME, Name.c_str());
-	return (*it)->val;
+	return fList[i]->val;
+}
+
+CdAny & CdObjAttr::operator[](const TdKey &Key)
+{
+	int i = IndexName(Key);
+	if (i < 0)
+		throw ErrGDSObj(ERR_ATTR_NAME, Key.Name.c_str());
+	return fList[i]->val;
 }
 
 CdAny & CdObjAttr::operator[](int Index)
@@ -172,6 +217,7 @@ void CdObjAttr::Loading(CdReader &Reader, TdVersion Version)
 {
 	C_Int32 Cnt;
 	Reader[VAR_ATTRCNT] >> Cnt;
+	fIndex.clear();
 	if (!fList.empty())
 	{
 		vector<TdPair*>::iterator it;
@@ -192,6 +238,7 @@ void CdObjAttr::Loading(CdReader &Reader, TdVersion Version)
 			TdPair *I = new TdPair;
 			try {
 				I->name = UTF16ToUTF8(Reader.Storage().RpUTF16()); // TODO
+				I->hash = AttrHash(I->name);
 				Reader >> I->val;
 			} catch (...) {
 				delete I;
@@ -220,30 +267,55 @@ void CdObjAttr::Saving(CdWriter &Writer)
 	}
 }
 
-vector<CdObjAttr::TdPair*>::iterator CdObjAttr::_Find(const UTF8String &Name)
+int CdObjAttr::_Find(const UTF8String &Name, C_UInt32 Hash)
 {
-	vector<TdPair*>::iterator it;
-	for (it = fList.begin(); it != fList.end(); it++)
+	const size_t n = fList.size();
+	if (n < ATTR_HASH_MIN_COUNT)
 	{
-		if ((*it)->name == Name)
-			break;
+		// a few attributes, linear scan comparing hash codes first
+		for (size_t i=0; i < n; i++)
+		{
+			TdPair *p = fList[i];
+			if ((p->hash == Hash) && (p->name == Name))
+				return i;
+		}
+		return -1;
+	}
+
+	if (fIndex.empty()) _BuildIndex();
+	const size_t mask = fIndex.size() - 1;
+	for (size_t k = Hash & mask; ; k = (k + 1) & mask)
+	{
+		C_Int32 i = fIndex[k];
+		if (i < 0) return -1;
+		TdPair *p = fList[i];
+		if ((p->hash == Hash) && (p->name == Name))
+			return i;
+	}
+}
+
+void CdObjAttr::_BuildIndex()
+{
+	// a power of two, at most half full
+	size_t sz = 16;
+	while (sz < 2*fList.size()) sz <<= 1;
+	fIndex.assign(sz, -1);
+	const size_t mask = sz - 1;
+	for (size_t i=0; i < fList.size(); i++)
+	{
+		size_t k = fList[i]->hash & mask;
+		while (fIndex[k] >= 0) k = (k + 1) & mask;
+		fIndex[k] = i;
 	}
-	return it;
 }
 
 void CdObjAttr::SetName(const UTF8String &OldName, const UTF8String &NewName)
 {
 	_ValidateName(NewName);
-	vector<TdPair*>::iterator it = _Find(OldName);
-	if (it == fList.end())
+	int i = IndexName(OldName);
+	if (i < 0)
 		throw ErrGDSObj(ERR_ATTR_NAME, OldName.c_str());
-	if (OldName != NewName)
-	{
-		if (HasName(NewName))
-			throw ErrGDSObj(ERR_ATTR_NAME_EXIST, NewName.c_str());
-		(*it)->name = NewName;
-		Changed();
-	}
+	SetName(i, NewName);
 }
 
 void CdObjAttr::SetName(int Index, const UTF8String &NewName)
@@ -255,6 +327,8 @@ void CdObjAttr::SetName(int Index, const UTF8String &NewName)
 		if (HasName(NewName))
 			throw ErrGDSObj(ERR_ATTR_NAME_EXIST, NewName.c_str());
 		p.name = NewName;
+		p.hash = AttrHash(NewName);
+		fIndex.clear();
 		Changed();
 	}
 }
@@ -286,7 +360,7 @@ CdGDSObj::CdGDSObj(): CdObjMsg(), fAttr(*this)
 {
 	fFolder = NULL;
 	fGDSStream = NULL;
-	fChanged = false;
+	fChanged = fDirty = false;
 }
 
 CdGDSObj::~CdGDSObj()
@@ -341,8 +415,14 @@ void CdGDSObj::SetName(const UTF8String &NewName)
 			{
 				if (fFolder->_HasName(NewName))
 					throw ErrGDSObj(ERR_DUP_NAME);
+				if (fFolder->fIndexed)
+				{
+					fFolder->fNameIndex.erase(it->Name);
+					fFolder->fNameIndex[NewName] = it - fFolder->fList.begin();
+				}
 				it->Name = NewName;
 				fFolder->fChanged = true;
+				fFolder->_SetDirty();
 			}
 			return;
 		}
@@ -381,6 +461,7 @@ void CdGDSObj::SetHidden(bool hidden)
 				else
 					it->Flag &= ~CdGDSFolder::TNode::FLAG_ATTR_HIDDEN;
 				fFolder->fChanged = true;
+				fFolder->_SetDirty();
 			}
 			return;
 		}
@@ -408,9 +489,14 @@ void CdGDSObj::MoveTo(CdGDSFolder &folder)
 				if (folder._HasName(it->Name))
 					throw ErrGDSObj(ERR_DUP_NAME);
 				folder.fList.push_back(*it);
+				folder._ListChanged();
 				fFolder->fList.erase(it);
+				fFolder->_ListChanged();
 				fFolder->fChanged = folder.fChanged = true;
+				fFolder->_SetDirty();
 				fFolder = &folder;
+				// the new parent folders have not been marked yet
+				_MarkDirty();
 			}
 		} else
 			throw ErrGDSObj(ERR_SAME_FILE);
@@ -474,6 +560,11 @@ void CdGDSObj::SaveStruct(CdWriter &Writer, bool IncludeName)
 	fChanged = false;
 }
 
+void CdGDSObj::Reloading(CdReader &Reader, TdVersion Version)
+{
+	COREARRAY_READER_CALL_SILENT(fAttr.Loading(Reader, Version));
+}
+
 void CdGDSObj::SaveToBlockStream()
 {
 	_CheckGDSStream();
@@ -501,6 +592,25 @@ void CdGDSObj::_CheckWritable()
 		throw ErrGDSObj(ERR_GDS_READONLY);
 }
 
+void CdGDSObj::_MarkDirty()
+{
+	fDirty = true;
+	CdGDSObj *p = this;
+	while (true)
+	{
+		CdGDSObj *up = p->fFolder;
+		if (!up)
+		{
+			// the root of a GDS file linked by a virtual folder
+			CdGDSRoot *root = dynamic_cast<CdGDSRoot*>(p);
+			if (root) up = root->fVFolder;
+		}
+		if (!up || up->fDirty) break;
+		up->fDirty = true;
+		p = up;
+	}
+}
+
 void CdGDSObj::_CheckGDSStream()
 {
 	if (!fGDSStream)
@@ -634,6 +744,45 @@ namespace CoreArray
 	};
 
 
+	/// The pipe for appending data to a closed stream with random access
+	template<typename CLASS>
+		class COREARRAY_DLL_DEFAULT CdAppendPipe: public CdStreamPipe
+	{
+	public:
+		CdAppendPipe(CdRecodeStream::TLevel vLevel,
+				CdRAAlgorithm::TBlockSize bs, bool vDropLast,
+				TdCompressRemainder &vRemainder):
+			CdStreamPipe(), fRemainder(vRemainder)
+		{
+			fLevel = vLevel;
+			fBSize = bs;
+			fDropLast = vDropLast;
+		}
+
+	protected:
+		CdStream *fStream;
+		CLASS *fPStream;
+		CdRecodeStream::TLevel fLevel;
+		CdRAAlgorithm::TBlockSize fBSize;
+		bool fDropLast;
+		TdCompressRemainder &fRemainder;
+
+		virtual CdStream *InitPipe(CdBufStream *BufStream)
+		{
+			fStream = BufStream->Stream();
+			fPStream = new CLASS(*fStream, fLevel, fBSize,
+				fDropLast ? CdRA_Write::wmDropLast : CdRA_Write::wmAppend);
+			fPStream->PtrExtRec = &fRemainder;
+			return fPStream;
+		}
+		virtual CdStream *FreePipe()
+		{
+			if (fPStream) { fPStream->Release(); fPStream = NULL; }
+			return fStream;
+		}
+	};
+
+
 	/// The pipe system with a template
 	template<int MaxBVal, int DefBVal, typename BSIZE,
 		typename CLASS, typename TYPE>
@@ -848,6 +997,13 @@ namespace CoreArray
 			{ buf.PushPipe(new CdZRAReadPipe); }
 		virtual void PushWritePipe(CdBufStream &buf)
 			{ buf.PushPipe(new CdZRAWritePipe(fLevel, fBlockSize, fRemainder)); }
+		virtual bool PushAppendPipe(CdBufStream &buf, bool DropLast)
+		{
+			if ((fLevel < 0) || (fBlockSize < 0)) return false;
+			buf.PushPipe(new CdAppendPipe<CdZEncoder_RA>(fLevel, fBlockSize,
+				DropLast, fRemainder));
+			return true;
+		}
 
 	protected:
 		virtual const char **CoderList() const { return ZRA_Strings; }
@@ -929,6 +1085,13 @@ namespace CoreArray
 			{ buf.PushPipe(new CdLZ4RAReadPipe); }
 		virtual void PushWritePipe(CdBufStream &buf)
 			{ buf.PushPipe(new CdLZ4RAWritePipe(fLevel, fBlockSize, fRemainder)); }
+		virtual bool PushAppendPipe(CdBufStream &buf, bool DropLast)
+		{
+			if ((fLevel < 0) || (fBlockSize < 0)) return false;
+			buf.PushPipe(new CdAppendPipe<CdLZ4Encoder_RA>(fLevel, fBlockSize,
+				DropLast, fRemainder));
+			return true;
+		}
 
 	protected:
 		virtual const char **CoderList() const { return LZ4RA_Strings; }
@@ -998,6 +1161,13 @@ namespace CoreArray
 			{ buf.PushPipe(new CdXZReadPipe_RA); }
 		virtual void PushWritePipe(CdBufStream &buf)
 			{ buf.PushPipe(new CdXZWritePipe_RA(fLevel, fBlockSize, fRemainder)); }
+		virtual bool PushAppendPipe(CdBufStream &buf, bool DropLast)
+		{
+			if ((fLevel < 0) || (fBlockSize < 0)) return false;
+			buf.PushPipe(new CdAppendPipe<CdXZEncoder_RA>(fLevel, fBlockSize,
+				DropLast, fRemainder));
+			return true;
+		}
 
 	protected:
 		virtual const char **CoderList() const { return XZ_RA_Strings; }
@@ -1029,6 +1199,11 @@ void CdPipeMgrItem::UpdateStreamSize()
 		fOwner->GetPipeInfo();
 }
 
+bool CdPipeMgrItem::PushAppendPipe(CdBufStream &buf, bool DropLast)
+{
+	return false;
+}
+
 void CdPipeMgrItem::LoadStream(CdReader &Reader, TdVersion Version) { }
 
 void CdPipeMgrItem::SaveStream(CdWriter &Writer) { }
@@ -1229,6 +1404,7 @@ CdGDSObjPipe *CdGDSObjPipe::AssignPipe(CdGDSObjPipe &Source)
 	if (Source.fPipeInfo)
 		fPipeInfo = Source.fPipeInfo->New();
 	fChanged = true;
+	_SetDirty();
 	return this;
 }
 
@@ -1262,6 +1438,11 @@ void CdGDSObjPipe::Saving(CdWriter &Writer)
 	}
 }
 
+void CdGDSObjPipe::Recompress(const char *Mode, int NumThread)
+{
+	SetPackedMode(Mode);
+}
+
 void CdGDSObjPipe::GetPipeInfo() {}
 
 
@@ -1329,6 +1510,11 @@ void CdGDSFolder::TNode::SetFlagAttr(C_UInt32 val)
 }
 
 
+CdGDSFolder::CdGDSFolder(): CdGDSAbsFolder()
+{
+	fIndexed = false;
+}
+
 CdGDSFolder::~CdGDSFolder()
 {
     _ClearFolder();
@@ -1383,7 +1569,13 @@ CdGDSObj *CdGDSFolder::AddFolder(const UTF8String &Name)
 	I.StreamID = rv->fGDSStream->ID();
 	I.SetFlagType(CdGDSFolder::TNode::FLAG_TYPE_FOLDER);
 	fList.push_back(I);
+	if (fIndexed)
+	{
+		fNameIndex[Name] = fList.size() - 1;
+		fObjIndex[rv] = fList.size() - 1;
+	}
 	fChanged = true;
+	rv->_MarkDirty();
 
 	return rv;
 }
@@ -1444,11 +1636,21 @@ CdGDSObj *CdGDSFolder::InsertObj(int index, const UTF8String &Name,
 		throw ErrGDSObj(ERR_INVALID_ASSOC);
 
 	I.Name = Name; I.Obj = val;
-	if (index < 0)
+	if ((index < 0) || (index >= (int)fList.size()))
+	{
 		fList.push_back(I);
-	else
+		if (fIndexed)
+		{
+			fNameIndex[Name] = fList.size() - 1;
+			fObjIndex[val] = fList.size() - 1;
+		}
+	} else {
 		fList.insert(fList.begin()+index, I);
+		_ListChanged();
+	}
 	fChanged = true;
+	// 'val' may have been modified before it has a parent folder
+	val->_MarkDirty();
 
 	return val;
 }
@@ -1475,8 +1677,10 @@ void CdGDSFolder::MoveTo(int Index, int NewPos)
 			fList.erase(fList.begin() + Index);
 			fList.insert(fList.begin() + NewPos, ND);
 		}
+		_ListChanged();
 
 		fChanged = true;
+		_SetDirty();
 	}
 }
 
@@ -1493,6 +1697,8 @@ void CdGDSFolder::UnloadObj(int Index)
 
 		if (dynamic_cast<CdGDSAbsFolder*>(it->Obj))
 			throw ErrGDSObj(ERR_IS_FOLDER);
+		// the address may be reused by another object
+		fObjIndex.erase(it->Obj);
 	#ifdef COREARRAY_CODE_DEBUG
 		if (it->Obj->Release() != 0)
 			throw ErrGDSObj(ERR_UNLOAD, (void*)(it->Obj));
@@ -1521,9 +1727,14 @@ void CdGDSFolder::UnloadObj(CdGDSObj *val)
 
 void CdGDSFolder::DeleteObj(int Index, bool force)
 {
+	static const char *ERR_SWMR_DELETE =
+		"Deleting a GDS node is not allowed in the SWMR mode.";
+
 	if ((Index < 0) || (Index >= (int)fList.size()))
 		throw ErrGDSObj(ERR_OBJ_INDEX, Index);
 	_CheckWritable();
+	if (GDSFile() && GDSFile()->fSWMRWrite)
+		throw ErrGDSObj(ERR_SWMR_DELETE);
 
 	vector<TNode>::iterator it = fList.begin() + Index;
 	_LoadItem(*it);
@@ -1569,23 +1780,18 @@ void CdGDSFolder::DeleteObj(int Index, bool force)
 	}
 
     fList.erase(it);
+	_ListChanged();
 	fChanged = true;
+	_SetDirty();
 }
 
 void CdGDSFolder::DeleteObj(CdGDSObj *val, bool force)
 {
 	if (val == NULL) return;
-	vector<CdGDSFolder::TNode>::iterator it;
-	int Index = 0;
-	for (it = fList.begin(); it != fList.end(); it++, Index++)
-	{
-		if (it->Obj == val)
-		{
-			DeleteObj(Index, force);
-			return;
-		}
-	}
-	throw ErrGDSObj();
+	int Index = _IndexObj(val);
+	if (Index < 0)
+		throw ErrGDSObj();
+	DeleteObj(Index, force);
 }
 
 void CdGDSFolder::ClearObj(bool force)
@@ -1649,16 +1855,11 @@ CdGDSObj *CdGDSFolder::ObjItemEx(int Index)
 
 CdGDSObj *CdGDSFolder::ObjItemEx(const UTF8String &Name)
 {
-	vector<CdGDSFolder::TNode>::iterator it;
-	for (it = fList.begin(); it != fList.end(); it++)
-	{
-		if (it->Name == Name)
-		{
-			_LoadItem(*it);
-			return it->Obj;
-		}
-	}
-	return NULL;
+	int i = _IndexName(Name);
+	if (i < 0) return NULL;
+	CdGDSFolder::TNode &I = fList[i];
+	_LoadItem(I);
+	return I.Obj;
 }
 
 CdGDSObj *CdGDSFolder::Path(const UTF8String &FullName)
@@ -1694,13 +1895,9 @@ CdGDSObj *CdGDSFolder::PathEx(const UTF8String &FullName)
 
 int CdGDSFolder::IndexObj(CdGDSObj *Obj)
 {
-	vector<CdGDSObj*> lst;
-	for (size_t i=0; i < fList.size(); i++)
-	{
-		if (Obj == ObjItem(i))
-			return i;
-	}
-	return -1;
+	// an object not loaded yet is not a child
+	if (Obj == NULL) return -1;
+	return _IndexObj(Obj);
 }
 
 bool CdGDSFolder::HasChild(CdGDSObj *Obj, bool Recursive)
@@ -1735,6 +1932,7 @@ void CdGDSFolder::Loading(CdReader &Reader, TdVersion Version)
 {
 	// Load directory inforamtion
 	fList.clear();
+	_ListChanged();
 	C_Int32 L = 0;
 	Reader[VAR_DIRCNT] >> L;
 
@@ -1788,6 +1986,40 @@ void CdGDSFolder::Saving(CdWriter &Writer)
 	CdGDSAbsFolder::Saving(Writer);
 }
 
+void CdGDSFolder::Reloading(CdReader &Reader, TdVersion Version)
+{
+	vector<TNode> Old;
+	Old.swap(fList);
+	try {
+		Loading(Reader, Version);
+	} catch (...) {
+		fList.swap(Old);
+		_ListChanged();
+		throw;
+	}
+
+	// keep the loaded objects
+	vector<TNode>::iterator it, p;
+	for (it = fList.begin(); it != fList.end(); it++)
+	{
+		for (p = Old.begin(); p != Old.end(); p++)
+		{
+			if (p->Obj && (p->StreamID == it->StreamID))
+			{
+				it->Obj = p->Obj;
+				p->Obj = NULL;
+				break;
+			}
+		}
+	}
+	// the objects removed by the writer
+	for (p = Old.begin(); p != Old.end(); p++)
+		if (p->Obj) p->Obj->Release();
+	_ListChanged();
+
+	CdGDSObj::Reloading(Reader, Version);
+}
+
 void CdGDSFolder::_ClearFolder()
 {
 	vector<CdGDSFolder::TNode>::iterator it;
@@ -1804,15 +2036,12 @@ void CdGDSFolder::_ClearFolder()
 		}
 	}
 	fList.clear();
+	_ListChanged();
 }
 
 bool CdGDSFolder::_HasName(const UTF8String &Name)
 {
-	vector<CdGDSFolder::TNode>::iterator it;
-	for (it = fList.begin(); it != fList.end(); it++)
-		if (it->Name == Name)
-			return true;
-	return false;
+	return _IndexName(Name) >= 0;
 }
 
 bool CdGDSFolder::_ValidName(const UTF8String &Name)
@@ -1827,11 +2056,59 @@ bool CdGDSFolder::_ValidName(const UTF8String &Name)
 
 CdGDSFolder::TNode &CdGDSFolder::_NameItem(const UTF8String &Name)
 {
-	vector<CdGDSFolder::TNode>::iterator it;
-	for (it = fList.begin(); it != fList.end(); it++)
-		if (it->Name == Name)
-			return *it;
-	throw ErrGDSObj(ERR_FOLDER_NAME, Name.c_str());
+	int i = _IndexName(Name);
+	if (i < 0)
+		throw ErrGDSObj(ERR_FOLDER_NAME, Name.c_str());
+	return fList[i];
+}
+
+/// the minimum number of items to index a folder
+static const size_t FOLDER_INDEX_MIN_COUNT = 32;
+
+int CdGDSFolder::_IndexName(const UTF8String &Name) const
+{
+	if (_BuildIndex())
+	{
+		map<UTF8String, size_t>::const_iterator it = fNameIndex.find(Name);
+		return (it != fNameIndex.end()) ? (int)it->second : -1;
+	}
+	for (size_t i=0; i < fList.size(); i++)
+		if (fList[i].Name == Name) return i;
+	return -1;
+}
+
+int CdGDSFolder::_IndexObj(const CdGDSObj *Obj) const
+{
+	if (_BuildIndex())
+	{
+		map<const CdGDSObj*, size_t>::const_iterator it = fObjIndex.find(Obj);
+		if (it != fObjIndex.end()) return it->second;
+	}
+	// objects are added to the index when loaded, a linear scan is kept
+	// for the ones which failed to load
+	for (size_t i=0; i < fList.size(); i++)
+	{
+		if (fList[i].Obj == Obj)
+		{
+			if (fIndexed && Obj) fObjIndex[Obj] = i;
+			return i;
+		}
+	}
+	return -1;
+}
+
+bool CdGDSFolder::_BuildIndex() const
+{
+	if (fIndexed) return true;
+	if (fList.size() < FOLDER_INDEX_MIN_COUNT) return false;
+	for (size_t i=0; i < fList.size(); i++)
+	{
+		const TNode &I = fList[i];
+		fNameIndex.insert(pair<UTF8String, size_t>(I.Name, i));
+		if (I.Obj) fObjIndex[I.Obj] = i;
+	}
+	fIndexed = true;
+	return true;
 }
 
 void CdGDSFolder::_LoadItem(TNode &I)
@@ -1843,7 +2120,10 @@ void CdGDSFolder::_LoadItem(TNode &I)
 	{
 		_CheckGDSStream();
 		CdBlockStream *IStream = fGDSStream->Collection()[I.StreamID];
-		CdReader Reader(IStream, &GDSFile()->Log());
+		// the header published by a SWMR writer if any
+		TdAutoRef<CdStream> HStream(GDSFile()->_SWMRHeader(I.StreamID));
+		CdReader Reader(HStream.get() ? HStream.get() : IStream,
+			&GDSFile()->Log());
 
 		if (I.IsFlagType(CdGDSFolder::TNode::FLAG_TYPE_LABEL))
 		{
@@ -1934,24 +2214,33 @@ void CdGDSFolder::_LoadItem(TNode &I)
 		}
 
 		I.Obj->AddRef();
+		if (fIndexed) fObjIndex[I.Obj] = &I - &fList[0];
 	}
 }
 
-void CdGDSFolder::_UpdateAll()
+void CdGDSFolder::_UpdateAll(vector<CdGDSObj*> *Synced)
 {
+	// clear the flag first, objects may be marked again when synchronizing
+	fDirty = false;
 	if (fChanged)
+	{
 		SaveToBlockStream();
+		if (Synced) Synced->push_back(this);
+	}
 
 	vector<CdGDSFolder::TNode>::iterator it;
 	for (it = fList.begin(); it != fList.end(); it++)
 	{
-		if (it->Obj)
+		// skip the unloaded and unmodified objects
+		if (it->Obj && it->Obj->fDirty)
 		{
 			if (dynamic_cast<CdGDSFolder*>(it->Obj))
 			{
-				static_cast<CdGDSFolder*>(it->Obj)->_UpdateAll();
+				static_cast<CdGDSFolder*>(it->Obj)->_UpdateAll(Synced);
 			} else {
+				it->Obj->fDirty = false;
 				it->Obj->Synchronize();
+				if (Synced) Synced->push_back(it->Obj);
 			}
 		}
 	}
@@ -1959,25 +2248,15 @@ void CdGDSFolder::_UpdateAll()
 
 vector<CdGDSFolder::TNode>::iterator CdGDSFolder::FindObj(CdGDSObj *Obj)
 {
-	vector<TNode>::iterator it  = fList.begin();
-	vector<TNode>::iterator end = fList.end();
-	for (; it != end; it++)
-	{
-		if (it->Obj == Obj) break;
-	}
-	return it;
+	int i = _IndexObj(Obj);
+	return (i >= 0) ? (fList.begin() + i) : fList.end();
 }
 
 vector<CdGDSFolder::TNode>::const_iterator CdGDSFolder::FindObj(
 	const CdGDSObj *Obj) const
 {
-	vector<TNode>::const_iterator it  = fList.begin();
-	vector<TNode>::const_iterator end = fList.end();
-	for (; it != end; it++)
-	{
-		if (it->Obj == Obj) break;
-	}
-	return it;
+	int i = _IndexObj(Obj);
+	return (i >= 0) ? (fList.begin() + i) : fList.end();
 }
 
 
@@ -2085,6 +2364,7 @@ void CdGDSVirtualFolder::SetLinkFile(const UTF8String &FileName)
 		fLinkFileName = FileName;
 		fHasTried = false;
 		fChanged = true;
+		_SetDirty();
 		fErrMsg.clear();
 	}
 }
@@ -2219,8 +2499,8 @@ void CdGDSVirtualFolder::Saving(CdWriter &Writer)
 void CdGDSVirtualFolder::Synchronize()
 {
 	CdGDSAbsFolder::Synchronize();
-	if (fLinkFile)
-		fLinkFile->fRoot.Synchronize();
+	if (fLinkFile && !fLinkFile->ReadOnly())
+		fLinkFile->SyncFile();
 }
 
 
@@ -2566,6 +2846,17 @@ static const char *ERR_GDS_OPEN_MODE = "Invalid open mode in CdGDSFile.";
 static const char *ERR_GDS_MAGIC     = "Invalid magic number!";
 static const char *ERR_GDS_ENTRY     = "Invalid entry point(0x%04X).";
 static const char *ERR_GDS_SAVE      = "Should save it to a GDS file first!";
+static const char *ERR_GDS_SWMR      = "Not allowed in the SWMR mode.";
+static const char *ERR_SWMR_FORMAT   = "Invalid SWMR snapshot (v%d).";
+static const char *ERR_SWMR_OPEN     =
+	"Fails to read a consistent SWMR snapshot, please try again.";
+
+/// the block ID reserved for the snapshots in the SWMR mode
+static const C_UInt32 SWMR_BLOCK_ID = 0xFFFFFFFE;
+/// the format version of the SWMR snapshot
+static const C_UInt8 SWMR_VERSION = 1;
+/// the number of attempts to read a snapshot when opening a file
+static const int SWMR_OPEN_RETRY = 10000;
 
 #ifdef COREARRAY_CODE_DEBUG
 static const char *ERR_GDS_STREAM    = "The GDS file has been saved.";
@@ -2584,6 +2875,9 @@ void CdGDSFile::_Init()
 	fReadOnly = false;
 	fLog = new CdLogRecord; fLog->AddRef();
 	fprocess_id = GetCurrentProcessID();
+	fSWMRStream = NULL;
+	fSWMRGen = 0;
+	fSWMRWrite = false;
 }
 
 CdGDSFile::CdGDSFile(): CdBlockCollection()
@@ -2668,6 +2962,25 @@ void CdGDSFile::LoadStream(CdStream *Stream, bool ReadOnly, bool AllowError)
 		(int)BlockList().size(), Entry.Get());
 #endif
 
+	// the snapshots of a SWMR writer
+	if (HaveID(SWMR_BLOCK_ID))
+	{
+		fSWMRStream = (*this)[SWMR_BLOCK_ID];
+		if (fSWMRStream->List())
+		{
+			if (!ReadOnly)
+			{
+				// an ordinary writer invalidates the snapshot of any
+				// previous SWMR writer
+				_SetSWMRGen(0);
+			} else {
+				// the writer may be modifying the file, so the block
+				// directory and node headers are taken from the snapshot
+				_LoadSWMR();
+			}
+		}
+	}
+
 	if (HaveID(Entry))
 	{
 		fRoot.fGDSStream = (*this)[Entry];
@@ -2679,7 +2992,9 @@ void CdGDSFile::LoadStream(CdStream *Stream, bool ReadOnly, bool AllowError)
 			(double)fRoot.fGDSStream->Size());
 	#endif
 
-		CdReader Reader(fRoot.fGDSStream, &Log());
+		TdAutoRef<CdStream> HStream(_SWMRHeader(Entry));
+		CdReader Reader(HStream.get() ? HStream.get() : fRoot.fGDSStream,
+			&Log());
 		Reader.BeginNameSpace();
 		_INTERNAL::CdObject_LoadStruct(fRoot, Reader, fVersion);
 		Reader.EndStruct();
@@ -2741,11 +3056,294 @@ void CdGDSFile::LoadFileFork(const char *fn, bool ReadOnly, bool AllowError)
 	fFileName = UTF8Text(fn);
 }
 
-void CdGDSFile::SyncFile()
+C_Int64 CdGDSFile::SyncFile()
+{
+	if (fStream == NULL)
+		throw ErrGDSFile(ERR_GDS_SAVE);
+	C_Int64 n = fBytesWritten;
+	if (fRoot.fDirty || fRoot.fChanged)
+	{
+		if (fSWMRWrite)
+		{
+			// an odd generation tells the readers a snapshot is in progress
+			_SetSWMRGen(fSWMRGen + 1);
+			vector<CdGDSObj*> List;
+			fRoot._UpdateAll(&List);
+			_PublishSWMR(List);
+		} else
+			fRoot._UpdateAll();
+	}
+	return fBytesWritten - n;
+}
+
+void CdGDSFile::StartSWMR()
+{
+	if (fStream == NULL)
+		throw ErrGDSFile(ERR_GDS_SAVE);
+	if (fReadOnly)
+		throw ErrGDSFile(ERR_GDS_READONLY);
+	if (fSWMRWrite) return;
+
+	SyncFile();
+	if (fSWMRStream)
+	{
+		// continue the generations of a previous writer
+		fSWMRGen = fSWMRStream->List() ? _SWMRGen() : 0;
+		fSWMRGen = (fSWMRGen + 1) & ~C_Int64(1);
+	} else {
+		fSWMRStream = NewBlockStream(SWMR_BLOCK_ID);
+		fSWMRGen = 0;
+	}
+	fSWMRItems.clear();
+	fSWMRWrite = true;
+	_PublishSWMR(vector<CdGDSObj*>());
+}
+
+bool CdGDSFile::RefreshSWMR()
 {
 	if (fStream == NULL)
 		throw ErrGDSFile(ERR_GDS_SAVE);
-	fRoot._UpdateAll();
+	if (fSWMRWrite || !fSWMRStream || !fSWMRStream->List())
+		return false;
+
+	// generation 0: no writer has published since the file was modified
+	C_Int64 Gen = _SWMRGen();
+	if ((Gen & 1) || (Gen == 0) || (Gen == fSWMRGen))
+		return false;
+
+	TdAutoRef<CdMemoryStream> M(new CdMemoryStream);
+	if (!_ReadSWMR(Gen, *M))
+		return false;
+	_ApplySWMR(*M);
+	fSWMRGen = Gen;
+	return true;
+}
+
+bool CdGDSFile::_ReadSWMR(C_Int64 Gen, CdMemoryStream &Snapshot)
+{
+	// read the snapshot, and check whether it was overwritten meanwhile
+	try {
+		LoadBlockChain(*fSWMRStream);
+		Snapshot.SetSize(fSWMRStream->GetSize());
+		fSWMRStream->SetPosition(0);
+		fSWMRStream->ReadData(Snapshot.BufPointer(), fSWMRStream->GetSize());
+	} catch (exception &E) {
+		if (_SWMRGen() != Gen) return false;
+		throw;
+	}
+	return (_SWMRGen() == Gen);
+}
+
+void CdGDSFile::_LoadSWMR()
+{
+	for (int k=0; k < SWMR_OPEN_RETRY; k++)
+	{
+		// generation 0: no writer has published since the file was modified
+		C_Int64 Gen = _SWMRGen();
+		if (Gen == 0) return;
+		// odd: a snapshot is being written
+		if (Gen & 1) continue;
+		TdAutoRef<CdMemoryStream> M(new CdMemoryStream);
+		if (_ReadSWMR(Gen, *M))
+		{
+			_ApplySWMR(*M);
+			fSWMRGen = Gen;
+			return;
+		}
+	}
+	throw ErrGDSFile(ERR_SWMR_OPEN);
+}
+
+C_Int64 CdGDSFile::_SWMRGen()
+{
+	C_Int64 Gen = 0;
+	fStream->SetPosition(fSWMRStream->List()->StreamStart);
+	BYTE_LE<CdStream>(fStream) >> Gen;
+	return Gen;
+}
+
+void CdGDSFile::_SetSWMRGen(C_Int64 Gen)
+{
+	fStream->SetPosition(fSWMRStream->List()->StreamStart);
+	BYTE_LE<CdStream>(fStream) << Gen;
+}
+
+void CdGDSFile::_PublishSWMR(const vector<CdGDSObj*> &List)
+{
+	const C_Int64 Gen = fSWMRGen + 2;
+
+	// the headers of synchronized nodes
+	vector<CdGDSObj*>::const_iterator it;
+	for (it = List.begin(); it != List.end(); it++)
+	{
+		CdBlockStream *s = (*it)->fGDSStream;
+		if (!s) continue;
+		TSWMRItem &I = fSWMRItems[s->ID().Get()];
+		I.Gen = Gen;
+		I.Data.resize(s->GetSize());
+		s->SetPosition(0);
+		if (!I.Data.empty())
+			s->ReadData(&I.Data[0], I.Data.size());
+	}
+
+	// the snapshot
+	TdAutoRef<CdMemoryStream> M(new CdMemoryStream);
+	BYTE_LE<CdStream> W(M.get());
+	W << C_Int64(Gen - 1) << SWMR_VERSION;
+	// block directory, except the snapshot itself
+	W << C_Int32(fBlockList.size() - 1);
+	vector<CdBlockStream*>::const_iterator b;
+	for (b = fBlockList.begin(); b != fBlockList.end(); b++)
+	{
+		if (*b == fSWMRStream) continue;
+		C_Int32 n = 0;
+		const CdBlockStream::TBlockInfo *p;
+		for (p = (*b)->List(); p; p = p->Next) n++;
+		W << (*b)->ID().Get() << C_Int64((*b)->GetSize()) << n;
+		for (p = (*b)->List(); p; p = p->Next)
+			W << C_Int64(p->StreamStart) << C_Int64(p->BlockSize);
+	}
+	// node headers
+	W << C_Int32(fSWMRItems.size());
+	map<C_UInt32, TSWMRItem>::const_iterator i;
+	for (i = fSWMRItems.begin(); i != fSWMRItems.end(); i++)
+	{
+		W << i->first << i->second.Gen << C_Int32(i->second.Data.size());
+		if (!i->second.Data.empty())
+			M->WriteData(&i->second.Data[0], i->second.Data.size());
+	}
+
+	const SIZE64 Size = M->GetSize();
+	fSWMRStream->SetPosition(0);
+	fSWMRStream->WriteData(M->BufPointer(), Size);
+	fSWMRStream->SetSize(Size);
+
+	// publish
+	_SetSWMRGen(Gen);
+	fSWMRGen = Gen;
+}
+
+void CdGDSFile::_ApplySWMR(CdMemoryStream &Snapshot)
+{
+	Snapshot.SetPosition(0);
+	BYTE_LE<CdStream> R(Snapshot);
+	C_Int64 Gen;
+	C_UInt8 Ver;
+	R >> Gen >> Ver;
+	if (Ver != SWMR_VERSION)
+		throw ErrGDSFile(ERR_SWMR_FORMAT, Ver);
+
+	// block directory
+	map<C_UInt32, CdBlockStream*> BL;
+	vector<CdBlockStream*>::iterator b;
+	for (b = fBlockList.begin(); b != fBlockList.end(); b++)
+		BL[(*b)->ID().Get()] = *b;
+	C_Int32 NStream;
+	R >> NStream;
+	for (C_Int32 k=0; k < NStream; k++)
+	{
+		C_UInt32 ID;
+		C_Int64 Size;
+		C_Int32 N;
+		R >> ID >> Size >> N;
+		CdBlockStream::TBlockInfo *Head=NULL, *q=NULL;
+		for (C_Int32 j=0; j < N; j++)
+		{
+			C_Int64 Start, Len;
+			R >> Start >> Len;
+			CdBlockStream::TBlockInfo *p =
+				new CdBlockStream::TBlockInfo(j==0, Len, Start, 0);
+			if (q) q->Next = p; else Head = p;
+			q = p;
+		}
+		map<C_UInt32, CdBlockStream*>::iterator it = BL.find(ID);
+		CdBlockStream *s = (it != BL.end()) ? it->second : NewBlockStream(ID);
+		s->ResetBlockList(Head, Size);
+	}
+
+	// node headers
+	C_Int32 NItem;
+	R >> NItem;
+	vector<C_UInt32> Updated;
+	for (C_Int32 k=0; k < NItem; k++)
+	{
+		C_UInt32 ID;
+		C_Int64 G;
+		C_Int32 L;
+		R >> ID >> G >> L;
+		TSWMRItem &I = fSWMRItems[ID];
+		I.Gen = G;
+		I.Data.resize(L);
+		if (L > 0) Snapshot.ReadData(&I.Data[0], L);
+		if (G > fSWMRGen) Updated.push_back(ID);
+	}
+	fStreamSize = fStream->GetSize();
+
+	// reload the loaded nodes
+	if (!Updated.empty())
+	{
+		map<C_UInt32, CdGDSObj*> Objs;
+		vector<CdGDSFolder*> Stack(1, &fRoot);
+		while (!Stack.empty())
+		{
+			CdGDSFolder *F = Stack.back();
+			Stack.pop_back();
+			if (F->fGDSStream)
+				Objs[F->fGDSStream->ID().Get()] = F;
+			vector<CdGDSFolder::TNode>::iterator it;
+			for (it = F->fList.begin(); it != F->fList.end(); it++)
+			{
+				if (!it->Obj) continue;
+				if (dynamic_cast<CdGDSFolder*>(it->Obj))
+					Stack.push_back(static_cast<CdGDSFolder*>(it->Obj));
+				else if (it->Obj->fGDSStream)
+					Objs[it->Obj->fGDSStream->ID().Get()] = it->Obj;
+			}
+		}
+		vector<C_UInt32>::iterator u;
+		for (u = Updated.begin(); u != Updated.end(); u++)
+		{
+			map<C_UInt32, CdGDSObj*>::iterator it = Objs.find(*u);
+			if (it != Objs.end())
+				_ReloadObj(it->second, fSWMRItems[*u].Data);
+		}
+	}
+}
+
+void CdGDSFile::_ReloadObj(CdGDSObj *Obj, const vector<C_UInt8> &Data)
+{
+	TdAutoRef<CdMemoryStream> M(new CdMemoryStream(Data.size()));
+	if (!Data.empty())
+		memcpy(M->BufPointer(), &Data[0], Data.size());
+	CdReader Reader(M.get(), &Log());
+	try {
+		if (Obj->IsWithClassName())
+		{
+			TdVersion Version;
+			string Name;
+			Reader.BeginClassNameSpace(Version, Name);
+			if (Name == Obj->dName())
+				Obj->Reloading(Reader, Version);
+		} else {
+			Reader.BeginNameSpace();
+			Obj->Reloading(Reader,
+				(Obj == &fRoot) ? fVersion : COREARRAY_CLASS_VERSION);
+		}
+		Reader.EndStruct();
+	} catch (exception &E) {
+		Log().Add(E.what());
+	}
+}
+
+CdMemoryStream *CdGDSFile::_SWMRHeader(TdGDSBlockID ID)
+{
+	if (fSWMRWrite || (fSWMRGen <= 0)) return NULL;
+	map<C_UInt32, TSWMRItem>::iterator it = fSWMRItems.find(ID.Get());
+	if (it == fSWMRItems.end()) return NULL;
+	CdMemoryStream *M = new CdMemoryStream(it->second.Data.size());
+	if (!it->second.Data.empty())
+		memcpy(M->BufPointer(), &it->second.Data[0], it->second.Data.size());
+	return M;
 }
 
 void CdGDSFile::SaveAsFile(const UTF8String &fn)
@@ -2810,6 +3408,9 @@ void CdGDSFile::CloseFile()
 	if (fStream)
 	{
 		SyncFile();
+		// the snapshot is not maintained after the writer closes
+		if (fSWMRWrite)
+			_SetSWMRGen(0);
 		fFileName.clear();
 		fLog->List().clear();
 		fRoot.Attribute().Clear();
@@ -2822,6 +3423,11 @@ void CdGDSFile::CloseFile()
 			fRoot.fGDSStream = NULL;
 		}
 		CdBlockCollection::Clear();
+		fRoot.fChanged = fRoot.fDirty = false;
+		fSWMRStream = NULL;
+		fSWMRGen = 0;
+		fSWMRWrite = false;
+		fSWMRItems.clear();
     }
 }
 
@@ -2864,6 +3470,16 @@ bool CdGDSFile::Modified()
 	return _HaveModify(&fRoot);
 }
 
+SIZE64 CdGDSFile::CompactFile(bool PunchHole)
+{
+	if (fReadOnly)
+		throw ErrGDSFile(ERR_GDS_READONLY);
+	if (fSWMRWrite)
+		throw ErrGDSFile(ERR_GDS_SWMR);
+	SyncFile();
+	return CdBlockCollection::Compact(PunchHole);
+}
+
 SIZE64 CdGDSFile::GetFileSize()
 {
     return fStreamSize;
@@ -67,12 +67,25 @@ namespace CoreArray
 		/// assignment from a CdObjAttr object
     	void Assign(CdObjAttr &Source);
 
+		/// an interned attribute name with a precomputed hash code
+		struct COREARRAY_DLL_DEFAULT TdKey
+		{
+			UTF8String Name;  ///< the attribute name
+			C_UInt32 Hash;    ///< the hash code of Name
+			explicit TdKey(const char *name);
+			explicit TdKey(const UTF8String &name);
+		};
+
 		/// add a new attribute
 		CdAny &Add(const UTF8String &Name);
 		/// get the attribute index with a specified name
 		int IndexName(const UTF8String &Name);
+		/// get the attribute index with an interned name
+		int IndexName(const TdKey &Key);
 		/// return whether there is an attribute with a specified name
 		bool HasName(const UTF8String &Name);
+		/// return whether there is an attribute with an interned name
+		bool HasName(const TdKey &Key);
 		/// delete the attribute with a specified name
 		void Delete(const UTF8String &Name);
 		/// delete the specified attribute
@@ -90,6 +103,7 @@ namespace CoreArray
 		COREARRAY_INLINE CdGDSObj &Owner() const { return fOwner; }
 
 		CdAny & operator[](const UTF8String &Name);
+		CdAny & operator[](const TdKey &Key);
 		CdAny & operator[](int Index);
 
 		COREARRAY_INLINE UTF8String &Names(int Index)
@@ -100,17 +114,21 @@ namespace CoreArray
 	protected:
 		struct TdPair {
 			UTF8String name;
+			C_UInt32 hash;
 			CdAny val;
 		};
 
 		CdGDSObj &fOwner;
 		std::vector<TdPair*> fList;
+		/// open-addressing hash index of fList (built lazily, empty if invalid)
+		std::vector<C_Int32> fIndex;
 
 		virtual void Loading(CdReader &Reader, TdVersion Version);
 		virtual void Saving(CdWriter &Writer);
 
 	private:
-		std::vector<TdPair*>::iterator _Find(const UTF8String &Name);
+		int _Find(const UTF8String &Name, C_UInt32 Hash);
+		void _BuildIndex();
         void _ValidateName(const UTF8String &name);
 	};
 
@@ -169,9 +187,12 @@ namespace CoreArray
 		CdGDSFolder *fFolder;
 		CdBlockStream *fGDSStream;
 		bool fChanged;
+		bool fDirty;  ///< whether the object or its children need synchronizing
 
 		virtual void LoadStruct(CdReader &Reader, TdVersion Version);
 		virtual void SaveStruct(CdWriter &Writer, bool IncludeName);
+		/// reload the object from a snapshot published by a SWMR writer
+		virtual void Reloading(CdReader &Reader, TdVersion Version);
 
 		void SaveToBlockStream();
 		virtual bool IsWithClassName() { return true; }
@@ -186,6 +207,10 @@ namespace CoreArray
 		void _CheckWritable();
 		/// check the internal GDS stream
 		void _CheckGDSStream();
+		/// mark the object and its parent folders to be visited by SyncFile
+		COREARRAY_INLINE void _SetDirty() { if (!fDirty) _MarkDirty(); }
+		/// set the dirty flags of the object and all its parent folders
+		void _MarkDirty();
 
 		/// throw an exception for invalid assignment 
 		static void RaiseInvalidAssign(const char *ThisClass, CdGDSObj *Source);
@@ -236,6 +261,8 @@ namespace CoreArray
 
 		virtual void PushReadPipe(CdBufStream &buf) = 0;
 		virtual void PushWritePipe(CdBufStream &buf) = 0;
+		/// push a writing pipe appending to the closed stream, false if unsupported
+		virtual bool PushAppendPipe(CdBufStream &buf, bool DropLast);
 		virtual void PopPipe(CdBufStream &buf) = 0;
 		virtual bool WriteMode(CdBufStream &buf) const = 0;
 		virtual void ClosePipe(CdBufStream &buf) = 0;
@@ -326,6 +353,8 @@ namespace CoreArray
 
 		/// Set the mode of data storage (e.g, packed mode or compression)
 		virtual void SetPackedMode(const char *Mode) = 0;
+		/// Recompress the data with the mode, using up to NumThread threads
+		virtual void Recompress(const char *Mode, int NumThread);
 
 	protected:
 		CdPipeMgrItem *fPipeInfo;
@@ -426,6 +455,8 @@ namespace CoreArray
 		friend class CdGDSObj;
 		friend class CdGDSFile;
 
+		/// constructor
+		CdGDSFolder();
 		/// destructor
 		virtual ~CdGDSFolder();
 
@@ -507,18 +538,40 @@ namespace CoreArray
 
 		virtual void Loading(CdReader &Reader, TdVersion Version);
 		virtual void Saving(CdWriter &Writer);
+		virtual void Reloading(CdReader &Reader, TdVersion Version);
 		virtual bool IsWithClassName() { return false; }
 
 		std::vector<TNode>::iterator FindObj(CdGDSObj *Obj);
 		std::vector<TNode>::const_iterator FindObj(const CdGDSObj *Obj) const;
 		void _ClearFolder();
 
+		/// the indices of fList by name and by object, built lazily for
+		/// large folders and invalidated when fList is modified
+		mutable std::map<UTF8String, size_t> fNameIndex;
+		mutable std::map<const CdGDSObj*, size_t> fObjIndex;
+		mutable bool fIndexed;
+
 	private:
 		bool _HasName(const UTF8String &Name);
 		bool _ValidName(const UTF8String &Name);
 		TNode &_NameItem(const UTF8String &Name);
 		void _LoadItem(TNode &I);
-		void _UpdateAll();
+		void _UpdateAll(vector<CdGDSObj*> *Synced=NULL);
+		/// the position of Name in fList, or -1 if not found
+		int _IndexName(const UTF8String &Name) const;
+		/// the position of Obj in fList, or -1 if not found
+		int _IndexObj(const CdGDSObj *Obj) const;
+		/// build the indices if fList is large
+		bool _BuildIndex() const;
+		/// invalidate the indices after fList is modified
+		COREARRAY_INLINE void _ListChanged()
+		{
+			if (fIndexed)
+			{
+				fNameIndex.clear(); fObjIndex.clear();
+				fIndexed = false;
+			}
+		}
 	};
 
 	/// The pointer to a GDS folder
@@ -647,6 +700,7 @@ namespace CoreArray
 	{
 	public:
 		friend class CdGDSVirtualFolder;
+		friend class CdGDSObj;
 
 		/// constructor
 		CdGDSRoot();
@@ -687,6 +741,7 @@ namespace CoreArray
 	class COREARRAY_DLL_DEFAULT CdGDSFile: protected CdBlockCollection
 	{
 	public:
+		friend class CdGDSFolder;
 		friend class CdGDSVirtualFolder;
 
 		/// opening mode flags
@@ -711,14 +766,26 @@ namespace CoreArray
 		void DuplicateFile(const UTF8String &fn, bool deep);
 		void DuplicateFile(const char *fn, bool deep);
 
-		void SyncFile();
+		/// save the modified objects, return the number of bytes written
+		C_Int64 SyncFile();
 		void CloseFile();
 
 		/// Clean up all fragments
 		void TidyUp(bool deep);
+		/// Clean up fragments in place without a second copy of the file,
+		/// return the number of bytes released
+		SIZE64 CompactFile(bool PunchHole=false);
 
 		bool Modified();
 
+		/// start the single-writer/multiple-reader (SWMR) mode, a snapshot of
+		/// the block directory and node headers is published at each SyncFile
+		void StartSWMR();
+		/// load the latest snapshot published by a SWMR writer, return false
+		/// if there is no snapshot newer than the file or the last refresh,
+		/// or the writer is publishing one or has closed the file
+		bool RefreshSWMR();
+
 		/// Return file size of the CdGDSFile object
 		SIZE64 GetFileSize();
 
@@ -734,6 +801,12 @@ namespace CoreArray
 		COREARRAY_INLINE bool ReadOnly() const { return fReadOnly; }
 		COREARRAY_INLINE CdLogRecord &Log() { return *fLog; }
 		COREARRAY_INLINE TdVersion Version() const { return fVersion; }
+		/// return true if the file has a SWMR snapshot
+		COREARRAY_INLINE bool SWMR() const { return fSWMRStream != NULL; }
+		/// return true if it is a SWMR writer
+		COREARRAY_INLINE bool SWMRWriter() const { return fSWMRWrite; }
+		/// the generation of the current SWMR snapshot, 0 if not loaded
+		COREARRAY_INLINE C_Int64 SWMRGeneration() const { return fSWMRGen; }
 
 		static const char *GDSFilePrefix();
 
@@ -747,11 +820,30 @@ namespace CoreArray
 		void SaveStream(CdStream* Stream);
 
 	private:
+		/// the header of a node published in the SWMR snapshot
+		struct TSWMRItem
+		{
+			C_Int64 Gen;               ///< the generation of the last update
+			vector<C_UInt8> Data;      ///< the content of the node stream
+		};
+
         CdLogRecord *fLog;
         TProcessID fprocess_id;
+		CdBlockStream *fSWMRStream;  ///< the stream of SWMR snapshots
+		C_Int64 fSWMRGen;            ///< the generation of the SWMR snapshot
+		bool fSWMRWrite;             ///< whether it is a SWMR writer
+		map<C_UInt32, TSWMRItem> fSWMRItems;
 
 		void _Init();
 		bool _HaveModify(CdGDSFolder *folder);
+		C_Int64 _SWMRGen();
+		void _SetSWMRGen(C_Int64 Gen);
+		bool _ReadSWMR(C_Int64 Gen, CdMemoryStream &Snapshot);
+		void _LoadSWMR();
+		void _PublishSWMR(const vector<CdGDSObj*> &List);
+		void _ApplySWMR(CdMemoryStream &Snapshot);
+		void _ReloadObj(CdGDSObj *Obj, const vector<C_UInt8> &Data);
+		CdMemoryStream *_SWMRHeader(TdGDSBlockID ID);
 	};
 
 	/// The pointer to a CoreArray GDS File
@@ -47,22 +47,21 @@ namespace CoreArray
 			struct COREARRAY_DLL_DEFAULT _pThreadStruct
 			{
 				void (*proc)(CoreArray::CdThread *, int, void*);
-				int ThreadIndex;
 				void *Param;
 				CoreArray::Parallel::CParallelBase *cpBase;
 			};
 
-			int _pDoThread(CoreArray::CdThread *Thread, _pThreadStruct Data)
+			void _pDoThread(CoreArray::CdThread *Thread, int Index, void *Param)
 			{
+				_pThreadStruct &Data = *((_pThreadStruct*)Param);
 				Data.cpBase->InitThread();
 
 				COREARRAY_PARALLEL_TRY
 					COREARRAY_Parallel_Call((TCallProc)Data.proc,
-						Thread, Data.ThreadIndex, Data.Param);
+						Thread, Index, Data.Param);
 				COREARRAY_PARALLEL_CATCH
 
 				Data.cpBase->DoneThread();
-				return 0;
 			}
 		}
 	}
@@ -157,6 +156,323 @@ void CdConsoleProgress::ShowProgress()
 }
 
 
+// CdTaskGroup
+
+static const char *ERR_TASK_UNKNOWN = "Unknown error in a parallel task.";
+static const char *ERR_POOL_WORKER =
+	"The thread pool can not be resized by its own worker.";
+static const char *ERR_POOL_BUSY =
+	"The thread pool can not be resized while parallel tasks are running.";
+
+CdTaskGroup::CdTaskGroup(CdThreadPool *pool)
+{
+	fPool = pool ? pool : &CdThreadPool::Global();
+	fPending = 0;
+	fFailed = false;
+	// the pool is not resized while a group exists
+	TdAutoMutex _m(&fPool->fResizeMutex);
+	fPool->fNumGroup ++;
+}
+
+CdTaskGroup::~CdTaskGroup()
+{
+	try {
+		Wait();
+	} catch (...) { }
+	TdAutoMutex _m(&fPool->fResizeMutex);
+	fPool->fNumGroup --;
+}
+
+void CdTaskGroup::Run(TdTaskProc Proc, int Index, void *Param)
+{
+	if (!Proc) return;
+	CdThreadPool::TdTask T;
+	T.Proc = Proc; T.Param = Param; T.Index = Index; T.Group = this;
+	{
+		TdAutoMutex _m(&fMutex);
+		fPending ++;
+	}
+	fPool->_Submit(T);
+}
+
+void CdTaskGroup::Wait(bool Help)
+{
+	const int Self = fPool->CurrentWorker();
+	while (true)
+	{
+		{
+			TdAutoMutex _m(&fMutex);
+			if (fPending <= 0) break;
+		}
+		// help to run the pending tasks of this group only, since a task of
+		// another group may wait for the task suspended on this stack
+		if (!Help || !fPool->_RunOne(Self, this))
+		{
+			// all tasks of this group have been taken by others
+			TdAutoMutex _m(&fMutex);
+			if (fPending > 0) fDone.Wait(fMutex);
+		}
+	}
+	if (fFailed)
+	{
+		string s = fErrMsg;
+		fFailed = false;
+		fErrMsg.clear();
+		throw ErrParallel(s);
+	}
+}
+
+void CdTaskGroup::_Finish(const char *err)
+{
+	TdAutoMutex _m(&fMutex);
+	if (err && !fFailed)
+	{
+		fFailed = true;
+		fErrMsg = err;
+	}
+	if ((--fPending) <= 0)
+		fDone.Broadcast();
+}
+
+
+// CdThreadPool
+
+static CdThreadPool *GlobalPool = NULL;
+static CdThreadMutex GlobalPoolMutex;
+
+CdThreadPool::CdThreadPool(int nWorker)
+{
+	fNumPending = 0;
+	fNumGroup = 0;
+	fStop = false;
+	fQueues.push_back(new TdQueue);
+	_StartWorkers(nWorker);
+}
+
+CdThreadPool::~CdThreadPool()
+{
+	_StopWorkers();
+	for (size_t i=0; i < fQueues.size(); i++)
+		delete fQueues[i];
+	fQueues.clear();
+}
+
+CdThreadPool &CdThreadPool::Global()
+{
+	TdAutoMutex _m(&GlobalPoolMutex);
+	// never released since a worker may call exit()
+	if (!GlobalPool)
+		GlobalPool = new CdThreadPool(-1);
+	return *GlobalPool;
+}
+
+int CdThreadPool::NumWorker()
+{
+	TdAutoMutex _m(&fResizeMutex);
+	return (int)fThreads.size();
+}
+
+void CdThreadPool::SetNumWorker(int nWorker)
+{
+	// no task group can be created while resizing, so the queues and
+	// threads are not accessed by others
+	TdAutoMutex _m(&fResizeMutex);
+	if (CurrentWorker() >= 0)
+		throw ErrParallel(ERR_POOL_WORKER);
+	if (fNumGroup > 0)
+		throw ErrParallel(ERR_POOL_BUSY);
+	_StopWorkers();
+	_StartWorkers(nWorker);
+}
+
+int CdThreadPool::CurrentWorker() const
+{
+	for (size_t i=0; i < fThreads.size(); i++)
+	{
+		CdThread::TThread &T = fThreads[i]->Thread();
+	#if defined(COREARRAY_POSIX_THREAD)
+		if (pthread_equal(T, pthread_self()))
+			return i;
+	#elif defined(COREARRAY_PLATFORM_WINDOWS)
+		if (T.ThreadID == GetCurrentThreadId())
+			return i;
+	#endif
+	}
+	return -1;
+}
+
+void CdThreadPool::_Submit(const TdTask &Task)
+{
+	// a worker pushes to its own queue, others to the shared one
+	int Self = CurrentWorker();
+	TdQueue *Q = fQueues[(Self >= 0) ? Self : fQueues.size()-1];
+	{
+		TdAutoMutex _m(&Q->Mutex);
+		Q->Tasks.push_back(Task);
+	}
+	TdAutoMutex _m(&fMutex);
+	fNumPending ++;
+	fWork.Signal();
+}
+
+bool CdThreadPool::_RunOne(int Self, CdTaskGroup *Group)
+{
+	{
+		TdAutoMutex _m(&fMutex);
+		if (fNumPending <= 0) return false;
+		fNumPending --;
+	}
+	TdTask T;
+	if (!_TakeGroup(Self, Group, T))
+	{
+		// give the claim back to the workers
+		TdAutoMutex _m(&fMutex);
+		fNumPending ++;
+		fWork.Signal();
+		return false;
+	}
+	_Execute(Self, T);
+	return true;
+}
+
+bool CdThreadPool::_TakeGroup(int Self, CdTaskGroup *Group, TdTask &Task)
+{
+	const int n = fQueues.size();
+	for (int k=0; k < n; k++)
+	{
+		// its own queue first
+		TdQueue *Q = fQueues[(Self + k + n) % n];
+		TdAutoMutex _m(&Q->Mutex);
+		deque<TdTask>::iterator it;
+		for (it=Q->Tasks.begin(); it != Q->Tasks.end(); it++)
+		{
+			if (it->Group == Group)
+			{
+				Task = *it;
+				Q->Tasks.erase(it);
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void CdThreadPool::_Take(int Self, TdTask &Task)
+{
+	// the caller has claimed a pending task, so one is in the queues
+	const int n = fQueues.size();
+	while (true)
+	{
+		if (Self >= 0)
+		{
+			// the newest task of its own queue
+			TdQueue *Q = fQueues[Self];
+			TdAutoMutex _m(&Q->Mutex);
+			if (!Q->Tasks.empty())
+			{
+				Task = Q->Tasks.back();
+				Q->Tasks.pop_back();
+				return;
+			}
+		}
+		// steal the oldest task from the others
+		for (int k=1; k <= n; k++)
+		{
+			TdQueue *Q = fQueues[(Self + k + n) % n];
+			TdAutoMutex _m(&Q->Mutex);
+			if (!Q->Tasks.empty())
+			{
+				Task = Q->Tasks.front();
+				Q->Tasks.pop_front();
+				return;
+			}
+		}
+	}
+}
+
+void CdThreadPool::_Execute(int Self, TdTask &Task)
+{
+	string Msg;
+	const char *err = NULL;
+	try {
+		(*Task.Proc)((Self >= 0) ? fThreads[Self] : NULL, Task.Index,
+			Task.Param);
+	}
+	catch (exception &E) {
+		Msg = E.what(); err = Msg.c_str();
+	}
+	catch (...) {
+		err = ERR_TASK_UNKNOWN;
+	}
+	Task.Group->_Finish(err);
+}
+
+void CdThreadPool::_StartWorkers(int nWorker)
+{
+	if (nWorker < 0)
+	{
+		nWorker = Mach::GetCPU_NumOfCores() - 1;
+		if (nWorker < 1) nWorker = 1;
+	}
+	// keep the pending tasks in the shared queue
+	TdQueue *Shared = fQueues.back();
+	fQueues.pop_back();
+	for (size_t i=0; i < fQueues.size(); i++)
+	{
+		TdQueue *Q = fQueues[i];
+		Shared->Tasks.insert(Shared->Tasks.end(), Q->Tasks.begin(),
+			Q->Tasks.end());
+		delete Q;
+	}
+	fQueues.clear();
+	for (int i=0; i < nWorker; i++)
+		fQueues.push_back(new TdQueue);
+	fQueues.push_back(Shared);
+
+	fStop = false;
+	// all thread objects exist before any worker looks up fThreads
+	for (int i=0; i < nWorker; i++)
+		fThreads.push_back(new CdThread);
+	for (int i=0; i < nWorker; i++)
+		fThreads[i]->BeginThread(_WorkerProc, pair<CdThreadPool*, int>(this, i));
+}
+
+void CdThreadPool::_StopWorkers()
+{
+	{
+		TdAutoMutex _m(&fMutex);
+		fStop = true;
+		fWork.Broadcast();
+	}
+	for (size_t i=0; i < fThreads.size(); i++)
+	{
+		fThreads[i]->EndThread();
+		delete fThreads[i];
+	}
+	fThreads.clear();
+}
+
+int CdThreadPool::_WorkerProc(CdThread *Thread, pair<CdThreadPool*, int> Data)
+{
+	CdThreadPool *Pool = Data.first;
+	while (true)
+	{
+		{
+			TdAutoMutex _m(&Pool->fMutex);
+			while ((Pool->fNumPending <= 0) && !Pool->fStop)
+				Pool->fWork.Wait(Pool->fMutex);
+			if (Pool->fStop) break;
+			Pool->fNumPending --;
+		}
+		TdTask T;
+		Pool->_Take(Data.second, T);
+		Pool->_Execute(Data.second, T);
+	}
+	return 0;
+}
+
+
+
 // CParallelBase
 
 static const char *ERR_NUM_THREAD = "Invalid number of threads (%d)";
@@ -167,12 +483,13 @@ CParallelBase::CParallelBase(int _nThread)
 		throw ErrParallel(ERR_NUM_THREAD, _nThread);
 	fnThread = _nThread;
 	fProgress = NULL;
+	fPoolOnly = false;
+	fProgStep = 1;
+	fProgDone = fProgShown = 0;
 }
 
 CParallelBase::~CParallelBase()
-{
-	CloseThreads();
-}
+{ }
 
 void CParallelBase::InitThread()
 {
@@ -187,18 +504,21 @@ void CParallelBase::DoneThread()
 
 void CParallelBase::CloseThreads()
 {
-	vector<CdThread*>::iterator it;
-	for (it=fThreads.begin(); it!=fThreads.end(); it++)
-	{
-		delete *it;
-		*it = NULL;
-	}
-	fThreads.clear();
+	// do nothing, the threads are owned by the thread pool
+}
+
+void CParallelBase::BeginWait()
+{
+	// do nothing ...
+}
+
+void CParallelBase::EndWait()
+{
+	// do nothing ...
 }
 
 void CParallelBase::SetNumThread(int _nThread)
 {
-	CloseThreads();
 	if (_nThread < 1)
     	throw ErrParallel(ERR_NUM_THREAD, _nThread);
 	fnThread = _nThread;
@@ -214,35 +534,83 @@ void CParallelBase::AutoSetnThread()
 void CParallelBase::RunThreads(CParallelBase::TProc Proc, void *param)
 {
 	if (!Proc) return;
-	CloseThreads();
+	_INTERNAL::_pThreadStruct pd;
+	pd.proc = Proc;
+	pd.cpBase = this;
+	pd.Param = param;
+	_RunTasks(_INTERNAL::_pDoThread, &pd);
+}
 
-	if (fnThread > 1)
+void CParallelBase::_RunTasks(TdTaskProc Proc, void *Param)
+{
+	_ProgressInit();
+	CdTaskGroup Group;
+	if (fPoolOnly && (Group.Pool()->NumWorker() > 0))
 	{
-		fThreads.resize(fnThread-1);
-		for (int i=0; i < fnThread-1; i++)
-		{
-			_INTERNAL::_pThreadStruct pd;
-			pd.proc = Proc;
-			pd.ThreadIndex = i+1;
-			pd.cpBase = this;
-			pd.Param = param;
-			fThreads[i] = new CdThread;
-			fThreads[i]->BeginThread(_INTERNAL::_pDoThread, pd);
+		for (int i=0; i < fnThread; i++)
+			Group.Run(Proc, i, Param);
+		BeginWait();
+		try {
+			Group.Wait(false);
+		} catch (...) {
+			EndWait();
+			throw;
 		}
+		EndWait();
+	} else {
+		for (int i=1; i < fnThread; i++)
+			Group.Run(Proc, i, Param);
+		(*Proc)(NULL, 0, Param);
+		Group.Wait();
 	}
+	_ProgressFlush();
+}
 
-	InitThread();
-
-	COREARRAY_PARALLEL_TRY
-		COREARRAY_Parallel_Call((TCallProc)Proc, NULL, 0, param);
-	COREARRAY_PARALLEL_CATCH
-
-	DoneThread();
+void CParallelBase::_ProgressInit()
+{
+	TdProgCounter Zero;
+	memset(&Zero, 0, sizeof(Zero));
+	fProgCnt.assign(fnThread, Zero);
+	// about 200 publications per thread, and fProgress lags behind by
+	// at most 0.5% of the total
+	fProgStep = fProgress ? (fProgress->Total() / (200 * fnThread)) : 1;
+	if (fProgStep < 1) fProgStep = 1;
+	fProgDone = fProgShown = 0;
+}
 
-	for (int i=0; i < fnThread-1; i++)
-		fThreads[i]->EndThread();
+void CParallelBase::_ProgressPublish(C_Int64 n)
+{
+	AtomicAdd(&fProgDone, n);
+	// the thread holding the lock reports for all, others skip it
+	if (fProgMutex.TryLock())
+	{
+		C_Int64 d = AtomicGet(&fProgDone) - fProgShown;
+		if (d > 0)
+		{
+			fProgShown += d;
+			fProgress->Forward(d);
+		}
+		fProgMutex.Unlock();
+	}
+}
 
-	CloseThreads();
+void CParallelBase::_ProgressFlush()
+{
+	if (!fProgress) return;
+	C_Int64 n = 0;
+	for (size_t i=0; i < fProgCnt.size(); i++)
+	{
+		n += fProgCnt[i].Count;
+		fProgCnt[i].Count = 0;
+	}
+	AtomicAdd(&fProgDone, n);
+	TdAutoMutex _m(&fProgMutex);
+	C_Int64 d = AtomicGet(&fProgDone) - fProgShown;
+	if (d > 0)
+	{
+		fProgShown += d;
+		fProgress->Forward(d);
+	}
 }
 
 void CParallelBase::SetProgress(CdBaseProgression *Val)
@@ -271,6 +639,110 @@ CParallelSection::~CParallelSection()
 { }
 
 
+// CdQueueScheduler
+
+/// the time spent on a chunk to amortize the cost of dispensing (ns)
+static const double QUEUE_CHUNK_TIME = 50000;
+
+CdQueueScheduler::TdChunk::TdChunk()
+{
+	Size = 1;
+	Tick = 0;
+	TimePerItem = -1;
+}
+
+void CdQueueScheduler::TdChunk::End(C_Int64 Len)
+{
+	double t = double(GetTimeStampNs() - Tick) / Len;
+	// exponential moving average of the time per item
+	TimePerItem = (TimePerItem < 0) ? t : (0.75*TimePerItem + 0.25*t);
+	double n = (TimePerItem > 0) ? (QUEUE_CHUNK_TIME / TimePerItem) : 1e9;
+	Size = (n < 1) ? 1 : ((n > 1e9) ? (C_Int64)1e9 : (C_Int64)n);
+}
+
+CdQueueScheduler::CdQueueScheduler()
+{
+	Init(0, 1, 1, 0, NULL, NULL);
+}
+
+void CdQueueScheduler::Init(C_Int64 Total, C_Int64 BufSize, int nThread,
+	C_Int64 MaxChunk, TFlush Flush, void *Rec)
+{
+	fTotal = Total;
+	fBufSize = BufSize;
+	fMaxChunk = MaxChunk;
+	fnThread = nThread;
+	fNext = 0;
+	fLimit = (2*BufSize < Total) ? 2*BufSize : Total;
+	fDone[0] = fDone[1] = 0;
+	fComplete[0] = fComplete[1] = false;
+	fFlushed = 0;
+	fFlush = Flush;
+	fRec = Rec;
+}
+
+bool CdQueueScheduler::Get(TdChunk &Chunk, C_Int64 &Start, C_Int64 &Len)
+{
+	while (true)
+	{
+		C_Int64 n = AtomicGet(&fNext);
+		if (n >= fTotal) return false;
+		if (n >= AtomicGet(&fLimit))
+		{
+			// both windows are dispensed, wait for a flush
+			TdAutoMutex _m(&fMutex);
+			while ((AtomicGet(&fNext) >= AtomicGet(&fLimit)) &&
+					(AtomicGet(&fNext) < fTotal))
+				fCond.Wait(fMutex);
+			continue;
+		}
+		// the rest of the current window
+		C_Int64 w_end = (n / fBufSize + 1) * fBufSize;
+		if (w_end > fTotal) w_end = fTotal;
+		C_Int64 rem = w_end - n;
+		// guided: at most a half of the even share of the rest
+		C_Int64 L = rem / (2*fnThread);
+		if (L > Chunk.Size) L = Chunk.Size;
+		if ((fMaxChunk > 0) && (L > fMaxChunk)) L = fMaxChunk;
+		if (L < 1) L = 1;
+		if (AtomicCAS(&fNext, n, n + L))
+		{
+			Start = n; Len = L;
+			return true;
+		}
+	}
+}
+
+void CdQueueScheduler::Finish(C_Int64 Start, C_Int64 Len, CdThread *Thread,
+	int Index)
+{
+	C_Int64 w = Start / fBufSize;
+	int slot = w & 1;
+	C_Int64 w_size = fTotal - w * fBufSize;
+	if (w_size > fBufSize) w_size = fBufSize;
+	if (AtomicAdd(&fDone[slot], Len) < w_size) return;
+
+	// the window is completed, flush it and the following completed one
+	TdAutoMutex _m(&fMutex);
+	fComplete[slot] = true;
+	while (fComplete[fFlushed & 1])
+	{
+		int s = fFlushed & 1;
+		C_Int64 st = fFlushed * fBufSize;
+		C_Int64 n = fTotal - st;
+		if (n > fBufSize) n = fBufSize;
+		(*fFlush)(fRec, Thread, Index, st, s * fBufSize, n);
+		fComplete[s] = false;
+		AtomicSet(&fDone[s], 0);
+		fFlushed ++;
+		// the buffer of the flushed window can be reused
+		C_Int64 lim = (fFlushed + 2) * fBufSize;
+		AtomicSet(&fLimit, (lim < fTotal) ? lim : fTotal);
+	}
+	fCond.Broadcast();
+}
+
+
 // CParallelQueue
 
 CParallelQueue::CParallelQueue(int _nThread):
@@ -282,6 +754,16 @@ CParallelQueue::CParallelQueue(int _nThread):
 CParallelQueue::~CParallelQueue()
 { }
 
+bool CParallelQueue::_Init(C_Int64 TotalSize, ssize_t &BufSize)
+{
+	if (BufSize <= 0)
+		throw ErrParallel("The size of buffer should be > 0.");
+	if (TotalSize <= 0) return false;
+	if (BufSize > TotalSize) BufSize = TotalSize;
+	if (fProgress) fProgress->Init(TotalSize);
+	return true;
+}
+
 
 // CParallelQueueEx
 
@@ -41,6 +41,7 @@
 #include "dTrait.h"
 
 #include <vector>
+#include <deque>
 #include <memory>
 #include <algorithm>
 #ifndef COREARRAY_NO_STD_IN_OUT
@@ -130,6 +131,107 @@ namespace CoreArray
 	#endif
 
 
+        // Thread pool
+
+		class CdThreadPool;
+
+		/// The procedure of a task, called with the pool thread (NULL if it
+		/// is not a worker), the task index and the user-defined parameter
+		typedef void (*TdTaskProc)(CdThread *Thread, int Index, void *Param);
+
+		/// A group of tasks submitted to a thread pool
+		class COREARRAY_DLL_DEFAULT CdTaskGroup
+		{
+		public:
+			friend class CdThreadPool;
+
+			/// Constructor, the global pool is used if pool is NULL
+			CdTaskGroup(CdThreadPool *pool=NULL);
+			/// Destructor, waiting for all tasks
+			~CdTaskGroup();
+
+			/// Submit a task
+			void Run(TdTaskProc Proc, int Index, void *Param);
+			/// Wait for all tasks while running the pending tasks of this group
+			/// if Help, and rethrow the first error raised by the tasks
+			void Wait(bool Help=true);
+
+			COREARRAY_INLINE CdThreadPool *Pool() const { return fPool; }
+
+		protected:
+			CdThreadPool *fPool;
+			CdThreadMutex fMutex;
+			CdThreadCondition fDone;
+			int fPending;
+			bool fFailed;
+			std::string fErrMsg;
+
+			void _Finish(const char *err);
+		};
+
+
+		/// A persistent pool of worker threads, each worker has its own task
+		/// queue and steals tasks from the other queues when it is idle
+		class COREARRAY_DLL_DEFAULT CdThreadPool
+		{
+		public:
+			friend class CdTaskGroup;
+
+			/// Constructor, nWorker < 0 for the number of cores minus one
+			CdThreadPool(int nWorker=-1);
+			/// Destructor
+			~CdThreadPool();
+
+			/// The process-wide pool
+			static CdThreadPool &Global();
+
+			/// Return the number of worker threads
+			int NumWorker();
+			/// Reset the number of worker threads, nWorker < 0 for the default;
+			/// it fails if a task group exists (i.e., tasks may be running)
+			void SetNumWorker(int nWorker);
+			/// Return the index of the current worker, or -1 if not a worker
+			int CurrentWorker() const;
+
+		protected:
+			struct TdTask
+			{
+				TdTaskProc Proc;
+				void *Param;
+				int Index;
+				CdTaskGroup *Group;
+			};
+			struct TdQueue
+			{
+				CdThreadMutex Mutex;
+				std::deque<TdTask> Tasks;
+			};
+
+			/// worker threads
+			std::vector<CdThread*> fThreads;
+			/// task queues of workers, the last one for non-worker threads
+			std::vector<TdQueue*> fQueues;
+			/// the mutex and condition for idle workers
+			CdThreadMutex fMutex;
+			CdThreadCondition fWork;
+			/// the number of tasks not taken yet
+			C_Int64 fNumPending;
+			bool fStop;
+			/// the mutex for resizing and the number of existing task groups
+			CdThreadMutex fResizeMutex;
+			int fNumGroup;
+
+			void _Submit(const TdTask &Task);
+			bool _RunOne(int Self, CdTaskGroup *Group);
+			bool _TakeGroup(int Self, CdTaskGroup *Group, TdTask &Task);
+			void _Take(int Self, TdTask &Task);
+			void _Execute(int Self, TdTask &Task);
+			void _StartWorkers(int nWorker);
+			void _StopWorkers();
+			static int _WorkerProc(CdThread *Thread, std::pair<CdThreadPool*, int> Data);
+		};
+
+
         // Parallel Mechanism
 
 		class CParallelBase;
@@ -140,21 +242,20 @@ namespace CoreArray
 			{
 				TCLASS * obj;
 				void (TCLASS::*proc)(CdThread *, int);
-				int ThreadIndex;
 				CParallelBase *cpBase;
 			};
 
 			template<class TCLASS> COREARRAY_DLL_DEFAULT
-				int _pDoThreadEx(CdThread *Thread, _pThreadStructEx<TCLASS> Data)
+				void _pDoThreadEx(CdThread *Thread, int Index, void *Param)
 			{
+				_pThreadStructEx<TCLASS> &Data = *((_pThreadStructEx<TCLASS>*)Param);
 				Data.cpBase->InitThread();
 
 				COREARRAY_PARALLEL_TRY
-                	(Data.obj->*Data.proc)(Thread, Data.ThreadIndex);
+                	(Data.obj->*Data.proc)(Thread, Index);
 				COREARRAY_PARALLEL_CATCH
 
 				Data.cpBase->DoneThread();
-				return 0;
 			}
 		}
 
@@ -181,6 +282,13 @@ namespace CoreArray
 
 			COREARRAY_INLINE CdThreadMutex &Mutex() { return fMutex; }
 
+			/// Whether all threads run in the thread pool, then the calling
+			/// thread only waits between BeginWait() and EndWait()
+			COREARRAY_INLINE bool PoolOnly() const { return fPoolOnly; }
+			/// Set whether all threads run in the thread pool (used if the
+			/// pool has a worker)
+			COREARRAY_INLINE void SetPoolOnly(bool val) { fPoolOnly = val; }
+
 			/// Create nThread threads (including the main thread), and Proc is called by each thread
 			typedef void (*TProc)(CdThread *Thread, int, void *);
 
@@ -192,33 +300,9 @@ namespace CoreArray
 				void RunThreads(void (TCLASS::*Proc)(CdThread *, int), TCLASS *obj)
 			{
 				if (!Proc || !obj) return;
-				CloseThreads();
-
-				if (fnThread > 1)
-				{
-					fThreads.resize(fnThread-1);
-					for (int i=0; i < fnThread-1; i++)
-					{
-						_INTERNAL::_pThreadStructEx<TCLASS> pd;
-						pd.obj = obj; pd.proc = Proc;
-						pd.ThreadIndex = i+1; pd.cpBase = this;
-						fThreads[i] = new CdThread;
-						fThreads[i]->BeginThread(_INTERNAL::_pDoThreadEx<TCLASS>, pd);
-					}
-				}
-
-				InitThread();
-
-				COREARRAY_PARALLEL_TRY
-					(obj->*Proc)(NULL, 0);
-				COREARRAY_PARALLEL_CATCH
-
-				DoneThread();
-
-				for (int i=0; i < fnThread-1; i++)
-					fThreads[i]->EndThread();
-
-				CloseThreads();
+				_INTERNAL::_pThreadStructEx<TCLASS> pd;
+				pd.obj = obj; pd.proc = Proc; pd.cpBase = this;
+				_RunTasks(_INTERNAL::_pDoThreadEx<TCLASS>, &pd);
 			}
 
 			COREARRAY_INLINE CdBaseProgression *Progress() const { return fProgress; }
@@ -227,16 +311,54 @@ namespace CoreArray
 
 		protected:
 			int fnThread;
-			std::vector<CdThread*> fThreads;
 			CdThreadMutex fMutex;
 			CdBaseProgression *fProgress;
+			bool fPoolOnly;
+
+			/// Called by the calling thread before waiting for the pool threads
+			virtual void BeginWait();
+			/// Called by the calling thread after waiting for the pool threads
+			virtual void EndWait();
+
+			/// Run Proc with the indices 1..nThread-1 in the thread pool and
+			/// the index 0 in the calling thread, or all indices in the pool
+			/// if PoolOnly()
+			void _RunTasks(TdTaskProc Proc, void *Param);
+
+			/// The progress counter of a thread, padded to a cache line
+			struct TdProgCounter
+			{
+				C_Int64 Count;
+				C_UInt8 Pad[64 - sizeof(C_Int64)];
+			};
+			/// the counters of threads
+			std::vector<TdProgCounter> fProgCnt;
+			/// a thread publishes its count when it reaches fProgStep
+			C_Int64 fProgStep;
+			/// the published count, and the count shown by fProgress
+			volatile C_Int64 fProgDone;
+			C_Int64 fProgShown;
+			CdThreadMutex fProgMutex;
+
+			void _ProgressInit();
+			void _ProgressPublish(C_Int64 n);
+			void _ProgressFlush();
 
 			COREARRAY_INLINE void ForwardProgress()
+			{
+				if (fProgress) _ProgressPublish(1);
+			}
+			/// Forward the progress by n items done by the thread Index
+			COREARRAY_INLINE void ForwardProgress(int Index, C_Int64 n)
 			{
 				if (fProgress)
 				{
-					TdAutoMutex AutoMutex(&fMutex);
-					fProgress->Forward();
+					C_Int64 &c = fProgCnt[Index].Count;
+					if ((c += n) >= fProgStep)
+					{
+						_ProgressPublish(c);
+						c = 0;
+					}
 				}
 			}
 		};
@@ -328,7 +450,7 @@ namespace CoreArray
 						Idx = Rec.Index; ++Rec.Index; --Rec.TotalSize;
 						fMutex.Unlock();
 						(Rec.Obj->*Rec.Proc)(Idx, *pBuf);
-						ForwardProgress();
+						ForwardProgress(Index, 1);
 					} else {
 						fMutex.Unlock();
 						break;
@@ -364,7 +486,7 @@ namespace CoreArray
 						Idx = Rec.Index; ++Rec.Index; --Rec.TotalSize;
 						fMutex.Unlock();
 						(Rec.Obj->*Rec.Proc)(Idx, *pBuf, ThreadData);
-						ForwardProgress();
+						ForwardProgress(Index, 1);
 					} else {
 						fMutex.Unlock();
 						break;
@@ -467,11 +589,7 @@ namespace CoreArray
 							(Rec.Obj->*Rec.Proc)(Idx, *pBuf++);
 							++Idx;
 						}
-						if (fProgress)
-						{
-							TdAutoMutex AutoMutex(&fMutex);
-							fProgress->Forward(S);
-						}
+						ForwardProgress(Index, S);
 					} else {
 						fMutex.Unlock();
 						break;
@@ -514,11 +632,7 @@ namespace CoreArray
 							(Rec.Obj->*Rec.Proc)(Idx, *pBuf++, ThreadData);
                             ++Idx;
 						}
-						if (fProgress)
-						{
-							TdAutoMutex AutoMutex(&fMutex);
-							fProgress->Forward(S);
-						}
+						ForwardProgress(Index, S);
 					} else {
 						fMutex.Unlock();
 						break;
@@ -530,6 +644,62 @@ namespace CoreArray
 
 		// Queueing model for parallel computing
 
+		/// The scheduler of CParallelQueue, the indices are dispensed in
+		/// chunks from two buffer windows, and a window is flushed in order
+		/// once all of its items are finished
+		class COREARRAY_DLL_DEFAULT CdQueueScheduler
+		{
+		public:
+			/// Flush the results [Start, Start+n) stored at Buffer[Offset]
+			typedef void (*TFlush)(void *Rec, CdThread *Thread, int Index,
+				C_Int64 Start, C_Int64 Offset, size_t n);
+
+			/// The chunk size measured by a thread
+			struct COREARRAY_DLL_DEFAULT TdChunk
+			{
+				C_Int64 Size;   ///< the number of items wanted
+				C_Int64 Tick;   ///< the time stamp when a chunk starts
+				double TimePerItem;  ///< the averaged time per item (ns)
+				TdChunk();
+				COREARRAY_INLINE void Begin() { Tick = GetTimeStampNs(); }
+				void End(C_Int64 Len);
+			};
+
+			CdQueueScheduler();
+
+			/// Initialize, MaxChunk <= 0 for no limit
+			void Init(C_Int64 Total, C_Int64 BufSize, int nThread,
+				C_Int64 MaxChunk, TFlush Flush, void *Rec);
+			/// Get a chunk [Start, Start+Len), return false if no index left
+			bool Get(TdChunk &Chunk, C_Int64 &Start, C_Int64 &Len);
+			/// Mark a chunk as finished, and flush the completed windows
+			void Finish(C_Int64 Start, C_Int64 Len, CdThread *Thread, int Index);
+
+			/// The offset in the buffer of two windows
+			COREARRAY_INLINE C_Int64 BufOffset(C_Int64 Start) const
+			{
+				C_Int64 w = Start / fBufSize;
+				return (w & 1) * fBufSize + (Start - w * fBufSize);
+			}
+			/// The buffer size needed
+			COREARRAY_INLINE C_Int64 NeedBufSize() const
+				{ return (fBufSize < fTotal) ? 2*fBufSize : fBufSize; }
+
+		protected:
+			C_Int64 fTotal, fBufSize, fMaxChunk;
+			int fnThread;
+			volatile C_Int64 fNext;     ///< the next index to be dispensed
+			volatile C_Int64 fLimit;    ///< the end of the two active windows
+			volatile C_Int64 fDone[2];  ///< the finished counts of two windows
+			bool fComplete[2];
+			C_Int64 fFlushed;   ///< the number of windows flushed
+			TFlush fFlush;
+			void *fRec;
+			CdThreadMutex fMutex;
+			CdThreadCondition fCond;
+		};
+
+
 		class COREARRAY_DLL_DEFAULT CParallelQueue:
 			public CParallelBase, protected CdThreadsSuspending
 		{
@@ -544,28 +714,7 @@ namespace CoreArray
 				void (TCLASS::*QueueFunc)(const TINDEX &, OUTTYPE *buf, size_t nbuf),
 				TCLASS *Obj, const TINDEX StartIndex = 0)
 			{
-				if (_ptr)
-					throw ErrParallel("CParallelQueue is working.");
-				if (BufSize <= 0)
-                    throw ErrParallel("The size of buffer should be > 0.");
-				if (TotalSize <= 0) return;
-				if (BufSize > TotalSize) BufSize = TotalSize;
-				if (fProgress) fProgress->Init(TotalSize);
-				// Initialize
-				std::vector<OUTTYPE> Buffer(BufSize);
-				_IStruct<TCLASS, TINDEX, OUTTYPE> Rec;
-				Rec.Obj = Obj;
-				Rec.Proc = Proc; Rec.QueueFunc = QueueFunc;
-				Rec.Buffer = &(Buffer[0]);
-				Rec.Idx = Rec.IdxBase = StartIndex;
-				Rec.TotalSize = TotalSize;
-				Rec.BufSize = Rec.IndexEnd = BufSize;
-				Rec.IndexBase = Rec.WorkingIndex = Rec.FinishIndex = 0;
-                // Working
-				_ptr = (void*)&Rec;
-				CParallelBase::RunThreads<CParallelQueue>(
-					&CParallelQueue::_pThread<TCLASS, TINDEX, OUTTYPE>, this);
-				_ptr = NULL;
+				_Run(TotalSize, BufSize, 0, Proc, QueueFunc, Obj, StartIndex);
 			}
 
 			template<class TCLASS, typename TINDEX, typename OUTTYPE, typename THREADDATA>
@@ -576,28 +725,8 @@ namespace CoreArray
 				void (TCLASS::*InternalFunc)(THREADDATA &, CdThread *, int),
 				TCLASS *Obj, const TINDEX StartIndex = 0)
 			{
-				if (_ptr)
-					throw ErrParallel("CParallelQueue is working.");
-				if (BufSize <= 0)
-                    throw ErrParallel("The size of buffer should be > 0.");
-				if (TotalSize <= 0) return;
-				if (BufSize > TotalSize) BufSize = TotalSize;
-				if (fProgress) fProgress->Init(TotalSize);
-				// Initialize
-				std::vector<OUTTYPE> Buffer(BufSize);
-				_IStruct2<TCLASS, TINDEX, OUTTYPE, THREADDATA> Rec;
-				Rec.Obj = Obj;
-				Rec.Proc = Proc; Rec.QueueFunc = QueueFunc; Rec.InternalFunc = InternalFunc;
-				Rec.Buffer = &(Buffer[0]);
-				Rec.Idx = Rec.IdxBase = StartIndex;
-				Rec.TotalSize = TotalSize;
-				Rec.BufSize = Rec.IndexEnd = BufSize;
-				Rec.IndexBase = Rec.WorkingIndex = Rec.FinishIndex = 0;
-                // Working
-				_ptr = (void*)&Rec;
-				CParallelBase::RunThreads<CParallelQueue>(
-					&CParallelQueue::_pThread2<TCLASS, TINDEX, OUTTYPE, THREADDATA>, this);
-				_ptr = NULL;
+				_Run2(TotalSize, BufSize, 0, Proc, QueueFunc, InternalFunc, Obj,
+					StartIndex);
 			}
 
 			template<class TCLASS, typename TINDEX, typename OUTTYPE>
@@ -609,23 +738,14 @@ namespace CoreArray
 			{
 				if (_ptr)
 					throw ErrParallel("CParallelQueue is working.");
-				if (BufSize <= 0)
-                    throw ErrParallel("The size of buffer should be > 0.");
-				if (TotalSize <= 0) return;
-				if (BufSize > TotalSize) BufSize = TotalSize;
-				if (fProgress) fProgress->Init(TotalSize);
+				if (!_Init(TotalSize, BufSize)) return;
 				// Initialize
-				std::vector<OUTTYPE> Buffer(BufSize);
 				_IStructEx<TCLASS, TINDEX, OUTTYPE> Rec;
 				Rec.Obj = Obj;
 				Rec.Proc = Proc; Rec.QueueFunc = QueueFunc;
-				Rec.Buffer = &(Buffer[0]);
-				Rec.Idx = Rec.IdxBase = StartIndex;
-				Rec.TotalSize = TotalSize;
-				Rec.BufSize = Rec.IndexEnd = BufSize;
-				Rec.IndexBase = Rec.WorkingIndex = Rec.FinishIndex = 0;
-                // Working
-				_ptr = (void*)&Rec;
+				Rec.Idx = StartIndex;
+				_Start(TotalSize, BufSize, 0,
+					&_FlushEx<TCLASS, TINDEX, OUTTYPE>, Rec);
 				CParallelBase::RunThreads<CParallelQueue>(
 					&CParallelQueue::_pThreadEx<TCLASS, TINDEX, OUTTYPE>, this);
 				_ptr = NULL;
@@ -633,6 +753,63 @@ namespace CoreArray
 
 		protected:
 			void *_ptr;
+			CdQueueScheduler fSched;
+
+			/// Check the arguments, return false if nothing to do
+			bool _Init(C_Int64 TotalSize, ssize_t &BufSize);
+
+			/// Allocate the buffer and start the scheduler
+			template<typename TREC>
+				void _Start(C_Int64 TotalSize, ssize_t BufSize, ssize_t SubBufSize,
+					CdQueueScheduler::TFlush Flush, TREC &Rec)
+			{
+				fSched.Init(TotalSize, BufSize, fnThread, SubBufSize, Flush, &Rec);
+				Rec.Buffer.resize(fSched.NeedBufSize());
+				_ptr = (void*)&Rec;
+			}
+
+			template<class TCLASS, typename TINDEX, typename OUTTYPE>
+				void _Run(C_Int64 TotalSize, ssize_t BufSize, ssize_t SubBufSize,
+					void (TCLASS::*Proc)(const TINDEX &, OUTTYPE &),
+					void (TCLASS::*QueueFunc)(const TINDEX &, OUTTYPE *buf, size_t nbuf),
+					TCLASS *Obj, const TINDEX StartIndex)
+			{
+				if (_ptr)
+					throw ErrParallel("CParallelQueue is working.");
+				if (!_Init(TotalSize, BufSize)) return;
+				// Initialize
+				_IStruct<TCLASS, TINDEX, OUTTYPE> Rec;
+				Rec.Obj = Obj;
+				Rec.Proc = Proc; Rec.QueueFunc = QueueFunc;
+				Rec.Idx = StartIndex;
+				_Start(TotalSize, BufSize, SubBufSize,
+					&_Flush<TCLASS, TINDEX, OUTTYPE>, Rec);
+				CParallelBase::RunThreads<CParallelQueue>(
+					&CParallelQueue::_pThread<TCLASS, TINDEX, OUTTYPE>, this);
+				_ptr = NULL;
+			}
+
+			template<class TCLASS, typename TINDEX, typename OUTTYPE, typename THREADDATA>
+				void _Run2(C_Int64 TotalSize, ssize_t BufSize, ssize_t SubBufSize,
+					void (TCLASS::*Proc)(const TINDEX &, OUTTYPE &, THREADDATA &),
+					void (TCLASS::*QueueFunc)(const TINDEX &, OUTTYPE *buf, size_t nbuf),
+					void (TCLASS::*InternalFunc)(THREADDATA &, CdThread *, int),
+					TCLASS *Obj, const TINDEX StartIndex)
+			{
+				if (_ptr)
+					throw ErrParallel("CParallelQueue is working.");
+				if (!_Init(TotalSize, BufSize)) return;
+				// Initialize
+				_IStruct2<TCLASS, TINDEX, OUTTYPE, THREADDATA> Rec;
+				Rec.Obj = Obj;
+				Rec.Proc = Proc; Rec.QueueFunc = QueueFunc; Rec.InternalFunc = InternalFunc;
+				Rec.Idx = StartIndex;
+				_Start(TotalSize, BufSize, SubBufSize,
+					&_Flush2<TCLASS, TINDEX, OUTTYPE, THREADDATA>, Rec);
+				CParallelBase::RunThreads<CParallelQueue>(
+					&CParallelQueue::_pThread2<TCLASS, TINDEX, OUTTYPE, THREADDATA>, this);
+				_ptr = NULL;
+			}
 
 			template<class TCLASS, typename TINDEX, typename OUTTYPE>
 				struct _IStruct
@@ -640,53 +817,40 @@ namespace CoreArray
 				TCLASS *Obj;
 				void (TCLASS::*Proc)(const TINDEX &, OUTTYPE &);
 				void (TCLASS::*QueueFunc)(const TINDEX &, OUTTYPE *buf, size_t nbuf);
-				OUTTYPE *Buffer;
-				TINDEX Idx, IdxBase;
-				C_Int64 TotalSize, IndexBase, IndexEnd;
-				C_Int64 WorkingIndex, FinishIndex;
-				ssize_t BufSize;
+				std::vector<OUTTYPE> Buffer;
+				TINDEX Idx;
 			};
+			template<class TCLASS, typename TINDEX, typename OUTTYPE>
+				static void _Flush(void *ptr, CdThread *Thread, int Index,
+					C_Int64 Start, C_Int64 Offset, size_t n)
+			{
+				_IStruct<TCLASS, TINDEX, OUTTYPE> &Rec =
+					*((_IStruct<TCLASS, TINDEX, OUTTYPE>*)ptr);
+				TINDEX Idx = Rec.Idx; Idx += Start;
+				(Rec.Obj->*Rec.QueueFunc)(Idx, &Rec.Buffer[Offset], n);
+			}
 			template<class TCLASS, typename TINDEX, typename OUTTYPE>
 				void _pThread(CdThread *Thread, int Index)
 			{
 				_IStruct<TCLASS, TINDEX, OUTTYPE> &Rec =
 					*((_IStruct<TCLASS, TINDEX, OUTTYPE>*)_ptr);
-				TINDEX Idx;
-				do {
-					fMutex.Lock();
-					if (Rec.WorkingIndex >= Rec.IndexEnd)
+				CdQueueScheduler::TdChunk Chunk;
+				C_Int64 Start, Len;
+				while (fSched.Get(Chunk, Start, Len))
+				{
+					OUTTYPE *pBuf = &Rec.Buffer[fSched.BufOffset(Start)];
+					TINDEX Idx = Rec.Idx; Idx += Start;
+					// call ...
+					Chunk.Begin();
+					for (C_Int64 i=Len; i > 0; i--)
 					{
-						if (Rec.IndexEnd >= Rec.TotalSize)
-						{
-							fMutex.Unlock(); break;  // exit do-loop
-						} else {
-							fMutex.Unlock(); Suspend();
-                        }
-					} else {
-						OUTTYPE *pBuf = Rec.Buffer + (Rec.WorkingIndex-Rec.IndexBase);
-						Rec.WorkingIndex++;
-						Idx = Rec.Idx; ++Rec.Idx;
-						fMutex.Unlock();
-						// call ...
-						(Rec.Obj->*Rec.Proc)(Idx, *pBuf);
-						// update FinishIndex
-						{
-							TdAutoMutex Auto(&fMutex);
-							if (fProgress)
-								fProgress->Forward();
-							if ((++Rec.FinishIndex) >= Rec.IndexEnd)
-							{
-								size_t OldSize = Rec.IndexEnd - Rec.IndexBase;
-								C_Int64 L = std::min(Rec.TotalSize-Rec.IndexEnd, (C_Int64)Rec.BufSize);
-								Rec.IndexBase = Rec.IndexEnd;
-								Rec.IndexEnd += L;
-								Idx = Rec.IdxBase; Rec.IdxBase += L;
-								(Rec.Obj->*Rec.QueueFunc)(Idx, Rec.Buffer, OldSize);
-								WakeUp();
-							}
-						}
+						(Rec.Obj->*Rec.Proc)(Idx, *pBuf++);
+						++Idx;
 					}
-				} while (true);
+					Chunk.End(Len);
+					ForwardProgress(Index, Len);
+					fSched.Finish(Start, Len, Thread, Index);
+				}
 			}
 
 			template<class TCLASS, typename TINDEX, typename OUTTYPE, typename THREADDATA>
@@ -696,12 +860,18 @@ namespace CoreArray
 				void (TCLASS::*Proc)(const TINDEX &, OUTTYPE &, THREADDATA &);
 				void (TCLASS::*QueueFunc)(const TINDEX &, OUTTYPE *, size_t);
 				void (TCLASS::*InternalFunc)(THREADDATA &, CdThread *, int);
-				OUTTYPE *Buffer;
-				TINDEX Idx, IdxBase;
-				C_Int64 TotalSize, IndexBase, IndexEnd;
-				C_Int64 WorkingIndex, FinishIndex;
-				ssize_t BufSize;
+				std::vector<OUTTYPE> Buffer;
+				TINDEX Idx;
 			};
+			template<class TCLASS, typename TINDEX, typename OUTTYPE, typename THREADDATA>
+				static void _Flush2(void *ptr, CdThread *Thread, int Index,
+					C_Int64 Start, C_Int64 Offset, size_t n)
+			{
+				_IStruct2<TCLASS, TINDEX, OUTTYPE, THREADDATA> &Rec =
+					*((_IStruct2<TCLASS, TINDEX, OUTTYPE, THREADDATA>*)ptr);
+				TINDEX Idx = Rec.Idx; Idx += Start;
+				(Rec.Obj->*Rec.QueueFunc)(Idx, &Rec.Buffer[Offset], n);
+			}
 			template<class TCLASS, typename TINDEX, typename OUTTYPE, typename THREADDATA>
 				void _pThread2(CdThread *Thread, int Index)
 			{
@@ -711,42 +881,23 @@ namespace CoreArray
 				THREADDATA ThreadData;
 				(Rec.Obj->*Rec.InternalFunc)(ThreadData, Thread, Index);
 
-				TINDEX Idx;
-				do {
-					fMutex.Lock();
-					if (Rec.WorkingIndex >= Rec.IndexEnd)
+				CdQueueScheduler::TdChunk Chunk;
+				C_Int64 Start, Len;
+				while (fSched.Get(Chunk, Start, Len))
+				{
+					OUTTYPE *pBuf = &Rec.Buffer[fSched.BufOffset(Start)];
+					TINDEX Idx = Rec.Idx; Idx += Start;
+					// call ...
+					Chunk.Begin();
+					for (C_Int64 i=Len; i > 0; i--)
 					{
-						if (Rec.IndexEnd >= Rec.TotalSize)
-						{
-							fMutex.Unlock(); break;  // exit do-loop
-						} else {
-							fMutex.Unlock(); Suspend();
-                        }
-					} else {
-						OUTTYPE *pBuf = Rec.Buffer + (Rec.WorkingIndex-Rec.IndexBase);
-						Rec.WorkingIndex++;
-						Idx = Rec.Idx; ++Rec.Idx;
-						fMutex.Unlock();
-						// call ...
-						(Rec.Obj->*Rec.Proc)(Idx, *pBuf, ThreadData);
-						// update FinishIndex
-						{
-							TdAutoMutex Auto(&fMutex);
-							if (fProgress)
-								fProgress->Forward();
-							if ((++Rec.FinishIndex) >= Rec.IndexEnd)
-							{
-								size_t OldSize = Rec.IndexEnd - Rec.IndexBase;
-								C_Int64 L = std::min(Rec.TotalSize-Rec.IndexEnd, (C_Int64)Rec.BufSize);
-								Rec.IndexBase = Rec.IndexEnd;
-								Rec.IndexEnd += L;
-								Idx = Rec.IdxBase; Rec.IdxBase += L;
-								(Rec.Obj->*Rec.QueueFunc)(Idx, Rec.Buffer, OldSize);
-								WakeUp();
-							}
-						}
+						(Rec.Obj->*Rec.Proc)(Idx, *pBuf++, ThreadData);
+						++Idx;
 					}
-				} while (true);
+					Chunk.End(Len);
+					ForwardProgress(Index, Len);
+					fSched.Finish(Start, Len, Thread, Index);
+				}
 			}
 
 			template<class TCLASS, typename TINDEX, typename OUTTYPE>
@@ -755,53 +906,40 @@ namespace CoreArray
 				TCLASS *Obj;
 				void (TCLASS::*Proc)(CdThread *, int, const TINDEX &, OUTTYPE &);
 				void (TCLASS::*QueueFunc)(CdThread *, int, const TINDEX &, OUTTYPE *, size_t);
-				OUTTYPE *Buffer;
-				TINDEX Idx, IdxBase;
-				C_Int64 TotalSize, IndexBase, IndexEnd;
-				C_Int64 WorkingIndex, FinishIndex;
-				ssize_t BufSize;
+				std::vector<OUTTYPE> Buffer;
+				TINDEX Idx;
 			};
+			template<class TCLASS, typename TINDEX, typename OUTTYPE>
+				static void _FlushEx(void *ptr, CdThread *Thread, int Index,
+					C_Int64 Start, C_Int64 Offset, size_t n)
+			{
+				_IStructEx<TCLASS, TINDEX, OUTTYPE> &Rec =
+					*((_IStructEx<TCLASS, TINDEX, OUTTYPE>*)ptr);
+				TINDEX Idx = Rec.Idx; Idx += Start;
+				(Rec.Obj->*Rec.QueueFunc)(Thread, Index, Idx, &Rec.Buffer[Offset], n);
+			}
 			template<class TCLASS, typename TINDEX, typename OUTTYPE>
 				void _pThreadEx(CdThread *Thread, int Index)
 			{
 				_IStructEx<TCLASS, TINDEX, OUTTYPE> &Rec =
 					*((_IStructEx<TCLASS, TINDEX, OUTTYPE>*)_ptr);
-				TINDEX Idx;
-				do {
-					fMutex.Lock();
-					if (Rec.WorkingIndex >= Rec.IndexEnd)
+				CdQueueScheduler::TdChunk Chunk;
+				C_Int64 Start, Len;
+				while (fSched.Get(Chunk, Start, Len))
+				{
+					OUTTYPE *pBuf = &Rec.Buffer[fSched.BufOffset(Start)];
+					TINDEX Idx = Rec.Idx; Idx += Start;
+					// call ...
+					Chunk.Begin();
+					for (C_Int64 i=Len; i > 0; i--)
 					{
-						if (Rec.IndexEnd >= Rec.TotalSize)
-						{
-							fMutex.Unlock(); break;  // exit do-loop
-						} else {
-							fMutex.Unlock(); Suspend();
-                        }
-					} else {
-						OUTTYPE *pBuf = Rec.Buffer + (Rec.WorkingIndex-Rec.IndexBase);
-						Rec.WorkingIndex++;
-						Idx = Rec.Idx; ++Rec.Idx;
-						fMutex.Unlock();
-						// call ...
-						(Rec.Obj->*Rec.Proc)(Thread, Index, Idx, *pBuf);
-						// update FinishIndex
-						{
-							TdAutoMutex Auto(&fMutex);
-							if (fProgress)
-								fProgress->Forward();
-							if ((++Rec.FinishIndex) >= Rec.IndexEnd)
-							{
-								size_t OldSize = Rec.IndexEnd - Rec.IndexBase;
-								C_Int64 L = std::min(Rec.TotalSize-Rec.IndexEnd, (C_Int64)Rec.BufSize);
-								Rec.IndexBase = Rec.IndexEnd;
-								Rec.IndexEnd += L;
-								Idx = Rec.IdxBase; Rec.IdxBase += L;
-								(Rec.Obj->*Rec.QueueFunc)(Thread, Index, Idx, Rec.Buffer, OldSize);
-								WakeUp();
-							}
-						}
+						(Rec.Obj->*Rec.Proc)(Thread, Index, Idx, *pBuf++);
+						++Idx;
 					}
-				} while (true);
+					Chunk.End(Len);
+					ForwardProgress(Index, Len);
+					fSched.Finish(Start, Len, Thread, Index);
+				}
 			}
 		};
 
@@ -818,32 +956,10 @@ namespace CoreArray
 				void (TCLASS::*QueueFunc)(const TINDEX &, OUTTYPE *buf, size_t nbuf),
 				TCLASS *Obj, const TINDEX StartIndex = 0)
 			{
-				if (_ptr)
-					throw ErrParallel("CParallelQueueEx is working.");
-				if (BufSize <= 0)
-					throw ErrParallel("The size of buffer should be > 0.");
 				if (SubBufSize <= 0)
 					throw ErrParallel("The size of sub buffer should be > 0.");
-				if (TotalSize <= 0) return;
-				if (BufSize > TotalSize) BufSize = TotalSize;
-				if (SubBufSize > BufSize) SubBufSize = BufSize;
-				if (fProgress) fProgress->Init(TotalSize);
-				// Initialize
-				std::vector<OUTTYPE> Buffer(BufSize);
-				_IStruct<TCLASS, TINDEX, OUTTYPE> Rec;
-				Rec.Obj = Obj;
-				Rec.Proc = Proc; Rec.QueueFunc = QueueFunc;
-				Rec.Buffer = &(Buffer[0]);
-				Rec.Idx = Rec.IdxBase = StartIndex;
-				Rec.TotalSize = TotalSize;
-				Rec.BufSize = Rec.IndexEnd = BufSize;
-				Rec.SubBufSize = SubBufSize;
-				Rec.IndexBase = Rec.WorkingIndex = Rec.FinishIndex = 0;
-                // Working
-				_ptr = (void*)&Rec;
-				CParallelBase::RunThreads<CParallelQueueEx>(
-					&CParallelQueueEx::_pThread<TCLASS, TINDEX, OUTTYPE>, this);
-				_ptr = NULL;
+				_Run(TotalSize, BufSize, SubBufSize, Proc, QueueFunc, Obj,
+					StartIndex);
 			}
 
 			template<class TCLASS, typename TINDEX, typename OUTTYPE, typename THREADDATA>
@@ -854,160 +970,8 @@ namespace CoreArray
 				void (TCLASS::*InternalFunc)(THREADDATA &, CdThread *, int),
 				TCLASS *Obj, const TINDEX StartIndex = 0)
 			{
-				if (_ptr)
-					throw ErrParallel("CParallelQueue is working.");
-				if (BufSize <= 0)
-                    throw ErrParallel("The size of buffer should be > 0.");
-				if (TotalSize <= 0) return;
-				if (BufSize > TotalSize) BufSize = TotalSize;
-				if (fProgress) fProgress->Init(TotalSize);
-				// Initialize
-				std::vector<OUTTYPE> Buffer(BufSize);
-				_IStruct2<TCLASS, TINDEX, OUTTYPE, THREADDATA> Rec;
-				Rec.Obj = Obj;
-				Rec.Proc = Proc; Rec.QueueFunc = QueueFunc; Rec.InternalFunc = InternalFunc;
-				Rec.Buffer = &(Buffer[0]);
-				Rec.Idx = Rec.IdxBase = StartIndex;
-				Rec.TotalSize = TotalSize;
-				Rec.BufSize = Rec.IndexEnd = BufSize;
-				Rec.IndexBase = Rec.WorkingIndex = Rec.FinishIndex = 0;
-                // Working
-				_ptr = (void*)&Rec;
-				CParallelBase::RunThreads<CParallelQueue>(
-					&CParallelQueue::_pThread2<TCLASS, TINDEX, OUTTYPE, THREADDATA>, this);
-				_ptr = NULL;
-			}
-
-		protected:
-			template<class TCLASS, typename TINDEX, typename OUTTYPE>
-				struct _IStruct
-			{
-				TCLASS *Obj;
-				void (TCLASS::*Proc)(const TINDEX &, OUTTYPE &);
-				void (TCLASS::*QueueFunc)(const TINDEX &, OUTTYPE *buf, size_t nbuf);
-				OUTTYPE *Buffer;
-				TINDEX Idx, IdxBase;
-				C_Int64 TotalSize, IndexBase, IndexEnd;
-				C_Int64 WorkingIndex, FinishIndex;
-				ssize_t BufSize, SubBufSize;
-			};
-			template<class TCLASS, typename TINDEX, typename OUTTYPE>
-				void _pThread(CdThread *Thread, int Index)
-			{
-				_IStruct<TCLASS, TINDEX, OUTTYPE> &Rec =
-					*((_IStruct<TCLASS, TINDEX, OUTTYPE>*)_ptr);
-				TINDEX Idx;
-				do {
-					fMutex.Lock();
-					if (Rec.WorkingIndex >= Rec.IndexEnd)
-					{
-						if (Rec.IndexEnd >= Rec.TotalSize)
-						{
-							fMutex.Unlock(); break;  // exit do-loop
-						} else {
-							fMutex.Unlock(); Suspend();
-                        }
-					} else {
-						ssize_t tmpL = Rec.IndexEnd - Rec.WorkingIndex;
-						if (tmpL > Rec.SubBufSize)
-                        	tmpL = Rec.SubBufSize;
-						OUTTYPE *pBuf = Rec.Buffer + (Rec.WorkingIndex-Rec.IndexBase);
-						Rec.WorkingIndex += tmpL;
-						Idx = Rec.Idx; Rec.Idx += tmpL;
-						fMutex.Unlock();
-						// call ...
-						for (ssize_t i = tmpL; i > 0; i--)
-						{
-							(Rec.Obj->*Rec.Proc)(Idx, *pBuf);
-							++Idx; pBuf++;
-                        }
-						// update FinishIndex
-						{
-							TdAutoMutex Auto(&fMutex);
-							if (fProgress)
-								fProgress->Forward(tmpL);
-							Rec.FinishIndex += tmpL;
-							if (Rec.FinishIndex >= Rec.IndexEnd)
-							{
-								size_t OldSize = Rec.IndexEnd - Rec.IndexBase;
-								C_Int64 L = std::min(Rec.TotalSize-Rec.IndexEnd, (C_Int64)Rec.BufSize);
-								Rec.IndexBase = Rec.IndexEnd;
-								Rec.IndexEnd += L;
-								Idx = Rec.IdxBase; Rec.IdxBase += L;
-								(Rec.Obj->*Rec.QueueFunc)(Idx, Rec.Buffer, OldSize);
-								WakeUp();
-							}
-						}
-					}
-				} while (true);
-			}
-
-			template<class TCLASS, typename TINDEX, typename OUTTYPE, typename THREADDATA>
-				struct _IStruct2
-			{
-				TCLASS *Obj;
-				void (TCLASS::*Proc)(const TINDEX &, OUTTYPE &, THREADDATA &);
-				void (TCLASS::*QueueFunc)(const TINDEX &, OUTTYPE *, size_t);
-				void (TCLASS::*InternalFunc)(THREADDATA &, CdThread *, int);
-				OUTTYPE *Buffer;
-				TINDEX Idx, IdxBase;
-				C_Int64 TotalSize, IndexBase, IndexEnd;
-				C_Int64 WorkingIndex, FinishIndex;
-				ssize_t BufSize, SubBufSize;
-			};
-			template<class TCLASS, typename TINDEX, typename OUTTYPE, typename THREADDATA>
-				void _pThread2(CdThread *Thread, int Index)
-			{
-				_IStruct2<TCLASS, TINDEX, OUTTYPE, THREADDATA> &Rec =
-					*((_IStruct2<TCLASS, TINDEX, OUTTYPE, THREADDATA>*)_ptr);
-                // _INTERNAL data for each thread
-				THREADDATA ThreadData;
-				(Rec.Obj->*Rec.InternalFunc)(ThreadData, Thread, Index);
-
-				TINDEX Idx;
-				do {
-					fMutex.Lock();
-					if (Rec.WorkingIndex >= Rec.IndexEnd)
-					{
-						if (Rec.IndexEnd >= Rec.TotalSize)
-						{
-							fMutex.Unlock(); break;  // exit do-loop
-						} else {
-							fMutex.Unlock(); Suspend();
-                        }
-					} else {
-						ssize_t tmpL = Rec.IndexEnd - Rec.WorkingIndex;
-						if (tmpL > Rec.SubBufSize)
-                        	tmpL = Rec.SubBufSize;
-						OUTTYPE *pBuf = Rec.Buffer + (Rec.WorkingIndex-Rec.IndexBase);
-						Rec.WorkingIndex += tmpL;
-						Idx = Rec.Idx; Rec.Idx += tmpL;
-						fMutex.Unlock();
-						// call ...
-						for (ssize_t i = tmpL; i > 0; i--)
-						{
-							(Rec.Obj->*Rec.Proc)(Idx, *pBuf, ThreadData);
-							++Idx; pBuf++;
-						}
-						// update FinishIndex
-						{
-							TdAutoMutex Auto(&fMutex);
-							if (fProgress)
-								fProgress->Forward(tmpL);
-							Rec.FinishIndex += tmpL;
-							if (Rec.FinishIndex >= Rec.IndexEnd)
-							{
-								size_t OldSize = Rec.IndexEnd - Rec.IndexBase;
-								C_Int64 L = std::min(Rec.TotalSize-Rec.IndexEnd, (C_Int64)Rec.BufSize);
-								Rec.IndexBase = Rec.IndexEnd;
-								Rec.IndexEnd += L;
-								Idx = Rec.IdxBase; Rec.IdxBase += L;
-								(Rec.Obj->*Rec.QueueFunc)(Idx, Rec.Buffer, OldSize);
-								WakeUp();
-							}
-						}
-					}
-				} while (true);
+				_Run2(TotalSize, BufSize, SubBufSize, Proc, QueueFunc,
+					InternalFunc, Obj, StartIndex);
 			}
         };
 	}
@@ -59,6 +59,10 @@
 	#  include <sys/sysinfo.h>
 	#endif
 
+	#if defined(COREARRAY_PLATFORM_LINUX)
+	#  include <sys/syscall.h>
+	#endif
+
 #endif
 
 
@@ -1231,6 +1235,35 @@ bool CoreArray::SysHandleSetSize(TSysHandle Handle, C_Int64 NewSize)
 	#endif
 }
 
+C_Int64 CoreArray::SysHandleCopy(TSysHandle Src, C_Int64 SrcPos,
+	TSysHandle Dst, C_Int64 Count)
+{
+	C_Int64 rv = 0;
+	#if defined(COREARRAY_PLATFORM_LINUX) && defined(__NR_copy_file_range)
+		// copy in the kernel without passing through the user space
+		loff_t off = SrcPos;
+		while (Count > 0)
+		{
+			size_t n = (Count < 0x40000000) ? Count : 0x40000000;
+			long r = syscall(__NR_copy_file_range, Src, &off, Dst, NULL, n, 0);
+			if (r <= 0) break;
+			rv += r; Count -= r;
+		}
+	#endif
+	return rv;
+}
+
+bool CoreArray::SysHandlePunchHole(TSysHandle Handle, C_Int64 Offset,
+	C_Int64 Len)
+{
+	#if defined(COREARRAY_PLATFORM_LINUX) && defined(FALLOC_FL_PUNCH_HOLE)
+		return fallocate(Handle, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+			Offset, Len) == 0;
+	#else
+		return false;
+	#endif
+}
+
 string CoreArray::TempFileName(const char *prefix, const char *tempdir)
 {
 #if defined(COREARRAY_USING_R)
@@ -1542,6 +1575,41 @@ TProcessID CoreArray::GetCurrentProcessID()
 #endif
 }
 
+C_Int64 CoreArray::GetTimeStampNs()
+{
+#if defined(COREARRAY_PLATFORM_WINDOWS)
+	LARGE_INTEGER cnt, freq;
+	QueryPerformanceCounter(&cnt);
+	QueryPerformanceFrequency(&freq);
+	return (C_Int64)((double)cnt.QuadPart * 1e9 / freq.QuadPart);
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (C_Int64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+
+#ifdef COREARRAY_ATOMIC_MUTEX
+
+static CdThreadMutex AtomicMutex;
+
+C_Int64 CoreArray::AtomicAdd(volatile C_Int64 *p, C_Int64 v)
+{
+	TdAutoMutex _m(&AtomicMutex);
+	return (*p += v);
+}
+
+bool CoreArray::AtomicCAS(volatile C_Int64 *p, C_Int64 old, C_Int64 val)
+{
+	TdAutoMutex _m(&AtomicMutex);
+	if (*p != old) return false;
+	*p = val;
+	return true;
+}
+
+#endif
+
 
 
 // =========================================================================
@@ -315,6 +315,14 @@ namespace CoreArray
 		C_Int64 Offset, enum TdSysSeekOrg sk);
 	COREARRAY_DLL_DEFAULT bool SysHandleSetSize(TSysHandle Handle,
 		C_Int64 NewSize);
+	/// copy 'Count' bytes at 'SrcPos' of 'Src' to the current position of
+	/// 'Dst' in the kernel if supported, return the number of copied bytes
+	COREARRAY_DLL_DEFAULT C_Int64 SysHandleCopy(TSysHandle Src,
+		C_Int64 SrcPos, TSysHandle Dst, C_Int64 Count);
+	/// deallocate the space of a file region if supported, the file size and
+	/// the content outside the region are kept
+	COREARRAY_DLL_DEFAULT bool SysHandlePunchHole(TSysHandle Handle,
+		C_Int64 Offset, C_Int64 Len);
 
 	/// get a temporary file name
 	COREARRAY_DLL_DEFAULT string TempFileName(const char *prefix,
@@ -385,6 +393,53 @@ namespace CoreArray
 	/// Get the current process id
 	COREARRAY_DLL_DEFAULT TProcessID GetCurrentProcessID();
 
+	/// Get a monotonic time stamp in nanoseconds
+	COREARRAY_DLL_DEFAULT C_Int64 GetTimeStampNs();
+
+
+
+	// =====================================================================
+	// Atomic operations on 64-bit integers
+	// =====================================================================
+
+#if defined(COREARRAY_CC_GNU) || defined(COREARRAY_CC_CLANG) || defined(COREARRAY_CC_INTEL)
+
+	/// Atomically add v to *p, and return the new value
+	COREARRAY_INLINE C_Int64 AtomicAdd(volatile C_Int64 *p, C_Int64 v)
+		{ return __sync_add_and_fetch(p, v); }
+	/// Atomically set *p to val if *p is old, return true if succeed
+	COREARRAY_INLINE bool AtomicCAS(volatile C_Int64 *p, C_Int64 old, C_Int64 val)
+		{ return __sync_bool_compare_and_swap(p, old, val); }
+
+#elif defined(COREARRAY_PLATFORM_WINDOWS)
+
+	/// Atomically add v to *p, and return the new value
+	COREARRAY_INLINE C_Int64 AtomicAdd(volatile C_Int64 *p, C_Int64 v)
+		{ return InterlockedExchangeAdd64((volatile LONGLONG*)p, v) + v; }
+	/// Atomically set *p to val if *p is old, return true if succeed
+	COREARRAY_INLINE bool AtomicCAS(volatile C_Int64 *p, C_Int64 old, C_Int64 val)
+		{ return InterlockedCompareExchange64((volatile LONGLONG*)p, val, old) == old; }
+
+#else
+
+	/// Atomically add v to *p, and return the new value (using a mutex)
+	COREARRAY_DLL_DEFAULT C_Int64 AtomicAdd(volatile C_Int64 *p, C_Int64 v);
+	/// Atomically set *p to val if *p is old, return true if succeed
+	COREARRAY_DLL_DEFAULT bool AtomicCAS(volatile C_Int64 *p, C_Int64 old, C_Int64 val);
+	#define COREARRAY_ATOMIC_MUTEX
+
+#endif
+
+	/// Atomically read *p
+	COREARRAY_INLINE C_Int64 AtomicGet(volatile C_Int64 *p)
+		{ return AtomicAdd(p, 0); }
+	/// Atomically set *p to v
+	COREARRAY_INLINE void AtomicSet(volatile C_Int64 *p, C_Int64 v)
+	{
+		C_Int64 old = AtomicGet(p);
+		while (!AtomicCAS(p, old, v)) old = AtomicGet(p);
+	}
+
 
 
 	// =====================================================================
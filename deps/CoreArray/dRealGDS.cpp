@@ -31,9 +31,427 @@
 
 #include "dRealGDS.h"
 
+#ifdef COREARRAY_SIMD_SSSE3
+#   include <tmmintrin.h>
+#endif
+
 
 namespace CoreArray
 {
+	// =====================================================================
+	// Vectorized conversion between packed integers and real numbers
+	// =====================================================================
+
+#ifdef COREARRAY_SIMD_SSE2
+
+	/// 4 packed doubles in two registers: (*lo, *hi) = x*scale + offset,
+	/// and NaN if the corresponding 32-bit mask is set
+	static COREARRAY_INLINE void sse2_dec_i32x4(__m128d &lo, __m128d &hi,
+		__m128i x, __m128i m32, __m128d bias, __m128d offset, __m128d scale)
+	{
+		const __m128d nan = _mm_set1_pd(NaN);
+		__m128d m0 = _mm_castsi128_pd(_mm_unpacklo_epi32(m32, m32));
+		__m128d m1 = _mm_castsi128_pd(_mm_unpackhi_epi32(m32, m32));
+		__m128d d0 = _mm_add_pd(_mm_cvtepi32_pd(x), bias);
+		__m128d d1 = _mm_add_pd(_mm_cvtepi32_pd(_mm_srli_si128(x, 8)), bias);
+		d0 = _mm_add_pd(_mm_mul_pd(d0, scale), offset);
+		d1 = _mm_add_pd(_mm_mul_pd(d1, scale), offset);
+		lo = _mm_or_pd(_mm_andnot_pd(m0, d0), _mm_and_pd(m0, nan));
+		hi = _mm_or_pd(_mm_andnot_pd(m1, d1), _mm_and_pd(m1, nan));
+	}
+
+	static COREARRAY_INLINE void sse2_store_i32x4(C_Float64 *p,
+		__m128i x, __m128i m32, __m128d bias, __m128d offset, __m128d scale)
+	{
+		__m128d lo, hi;
+		sse2_dec_i32x4(lo, hi, x, m32, bias, offset, scale);
+		_mm_storeu_pd(p, lo);
+		_mm_storeu_pd(p + 2, hi);
+	}
+
+	static COREARRAY_INLINE void sse2_store_i32x4(C_Float32 *p,
+		__m128i x, __m128i m32, __m128d bias, __m128d offset, __m128d scale)
+	{
+		__m128d lo, hi;
+		sse2_dec_i32x4(lo, hi, x, m32, bias, offset, scale);
+		_mm_storeu_ps(p, _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi)));
+	}
+
+	/// round half away from zero and check the range, return 2 integers in
+	/// the lower 64 bits and the mask of valid values
+	static COREARRAY_INLINE __m128i sse2_enc_f64x2(__m128d x, __m128d lo,
+		__m128d hi, __m128i &valid)
+	{
+		const __m128d sign = _mm_set1_pd(-0.0);
+		const __m128d one  = _mm_set1_pd(1.0);
+		const __m128d half = _mm_set1_pd(0.5);
+		// finite and in (lo-1, hi+1), NaN fails the comparisons
+		__m128d ok = _mm_and_pd(_mm_cmpgt_pd(x, _mm_sub_pd(lo, one)),
+			_mm_cmplt_pd(x, _mm_add_pd(hi, one)));
+		x = _mm_and_pd(ok, x);
+		__m128d t = _mm_cvtepi32_pd(_mm_cvttpd_epi32(x));
+		__m128d f = _mm_andnot_pd(sign, _mm_sub_pd(x, t));
+		__m128d a = _mm_and_pd(_mm_cmpge_pd(f, half),
+			_mm_or_pd(_mm_and_pd(x, sign), one));
+		t = _mm_add_pd(t, a);
+		ok = _mm_and_pd(ok, _mm_and_pd(_mm_cmpge_pd(t, lo), _mm_cmple_pd(t, hi)));
+		valid = _mm_shuffle_epi32(_mm_castpd_si128(ok), _MM_SHUFFLE(3,1,2,0));
+		return _mm_cvttpd_epi32(_mm_and_pd(ok, t));
+	}
+
+	/// encode 4 doubles to 4 integers, missing if invalid
+	static COREARRAY_INLINE __m128i sse2_enc_f64x4(__m128d x0, __m128d x1,
+		__m128d lo, __m128d hi, __m128i missing)
+	{
+		__m128i m0, m1;
+		__m128i i0 = sse2_enc_f64x2(x0, lo, hi, m0);
+		__m128i i1 = sse2_enc_f64x2(x1, lo, hi, m1);
+		__m128i v = _mm_unpacklo_epi64(i0, i1);
+		__m128i m = _mm_unpacklo_epi64(m0, m1);
+		return _mm_or_si128(_mm_and_si128(m, v), _mm_andnot_si128(m, missing));
+	}
+
+	static COREARRAY_INLINE __m128i sse2_enc_x4(const C_Float64 *s,
+		__m128d offset, __m128d invscale, __m128d lo, __m128d hi,
+		__m128i missing)
+	{
+		__m128d x0 = _mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(s), offset), invscale);
+		__m128d x1 = _mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(s+2), offset), invscale);
+		return sse2_enc_f64x4(x0, x1, lo, hi, missing);
+	}
+
+	static COREARRAY_INLINE __m128i sse2_enc_x4(const C_Float32 *s,
+		__m128d offset, __m128d invscale, __m128d lo, __m128d hi,
+		__m128i missing)
+	{
+		__m128 v = _mm_loadu_ps(s);
+		__m128d x0 = _mm_cvtps_pd(v);
+		__m128d x1 = _mm_cvtps_pd(_mm_movehl_ps(v, v));
+		x0 = _mm_mul_pd(_mm_sub_pd(x0, offset), invscale);
+		x1 = _mm_mul_pd(_mm_sub_pd(x1, offset), invscale);
+		return sse2_enc_f64x4(x0, x1, lo, hi, missing);
+	}
+
+	/// truncate 8 32-bit integers to 8 16-bit integers
+	static COREARRAY_INLINE __m128i sse2_i32_to_i16(__m128i v0, __m128i v1)
+	{
+		v0 = _mm_srai_epi32(_mm_slli_epi32(v0, 16), 16);
+		v1 = _mm_srai_epi32(_mm_slli_epi32(v1, 16), 16);
+		return _mm_packs_epi32(v0, v1);
+	}
+
+#endif
+
+
+	// decode 16-bit integers
+
+	template<typename OUT_TYPE>
+		static COREARRAY_INLINE OUT_TYPE *dec_i16(OUT_TYPE *p, const C_Int16 *s,
+		size_t n, C_Float64 offset, C_Float64 scale, C_Int16 missing)
+	{
+	#ifdef COREARRAY_SIMD_SSE2
+		const __m128d bias = _mm_setzero_pd();
+		const __m128d off4 = _mm_set1_pd(offset);
+		const __m128d sc4 = _mm_set1_pd(scale);
+		const __m128i mv = _mm_set1_epi16(missing);
+		for (; n >= 8; n-=8, s+=8, p+=8)
+		{
+			__m128i v = _mm_loadu_si128((__m128i const*)s);
+			__m128i m = _mm_cmpeq_epi16(v, mv);
+			__m128i x0 = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+			__m128i x1 = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+			sse2_store_i32x4(p, x0, _mm_unpacklo_epi16(m, m), bias, off4, sc4);
+			sse2_store_i32x4(p+4, x1, _mm_unpackhi_epi16(m, m), bias, off4, sc4);
+		}
+	#endif
+		for (; n > 0; n--, s++)
+			*p++ = (*s != missing) ? OUT_TYPE((*s) * scale + offset) : OUT_TYPE(NaN);
+		return p;
+	}
+
+	C_Float64 *vec_real_decode(C_Float64 *p, const C_Int16 *s, size_t n,
+		C_Float64 offset, C_Float64 scale, C_Int16 missing)
+	{
+		return dec_i16(p, s, n, offset, scale, missing);
+	}
+
+	C_Float32 *vec_real_decode(C_Float32 *p, const C_Int16 *s, size_t n,
+		C_Float64 offset, C_Float64 scale, C_Int16 missing)
+	{
+		return dec_i16(p, s, n, offset, scale, missing);
+	}
+
+
+	// decode unsigned 16-bit integers
+
+	template<typename OUT_TYPE>
+		static COREARRAY_INLINE OUT_TYPE *dec_u16(OUT_TYPE *p, const C_UInt16 *s,
+		size_t n, C_Float64 offset, C_Float64 scale, C_UInt16 missing)
+	{
+	#ifdef COREARRAY_SIMD_SSE2
+		const __m128d bias = _mm_setzero_pd();
+		const __m128d off4 = _mm_set1_pd(offset);
+		const __m128d sc4 = _mm_set1_pd(scale);
+		const __m128i mv = _mm_set1_epi16(missing);
+		const __m128i zero = _mm_setzero_si128();
+		for (; n >= 8; n-=8, s+=8, p+=8)
+		{
+			__m128i v = _mm_loadu_si128((__m128i const*)s);
+			__m128i m = _mm_cmpeq_epi16(v, mv);
+			__m128i x0 = _mm_unpacklo_epi16(v, zero);
+			__m128i x1 = _mm_unpackhi_epi16(v, zero);
+			sse2_store_i32x4(p, x0, _mm_unpacklo_epi16(m, m), bias, off4, sc4);
+			sse2_store_i32x4(p+4, x1, _mm_unpackhi_epi16(m, m), bias, off4, sc4);
+		}
+	#endif
+		for (; n > 0; n--, s++)
+			*p++ = (*s != missing) ? OUT_TYPE((*s) * scale + offset) : OUT_TYPE(NaN);
+		return p;
+	}
+
+	C_Float64 *vec_real_decode(C_Float64 *p, const C_UInt16 *s, size_t n,
+		C_Float64 offset, C_Float64 scale, C_UInt16 missing)
+	{
+		return dec_u16(p, s, n, offset, scale, missing);
+	}
+
+	C_Float32 *vec_real_decode(C_Float32 *p, const C_UInt16 *s, size_t n,
+		C_Float64 offset, C_Float64 scale, C_UInt16 missing)
+	{
+		return dec_u16(p, s, n, offset, scale, missing);
+	}
+
+
+	// decode 32-bit integers
+
+	template<typename OUT_TYPE>
+		static COREARRAY_INLINE OUT_TYPE *dec_i32(OUT_TYPE *p, const C_Int32 *s,
+		size_t n, C_Float64 offset, C_Float64 scale, C_Int32 missing)
+	{
+	#ifdef COREARRAY_SIMD_SSE2
+		const __m128d bias = _mm_setzero_pd();
+		const __m128d off4 = _mm_set1_pd(offset);
+		const __m128d sc4 = _mm_set1_pd(scale);
+		const __m128i mv = _mm_set1_epi32(missing);
+		for (; n >= 4; n-=4, s+=4, p+=4)
+		{
+			__m128i v = _mm_loadu_si128((__m128i const*)s);
+			sse2_store_i32x4(p, v, _mm_cmpeq_epi32(v, mv), bias, off4, sc4);
+		}
+	#endif
+		for (; n > 0; n--, s++)
+			*p++ = (*s != missing) ? OUT_TYPE((*s) * scale + offset) : OUT_TYPE(NaN);
+		return p;
+	}
+
+	C_Float64 *vec_real_decode(C_Float64 *p, const C_Int32 *s, size_t n,
+		C_Float64 offset, C_Float64 scale, C_Int32 missing)
+	{
+		return dec_i32(p, s, n, offset, scale, missing);
+	}
+
+	C_Float32 *vec_real_decode(C_Float32 *p, const C_Int32 *s, size_t n,
+		C_Float64 offset, C_Float64 scale, C_Int32 missing)
+	{
+		return dec_i32(p, s, n, offset, scale, missing);
+	}
+
+
+	// decode unsigned 32-bit integers
+
+	template<typename OUT_TYPE>
+		static COREARRAY_INLINE OUT_TYPE *dec_u32(OUT_TYPE *p, const C_UInt32 *s,
+		size_t n, C_Float64 offset, C_Float64 scale, C_UInt32 missing)
+	{
+	#ifdef COREARRAY_SIMD_SSE2
+		// flip the sign bit, and then add 2^31 after conversion
+		const __m128d bias = _mm_set1_pd(2147483648.0);
+		const __m128d off4 = _mm_set1_pd(offset);
+		const __m128d sc4 = _mm_set1_pd(scale);
+		const __m128i mv = _mm_set1_epi32(missing);
+		const __m128i flip = _mm_set1_epi32(0x80000000);
+		for (; n >= 4; n-=4, s+=4, p+=4)
+		{
+			__m128i v = _mm_loadu_si128((__m128i const*)s);
+			sse2_store_i32x4(p, _mm_xor_si128(v, flip),
+				_mm_cmpeq_epi32(v, mv), bias, off4, sc4);
+		}
+	#endif
+		for (; n > 0; n--, s++)
+			*p++ = (*s != missing) ? OUT_TYPE((*s) * scale + offset) : OUT_TYPE(NaN);
+		return p;
+	}
+
+	C_Float64 *vec_real_decode(C_Float64 *p, const C_UInt32 *s, size_t n,
+		C_Float64 offset, C_Float64 scale, C_UInt32 missing)
+	{
+		return dec_u32(p, s, n, offset, scale, missing);
+	}
+
+	C_Float32 *vec_real_decode(C_Float32 *p, const C_UInt32 *s, size_t n,
+		C_Float64 offset, C_Float64 scale, C_UInt32 missing)
+	{
+		return dec_u32(p, s, n, offset, scale, missing);
+	}
+
+
+	// encode real numbers
+
+	template<typename INT_TYPE, typename IN_TYPE>
+		static COREARRAY_INLINE INT_TYPE *enc_scalar(INT_TYPE *p,
+		const IN_TYPE *s, size_t n, C_Float64 offset, C_Float64 invscale,
+		C_Float64 lo, C_Float64 hi, INT_TYPE missing)
+	{
+		for (; n > 0; n--)
+		{
+			double v = round((*s++ - offset) * invscale);
+			*p++ = (IsFinite(v) && (lo <= v) && (v <= hi)) ?
+				(INT_TYPE)v : missing;
+		}
+		return p;
+	}
+
+	template<typename INT_TYPE, typename IN_TYPE>
+		static COREARRAY_INLINE INT_TYPE *enc_i16(INT_TYPE *p, const IN_TYPE *s,
+		size_t n, C_Float64 offset, C_Float64 invscale, C_Float64 lo,
+		C_Float64 hi, INT_TYPE missing)
+	{
+	#ifdef COREARRAY_SIMD_SSE2
+		const __m128d off2 = _mm_set1_pd(offset);
+		const __m128d isc2 = _mm_set1_pd(invscale);
+		const __m128d lo2 = _mm_set1_pd(lo), hi2 = _mm_set1_pd(hi);
+		const __m128i mv = _mm_set1_epi32(missing);
+		for (; n >= 8; n-=8, s+=8, p+=8)
+		{
+			__m128i v0 = sse2_enc_x4(s, off2, isc2, lo2, hi2, mv);
+			__m128i v1 = sse2_enc_x4(s+4, off2, isc2, lo2, hi2, mv);
+			_mm_storeu_si128((__m128i*)p, sse2_i32_to_i16(v0, v1));
+		}
+	#endif
+		return enc_scalar(p, s, n, offset, invscale, lo, hi, missing);
+	}
+
+	template<typename IN_TYPE>
+		static COREARRAY_INLINE C_Int32 *enc_i32(C_Int32 *p, const IN_TYPE *s,
+		size_t n, C_Float64 offset, C_Float64 invscale, C_Float64 lo,
+		C_Float64 hi, C_Int32 missing)
+	{
+	#ifdef COREARRAY_SIMD_SSE2
+		const __m128d off2 = _mm_set1_pd(offset);
+		const __m128d isc2 = _mm_set1_pd(invscale);
+		const __m128d lo2 = _mm_set1_pd(lo), hi2 = _mm_set1_pd(hi);
+		const __m128i mv = _mm_set1_epi32(missing);
+		for (; n >= 4; n-=4, s+=4, p+=4)
+		{
+			_mm_storeu_si128((__m128i*)p,
+				sse2_enc_x4(s, off2, isc2, lo2, hi2, mv));
+		}
+	#endif
+		return enc_scalar(p, s, n, offset, invscale, lo, hi, missing);
+	}
+
+	C_Int16 *vec_real_encode(C_Int16 *p, const C_Float64 *s, size_t n,
+		C_Float64 offset, C_Float64 invscale, C_Float64 lo, C_Float64 hi,
+		C_Int16 missing)
+	{
+		return enc_i16(p, s, n, offset, invscale, lo, hi, missing);
+	}
+
+	C_UInt16 *vec_real_encode(C_UInt16 *p, const C_Float64 *s, size_t n,
+		C_Float64 offset, C_Float64 invscale, C_Float64 lo, C_Float64 hi,
+		C_UInt16 missing)
+	{
+		return enc_i16(p, s, n, offset, invscale, lo, hi, missing);
+	}
+
+	C_Int32 *vec_real_encode(C_Int32 *p, const C_Float64 *s, size_t n,
+		C_Float64 offset, C_Float64 invscale, C_Float64 lo, C_Float64 hi,
+		C_Int32 missing)
+	{
+		return enc_i32(p, s, n, offset, invscale, lo, hi, missing);
+	}
+
+	C_Int16 *vec_real_encode(C_Int16 *p, const C_Float32 *s, size_t n,
+		C_Float64 offset, C_Float64 invscale, C_Float64 lo, C_Float64 hi,
+		C_Int16 missing)
+	{
+		return enc_i16(p, s, n, offset, invscale, lo, hi, missing);
+	}
+
+	C_UInt16 *vec_real_encode(C_UInt16 *p, const C_Float32 *s, size_t n,
+		C_Float64 offset, C_Float64 invscale, C_Float64 lo, C_Float64 hi,
+		C_UInt16 missing)
+	{
+		return enc_i16(p, s, n, offset, invscale, lo, hi, missing);
+	}
+
+	C_Int32 *vec_real_encode(C_Int32 *p, const C_Float32 *s, size_t n,
+		C_Float64 offset, C_Float64 invscale, C_Float64 lo, C_Float64 hi,
+		C_Int32 missing)
+	{
+		return enc_i32(p, s, n, offset, invscale, lo, hi, missing);
+	}
+
+
+	// 24-bit integers
+
+	C_Int32 *vec_i24_unpack(C_Int32 *p, const C_UInt8 *s, size_t n)
+	{
+	#ifdef COREARRAY_SIMD_SSSE3
+		// 16 bytes are loaded for 4 integers (12 bytes)
+		const __m128i shuf = _mm_setr_epi8(-1,0,1,2, -1,3,4,5, -1,6,7,8,
+			-1,9,10,11);
+		for (; n >= 6; n-=4, s+=12, p+=4)
+		{
+			__m128i v = _mm_loadu_si128((__m128i const*)s);
+			v = _mm_srai_epi32(_mm_shuffle_epi8(v, shuf), 8);
+			_mm_storeu_si128((__m128i*)p, v);
+		}
+	#endif
+		for (; n > 0; n--, s+=3)
+		{
+			C_Int32 v = s[0] | (C_Int32(s[1]) << 8) | (C_Int32(s[2]) << 16);
+			if (v & 0x800000) v |= 0xFF000000;
+			*p++ = v;
+		}
+		return p;
+	}
+
+	C_UInt32 *vec_u24_unpack(C_UInt32 *p, const C_UInt8 *s, size_t n)
+	{
+	#ifdef COREARRAY_SIMD_SSSE3
+		// 16 bytes are loaded for 4 integers (12 bytes)
+		const __m128i shuf = _mm_setr_epi8(0,1,2,-1, 3,4,5,-1, 6,7,8,-1,
+			9,10,11,-1);
+		for (; n >= 6; n-=4, s+=12, p+=4)
+		{
+			__m128i v = _mm_loadu_si128((__m128i const*)s);
+			_mm_storeu_si128((__m128i*)p, _mm_shuffle_epi8(v, shuf));
+		}
+	#endif
+		for (; n > 0; n--, s+=3)
+			*p++ = s[0] | (C_UInt32(s[1]) << 8) | (C_UInt32(s[2]) << 16);
+		return p;
+	}
+
+	C_UInt8 *vec_i24_pack(C_UInt8 *p, const C_Int32 *s, size_t n)
+	{
+		for (; n > 0; n--, p+=3)
+		{
+			C_Int32 v = *s++;
+			p[0] = C_UInt8(v);
+			p[1] = C_UInt8(v >> 8);
+			p[2] = C_UInt8(v >> 16);
+		}
+		return p;
+	}
+
+
+
+	// =====================================================================
+	// Class registration
+	// =====================================================================
+
 	template<typename TClass> static CdObjRef *OnObjCreate()
 	{
 		return new TClass();
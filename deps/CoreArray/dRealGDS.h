@@ -294,6 +294,7 @@ namespace CoreArray
 					(this->fScale == Src->fScale) &&
 					this->fAllocator.BufStream())
 				{
+					this->_TransChanged();
 					Src->Allocator().BufStream()->FlushWrite();
 					this->fAllocator.BufStream()->CopyFrom(
 						*(Src->Allocator().BufStream()->Stream()),
@@ -306,6 +307,7 @@ namespace CoreArray
 					{
 						R.DimLen = this->fTotalCount / R.DimElmCnt;
 						this->fNeedUpdate = true;
+						this->_SetDirty();
 					}
 
 					return;
@@ -325,6 +327,7 @@ namespace CoreArray
 				fOffset = val;
 				_ChangeLookup();
 				this->fChanged = true;
+				this->_SetDirty();
 			}
 		}
 
@@ -339,6 +342,7 @@ namespace CoreArray
 				fScale = val; fInvScale = 1.0 / fScale;
 				_ChangeLookup();
 				this->fChanged = true;
+				this->_SetDirty();
 			}
 		}
 
@@ -419,6 +423,111 @@ namespace CoreArray
 
 
 
+	// =====================================================================
+	// Vectorized conversion between packed integers and real numbers
+	// =====================================================================
+
+	/// decode packed integers to real numbers: p[i] = s[i]*scale + offset
+	/** 'missing' is decoded to NaN; the generic version is used for non-float
+	 *  output types, and the overloaded functions for C_Float32 and C_Float64
+	 *  use SIMD instructions if possible
+	**/
+	template<typename MEM_TYPE, typename INT_TYPE>
+		COREARRAY_INLINE MEM_TYPE *vec_real_decode(MEM_TYPE *p,
+		const INT_TYPE *s, size_t n, C_Float64 offset, C_Float64 scale,
+		INT_TYPE missing)
+	{
+		for (; n > 0; n--, s++)
+		{
+			*p++ = VAL_CONV_FROM_F64(MEM_TYPE,
+				(*s != missing) ? ((*s) * scale + offset) : NaN);
+		}
+		return p;
+	}
+
+	COREARRAY_DLL_DEFAULT C_Float64 *vec_real_decode(C_Float64 *p,
+		const C_Int16 *s, size_t n, C_Float64 offset, C_Float64 scale,
+		C_Int16 missing);
+	COREARRAY_DLL_DEFAULT C_Float64 *vec_real_decode(C_Float64 *p,
+		const C_UInt16 *s, size_t n, C_Float64 offset, C_Float64 scale,
+		C_UInt16 missing);
+	COREARRAY_DLL_DEFAULT C_Float64 *vec_real_decode(C_Float64 *p,
+		const C_Int32 *s, size_t n, C_Float64 offset, C_Float64 scale,
+		C_Int32 missing);
+	COREARRAY_DLL_DEFAULT C_Float64 *vec_real_decode(C_Float64 *p,
+		const C_UInt32 *s, size_t n, C_Float64 offset, C_Float64 scale,
+		C_UInt32 missing);
+
+	COREARRAY_DLL_DEFAULT C_Float32 *vec_real_decode(C_Float32 *p,
+		const C_Int16 *s, size_t n, C_Float64 offset, C_Float64 scale,
+		C_Int16 missing);
+	COREARRAY_DLL_DEFAULT C_Float32 *vec_real_decode(C_Float32 *p,
+		const C_UInt16 *s, size_t n, C_Float64 offset, C_Float64 scale,
+		C_UInt16 missing);
+	COREARRAY_DLL_DEFAULT C_Float32 *vec_real_decode(C_Float32 *p,
+		const C_Int32 *s, size_t n, C_Float64 offset, C_Float64 scale,
+		C_Int32 missing);
+	COREARRAY_DLL_DEFAULT C_Float32 *vec_real_decode(C_Float32 *p,
+		const C_UInt32 *s, size_t n, C_Float64 offset, C_Float64 scale,
+		C_UInt32 missing);
+
+
+	/// encode real numbers to packed integers: p[i] = round((s[i]-offset)*invscale)
+	/** the result is 'missing' if it is not finite or out of [lo, hi];
+	 *  the generic version is used for non-float input types, and the
+	 *  overloaded functions for C_Float32 and C_Float64 use SIMD instructions
+	 *  if possible
+	**/
+	template<typename INT_TYPE, typename MEM_TYPE>
+		COREARRAY_INLINE INT_TYPE *vec_real_encode(INT_TYPE *p,
+		const MEM_TYPE *s, size_t n, C_Float64 offset, C_Float64 invscale,
+		C_Float64 lo, C_Float64 hi, INT_TYPE missing)
+	{
+		for (; n > 0; n--)
+		{
+			double v = round((VAL_CONV_TO_F64(MEM_TYPE, *s++) - offset) * invscale);
+			*p++ = (IsFinite(v) && (lo <= v) && (v <= hi)) ?
+				(INT_TYPE)v : missing;
+		}
+		return p;
+	}
+
+	COREARRAY_DLL_DEFAULT C_Int16 *vec_real_encode(C_Int16 *p,
+		const C_Float64 *s, size_t n, C_Float64 offset, C_Float64 invscale,
+		C_Float64 lo, C_Float64 hi, C_Int16 missing);
+	COREARRAY_DLL_DEFAULT C_UInt16 *vec_real_encode(C_UInt16 *p,
+		const C_Float64 *s, size_t n, C_Float64 offset, C_Float64 invscale,
+		C_Float64 lo, C_Float64 hi, C_UInt16 missing);
+	COREARRAY_DLL_DEFAULT C_Int32 *vec_real_encode(C_Int32 *p,
+		const C_Float64 *s, size_t n, C_Float64 offset, C_Float64 invscale,
+		C_Float64 lo, C_Float64 hi, C_Int32 missing);
+
+	COREARRAY_DLL_DEFAULT C_Int16 *vec_real_encode(C_Int16 *p,
+		const C_Float32 *s, size_t n, C_Float64 offset, C_Float64 invscale,
+		C_Float64 lo, C_Float64 hi, C_Int16 missing);
+	COREARRAY_DLL_DEFAULT C_UInt16 *vec_real_encode(C_UInt16 *p,
+		const C_Float32 *s, size_t n, C_Float64 offset, C_Float64 invscale,
+		C_Float64 lo, C_Float64 hi, C_UInt16 missing);
+	COREARRAY_DLL_DEFAULT C_Int32 *vec_real_encode(C_Int32 *p,
+		const C_Float32 *s, size_t n, C_Float64 offset, C_Float64 invscale,
+		C_Float64 lo, C_Float64 hi, C_Int32 missing);
+
+
+	/// unpack little-endian signed 24-bit integers with sign extension
+	COREARRAY_DLL_DEFAULT C_Int32 *vec_i24_unpack(C_Int32 *p,
+		const C_UInt8 *s, size_t n);
+	/// unpack little-endian unsigned 24-bit integers
+	COREARRAY_DLL_DEFAULT C_UInt32 *vec_u24_unpack(C_UInt32 *p,
+		const C_UInt8 *s, size_t n);
+	/// pack 32-bit integers to little-endian 24-bit integers
+	COREARRAY_DLL_DEFAULT C_UInt8 *vec_i24_pack(C_UInt8 *p,
+		const C_Int32 *s, size_t n);
+
+	/// the missing value of TReal24 after sign extension
+	static const C_Int32 REAL24_MISSING_EXT = C_Int32(0xFF800000);
+
+
+
 	// =====================================================================
 	// Template for Allocator
 	// =====================================================================
@@ -705,11 +814,7 @@ namespace CoreArray
 				ssize_t Cnt = (n >= NBUF) ? NBUF : n;
 				ss.R(Buf, Cnt);
 				n -= Cnt;
-				for (C_Int16 *s=Buf; Cnt > 0; Cnt--, s++)
-				{
-					*p++ = VAL_CONV_FROM_F64(MEM_TYPE,
-						(*s != C_Int16(0x8000)) ? ((*s) * scale + offset) : NaN);
-				}
+				p = vec_real_decode(p, Buf, Cnt, offset, scale, C_Int16(0x8000));
 			}
 			return p;
 		}
@@ -732,14 +837,11 @@ namespace CoreArray
 				ssize_t Cnt = (n >= NBUF) ? NBUF : n;
 				ss.R(Buf, Cnt);
 				n -= Cnt;
+				// pack the selected elements, then decode them in a batch
+				C_Int16 *d = Buf;
 				for (C_Int16 *s=Buf; Cnt > 0; Cnt--, s++)
-				{
-					if (*sel++)
-					{
-						*p++ = VAL_CONV_FROM_F64(MEM_TYPE,
-							(*s != C_Int16(0x8000)) ? ((*s) * scale + offset) : NaN);
-					}
-				}
+					if (*sel++) *d++ = *s;
+				p = vec_real_decode(p, Buf, d - Buf, offset, scale, C_Int16(0x8000));
 			}
 			return p;
 		}
@@ -758,15 +860,8 @@ namespace CoreArray
 			while (n > 0)
 			{
 				ssize_t Cnt = (n >= NBUF) ? NBUF : n;
-				C_Int16 *s = Buf;
-				for (ssize_t m=Cnt; m > 0; m--)
-				{
-					double v = round((VAL_CONV_TO_F64(MEM_TYPE, *p++) - offset) * scale);
-					C_Int16 I = 0x8000;
-					if (IsFinite(v) && (-32767.5 < v) && (v <= 32767.5))
-						I = (C_Int16)v;
-					*s++ = I;
-				}
+				vec_real_encode(Buf, p, Cnt, offset, scale, -32767, 32767, C_Int16(0x8000));
+				p += Cnt;
 				COREARRAY_ENDIAN_NT_TO_LE_ARRAY(Buf, Cnt);
 				I.Allocator->WriteData(Buf, Cnt << 1);
 				n -= Cnt;
@@ -800,11 +895,7 @@ namespace CoreArray
 				ssize_t Cnt = (n >= NBUF) ? NBUF : n;
 				ss.R(Buf, Cnt);
 				n -= Cnt;
-				for (C_UInt16 *s=Buf; Cnt > 0; Cnt--, s++)
-				{
-					*p++ = VAL_CONV_FROM_F64(MEM_TYPE,
-						(*s != 0xFFFF) ? ((*s) * scale + offset) : NaN);
-				}
+				p = vec_real_decode(p, Buf, Cnt, offset, scale, C_UInt16(0xFFFF));
 			}
 			return p;
 		}
@@ -827,14 +918,11 @@ namespace CoreArray
 				ssize_t Cnt = (n >= NBUF) ? NBUF : n;
 				ss.R(Buf, Cnt);
 				n -= Cnt;
+				// pack the selected elements, then decode them in a batch
+				C_UInt16 *d = Buf;
 				for (C_UInt16 *s=Buf; Cnt > 0; Cnt--, s++)
-				{
-					if (*sel++)
-					{
-						*p++ = VAL_CONV_FROM_F64(MEM_TYPE,
-							(*s != 0xFFFF) ? ((*s) * scale + offset) : NaN);
-					}
-				}
+					if (*sel++) *d++ = *s;
+				p = vec_real_decode(p, Buf, d - Buf, offset, scale, C_UInt16(0xFFFF));
 			}
 			return p;
 		}
@@ -853,15 +941,8 @@ namespace CoreArray
 			while (n > 0)
 			{
 				ssize_t Cnt = (n >= NBUF) ? NBUF : n;
-				C_UInt16 *s = Buf;
-				for (ssize_t m=Cnt; m > 0; m--)
-				{
-					double v = round((VAL_CONV_TO_F64(MEM_TYPE, *p++) - offset) * scale);
-					C_UInt16 I = 0xFFFF;
-					if (IsFinite(v) && (-0.5 < v) && (v <= 65534.5))
-						I = (C_UInt16)v;
-					*s++ = I;
-				}
+				vec_real_encode(Buf, p, Cnt, offset, scale, 0, 65534, C_UInt16(0xFFFF));
+				p += Cnt;
 				COREARRAY_ENDIAN_NT_TO_LE_ARRAY(Buf, Cnt);
 				I.Allocator->WriteData(Buf, Cnt << 1);
 				n -= Cnt;
@@ -877,13 +958,14 @@ namespace CoreArray
 	template<typename MEM_TYPE>
 		struct COREARRAY_DLL_DEFAULT ALLOC_FUNC<TReal24, MEM_TYPE>
 	{
-		static const ssize_t NBUF = COREARRAY_ALLOC_FUNC_BUFFER / 3;
+		static const ssize_t NBUF = COREARRAY_ALLOC_FUNC_BUFFER / 7;
 
 		/// read an array from CdAllocator
 		static MEM_TYPE *Read(CdIterator &I, MEM_TYPE *p, ssize_t n)
 		{
 			if (n <= 0) return p;
 			C_UInt8 Buf[NBUF][3];
+			C_Int32 IBuf[NBUF];
 			CdPackedReal24 *IT = static_cast<CdPackedReal24*>(I.Handler);
 			const C_Float64 offset = IT->Offset();
 			const C_Float64 scale = IT->Scale();
@@ -894,16 +976,8 @@ namespace CoreArray
 				ssize_t Cnt = (n >= NBUF) ? NBUF : n;
 				I.Allocator->ReadData(Buf, Cnt*3);
 				n -= Cnt;
-				for (C_UInt8 *s=Buf[0]; Cnt > 0; Cnt--, s+=3)
-				{
-					C_Int32 val = s[0] | (C_Int32(s[1]) << 8) | (C_Int32(s[2]) << 16);
-					if (val != 0x800000)
-					{
-						if (val & 0x800000) val |= 0xFF000000;
-						*p++ = VAL_CONV_FROM_F64(MEM_TYPE, val * scale + offset);
-					} else
-						*p++ = NaN;
-				}
+				vec_i24_unpack(IBuf, Buf[0], Cnt);
+				p = vec_real_decode(p, IBuf, Cnt, offset, scale, REAL24_MISSING_EXT);
 			}
 			return p;
 		}
@@ -915,6 +989,7 @@ namespace CoreArray
 			if (n <= 0) return p;
 			for (; n>0 && !*sel; n--, sel++) I.Ptr += 3;
 			C_UInt8 Buf[NBUF][3];
+			C_Int32 IBuf[NBUF];
 			CdPackedReal24 *IT = static_cast<CdPackedReal24*>(I.Handler);
 			const C_Float64 offset = IT->Offset();
 			const C_Float64 scale = IT->Scale();
@@ -925,19 +1000,12 @@ namespace CoreArray
 				ssize_t Cnt = (n >= NBUF) ? NBUF : n;
 				I.Allocator->ReadData(Buf, Cnt*3);
 				n -= Cnt;
-				for (C_UInt8 *s=Buf[0]; Cnt > 0; Cnt--, s+=3)
-				{
-					if (*sel++)
-					{
-						C_Int32 val = s[0] | (C_Int32(s[1]) << 8) | (C_Int32(s[2]) << 16);
-						if (val != 0x800000)
-						{
-							if (val & 0x800000) val |= 0xFF000000;
-							*p++ = VAL_CONV_FROM_F64(MEM_TYPE, val * scale + offset);
-						} else
-							*p++ = NaN;
-					}
-				}
+				vec_i24_unpack(IBuf, Buf[0], Cnt);
+				// pack the selected elements, then decode them in a batch
+				C_Int32 *d = IBuf;
+				for (C_Int32 *s=IBuf; Cnt > 0; Cnt--, s++)
+					if (*sel++) *d++ = *s;
+				p = vec_real_decode(p, IBuf, d - IBuf, offset, scale, REAL24_MISSING_EXT);
 			}
 			return p;
 		}
@@ -948,6 +1016,7 @@ namespace CoreArray
 		{
 			if (n <= 0) return p;
 			C_UInt8 Buf[NBUF][3];
+			C_Int32 IBuf[NBUF];
 			CdPackedReal24 *IT = static_cast<CdPackedReal24*>(I.Handler);
 			const C_Float64 offset = IT->Offset();
 			const C_Float64 scale = IT->InvScale();
@@ -956,18 +1025,9 @@ namespace CoreArray
 			while (n > 0)
 			{
 				ssize_t Cnt = (n >= NBUF) ? NBUF : n;
-				C_UInt8 *s = Buf[0];
-				for (ssize_t m=Cnt; m > 0; m--)
-				{
-					double v = round((VAL_CONV_TO_F64(MEM_TYPE, *p++) - offset) * scale);
-					C_Int32 I = 0x800000;
-					if (IsFinite(v) && (-8388607.5 < v) && (v <= 8388607.5))
-						I = (C_Int32)v;
-					s[0] = C_UInt8(I);
-					s[1] = C_UInt8(I >> 8);
-					s[2] = C_UInt8(I >> 16);
-					s += 3;
-				}
+				vec_real_encode(IBuf, p, Cnt, offset, scale, -8388607, 8388607, C_Int32(0x800000));
+				p += Cnt;
+				vec_i24_pack(Buf[0], IBuf, Cnt);
 				I.Allocator->WriteData(Buf, Cnt*3);
 				n -= Cnt;
 			}
@@ -982,13 +1042,14 @@ namespace CoreArray
 	template<typename MEM_TYPE>
 		struct COREARRAY_DLL_DEFAULT ALLOC_FUNC<TReal24u, MEM_TYPE>
 	{
-		static const ssize_t NBUF = COREARRAY_ALLOC_FUNC_BUFFER / 3;
+		static const ssize_t NBUF = COREARRAY_ALLOC_FUNC_BUFFER / 7;
 
 		/// read an array from CdAllocator
 		static MEM_TYPE *Read(CdIterator &I, MEM_TYPE *p, ssize_t n)
 		{
 			if (n <= 0) return p;
 			C_UInt8 Buf[NBUF][3];
+			C_UInt32 IBuf[NBUF];
 			CdPackedReal24U *IT = static_cast<CdPackedReal24U*>(I.Handler);
 			const C_Float64 offset = IT->Offset();
 			const C_Float64 scale = IT->Scale();
@@ -999,14 +1060,8 @@ namespace CoreArray
 				ssize_t Cnt = (n >= NBUF) ? NBUF : n;
 				I.Allocator->ReadData(Buf, Cnt*3);
 				n -= Cnt;
-				for (C_UInt8 *s=Buf[0]; Cnt > 0; Cnt--, s+=3)
-				{
-					C_UInt32 val = s[0] | (C_UInt32(s[1]) << 8) | (C_UInt32(s[2]) << 16);
-					if (val != 0xFFFFFF)
-						*p++ = VAL_CONV_FROM_F64(MEM_TYPE, val*scale + offset);
-					else
-						*p++ = NaN;
-				}
+				vec_u24_unpack(IBuf, Buf[0], Cnt);
+				p = vec_real_decode(p, IBuf, Cnt, offset, scale, C_UInt32(0xFFFFFF));
 			}
 			return p;
 		}
@@ -1018,6 +1073,7 @@ namespace CoreArray
 			if (n <= 0) return p;
 			for (; n>0 && !*sel; n--, sel++) I.Ptr += 3;
 			C_UInt8 Buf[NBUF][3];
+			C_UInt32 IBuf[NBUF];
 			CdPackedReal24U *IT = static_cast<CdPackedReal24U*>(I.Handler);
 			const C_Float64 offset = IT->Offset();
 			const C_Float64 scale = IT->Scale();
@@ -1028,17 +1084,12 @@ namespace CoreArray
 				ssize_t Cnt = (n >= NBUF) ? NBUF : n;
 				I.Allocator->ReadData(Buf, Cnt*3);
 				n -= Cnt;
-				for (C_UInt8 *s=Buf[0]; Cnt > 0; Cnt--, s+=3)
-				{
-					if (*sel++)
-					{
-						C_UInt32 val = s[0] | (C_UInt32(s[1]) << 8) | (C_UInt32(s[2]) << 16);
-						if (val != 0xFFFFFF)
-							*p++ = VAL_CONV_FROM_F64(MEM_TYPE, val*scale + offset);
-						else
-							*p++ = NaN;
-					}
-				}
+				vec_u24_unpack(IBuf, Buf[0], Cnt);
+				// pack the selected elements, then decode them in a batch
+				C_UInt32 *d = IBuf;
+				for (C_UInt32 *s=IBuf; Cnt > 0; Cnt--, s++)
+					if (*sel++) *d++ = *s;
+				p = vec_real_decode(p, IBuf, d - IBuf, offset, scale, C_UInt32(0xFFFFFF));
 			}
 			return p;
 		}
@@ -1049,6 +1100,7 @@ namespace CoreArray
 		{
 			if (n <= 0) return p;
 			C_UInt8 Buf[NBUF][3];
+			C_Int32 IBuf[NBUF];
 			CdPackedReal24U *IT = static_cast<CdPackedReal24U*>(I.Handler);
 			const C_Float64 offset = IT->Offset();
 			const C_Float64 scale = IT->InvScale();
@@ -1057,18 +1109,9 @@ namespace CoreArray
 			while (n > 0)
 			{
 				ssize_t Cnt = (n >= NBUF) ? NBUF : n;
-				C_UInt8 *s = Buf[0];
-				for (ssize_t m=Cnt; m > 0; m--)
-				{
-					double v = round((VAL_CONV_TO_F64(MEM_TYPE, *p++) - offset) * scale);
-					C_UInt32 I = 0xFFFFFF;
-					if (IsFinite(v) && (-0.5 < v) && (v <= 16777214.5))
-						I = (C_UInt32)v;
-					s[0] = C_UInt8(I);
-					s[1] = C_UInt8(I >> 8);
-					s[2] = C_UInt8(I >> 16);
-					s += 3;
-				}
+				vec_real_encode(IBuf, p, Cnt, offset, scale, 0, 16777214, C_Int32(0xFFFFFF));
+				p += Cnt;
+				vec_i24_pack(Buf[0], IBuf, Cnt);
 				I.Allocator->WriteData(Buf, Cnt*3);
 				n -= Cnt;
 			}
@@ -1101,11 +1144,7 @@ namespace CoreArray
 				ssize_t Cnt = (n >= NBUF) ? NBUF : n;
 				ss.R(Buf, Cnt);
 				n -= Cnt;
-				for (C_Int32 *s=Buf; Cnt > 0; Cnt--, s++)
-				{
-					*p++ = VAL_CONV_FROM_F64(MEM_TYPE,
-						(*s != C_Int32(0x80000000)) ? ((*s) * scale + offset) : NaN);
-				}
+				p = vec_real_decode(p, Buf, Cnt, offset, scale, C_Int32(0x80000000));
 			}
 			return p;
 		}
@@ -1128,14 +1167,11 @@ namespace CoreArray
 				ssize_t Cnt = (n >= NBUF) ? NBUF : n;
 				ss.R(Buf, Cnt);
 				n -= Cnt;
+				// pack the selected elements, then decode them in a batch
+				C_Int32 *d = Buf;
 				for (C_Int32 *s=Buf; Cnt > 0; Cnt--, s++)
-				{
-					if (*sel++)
-					{
-						*p++ = VAL_CONV_FROM_F64(MEM_TYPE,
-							(*s != C_Int32(0x80000000)) ? ((*s) * scale + offset) : NaN);
-					}
-				}
+					if (*sel++) *d++ = *s;
+				p = vec_real_decode(p, Buf, d - Buf, offset, scale, C_Int32(0x80000000));
 			}
 			return p;
 		}
@@ -1154,15 +1190,8 @@ namespace CoreArray
 			while (n > 0)
 			{
 				ssize_t Cnt = (n >= NBUF) ? NBUF : n;
-				C_Int32 *s = Buf;
-				for (ssize_t m=Cnt; m > 0; m--)
-				{
-					double v = round((VAL_CONV_TO_F64(MEM_TYPE, *p++) - offset) * scale);
-					C_Int32 I = 0x80000000;
-					if (IsFinite(v) && (-2147483647.5 < v) && (v <= 2147483647.5))
-						I = (C_Int32)v;
-					*s++ = I;
-				}
+				vec_real_encode(Buf, p, Cnt, offset, scale, -2147483647, 2147483647, C_Int32(0x80000000));
+				p += Cnt;
 				COREARRAY_ENDIAN_NT_TO_LE_ARRAY(Buf, Cnt);
 				I.Allocator->WriteData(Buf, Cnt << 2);
 				n -= Cnt;
@@ -1196,11 +1225,7 @@ namespace CoreArray
 				ssize_t Cnt = (n >= NBUF) ? NBUF : n;
 				ss.R(Buf, Cnt);
 				n -= Cnt;
-				for (C_UInt32 *s=Buf; Cnt > 0; Cnt--, s++)
-				{
-					*p++ = VAL_CONV_FROM_F64(MEM_TYPE,
-						(*s != 0xFFFFFFFF) ? ((*s) * scale + offset) : NaN);
-				}
+				p = vec_real_decode(p, Buf, Cnt, offset, scale, C_UInt32(0xFFFFFFFF));
 			}
 			return p;
 		}
@@ -1223,14 +1248,11 @@ namespace CoreArray
 				ssize_t Cnt = (n >= NBUF) ? NBUF : n;
 				ss.R(Buf, Cnt);
 				n -= Cnt;
+				// pack the selected elements, then decode them in a batch
+				C_UInt32 *d = Buf;
 				for (C_UInt32 *s=Buf; Cnt > 0; Cnt--, s++)
-				{
-					if (*sel++)
-					{
-						*p++ = VAL_CONV_FROM_F64(MEM_TYPE,
-							(*s != 0xFFFFFFFF) ? ((*s) * scale + offset) : NaN);
-					}
-				}
+					if (*sel++) *d++ = *s;
+				p = vec_real_decode(p, Buf, d - Buf, offset, scale, C_UInt32(0xFFFFFFFF));
 			}
 			return p;
 		}
@@ -1249,15 +1271,8 @@ namespace CoreArray
 			while (n > 0)
 			{
 				ssize_t Cnt = (n >= NBUF) ? NBUF : n;
-				C_UInt32 *s = Buf;
-				for (ssize_t m=Cnt; m > 0; m--)
-				{
-					double v = round((VAL_CONV_TO_F64(MEM_TYPE, *p++) - offset) * scale);
-					C_UInt32 I = 0xFFFFFFFF;
-					if (IsFinite(v) && (-0.5 < v) && (v <= 4294967294.5))
-						I = (C_UInt32)v;
-					*s++ = I;
-				}
+				vec_real_encode(Buf, p, Cnt, offset, scale, 0, 4294967294.0, C_UInt32(0xFFFFFFFF));
+				p += Cnt;
 				COREARRAY_ENDIAN_NT_TO_LE_ARRAY(Buf, Cnt);
 				I.Allocator->WriteData(Buf, Cnt << 2);
 				n -= Cnt;
@@ -26,6 +26,7 @@
 // If not, see <http://www.gnu.org/licenses/>.
 
 #include "dSerial.h"
+#include <algorithm>
 
 
 namespace CoreArray
@@ -127,7 +128,8 @@ CdSerialization::CdSerialization(CdBufStream *vBufStream, CdLogRecord *vLog,
 	if (vLog == NULL) vLog = new CdLogRecord;
 	(fLog = vLog)->AddRef();
 
-	fStructListHead = NULL;
+	fStructListHead = fFreeStruct = NULL;
+	memset(fFreeVar, 0, sizeof(fFreeVar));
 }
 
 CdSerialization::CdSerialization(CdStream *vStream, CdLogRecord *vLog,
@@ -148,7 +150,8 @@ CdSerialization::CdSerialization(CdStream *vStream, CdLogRecord *vLog,
 	if (vLog == NULL) vLog = new CdLogRecord;
 	(fLog = vLog)->AddRef();
 
-	fStructListHead = NULL;
+	fStructListHead = fFreeStruct = NULL;
+	memset(fFreeVar, 0, sizeof(fFreeVar));
 }
 
 CdSerialization::~CdSerialization()
@@ -167,6 +170,25 @@ CdSerialization::~CdSerialization()
 		delete tmp;
 	}
 	fStructListHead = NULL;
+	// clear the recycled objects
+	for (p = fFreeStruct; p != NULL; )
+	{
+		CVarList *tmp = p;
+		p = p->Next;
+		delete tmp;
+	}
+	fFreeStruct = NULL;
+	for (int i=0; i < NUM_TYPE_ID; i++)
+	{
+		TVariable *v = fFreeVar[i];
+		while (v != NULL)
+		{
+			TVariable *tmp = v;
+			v = v->Next;
+			delete tmp;
+		}
+		fFreeVar[i] = NULL;
+	}
 }
 
 void CdSerialization::SetLog(CdLogRecord &vLog)
@@ -220,7 +242,14 @@ void CdSerialization::PropInfo(const char *Name, TdSerialTypeID &TypeID,
 
 CdSerialization::CVarList &CdSerialization::PushStruct()
 {
-	CVarList *p = new CVarList;
+	CVarList *p = fFreeStruct;
+	if (p)
+	{
+		fFreeStruct = p->Next;
+		p->Start = p->Length = 0;
+		p->VarCount = 0;
+	} else
+		p = new CVarList;
 	p->Next = fStructListHead;
 	fStructListHead = p;
 	return *p;
@@ -232,7 +261,9 @@ void CdSerialization::PopStruct()
 	if (p != NULL)
 	{
 		fStructListHead = fStructListHead->Next;
-		delete p;
+		p->ClearVarList(fFreeVar);
+		p->Next = fFreeStruct;
+		fFreeStruct = p;
 	} else
 		throw ErrSerial(ERR_NO_STRUCTURE);
 }
@@ -249,6 +280,7 @@ CdSerialization::TVariable::TVariable()
 	TypeID = osUnknown;
 	Start = Length = 0;
 	Next = NULL;
+	Hash = 0;
 }
 
 CdSerialization::TVariable::~TVariable()
@@ -260,6 +292,7 @@ CdSerialization::CVarList::CVarList()
 	Start = Length = 0;
 	VarCount = 0;
 	Next = NULL;
+	fNumHash = 0;
 }
 
 CdSerialization::CVarList::~CVarList()
@@ -267,29 +300,84 @@ CdSerialization::CVarList::~CVarList()
 	ClearVarList();
 }
 
+/// FNV-1a hash of a property name
+static C_UInt32 PropNameHash(const char *s)
+{
+	C_UInt32 h = 2166136261U;
+	for (; *s; s++)
+	{
+		h ^= (C_UInt8)(*s);
+		h *= 16777619U;
+	}
+	return h;
+}
+
 CdSerialization::TVariable* CdSerialization::CVarList::Name2Variable(
 	const char *Name)
 {
-	TVariable *p = VarHead;
-	while (p != NULL)
+	if (fNumHash <= 0) return NULL;
+	const C_UInt32 h = PropNameHash(Name);
+	const size_t mask = fHash.size() - 1;
+	for (size_t k = h & mask; ; k = (k + 1) & mask)
 	{
-		if (p->Name.compare(Name) == 0)
+		TVariable *p = fHash[k];
+		if (p == NULL) return NULL;
+		if ((p->Hash == h) && (p->Name.compare(Name) == 0))
 			return p;
-		p = p->Next;
 	}
-	return NULL;
 }
 
-void CdSerialization::CVarList::ClearVarList()
+void CdSerialization::CVarList::AddVar(TVariable *p)
+{
+	p->Next = NULL;
+	p->Hash = PropNameHash(p->Name.c_str());
+	if (VarTail == NULL)
+		VarHead = VarTail = p;
+	else {
+		VarTail->Next = p;
+		VarTail = p;
+	}
+
+	// the hash table is at most half full
+	if (2*(fNumHash + 1) > fHash.size())
+	{
+		fHash.assign(fHash.empty() ? 16 : 2*fHash.size(), NULL);
+		fNumHash = 0;
+		for (TVariable *v = VarHead; v != p; v = v->Next)
+		{
+			size_t k = v->Hash & (fHash.size() - 1);
+			while (fHash[k]) k = (k + 1) & (fHash.size() - 1);
+			fHash[k] = v;
+			fNumHash ++;
+		}
+	}
+	// linear probing keeps the first one of duplicated names
+	size_t k = p->Hash & (fHash.size() - 1);
+	while (fHash[k]) k = (k + 1) & (fHash.size() - 1);
+	fHash[k] = p;
+	fNumHash ++;
+}
+
+void CdSerialization::CVarList::ClearVarList(TVariable **FreeVar)
 {
 	TVariable *p = VarHead;
 	while (p != NULL)
 	{
 		TVariable *tmp = p;
 		p = p->Next;
-		delete tmp;
+		if (FreeVar && (tmp->TypeID >= 0) && (tmp->TypeID < NUM_TYPE_ID))
+		{
+			tmp->Next = FreeVar[tmp->TypeID];
+			FreeVar[tmp->TypeID] = tmp;
+		} else
+			delete tmp;
 	}
 	VarHead = VarTail = NULL;
+	if (fNumHash > 0)
+	{
+		fill(fHash.begin(), fHash.end(), (TVariable*)NULL);
+		fNumHash = 0;
+	}
 }
 
 
@@ -367,19 +455,13 @@ CdWriter::TVariable* CdWriter::NewVar(const char *Name,
 	fStorage << C_UInt8(TypeID);
 	WritePropName(Name);
 
-	TVariable *p = new TVariable;
+	TVariable *p = _RecycledVar(TypeID);
+	if (!p) p = new TVariable;
 	p->Name = Name;
 	p->TypeID = TypeID;
 	p->Start = fStorage.Position();
 	p->Length = Size;
-
-	if (Cur.VarTail == NULL)
-	{
-		Cur.VarHead = Cur.VarTail = p;
-	} else {
-		Cur.VarTail->Next = p;
-		Cur.VarTail = p;
-	}
+	Cur.AddVar(p);
 	Cur.VarCount ++;
 
 	return p;
@@ -701,6 +783,16 @@ SIZE64 CdReader::BeginNameSpace()
 	return rv;
 }
 
+SIZE64 CdReader::BeginClassNameSpace(TdVersion &Version, string &ClassName)
+{
+	SIZE64 rv = _BeginNameSpace();
+	Version = fStorage.R8b();
+	Version |= ((TdVersion)fStorage.R8b()) << 8;
+	ClassName = ReadClassName();
+	_InitNameSpace();
+	return rv;
+}
+
 void CdReader::EndStruct()
 {
 	CVarList &p = CurrentStruct();
@@ -735,7 +827,7 @@ void CdReader::_InitNameSpace()
 	// get the current block structure
 	CVarList &Cur = CurrentStruct();
 	// clear the current variable list
-	Cur.ClearVarList();
+	Cur.ClearVarList(fFreeVar);
 
 	// for-loop: variables
 	for (int i=1; i <= Cur.VarCount; i++)
@@ -870,35 +962,9 @@ CdSerialization::TVariable* CdReader::FindVar(const char *Name)
 		throw ErrSerial(ERR_NO_NAMESPACE);
 
 	// find it
-	TVariable *p=Cur.VarHead, *pH=NULL;
-	while (p != NULL)
-	{
-		if (p->Name.compare(Name) == 0)
-			break;
-		pH = p;
-		p = p->Next;
-	}
+	TVariable *p = Cur.Name2Variable(Name);
 	if (p == NULL)
 		throw ErrSerial(ERR_NO_PROPERTY, Name);
-
-	if (p->Next != NULL)
-	{
-		// not the last one, move to the last one
-		if (pH != NULL)
-		{
-			pH->Next = p->Next;
-			Cur.VarTail->Next = p;
-			p->Next = NULL;
-			Cur.VarTail = p;
-		} else {
-			// VarHead == VarTail, it is not possible
-			Cur.VarHead = p->Next;
-			Cur.VarTail->Next = p;
-			p->Next = NULL;
-			Cur.VarTail = p;
-		}
-	}
-
 	return p;
 }
 
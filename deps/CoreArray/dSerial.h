@@ -194,11 +194,15 @@ namespace CoreArray
 			SIZE64 Start;           ///< the starting position
 			SIZE64 Length;          ///< the stream length
 			TVariable *Next;        ///< next object in a list
+			C_UInt32 Hash;          ///< the hash code of Name
 
 			TVariable();
 			virtual ~TVariable();
 		};
 
+		/// the number of type IDs
+		static const int NUM_TYPE_ID = osGDSPos + 1;
+
 		/// the collection of variables in a block
 		class CVarList
 		{
@@ -215,17 +219,36 @@ namespace CoreArray
 
 			/// return a pointer to TVariable with Name, NULL if not exist
 			TVariable* Name2Variable(const char *Name);
-			/// remove variables in VarHead
-			void ClearVarList();
+			/// append a variable to the list (the first one wins if duplicated)
+			void AddVar(TVariable *p);
+			/// remove variables in VarHead, recycled in FreeVar if not NULL
+			void ClearVarList(TVariable **FreeVar=NULL);
+
+		private:
+			/// open-addressing hash table of variables
+			std::vector<TVariable*> fHash;
+			/// the number of variables in fHash
+			size_t fNumHash;
 		};
 
 		/// a list of block collection
 		CVarList *fStructListHead;
+		/// recycled CVarList objects
+		CVarList *fFreeStruct;
+		/// recycled variables for each type id
+		TVariable *fFreeVar[NUM_TYPE_ID];
 
 		/// create a new CVarList in fStructListHead
 		CVarList &PushStruct();
 		/// delete the top CVarList in fStructListHead
 		void PopStruct();
+		/// get a recycled variable of TypeID, or NULL if none
+		COREARRAY_INLINE TVariable *_RecycledVar(TdSerialTypeID TypeID)
+		{
+			TVariable *p = fFreeVar[TypeID];
+			if (p) { fFreeVar[TypeID] = p->Next; p->Next = NULL; }
+			return p;
+		}
 		/// get the current variable structure (throw exception if fStructListHead==NULL)
 		CVarList &CurrentStruct();
 	};
@@ -375,6 +398,8 @@ namespace CoreArray
 		SIZE64 BeginStruct();
 		/// begin a namespace
 		SIZE64 BeginNameSpace();
+		/// begin a namespace saved with a version number and a class name
+		SIZE64 BeginClassNameSpace(TdVersion &Version, std::string &ClassName);
 		/// end a block or namespace
 		void EndStruct();
 
@@ -407,19 +432,14 @@ namespace CoreArray
 			CVarList &Cur = CurrentStruct();
 			// no "Cur.VarCount ++" since 'Cur.VarCount' is fixed
 
-			TVar<TYPE> *p = new TVar<TYPE>;
+			// a type id is always associated with the same TYPE
+			TVar<TYPE> *p = static_cast<TVar<TYPE>*>(_RecycledVar(TypeID));
+			if (!p) p = new TVar<TYPE>;
 			p->Name = Name;
 			p->TypeID = TypeID;
 			p->Start = fStorage.Position();
 			p->Length = 0;
-
-			if (Cur.VarTail == NULL)
-			{
-				Cur.VarHead = Cur.VarTail = p;
-			} else {
-				Cur.VarTail->Next = p;
-				Cur.VarTail = p;
-			}
+			Cur.AddVar(p);
 
 			return p->Data;
 		}
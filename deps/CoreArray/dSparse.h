@@ -735,6 +735,7 @@ namespace CoreArray
 			} else if (I.Ptr == IT->fTotalCount)
 			{
 				// append
+				IT->_SetDirty();
 				I.Allocator->SetPosition(IT->fTotalStreamSize);
 				BYTE_LE<CdAllocator> SS(I.Allocator);
 				// for-loop
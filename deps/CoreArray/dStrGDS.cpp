@@ -60,6 +60,11 @@ namespace CoreArray
 		REG_CLASS(VARIABLE_LEN<C_UTF16>, CdStr16, ctArray, "variable-length UTF-16 string");
 		REG_CLASS(VARIABLE_LEN<C_UTF32>, CdStr32, ctArray, "variable-length UTF-32 string");
 
+		// dictionary-encoded strings
+		REG_CLASS(DICT_STRING<C_UTF8>,  CdDStr8,  ctArray, "dictionary-encoded UTF-8 string");
+		REG_CLASS(DICT_STRING<C_UTF16>, CdDStr16, ctArray, "dictionary-encoded UTF-16 string");
+		REG_CLASS(DICT_STRING<C_UTF32>, CdDStr32, ctArray, "dictionary-encoded UTF-32 string");
+
 		#undef REG_CLASS
 	}
 }
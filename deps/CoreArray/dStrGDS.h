@@ -38,6 +38,7 @@
 #define _HEADER_COREARRAY_STRING_GDS_
 
 #include "dStruct.h"
+#include <map>
 
 
 namespace CoreArray
@@ -134,6 +135,39 @@ namespace CoreArray
 				throw ErrArray("CdFixedStr::SetMaxLength, invalid parameter.");
 		}
 
+		/// read the raw bytes of fixed-length strings without conversion
+		/** ElmSize() bytes are copied for each element, characters are
+		 *  little-endian and padded with zero.
+		 *  \param Start       the starting positions (from ZERO), it could be NULL
+		 *  \param Length      the lengths of each dimension, it could be NULL
+		 *  \param Selection   the array of selection, it could be NULL
+		 *  \param OutBuffer   the pointer to the output buffer
+		**/
+		C_UInt8 *ReadRaw(const C_Int32 *Start, const C_Int32 *Length,
+			const C_BOOL *const Selection[], C_UInt8 *OutBuffer)
+		{
+			CdAbstractArray::TArrayDim DStart, DLength;
+			if (!Start)
+			{
+				memset(DStart, 0, sizeof(C_Int32)*this->fDimension.size());
+				Start = DStart;
+			}
+			if (!Length)
+			{
+				this->GetDim(DLength);
+				Length = DLength;
+			}
+			this->_CheckRect(Start, Length);
+			if (Selection)
+			{
+				return ArrayRIterRectEx(Start, Length, Selection,
+					this->fDimension.size(), *this, OutBuffer, IIndex, RawReadEx);
+			} else {
+				return ArrayRIterRect(Start, Length, this->fDimension.size(),
+					*this, OutBuffer, IIndex, RawRead);
+			}
+		}
+
 	protected:
 
 		/// loading function for serialization
@@ -167,6 +201,40 @@ namespace CoreArray
 
 	private:
 		SIZE64 vElmSize_Ptr;
+
+		COREARRAY_FORCEINLINE static void IIndex(CdFixedStr<TYPE> &Obj,
+			CdIterator &I, const C_Int32 DimI[])
+		{
+			I.Ptr = Obj._IndexPtr(DimI);
+		}
+
+		/// read n elements in bulk
+		static C_UInt8 *RawRead(CdIterator &I, C_UInt8 *p, ssize_t n)
+		{
+			if (n <= 0) return p;
+			const ssize_t size = n *
+				static_cast<CdAllocArray*>(I.Handler)->ElmSize();
+			I.Allocator->SetPosition(I.Ptr);
+			I.Allocator->ReadData(p, size);
+			I.Ptr += size;
+			return p + size;
+		}
+
+		/// read the selected elements, each run of selection in bulk
+		static C_UInt8 *RawReadEx(CdIterator &I, C_UInt8 *p, ssize_t n,
+			const C_BOOL sel[])
+		{
+			const ssize_t ElmSize =
+				static_cast<CdAllocArray*>(I.Handler)->ElmSize();
+			while (n > 0)
+			{
+				for (; n>0 && !*sel; n--, sel++) I.Ptr += ElmSize;
+				ssize_t m = 0;
+				for (; n>0 && *sel; n--, sel++) m++;
+				p = RawRead(I, p, m);
+			}
+			return p;
+		}
 	};
 
 
@@ -971,6 +1039,380 @@ namespace CoreArray
 	typedef CdString<C_UTF16>    CdStr16;
 	/// Variable-length of UTF-32 string
 	typedef CdString<C_UTF32>    CdStr32;
+
+
+
+	// =======================================================================
+	// Dictionary-encoded string
+	// =======================================================================
+
+	/// Dictionary-encoded string
+	/** \tparam TYPE  data type, e.g C_UTF8, C_UTF16 and C_UTF32
+	**/
+	template<typename TYPE> struct COREARRAY_DLL_DEFAULT DICT_STRING
+	{
+		typedef TYPE TType;
+		C_UInt32 Code;
+	};
+
+	template<> struct COREARRAY_DLL_DEFAULT TdTraits< DICT_STRING<C_UTF8> >
+	{
+		typedef UTF8String TType;
+		typedef C_UTF8 ElmType;
+		typedef char RawType;
+		static const int trVal = COREARRAY_TR_DICT_STRING;
+		static const unsigned BitOf = 32u;
+		static const bool IsPrimitive = false;
+		static const C_SVType SVType = svStrUTF8;
+
+		static const char *StreamName() { return "dDStr8"; }
+		static const char *TraitName() { return StreamName()+1; }
+	};
+
+	template<> struct COREARRAY_DLL_DEFAULT TdTraits< DICT_STRING<C_UTF16> >
+	{
+		typedef UTF16String TType;
+		typedef C_UTF16 ElmType;
+		typedef C_UTF16 RawType;
+		static const int trVal = COREARRAY_TR_DICT_STRING;
+		static const unsigned BitOf = 32u;
+		static const bool IsPrimitive = false;
+		static const C_SVType SVType = svStrUTF16;
+
+		static const char *StreamName() { return "dDStr16"; }
+		static const char *TraitName() { return StreamName()+1; }
+	};
+
+	template<> struct COREARRAY_DLL_DEFAULT TdTraits< DICT_STRING<C_UTF32> >
+	{
+		typedef UTF32String TType;
+		typedef C_UTF32 ElmType;
+		typedef C_UTF32 RawType;
+		static const int trVal = COREARRAY_TR_DICT_STRING;
+		static const unsigned BitOf = 32u;
+		static const bool IsPrimitive = false;
+		static const C_SVType SVType = svCustomStr;
+
+		static const char *StreamName() { return "dDStr32"; }
+		static const char *TraitName() { return StreamName()+1; }
+	};
+
+
+	/// Dictionary-encoded string container
+	/** Each element is stored as a 32-bit little-endian code in the data
+	 *  stream, and the distinct strings are kept in a separate block stream
+	 *  (the property "DICT") in order of first appearance, each of them
+	 *  prefixed by its length in 7-bit variable-length encoding. Code 0
+	 *  stands for an empty string which is never added to the dictionary,
+	 *  and code i (i >= 1) refers to the i-th dictionary entry, so zero-filled
+	 *  elements are valid empty strings.
+	 *  \tparam T  should be DICT_STRING<C_UTF8>,
+	 *             DICT_STRING<C_UTF16> or DICT_STRING<C_UTF32>
+	 *  \sa  CdDStr8, CdDStr16, CdDStr32
+	**/
+	template<typename TYPE> class COREARRAY_DLL_DEFAULT CdDictStr:
+		public CdArray< DICT_STRING<TYPE> >
+	{
+	public:
+		template<typename ALLOC_TYPE, typename MEM_TYPE> friend struct ALLOC_FUNC;
+
+		typedef typename TdTraits< DICT_STRING<TYPE> >::TType TType;
+		typedef TYPE ElmType;
+		typedef typename TdTraits< DICT_STRING<TYPE> >::RawType RawType;
+
+		CdDictStr(): CdArray< DICT_STRING<TYPE> >()
+		{
+			fDictID = 0;
+			fDictStream = NULL;
+			fDictLoaded = true;
+			fDictSavedCnt = 0;
+		}
+
+		virtual CdGDSObj *NewObject()
+		{
+			return (new CdDictStr<TYPE>)->AssignPipe(*this);
+		}
+
+		/// get a list of CdBlockStream owned by this object, except fGDSStream
+		virtual void GetOwnBlockStream(vector<const CdBlockStream*> &Out) const
+		{
+			CdArray< DICT_STRING<TYPE> >::GetOwnBlockStream(Out);
+			if (fDictStream) Out.push_back(fDictStream);
+		}
+
+		/// get a list of CdStream owned by this object, except fGDSStream
+		virtual void GetOwnBlockStream(vector<CdStream*> &Out)
+		{
+			CdArray< DICT_STRING<TYPE> >::GetOwnBlockStream(Out);
+			if (fDictStream) Out.push_back(fDictStream);
+		}
+
+		/// return the dictionary, code i (i >= 1) refers to Dictionary()[i-1]
+		const vector<TType> &Dictionary()
+		{
+			_LoadDict();
+			return fDict;
+		}
+
+		/// read the codes instead of strings
+		/** \param Start       the starting positions (from ZERO), it could be NULL
+		 *  \param Length      the lengths of each dimension, it could be NULL
+		 *  \param Selection   the array of selection, it could be NULL
+		 *  \param OutBuffer   the pointer to the output buffer
+		**/
+		C_UInt32 *ReadCode(const C_Int32 *Start, const C_Int32 *Length,
+			const C_BOOL *const Selection[], C_UInt32 *OutBuffer)
+		{
+			CdAbstractArray::TArrayDim DStart, DLength;
+			if (!Start)
+			{
+				memset(DStart, 0, sizeof(C_Int32)*this->fDimension.size());
+				Start = DStart;
+			}
+			if (!Length)
+			{
+				this->GetDim(DLength);
+				Length = DLength;
+			}
+			this->_CheckRect(Start, Length);
+			if (Selection)
+			{
+				return ArrayRIterRectEx(Start, Length, Selection,
+					this->fDimension.size(), *this, OutBuffer,
+					IIndex, ALLOC_FUNC<C_UInt32, C_UInt32>::ReadEx);
+			} else {
+				return ArrayRIterRect(Start, Length, this->fDimension.size(),
+					*this, OutBuffer, IIndex, ALLOC_FUNC<C_UInt32, C_UInt32>::Read);
+			}
+		}
+
+	protected:
+		/// the distinct strings in order of first appearance
+		vector<TType> fDict;
+		/// the map from a string to its code
+		map<TType, C_UInt32> fDictMap;
+		/// the block ID of dictionary
+		TdGDSBlockID fDictID;
+		/// the GDS stream for dictionary
+		CdBlockStream *fDictStream;
+		/// whether fDict has been loaded from fDictStream
+		bool fDictLoaded;
+		/// the number of dictionary entries stored in fDictStream
+		size_t fDictSavedCnt;
+
+		virtual void Loading(CdReader &Reader, TdVersion Version)
+		{
+			CdArray< DICT_STRING<TYPE> >::Loading(Reader, Version);
+			fDict.clear();
+			fDictMap.clear();
+			fDictSavedCnt = 0;
+			fDictLoaded = true;
+			if (this->fGDSStream)
+			{
+				Reader[VAR_DICT()] >> fDictID;
+				fDictStream = this->fGDSStream->Collection()[fDictID];
+				fDictLoaded = false;
+			}
+		}
+
+		virtual void Saving(CdWriter &Writer)
+		{
+			CdArray< DICT_STRING<TYPE> >::Saving(Writer);
+			if (this->fGDSStream)
+			{
+				if (!fDictStream)
+					fDictStream = this->fGDSStream->Collection().NewBlockStream();
+				_SaveDict();
+				TdGDSBlockID Entry = fDictStream->ID();
+				Writer[VAR_DICT()] << Entry;
+			}
+		}
+
+		/// the property name of dictionary block ID
+		COREARRAY_INLINE static const char *VAR_DICT() { return "DICT"; }
+
+		/// load the dictionary from fDictStream if needed
+		void _LoadDict()
+		{
+			if (fDictLoaded) return;
+			fDictLoaded = true;
+			const SIZE64 Size = fDictStream->GetSize();
+			vector<C_UInt8> Buf(Size);
+			if (Size > 0)
+			{
+				fDictStream->SetPosition(0);
+				fDictStream->ReadData(&Buf[0], Size);
+			}
+			const C_UInt8 *p = Size > 0 ? &Buf[0] : NULL, *end = p + Size;
+			while (p < end)
+			{
+				size_t n = 0;
+				C_UInt8 ch, shl = 0;
+				do {
+					if (p >= end) throw ErrArray(ERR_DICT());
+					ch = *p++;
+					n |= size_t(ch & 0x7F) << shl;
+					shl += 7;
+				} while (ch & 0x80);
+				if (n*sizeof(TYPE) > size_t(end - p))
+					throw ErrArray(ERR_DICT());
+				TType s(n, RawType(0));
+				if (n > 0)
+				{
+					memcpy((void*)&s[0], p, n*sizeof(TYPE));
+					COREARRAY_ENDIAN_LE_TO_NT_ARRAY((TYPE*)&s[0], n);
+				}
+				p += n*sizeof(TYPE);
+				fDictMap[s] = fDict.size() + 1;
+				fDict.push_back(s);
+			}
+			fDictSavedCnt = fDict.size();
+		}
+
+		/// append the unsaved dictionary entries to fDictStream
+		void _SaveDict()
+		{
+			if (!fDictStream || (fDictSavedCnt >= fDict.size())) return;
+			BYTE_LE<CdStream> ss(fDictStream);
+			ss.SetPosition(fDictStream->GetSize());
+			for (; fDictSavedCnt < fDict.size(); fDictSavedCnt++)
+			{
+				const TType &val = fDict[fDictSavedCnt];
+				size_t m = val.size();
+				do {
+					C_UInt8 ch = (m & 0x7F); m >>= 7;
+					if (m > 0) ch |= 0x80;
+					ss.W8b(ch);
+				} while (m > 0);
+				if (!val.empty())
+					ss.W((const TYPE*)&val[0], val.size());
+			}
+		}
+
+		/// return the code of a string, and add it to the dictionary if needed
+		COREARRAY_INLINE C_UInt32 _Encode(const TType &val)
+		{
+			if (val.empty()) return 0;
+			typename map<TType, C_UInt32>::iterator it = fDictMap.find(val);
+			if (it != fDictMap.end()) return it->second;
+			if (fDict.size() >= 0xFFFFFFFEu)
+				throw ErrArray("Too many distinct strings in the dictionary.");
+			C_UInt32 code = fDict.size() + 1;
+			fDict.push_back(val);
+			fDictMap.insert(pair<TType, C_UInt32>(val, code));
+			return code;
+		}
+
+		/// return the string of a code
+		COREARRAY_INLINE const TType &_Decode(C_UInt32 code)
+		{
+			static const TType EMPTY;
+			if (code == 0) return EMPTY;
+			if (code > fDict.size()) throw ErrArray(ERR_DICT());
+			return fDict[code - 1];
+		}
+
+		COREARRAY_INLINE static const char *ERR_DICT()
+			{ return "Invalid dictionary of dictionary-encoded string."; }
+
+	private:
+		COREARRAY_FORCEINLINE static void IIndex(CdDictStr<TYPE> &Obj,
+			CdIterator &I, const C_Int32 DimI[])
+		{
+			I.Ptr = Obj._IndexPtr(DimI);
+		}
+	};
+
+
+	/// Template functions for allocator
+
+	template<typename TYPE, typename MEM_TYPE>
+		struct COREARRAY_DLL_DEFAULT ALLOC_FUNC<DICT_STRING<TYPE>, MEM_TYPE>
+	{
+		/// string type
+		typedef typename TdTraits< DICT_STRING<TYPE> >::TType StrType;
+
+		/// read an array from CdAllocator
+		static MEM_TYPE *Read(CdIterator &I, MEM_TYPE *p, ssize_t n)
+		{
+			if (n <= 0) return p;
+			CdDictStr<TYPE> *IT = static_cast< CdDictStr<TYPE>* >(I.Handler);
+			IT->_LoadDict();
+			const ssize_t N = COREARRAY_ALLOC_FUNC_BUFFER / sizeof(C_UInt32);
+			C_UInt32 Buf[N];
+			BYTE_LE<CdAllocator> ss(I.Allocator);
+			I.Allocator->SetPosition(I.Ptr);
+			I.Ptr += n * sizeof(C_UInt32);
+			while (n > 0)
+			{
+				ssize_t Cnt = (n >= N) ? N : n;
+				ss.R(Buf, Cnt);
+				for (ssize_t i=0; i < Cnt; i++)
+					*p++ = VAL_CONVERT(MEM_TYPE, StrType, IT->_Decode(Buf[i]));
+				n -= Cnt;
+			}
+			return p;
+		}
+
+		/// read an array from CdAllocator with selection
+		static MEM_TYPE *ReadEx(CdIterator &I, MEM_TYPE *p, ssize_t n,
+			const C_BOOL sel[])
+		{
+			if (n <= 0) return p;
+			for (; n>0 && !*sel; n--, sel++) I.Ptr += sizeof(C_UInt32);
+			CdDictStr<TYPE> *IT = static_cast< CdDictStr<TYPE>* >(I.Handler);
+			IT->_LoadDict();
+			const ssize_t N = COREARRAY_ALLOC_FUNC_BUFFER / sizeof(C_UInt32);
+			C_UInt32 Buf[N];
+			BYTE_LE<CdAllocator> ss(I.Allocator);
+			I.Allocator->SetPosition(I.Ptr);
+			I.Ptr += n * sizeof(C_UInt32);
+			while (n > 0)
+			{
+				ssize_t Cnt = (n >= N) ? N : n;
+				ss.R(Buf, Cnt);
+				for (ssize_t i=0; i < Cnt; i++)
+				{
+					if (*sel++)
+						*p++ = VAL_CONVERT(MEM_TYPE, StrType, IT->_Decode(Buf[i]));
+				}
+				n -= Cnt;
+			}
+			return p;
+		}
+
+		/// write an array to CdAllocator
+		static const MEM_TYPE *Write(CdIterator &I, const MEM_TYPE *p,
+			ssize_t n)
+		{
+			if (n <= 0) return p;
+			CdDictStr<TYPE> *IT = static_cast< CdDictStr<TYPE>* >(I.Handler);
+			IT->_LoadDict();
+			const ssize_t N = COREARRAY_ALLOC_FUNC_BUFFER / sizeof(C_UInt32);
+			C_UInt32 Buf[N];
+			I.Allocator->SetPosition(I.Ptr);
+			I.Ptr += n * sizeof(C_UInt32);
+			while (n > 0)
+			{
+				ssize_t Cnt = (n >= N) ? N : n;
+				for (ssize_t i=0; i < Cnt; i++)
+					Buf[i] = IT->_Encode(VAL_CONVERT(StrType, MEM_TYPE, *p++));
+				COREARRAY_ENDIAN_NT_TO_LE_ARRAY(Buf, Cnt);
+				I.Allocator->WriteData(Buf, Cnt*sizeof(C_UInt32));
+				n -= Cnt;
+			}
+			IT->_SaveDict();
+			return p;
+		}
+	};
+
+
+	/// Dictionary-encoded UTF-8 string
+	typedef CdDictStr<C_UTF8>     CdDStr8;
+	/// Dictionary-encoded UTF-16 string
+	typedef CdDictStr<C_UTF16>    CdDStr16;
+	/// Dictionary-encoded UTF-32 string
+	typedef CdDictStr<C_UTF32>    CdDStr32;
 }
 
 #endif /* _HEADER_COREARRAY_STRING_GDS_ */
@@ -28,6 +28,7 @@
 #include "dStream.h"
 #include <cctype>
 #include <limits>
+#include <algorithm>
 
 #ifndef COREARRAY_NO_STD_IN_OUT
 #   include <iostream>
@@ -81,6 +82,65 @@ void CdHandleStream::SetSize(SIZE64 NewSize)
     	RaiseLastOSError<ErrOSError>();
 }
 
+void CdHandleStream::CopyFrom(CdStream &Source, SIZE64 Pos, SIZE64 Count)
+{
+	if (!dynamic_cast<CdForkFileStream*>(this))
+	{
+		// the chunks of a block stream are copied from the file directly
+		CdBlockStream *Blk = dynamic_cast<CdBlockStream*>(&Source);
+		CdStream *S = Blk ? Blk->Collection().Stream() : &Source;
+		if (dynamic_cast<CdHandleStream*>(S) &&
+			!dynamic_cast<CdForkFileStream*>(S) &&
+			(static_cast<CdHandleStream*>(S)->Handle() != fHandle))
+		{
+			TSysHandle H = static_cast<CdHandleStream*>(S)->Handle();
+			if (Count < 0)
+				Count = Source.GetSize() - Pos;
+			if (Blk)
+			{
+				const CdBlockStream::TBlockInfo *p = Blk->List();
+				for (; p && (Count > 0); p = p->Next)
+				{
+					SIZE64 End = p->BlockStart + p->BlockSize;
+					if (Pos >= End) continue;
+					SIZE64 L = End - Pos;
+					if (L > Count) L = Count;
+					_CopyRaw(H, p->StreamStart + (Pos - p->BlockStart), L);
+					Pos += L; Count -= L;
+				}
+				if (Count > 0)
+					throw ErrStream("CdHandleStream::CopyFrom: out of range.");
+			} else
+				_CopyRaw(H, Pos, Count);
+			return;
+		}
+	}
+	CdStream::CopyFrom(Source, Pos, Count);
+}
+
+void CdHandleStream::_CopyRaw(TSysHandle Src, SIZE64 Pos, SIZE64 Count)
+{
+	SIZE64 n = SysHandleCopy(Src, Pos, fHandle, Count);
+	Pos += n; Count -= n;
+	if (Count > 0)
+	{
+		// fall back to a large buffer
+		vector<C_UInt8> Buffer(
+			(Count < (SIZE64)COREARRAY_LARGE_STREAM_BUFFER) ? Count :
+			COREARRAY_LARGE_STREAM_BUFFER);
+		if (SysHandleSeek(Src, Pos, soBeginning) < 0)
+			RaiseLastOSError<ErrOSError>();
+		while (Count > 0)
+		{
+			ssize_t N = (Count < (SIZE64)Buffer.size()) ? Count : Buffer.size();
+			if ((ssize_t)SysHandleRead(Src, &Buffer[0], N) != N)
+				throw ErrStream("CdHandleStream::CopyFrom: read error.");
+			WriteData(&Buffer[0], N);
+			Count -= N;
+		}
+	}
+}
+
 
 // =====================================================================
 // CdFileStream
@@ -452,6 +512,11 @@ CdRA_Read::CdRA_Read(CdRecodeStream *owner):
 	fIndexingStart = 0;
 	fIndex = NULL;
 	fIndexSize = 0;
+	fCache = fCacheSeen = NULL;
+	fCacheState = 0;
+	memset(&fCacheKey, 0, sizeof(fCacheKey));
+	fCacheIdx = -1;
+	fCacheFill = false;
 }
 
 CdRA_Read::~CdRA_Read()
@@ -676,6 +741,131 @@ void CdRA_Read::LoadIndexing()
 	}
 }
 
+ssize_t CdRA_Read::CacheRead(void *Buffer, ssize_t Count, SIZE64 &CurPos)
+{
+	if (Count <= 0) return 0;
+	C_UInt8 *pBuf = (C_UInt8*)Buffer;
+	ssize_t OldCount = Count;
+	const SIZE64 Total = fIndex[fIndexSize].RawStart;
+
+	while ((Count > 0) && (CurPos < Total))
+	{
+		if ((fCacheIdx < 0) || (CurPos < fIndex[fCacheIdx].RawStart) ||
+			(CurPos >= fIndex[fCacheIdx+1].RawStart))
+		{
+			// decoding changes the position
+			SIZE64 Pos = CurPos;
+			LoadCacheBlock(FindBlock(Pos));
+			CurPos = Pos;
+		}
+		SIZE64 Start = fIndex[fCacheIdx].RawStart;
+		ssize_t L = fIndex[fCacheIdx+1].RawStart - CurPos;
+		if (L > Count) L = Count;
+		memcpy(pBuf, &fCacheBuf[CurPos - Start], L);
+		CurPos += L; pBuf += L;
+		Count -= L;
+	}
+
+	if (CurPos > fOwner.fTotalOut) fOwner.fTotalOut = CurPos;
+	return OldCount - Count;
+}
+
+SIZE64 CdRA_Read::CacheSeek(SIZE64 Position, SIZE64 &CurPos)
+{
+	static const char *ERR_SEEK = "'Seek' out of the range with position (%lld).";
+	if ((Position < 0) || (Position > fIndex[fIndexSize].RawStart))
+		throw ErrStream(ERR_SEEK, Position);
+	CurPos = Position;
+	return CurPos;
+}
+
+void CdRA_Read::SwitchCache(CdBlockCache *Cache, SIZE64 &CurPos)
+{
+	fCacheSeen = Cache;
+	CdBlockCache *Old = fCache;
+	fCache = NULL;
+	fCacheIdx = -1;
+	if (Cache && (fCacheState == 0))
+	{
+		// only the blocks in a read-only file are shared
+		fCacheState = -1;
+		CdBlockStream *Blk = dynamic_cast<CdBlockStream*>(fOwner.fStream);
+		if (Blk && Blk->Collection().ReadOnly())
+		{
+			CdHandleStream *H =
+				dynamic_cast<CdHandleStream*>(Blk->Collection().Stream());
+			if (H && CdBlockCache::FileKey(H->Handle(), fCacheKey))
+				fCacheState = 1;
+		}
+	}
+	if (Cache && (fCacheState > 0))
+	{
+		fCache = Cache;
+		// all block sizes are needed
+		if (!Old) GetUpdated();
+	} else if (Old && (fIndexSize > 0))
+	{
+		// continue with the decoder at the current position
+		SIZE64 Pos = CurPos;
+		BinSearch(Pos, 0, fIndexSize-1);
+		Reset();
+		fOwner.SetPosition(Pos);
+	}
+}
+
+void CdRA_Read::LoadCacheBlock(C_Int32 Index)
+{
+	SIZE64 Size = fIndex[Index+1].RawStart - fIndex[Index].RawStart;
+	fCacheIdx = -1;
+	fCacheBuf.resize(Size);
+	if (Size <= 0)
+		{ fCacheIdx = Index; return; }
+
+	// the key is the position of compressed block in the file
+	CdBlockCache::TKey Key = fCacheKey;
+	Key.Pos = -1;
+	Key.CmpSize = fIndex[Index+1].CmpStart - fIndex[Index].CmpStart;
+	SIZE64 Pos = fIndex[Index].CmpStart;
+	const CdBlockStream::TBlockInfo *p =
+		static_cast<CdBlockStream*>(fOwner.fStream)->List();
+	for (; p; p = p->Next)
+	{
+		if ((p->BlockStart <= Pos) && (Pos < p->BlockStart + p->BlockSize))
+			{ Key.Pos = p->StreamStart + (Pos - p->BlockStart); break; }
+	}
+
+	if ((Key.Pos < 0) || !fCache->Find(Key, &fCacheBuf[0], Size))
+	{
+		BinSearch(fIndex[Index].RawStart, Index, Index);
+		Reset();
+		fCacheFill = true;
+		try {
+			fOwner.ReadData(&fCacheBuf[0], Size);
+		} catch (...) {
+			fCacheFill = false;
+			throw;
+		}
+		fCacheFill = false;
+		if (Key.Pos >= 0)
+			fCache->Add(Key, &fCacheBuf[0], Size);
+	}
+	fCacheIdx = Index;
+}
+
+C_Int32 CdRA_Read::FindBlock(SIZE64 Position) const
+{
+	ssize_t low = 0, high = fIndexSize - 1;
+	while (low < high)
+	{
+		ssize_t mid = low + ((high - low + 1) >> 1);
+		if (Position >= fIndex[mid].RawStart)
+			low = mid;
+		else
+			high = mid - 1;
+	}
+	return low;
+}
+
 
 // CdRA_Write
 
@@ -719,6 +909,76 @@ void CdRA_Write::InitWriteStream()
 	fHasInitWriteBlock = false;
 }
 
+void CdRA_Write::ResumeWriteStream(bool DropLast)
+{
+	static const char *ERR_RESUME =
+		"Unable to append to the stream with random access (%s).";
+
+	CdStream *S = fOwner.fStream;
+	// get the base position
+	fOwner.fStreamBase = S->Position();
+	// check the magic number
+	{
+		CdMemoryStream Magic;
+		WriteMagicNumber(Magic);
+		ssize_t n = Magic.GetSize();
+		vector<C_UInt8> Buf(n);
+		S->ReadData(&Buf[0], n);
+		if (memcmp(&Buf[0], Magic.BufPointer(), n) != 0)
+			throw ErrRecodeStream(ERR_RESUME, "invalid header");
+	}
+	// the block list is followed by indexing only in version 0x11
+	if (S->R8b() != 0x11)
+		throw ErrRecodeStream(ERR_RESUME, "unsupported version");
+	if ((C_Int8)S->R8b() != fSizeType)
+		throw ErrRecodeStream(ERR_RESUME, "different block size");
+	C_Int32 Num;
+	TdGDSPos Len;
+	BYTE_LE<CdStream>(S) >> Num >> Len;
+	if (Num < 0)
+		throw ErrRecodeStream(ERR_RESUME, "not closed");
+	fBlockListStart = S->Position();
+
+	// load indexing information
+	S->SetPosition(fBlockListStart + Len);
+	fBlockInfoList.resize(Num);
+	SIZE64 CmpTotal=0, RawTotal=0;
+	for (C_Int32 i=0; i < Num; i++)
+	{
+		C_UInt8 BSZ[SIZE_RA_BLOCK_HEADER];
+		S->ReadData(BSZ, SIZE_RA_BLOCK_HEADER);
+		C_UInt32 SC = BSZ[0] | (C_UInt32(BSZ[1]) << 8) |
+			(C_UInt32(BSZ[2]) << 16);
+		C_UInt32 SU = BSZ[3] | (C_UInt32(BSZ[4]) << 8) |
+			(C_UInt32(BSZ[5]) << 16) | (C_UInt32(BSZ[6]) << 24);
+		fBlockInfoList[i] = SC | (C_UInt64(SU) << 32);
+		CmpTotal += SC; RawTotal += SU;
+	}
+	if (CmpTotal != (SIZE64)Len)
+		throw ErrRecodeStream(ERR_RESUME, "invalid indexing");
+	// the last block is rewritten by the caller
+	if (DropLast && (Num > 0))
+	{
+		C_UInt64 u = fBlockInfoList.back();
+		CmpTotal -= u & 0xFFFFFFFF;
+		RawTotal -= u >> 32;
+		fBlockInfoList.pop_back();
+		Num --;
+	}
+	fBlockNum = Num;
+
+	// the number of blocks is unknown until closing
+	S->SetPosition(fBlockListStart - sizeof(C_Int32) - GDS_POS_SIZE);
+	BYTE_LE<CdStream>(S) << C_Int32(-1);
+	// remove the indexing, and new blocks follow the existing ones
+	fOwner.fStreamPos = fBlockListStart + CmpTotal;
+	S->SetSize(fOwner.fStreamPos);
+	S->SetPosition(fOwner.fStreamPos);
+	fOwner.fTotalIn = RawTotal;
+	fOwner.fTotalOut = fOwner.fStreamPos - fOwner.fStreamBase;
+	fHasInitWriteBlock = false;
+}
+
 void CdRA_Write::DoneWriteStream()
 {
 	DoneWriteBlock();
@@ -1138,7 +1398,7 @@ static const C_UInt8 ZRA_MAGIC_HEADER[ZRA_MAGIC_HEADER_SIZE] =
 
 
 CdZEncoder_RA::CdZEncoder_RA(CdStream &Dest, TLevel Level,
-	TBlockSize BK): CdRA_Write(this, BK),
+	TBlockSize BK, TWriteMode Mode): CdRA_Write(this, BK),
 	CdZEncoder( Dest, Level,
 		 BK==ra16KB  ? ZRA_WINDOW_BITS_16K :
 		(BK==ra32KB  ? ZRA_WINDOW_BITS_32K :
@@ -1146,7 +1406,10 @@ CdZEncoder_RA::CdZEncoder_RA(CdStream &Dest, TLevel Level,
 		(BK==ra128KB ? ZRA_WINDOW_BITS_128K : ZRA_WINDOW_BITS))) )
 {
 	fBlockZIPSize = fCurBlockZIPSize = RA_BLOCK_SIZE_LIST[BK];
-	InitWriteStream();
+	if (Mode == wmNew)
+		InitWriteStream();
+	else
+		ResumeWriteStream(Mode == wmDropLast);
 }
 
 ssize_t CdZEncoder_RA::Write(const void *Buffer, ssize_t Count)
@@ -1324,6 +1587,8 @@ CdZDecoder_RA::CdZDecoder_RA(CdStream &Source):
 ssize_t CdZDecoder_RA::Read(void *Buffer, ssize_t Count)
 {
 	if (Count <= 0) return 0;
+	if (UseCache(fCurPosition))
+		return CacheRead(Buffer, Count, fCurPosition);
 	if (fBlockIdx >= fBlockNum) return 0;
 
 	C_UInt8 *pBuf = (C_UInt8*)Buffer;
@@ -1395,6 +1660,9 @@ SIZE64 CdZDecoder_RA::Seek(SIZE64 Offset, TdSysSeekOrg Origin)
 	} else if (Origin == soEnd)
 		throw EZLibError(ERR_ZINFLATE_INVALID, "Seek");
 
+	if (UseCache(fCurPosition))
+		return CacheSeek(Offset, fCurPosition);
+
 	bool flag = SeekStream(Offset);
 	if (flag || (Offset < fCurPosition))
 		Reset();
@@ -1728,7 +1996,8 @@ static const C_UInt8 LZ4_MAGIC_HEADER[LZ4_MAGIC_HEADER_SIZE] =
 static const char *ERR_LZ4_COMPRESSING =
 	"Internal error in CdLZ4Encoder_RA::Compressing().";
 
-CdLZ4Encoder_RA::CdLZ4Encoder_RA(CdStream &Dest, TLevel Level, TBlockSize BK):
+CdLZ4Encoder_RA::CdLZ4Encoder_RA(CdStream &Dest, TLevel Level, TBlockSize BK,
+	TWriteMode Mode):
 	CdRA_Write(this, BK), CdBaseLZ4Stream(Dest), CdRecodeLevel(Level)
 {
 	switch (Level)
@@ -1750,7 +2019,10 @@ CdLZ4Encoder_RA::CdLZ4Encoder_RA(CdStream &Dest, TLevel Level, TBlockSize BK):
 	_IdxRaw = 0;
 
 	fBlockLZ4Size = fCurBlockLZ4Size = RA_BLOCK_SIZE_LIST[BK];
-	InitWriteStream();
+	if (Mode == wmNew)
+		InitWriteStream();
+	else
+		ResumeWriteStream(Mode == wmDropLast);
 }
 
 CdLZ4Encoder_RA::~CdLZ4Encoder_RA()
@@ -2021,6 +2293,8 @@ CdLZ4Decoder_RA::CdLZ4Decoder_RA(CdStream &Source):
 ssize_t CdLZ4Decoder_RA::Read(void *Buffer, ssize_t Count)
 {
 	if (Count <= 0) return 0;
+	if (UseCache(fCurPosition))
+		return CacheRead(Buffer, Count, fCurPosition);
 	if (fBlockIdx >= fBlockNum) return 0;
 
 	C_UInt8 *pBuf = (C_UInt8*)Buffer;
@@ -2103,6 +2377,9 @@ SIZE64 CdLZ4Decoder_RA::Seek(SIZE64 Offset, TdSysSeekOrg Origin)
 	} else if (Origin == soEnd)
 		throw ELZ4Error(ERR_LZ4_INFLATE_INVALID, "Seek");
 
+	if (UseCache(fCurPosition))
+		return CacheSeek(Offset, fCurPosition);
+
 	bool flag = SeekStream(Offset);
 	if (flag || (Offset < fCurPosition))
 		Reset();
@@ -2496,10 +2773,13 @@ static const C_UInt8 XZ_RA_MAGIC_HEADER[XZ_RA_MAGIC_HEADER_SIZE] =
 
 
 CdXZEncoder_RA::CdXZEncoder_RA(CdStream &Dest, TLevel Level,
-	TBlockSize B): CdRA_Write(this, B), CdXZEncoder(Dest, Level)
+	TBlockSize B, TWriteMode Mode): CdRA_Write(this, B), CdXZEncoder(Dest, Level)
 {
 	fBlockZIPSize = fCurBlockZIPSize = RA_BLOCK_SIZE_LIST[B];
-	InitWriteStream();
+	if (Mode == wmNew)
+		InitWriteStream();
+	else
+		ResumeWriteStream(Mode == wmDropLast);
 }
 
 ssize_t CdXZEncoder_RA::Write(const void *Buffer, ssize_t Count)
@@ -2675,6 +2955,8 @@ CdXZDecoder_RA::CdXZDecoder_RA(CdStream &Source): CdRA_Read(this),
 ssize_t CdXZDecoder_RA::Read(void *Buffer, ssize_t Count)
 {
 	if (Count <= 0) return 0;
+	if (UseCache(fCurPosition))
+		return CacheRead(Buffer, Count, fCurPosition);
 	if (fBlockIdx >= fBlockNum) return 0;
 
 	ssize_t OriCount = Count;
@@ -2744,6 +3026,9 @@ SIZE64 CdXZDecoder_RA::Seek(SIZE64 Offset, TdSysSeekOrg Origin)
 	} else if (Origin == soEnd)
 		throw EXZError(ERR_XZ_INFLATE_INVALID, "Seek");
 
+	if (UseCache(fCurPosition))
+		return CacheSeek(Offset, fCurPosition);
+
 	bool flag = SeekStream(Offset);
 	if (flag || (Offset < fCurPosition))
 		Reset();
@@ -2966,6 +3251,7 @@ ssize_t CdBlockStream::Write(const void *Buffer, ssize_t Count)
 			fNeedSyncSize = true;
 			SyncSizeInfo();
 		}
+		fCollection.fBytesWritten += fPosition - LastPos;
 	}
 	return fPosition - LastPos;
 }
@@ -3078,6 +3364,23 @@ void CdBlockStream::SyncSizeInfo()
 	}
 }
 
+void CdBlockStream::ResetBlockList(TBlockInfo *List, SIZE64 Size)
+{
+	xClearList(fList);
+	fList = List;
+	fBlockCapacity = 0;
+	for (TBlockInfo *p=List; p; p=p->Next)
+	{
+		p->BlockStart = fBlockCapacity;
+		fBlockCapacity += p->BlockSize;
+	}
+	fBlockSize = Size;
+	fNeedSyncSize = false;
+	if (fPosition > Size) fPosition = Size;
+	fCurrent = NULL;
+	fCurrent = _FindCur(fPosition);
+}
+
 CdBlockStream::TBlockInfo *CdBlockStream::_FindCur(const SIZE64 Pos)
 {
 	if (Pos < fBlockCapacity)
@@ -3112,6 +3415,7 @@ CdBlockCollection::CdBlockCollection(const SIZE64 vCodeStart)
 	fCodeStart = vCodeStart;
 	fClassMgr = &dObjManager();
 	fReadOnly = false;
+	fBytesWritten = 0;
 }
 
 CdBlockCollection::~CdBlockCollection()
@@ -3293,16 +3597,39 @@ CdBlockStream *CdBlockCollection::NewBlockStream()
 	CdBlockStream *rv = new CdBlockStream(*this);
 	rv->AddRef();
 	rv->fID = vNextID; ++vNextID;
-	fBlockList.push_back(rv);
+	_AddBlock(rv);
+	return rv;
+}
+
+CdBlockStream *CdBlockCollection::NewBlockStream(TdGDSBlockID id)
+{
+	static const char *ERR_BLOCK_ID_EXIST = "Block ID (%u) exists.";
+	if (HaveID(id))
+		throw ErrStream(ERR_BLOCK_ID_EXIST, id.Get());
+	CdBlockStream *rv = new CdBlockStream(*this);
+	rv->AddRef();
+	rv->fID = id;
+	_AddBlock(rv);
 	return rv;
 }
 
 bool CdBlockCollection::HaveID(TdGDSBlockID id)
 {
-	vector<CdBlockStream*>::const_iterator it;
-	for (it=fBlockList.begin(); it != fBlockList.end(); it++)
-		if ((*it)->fID == id) return true;
-	return false;
+	return _FindID(id) != NULL;
+}
+
+CdBlockStream *CdBlockCollection::_FindID(TdGDSBlockID id) const
+{
+	map<C_UInt32, CdBlockStream*>::const_iterator it =
+		fBlockIndex.find(id.Get());
+	return (it != fBlockIndex.end()) ? it->second : NULL;
+}
+
+void CdBlockCollection::_AddBlock(CdBlockStream *bs)
+{
+	fBlockList.push_back(bs);
+	// keep the first one if the ID is duplicated in a corrupted file
+	fBlockIndex.insert(pair<C_UInt32, CdBlockStream*>(bs->fID.Get(), bs));
 }
 
 int CdBlockCollection::NumOfFragment()
@@ -3332,9 +3659,11 @@ void CdBlockCollection::LoadStream(CdStream *vStream, bool vReadOnly,
 	(fStream=vStream)->AddRef();
 	fReadOnly = vReadOnly;
 	CdBlockStream::TBlockInfo *p = fUnuse;
-	fStream->SetPosition(fCodeStart);
 	fStreamSize = fStream->GetSize();
-	SIZE64 pos = fStream->Position();
+	// block headers are small and scattered, read them through a buffer
+	TdAutoRef<CdBufStream> Buf(new CdBufStream(fStream, 0x10000));
+	Buf->SetPosition(fCodeStart);
+	SIZE64 pos = Buf->Position();
 	SIZE64 stream_end = fStreamSize - GDS_POS_SIZE*2;
 
 	// block scan
@@ -3342,7 +3671,7 @@ void CdBlockCollection::LoadStream(CdStream *vStream, bool vReadOnly,
 	{
 		// read data
 		TdGDSPos sSize, sNext;
-		BYTE_LE<CdStream>(fStream) >> sSize >> sNext;
+		BYTE_LE<CdBufStream>(Buf.get()) >> sSize >> sNext;
 		// check size
 		const SIZE64 sz = sSize & GDS_STREAM_POS_MASK;
 		SIZE64 s = sz - GDS_POS_SIZE*2;
@@ -3354,7 +3683,7 @@ void CdBlockCollection::LoadStream(CdStream *vStream, bool vReadOnly,
 				Log->Add(CdLogRecord::LOG_ERROR, ERR_SIZE1, sz, pos);
 		}
 		// check position
-		pos = fStream->Position() + s;
+		pos = Buf->Position() + s;
 		if (pos > fStreamSize)
 		{
 			if (!vAllowError)
@@ -3362,7 +3691,7 @@ void CdBlockCollection::LoadStream(CdStream *vStream, bool vReadOnly,
 			else if (Log)
 				Log->Add(CdLogRecord::LOG_ERROR, ERR_SIZE_END, sz, pos);
 			pos = fStreamSize;
-			s = pos - fStream->Position();
+			s = pos - Buf->Position();
 		}
 		// check the next position
 		if (sNext >= fStreamSize)
@@ -3385,11 +3714,11 @@ void CdBlockCollection::LoadStream(CdStream *vStream, bool vReadOnly,
 			s = L;
 		}
 		CdBlockStream::TBlockInfo *n = new CdBlockStream::TBlockInfo(head, s - L,
-			fStream->Position() + L, sNext);
+			Buf->Position() + L, sNext);
 		// next
 		if (p) p->Next = n; else fUnuse = n;
 		p = n;
-		fStream->SetPosition(pos);
+		Buf->SetPosition(pos);
 	}
 
 	// check the file end
@@ -3401,63 +3730,38 @@ void CdBlockCollection::LoadStream(CdStream *vStream, bool vReadOnly,
 			Log->Add(ERR_GDS_END, CdLogRecord::LOG_ERROR);
 	}
 
-	// reconstruct block lists
-	while (fUnuse)
+	// reconstruct block lists, all blocks are indexed by their positions
+	vector<CdBlockStream::TBlockInfo*> All;
+	map<SIZE64, size_t> PosIdx;
+	for (p = fUnuse; p; p = p->Next)
 	{
-		// find the header
-		CdBlockStream::TBlockInfo *q=NULL;
-		for (p = fUnuse; p; )
-		{
-			if (p->Head) break;
-			q = p; p = p->Next;
-        }
-		// find all blocks linked to the header
-		if (p)
+		PosIdx[p->AbsStart()] = All.size();
+		All.push_back(p);
+	}
+	vector<bool> Used(All.size(), false);
+
+	for (size_t i=0; i < All.size(); i++)
+	{
+		if (!All[i]->Head || Used[i]) continue;
+		p = All[i];
+		Used[i] = true;
+		// a new block stream
+		CdBlockStream *bs = new CdBlockStream(*this);
+		bs->AddRef();
+		Buf->SetPosition(p->StreamStart - CdBlockStream::TBlockInfo::HEAD_SIZE);
+		BYTE_LE<CdBufStream>(Buf.get()) >> bs->fID >> bs->fBlockSize;
+		_AddBlock(bs);
+		bs->fBlockCapacity = p->BlockSize;
+		bs->fList = bs->fCurrent = p;
+		p->Next = NULL;
+		// find a list of blocks linked to the header
+		while (p->StreamNext != 0)
 		{
-			// delete p from the unused list
-			if (q) q->Next = p->Next; else fUnuse = p->Next;
-			// a new block stream
-			CdBlockStream *bs = new CdBlockStream(*this);
-			bs->AddRef();
-			fBlockList.push_back(bs);
-			// block list
-			fStream->SetPosition(p->StreamStart - CdBlockStream::TBlockInfo::HEAD_SIZE);
-			BYTE_LE<CdStream>(fStream) >> bs->fID >> bs->fBlockSize;
-			bs->fBlockCapacity = p->BlockSize;
-			bs->fList = bs->fCurrent = p;
-			p->Next = NULL;
-			// find a list of blocks linked to the header
-			CdBlockStream::TBlockInfo *n = fUnuse;
-			q = NULL;
-			while (n && (p->StreamNext != 0))
-			{
-				if (p->StreamNext == n->AbsStart())
-				{
-					if  (!n->Head)
-					{
-						// remove n from the unused list
-						if (q) q->Next = n->Next; else fUnuse = n->Next;
-						p->Next = n;
-						// update stream info
-						n->BlockStart = p->BlockStart + p->BlockSize;
-						bs->fBlockCapacity += n->BlockSize;
-						p = n; p->Next = NULL;
-						// restart searching
-						n = fUnuse; q = NULL;
-					} else {
-						int id = bs->fID.Get();
-						if (!vAllowError)
-							throw ErrStream(ERR_BLOCK, id, p->StreamNext);
-						else if (Log)
-							Log->Add(CdLogRecord::LOG_ERROR, ERR_BLOCK, id, p->StreamNext);
-						p->StreamNext = 0;
-					}
-				} else {
-					q = n; n = n->Next;
-				}
-			}
-			// check whether end of block
-			if (!n && (p->StreamNext != 0))
+			map<SIZE64, size_t>::iterator it = PosIdx.find(p->StreamNext);
+			CdBlockStream::TBlockInfo *n = NULL;
+			if ((it != PosIdx.end()) && !Used[it->second])
+				n = All[it->second];
+			if (!n || n->Head)
 			{
 				int id = bs->fID.Get();
 				if (!vAllowError)
@@ -3465,9 +3769,25 @@ void CdBlockCollection::LoadStream(CdStream *vStream, bool vReadOnly,
 				else if (Log)
 					Log->Add(CdLogRecord::LOG_ERROR, ERR_BLOCK, id, p->StreamNext);
 				p->StreamNext = 0;
+				break;
 			}
-		} else
-        	break;
+			Used[it->second] = true;
+			p->Next = n;
+			// update stream info
+			n->BlockStart = p->BlockStart + p->BlockSize;
+			bs->fBlockCapacity += n->BlockSize;
+			p = n; p->Next = NULL;
+		}
+	}
+
+	// the remaining blocks are unused
+	fUnuse = p = NULL;
+	for (size_t i=0; i < All.size(); i++)
+	{
+		if (Used[i]) continue;
+		if (p) p->Next = All[i]; else fUnuse = All[i];
+		p = All[i];
+		p->Next = NULL;
 	}
 
 	// unused blocks
@@ -3479,6 +3799,54 @@ void CdBlockCollection::LoadStream(CdStream *vStream, bool vReadOnly,
 	}
 }
 
+void CdBlockCollection::LoadBlockChain(CdBlockStream &Block)
+{
+	static const char *ERR_BLOCK_CHAIN =
+		"Invalid block chain of the stream (ID: %u).";
+	if (!Block.fList) return;
+
+	const SIZE64 L = CdBlockStream::TBlockInfo::HEAD_SIZE;
+	const SIZE64 FileSize = fStream->GetSize();
+	SIZE64 pos = Block.fList->AbsStart();
+	SIZE64 MaxCnt = FileSize / (GDS_POS_SIZE*2);
+	CdBlockStream::TBlockInfo *Head=NULL, *p=NULL;
+	TdGDSPos BlockSize = 0;
+	try {
+		for (bool head=true; pos > 0; head=false)
+		{
+			if ((pos + GDS_POS_SIZE*2 > FileSize) || (--MaxCnt < 0))
+				throw ErrStream(ERR_BLOCK_CHAIN, Block.fID.Get());
+			TdGDSPos sSize, sNext;
+			fStream->SetPosition(pos);
+			BYTE_LE<CdStream>(fStream) >> sSize >> sNext;
+			const bool h = (sSize & GDS_STREAM_POS_MASK_HEAD_BIT) != 0;
+			SIZE64 s = (sSize & GDS_STREAM_POS_MASK) - GDS_POS_SIZE*2;
+			if (h != head)
+				throw ErrStream(ERR_BLOCK_CHAIN, Block.fID.Get());
+			if (head)
+			{
+				TdGDSBlockID id;
+				BYTE_LE<CdStream>(fStream) >> id >> BlockSize;
+				if (id != Block.fID)
+					throw ErrStream(ERR_BLOCK_CHAIN, Block.fID.Get());
+				s -= L;
+			}
+			if (s < 0)
+				throw ErrStream(ERR_BLOCK_CHAIN, Block.fID.Get());
+			CdBlockStream::TBlockInfo *n = new CdBlockStream::TBlockInfo(head,
+				s, pos + GDS_POS_SIZE*2 + (head ? L : 0), sNext);
+			if (p) p->Next = n; else Head = n;
+			p = n;
+			pos = sNext;
+		}
+	}
+	catch (...) {
+		xClearList(Head);
+		throw;
+	}
+	Block.ResetBlockList(Head, BlockSize);
+}
+
 void CdBlockCollection::WriteStream(CdStream *vStream)
 {
 	if (fStream) throw ErrStream(ERR_INTERNAL_CALL);
@@ -3508,6 +3876,7 @@ void CdBlockCollection::Clear()
 		}
 	}
 	fBlockList.clear();
+	fBlockIndex.clear();
 
 	if (fStream)
 	{
@@ -3522,12 +3891,266 @@ void CdBlockCollection::Clear()
 	fUnuse = NULL;
 }
 
-void CdBlockCollection::DeleteBlockStream(TdGDSBlockID id)
+// the total size of a chunk in the file, including its header
+static SIZE64 chunk_total(const CdBlockStream::TBlockInfo *p)
 {
-	// find ID
+	return 2*GDS_POS_SIZE + (p->Head ? CdBlockStream::TBlockInfo::HEAD_SIZE : 0) +
+		p->BlockSize;
+}
+
+static bool chunk_less(const CdBlockStream::TBlockInfo *a,
+	const CdBlockStream::TBlockInfo *b)
+{
+	return a->AbsStart() < b->AbsStart();
+}
+
+namespace CoreArray
+{
+	/// a chunk in use and its block stream, used in compaction
+	struct TLiveChunk
+	{
+		CdBlockStream::TBlockInfo *Info;
+		CdBlockStream *Owner;
+		TLiveChunk(CdBlockStream::TBlockInfo *i, CdBlockStream *o)
+			{ Info = i; Owner = o; }
+		bool operator< (const TLiveChunk &v) const
+			{ return Info->AbsStart() < v.Info->AbsStart(); }
+	};
+
+	/// a piece of the relocated chunk in a free region
+	struct TChunkPiece
+	{
+		size_t Hole;
+		SIZE64 Size, Hdr;
+		TChunkPiece(size_t h, SIZE64 s, SIZE64 d) { Hole = h; Size = s; Hdr = d; }
+	};
+}
+
+void CdBlockCollection::_MoveData(SIZE64 Src, SIZE64 Dst, SIZE64 Count)
+{
+	vector<C_UInt8> Buffer(
+		(Count < (SIZE64)COREARRAY_LARGE_STREAM_BUFFER) ? Count :
+		COREARRAY_LARGE_STREAM_BUFFER);
+	while (Count > 0)
+	{
+		ssize_t N = (Count < (SIZE64)Buffer.size()) ? Count : Buffer.size();
+		fStream->SetPosition(Src);
+		fStream->ReadData(&Buffer[0], N);
+		fStream->SetPosition(Dst);
+		fStream->WriteData(&Buffer[0], N);
+		Src += N; Dst += N; Count -= N;
+	}
+}
+
+SIZE64 CdBlockCollection::Compact(bool PunchHole)
+{
+	static const char *ERR_COMPACT = "CdBlockCollection::Compact, %s";
+	typedef CdBlockStream::TBlockInfo TInfo;
+	const SIZE64 MIN_CHUNK = 2*GDS_POS_SIZE;
+
+	if (!fStream)
+		throw ErrStream(ERR_COMPACT, "no stream.");
+	if (fReadOnly)
+		throw ErrStream(ERR_COMPACT, "the stream is read-only.");
+
 	vector<CdBlockStream*>::iterator it;
 	for (it=fBlockList.begin(); it != fBlockList.end(); it++)
-		if ((*it)->fID == id) break;
+		(*it)->SyncSizeInfo();
+
+	// free regions sorted by position, adjacent ones are merged
+	vector<TInfo*> Holes;
+	for (TInfo *p=fUnuse; p; p=p->Next)
+	{
+		if (p->Head)
+		{
+			p->BlockSize += TInfo::HEAD_SIZE;
+			p->StreamStart -= TInfo::HEAD_SIZE;
+			p->Head = false;
+		}
+		Holes.push_back(p);
+	}
+	fUnuse = NULL;
+	sort(Holes.begin(), Holes.end(), chunk_less);
+	if (!Holes.empty())
+	{
+		size_t j = 0;
+		for (size_t i=1; i < Holes.size(); i++)
+		{
+			TInfo *h = Holes[j];
+			if (h->AbsStart() + chunk_total(h) == Holes[i]->AbsStart())
+			{
+				h->BlockSize += chunk_total(Holes[i]);
+				delete Holes[i];
+			} else
+				Holes[++j] = Holes[i];
+		}
+		Holes.resize(j + 1);
+		for (size_t i=0; i < Holes.size(); i++)
+			Holes[i]->SetSize2(*fStream, Holes[i]->BlockSize, 0);
+	}
+
+	// chunks in use sorted by position
+	vector<TLiveChunk> Live;
+	for (it=fBlockList.begin(); it != fBlockList.end(); it++)
+		for (TInfo *p=(*it)->fList; p; p=p->Next)
+			Live.push_back(TLiveChunk(p, *it));
+	sort(Live.begin(), Live.end());
+
+	// relocate the last chunk into free regions until it does not fit
+	SIZE64 End = fStreamSize;
+	while (true)
+	{
+		while (!Holes.empty() &&
+			(Holes.back()->AbsStart() + chunk_total(Holes.back()) == End))
+		{
+			End = Holes.back()->AbsStart();
+			delete Holes.back();
+			Holes.pop_back();
+		}
+		if (Live.empty()) break;
+
+		TInfo *c = Live.back().Info;
+		CdBlockStream *Owner = Live.back().Owner;
+		if (c->AbsStart() + chunk_total(c) != End)
+			throw ErrStream(ERR_COMPACT, "invalid chunk list.");
+
+		// plan the pieces of the chunk in the free regions
+		vector<TChunkPiece> Plan;
+		SIZE64 Remain = c->BlockSize;
+		bool NeedHead = c->Head;
+		for (size_t i=0; i < Holes.size() && (Remain > 0 || NeedHead); i++)
+		{
+			SIZE64 H = chunk_total(Holes[i]);
+			SIZE64 Hdr = MIN_CHUNK + (NeedHead ? TInfo::HEAD_SIZE : 0);
+			SIZE64 n = std::min(Remain, H - Hdr);
+			if ((n < 0) || ((n == 0) && !NeedHead)) continue;
+			SIZE64 Left = H - Hdr - n;
+			if ((Left > 0) && (Left < MIN_CHUNK))
+			{
+				n -= MIN_CHUNK - Left;
+				if ((n < 0) || ((n == 0) && !NeedHead)) continue;
+			}
+			Plan.push_back(TChunkPiece(i, n, Hdr));
+			Remain -= n; NeedHead = false;
+		}
+		if ((Remain > 0) || NeedHead) break;
+
+		// find the previous chunk in the block stream
+		TInfo *Prev = NULL;
+		if (Owner->fList != c)
+		{
+			for (Prev=Owner->fList; Prev && Prev->Next!=c; Prev=Prev->Next);
+			if (!Prev)
+				throw ErrStream(ERR_COMPACT, "invalid chunk list.");
+		}
+
+		// an empty chunk is unlinked
+		if (Plan.empty())
+		{
+			Prev->Next = c->Next;
+			Prev->SetNext(*fStream, c->StreamNext);
+			Owner->fCurrent = NULL;
+			End = c->AbsStart();
+			delete c;
+			Live.pop_back();
+			continue;
+		}
+
+		// copy the pieces
+		TInfo *First=NULL, *Last=NULL;
+		SIZE64 Off = 0;
+		for (size_t k=0; k < Plan.size(); k++)
+		{
+			TInfo *h = Holes[Plan[k].Hole];
+			SIZE64 A = h->AbsStart(), H = chunk_total(h);
+			bool head = (k == 0) && c->Head;
+			TInfo *n = new TInfo(head, Plan[k].Size, A + Plan[k].Hdr, 0);
+			n->BlockStart = c->BlockStart + Off;
+			_MoveData(c->StreamStart + Off, n->StreamStart, n->BlockSize);
+			n->SetSize2(*fStream, n->BlockSize, 0);
+			if (head)
+			{
+				fStream->SetPosition(n->StreamStart - TInfo::HEAD_SIZE);
+				BYTE_LE<CdStream>(fStream) << Owner->fID << Owner->fBlockSize;
+			}
+			if (Last) { Last->Next = n; Last->SetNext(*fStream, n->AbsStart()); }
+			else First = n;
+			Last = n;
+			Off += n->BlockSize;
+			Live.insert(lower_bound(Live.begin(), Live.end()-1,
+				TLiveChunk(n, Owner)), TLiveChunk(n, Owner));
+
+			// the rest of the free region
+			SIZE64 Left = H - Plan[k].Hdr - n->BlockSize;
+			if (Left > 0)
+			{
+				h->StreamStart = A + Plan[k].Hdr + n->BlockSize + MIN_CHUNK;
+				h->SetSize2(*fStream, Left - MIN_CHUNK, 0);
+			} else {
+				h->BlockSize = -1;  // mark to remove
+			}
+		}
+		for (size_t i=0; i < Holes.size(); )
+		{
+			if (Holes[i]->BlockSize < 0)
+				{ delete Holes[i]; Holes.erase(Holes.begin() + i); }
+			else i++;
+		}
+
+		// relink
+		Last->Next = c->Next;
+		Last->SetNext(*fStream, c->StreamNext);
+		if (Prev)
+		{
+			Prev->Next = First;
+			Prev->SetNext(*fStream, First->AbsStart());
+		} else
+			Owner->fList = First;
+		Owner->fCurrent = NULL;
+
+		End = c->AbsStart();
+		delete c;
+		Live.pop_back();
+	}
+
+	// truncate the stream
+	SIZE64 rv = fStreamSize - End;
+	if (rv > 0)
+	{
+		fStreamSize = End;
+		fStream->SetSize(End);
+	}
+
+	// the remaining free regions
+	for (size_t i=Holes.size(); i > 0; i--)
+	{
+		TInfo *h = Holes[i-1];
+		h->Next = fUnuse; fUnuse = h;
+		if (PunchHole && (h->BlockSize > 0) &&
+			dynamic_cast<CdHandleStream*>(fStream))
+		{
+			SysHandlePunchHole(static_cast<CdHandleStream*>(fStream)->Handle(),
+				h->StreamStart, h->BlockSize);
+		}
+	}
+
+	// reset the current chunks
+	for (it=fBlockList.begin(); it != fBlockList.end(); it++)
+	{
+		(*it)->fCurrent = NULL;
+		(*it)->fCurrent = (*it)->_FindCur((*it)->fPosition);
+	}
+
+	return rv;
+}
+
+void CdBlockCollection::DeleteBlockStream(TdGDSBlockID id)
+{
+	// find ID
+	CdBlockStream *bs = _FindID(id);
+	vector<CdBlockStream*>::iterator it = fBlockList.end();
+	if (bs)
+		it = find(fBlockList.begin(), fBlockList.end(), bs);
 	// delete this block list
 	if (it != fBlockList.end())
 	{
@@ -3554,6 +4177,12 @@ void CdBlockCollection::DeleteBlockStream(TdGDSBlockID id)
 		// remove
 		(*it)->Release();
 		fBlockList.erase(it);
+		fBlockIndex.erase(id.Get());
+		for (it=fBlockList.begin(); it != fBlockList.end(); it++)
+		{
+			if ((*it)->fID == id)
+				{ fBlockIndex[id.Get()] = *it; break; }
+		}
 	} else {
 		static const char *ERR_INVALID_BLOCK_ID = "Invalid block with ID (%i).";
 		throw ErrStream(ERR_INVALID_BLOCK_ID, int(id.Get()));
@@ -3563,14 +4192,13 @@ void CdBlockCollection::DeleteBlockStream(TdGDSBlockID id)
 CdBlockStream *CdBlockCollection::operator[] (const TdGDSBlockID &id)
 {
 	// find ID
-	vector<CdBlockStream*>::iterator it;
-	for (it=fBlockList.begin(); it != fBlockList.end(); it++)
-		if ((*it)->fID == id) return *it;
+	CdBlockStream *rv = _FindID(id);
+	if (rv) return rv;
 	// if no, get a new one
-	CdBlockStream *rv = new CdBlockStream(*this);
+	rv = new CdBlockStream(*this);
 	rv->AddRef();
 	rv->fID = id;
-	fBlockList.push_back(rv);
+	_AddBlock(rv);
 	if (vNextID.Get() < id.Get()) vNextID = id.Get() + 1;
 	return rv;
 }
@@ -39,6 +39,7 @@
 
 #include "dBase.h"
 #include "dSerial.h"
+#include "dBlockCache.h"
 
 // zlib library
 #ifdef COREARRAY_USE_ZLIB_EXT
@@ -66,6 +67,7 @@
 
 #include <cstring>
 #include <vector>
+#include <map>
 
 #ifdef COREARRAY_PLATFORM_UNIX
 #  include <sys/types.h>
@@ -89,11 +91,16 @@ namespace CoreArray
 		virtual ssize_t Write(const void *Buffer, ssize_t Count);
 		virtual SIZE64 Seek(SIZE64 Offset, TdSysSeekOrg Origin);
 		virtual void SetSize(SIZE64 NewSize);
+		/// copy from a file-based stream without user-space buffering if possible
+		virtual void CopyFrom(CdStream &Source, SIZE64 Pos, SIZE64 Count);
 
 		COREARRAY_INLINE TSysHandle Handle() const { return fHandle; }
 
 	protected:
 		TSysHandle fHandle;
+
+	private:
+		void _CopyRaw(TSysHandle Src, SIZE64 Pos, SIZE64 Count);
 	};
 
 
@@ -395,20 +402,66 @@ namespace CoreArray
 		virtual bool ReadMagicNumber(CdStream &Stream) = 0;
 		/// load the indexing information for version 0x11
 		void LoadIndexing();
+		/// reset the decoder at the start of current block
+		virtual void Reset() = 0;
+
+		/// the shared cache of decoded blocks in use, or NULL
+		CdBlockCache *fCache;
+		/// the cache last seen by UseCache()
+		CdBlockCache *fCacheSeen;
+		/// the key of file, 0 for unknown, 1 if cacheable, -1 if not
+		int fCacheState;
+		/// the file identity in the keys of blocks
+		CdBlockCache::TKey fCacheKey;
+		/// the decoded block for reading through the cache
+		vector<C_UInt8> fCacheBuf;
+		/// the index of block in fCacheBuf, -1 for none
+		C_Int32 fCacheIdx;
+		/// true when decoding a block for the cache
+		bool fCacheFill;
+
+		/// return true if reading through the shared block cache
+		/** \param CurPos  the current position of uncompressed data **/
+		COREARRAY_INLINE bool UseCache(SIZE64 &CurPos)
+		{
+			CdBlockCache *C = CdBlockCache::Current();
+			if (C != fCacheSeen) SwitchCache(C, CurPos);
+			return fCache && !fCacheFill;
+		}
+		/// read through the shared block cache
+		ssize_t CacheRead(void *Buffer, ssize_t Count, SIZE64 &CurPos);
+		/// seek when reading through the shared block cache
+		SIZE64 CacheSeek(SIZE64 Position, SIZE64 &CurPos);
 
 	private:
 		/// get the header of block used in Version_1.0
 		inline void GetBlockHeader_v1_0();
+		/// start or stop using the shared block cache
+		void SwitchCache(CdBlockCache *Cache, SIZE64 &CurPos);
+		/// load the decoded block 'Index' into fCacheBuf
+		void LoadCacheBlock(C_Int32 Index);
+		/// the block containing the position of uncompressed data
+		C_Int32 FindBlock(SIZE64 Position) const;
 	};
 
 	/// The writing algorithm with random access on data stream
 	class COREARRAY_DLL_DEFAULT CdRA_Write: public CdRAAlgorithm
 	{
 	public:
+		/// how to open a stream for writing
+		enum TWriteMode
+		{
+			wmNew      = 0,   ///< create a new stream
+			wmAppend   = 1,   ///< append new blocks to a closed stream
+			wmDropLast = 2    ///< append after removing the last block
+		};
+
 		CdRA_Write(CdRecodeStream *owner, TBlockSize bs);
 
 		/// initialize the stream with magic number and others
 		void InitWriteStream();
+		/// reopen a closed stream (v1.1), and new blocks follow the existing ones
+		void ResumeWriteStream(bool DropLast);
 		/// finalize the stream
 		void DoneWriteStream();
 
@@ -515,7 +568,8 @@ namespace CoreArray
 		protected CdRA_Write, public CdZEncoder
 	{
 	public:
-		CdZEncoder_RA(CdStream &Dest, TLevel Level, TBlockSize BlockSize);
+		CdZEncoder_RA(CdStream &Dest, TLevel Level, TBlockSize BlockSize,
+			TWriteMode Mode=wmNew);
 
 		virtual ssize_t Write(const void *Buffer, ssize_t Count);
 		virtual void Close();
@@ -665,7 +719,7 @@ namespace CoreArray
 	{
 	public:
 		CdLZ4Encoder_RA(CdStream &Dest, TLevel Level,
-			TBlockSize BlockSize);
+			TBlockSize BlockSize, TWriteMode Mode=wmNew);
 		virtual ~CdLZ4Encoder_RA();
 
 		virtual ssize_t Read(void *Buffer, ssize_t Count);
@@ -828,7 +882,8 @@ namespace CoreArray
 		protected CdRA_Write, public CdXZEncoder
 	{
 	public:
-		CdXZEncoder_RA(CdStream &Dest, TLevel Level, TBlockSize BlockSize);
+		CdXZEncoder_RA(CdStream &Dest, TLevel Level, TBlockSize BlockSize,
+			TWriteMode Mode=wmNew);
 
 		virtual ssize_t Write(const void *Buffer, ssize_t Count);
 		virtual void Close();
@@ -937,6 +992,8 @@ namespace CoreArray
 
 		void SyncSizeInfo();
 		SIZE64 GetSize() const;
+		/// replace the list of blocks (the stream is not modified on disk)
+		void ResetBlockList(TBlockInfo *List, SIZE64 Size);
 
 		bool ReadOnly() const;
 		int ListCount() const;
@@ -980,6 +1037,8 @@ namespace CoreArray
 		void Clear();
 
     	CdBlockStream *NewBlockStream();
+		/// create a stream object with a specified ID which is not in use
+		CdBlockStream *NewBlockStream(TdGDSBlockID id);
 		/// remove the stream object associated with ID
     	void DeleteBlockStream(TdGDSBlockID id);
 
@@ -990,6 +1049,16 @@ namespace CoreArray
 
 		int NumOfFragment();
 
+		/// move the chunks at the end into free space and truncate the stream
+		/** return the number of bytes released; free regions which cannot be
+		 *  removed are deallocated in the file system if 'PunchHole' is true
+		**/
+		SIZE64 Compact(bool PunchHole=false);
+
+		/// reload the list of blocks of a stream from the block headers on
+		/// disk, which could be modified by another process
+		void LoadBlockChain(CdBlockStream &Block);
+
 		COREARRAY_INLINE CdStream *Stream() const
 			{ return fStream; }
 		COREARRAY_INLINE CdObjClassMgr *ClassMgr() const
@@ -1000,19 +1069,30 @@ namespace CoreArray
 			{ return fBlockList; }
 		COREARRAY_INLINE const CdBlockStream::TBlockInfo* UnusedBlock() const
         	{ return fUnuse; }
+		/// the total number of bytes written through the block streams
+		COREARRAY_INLINE C_Int64 BytesWritten() const
+			{ return fBytesWritten; }
 
 	protected:
 		CdStream *fStream;
 		SIZE64 fStreamSize;
 		PdBlockStream_BlockInfo fUnuse;
 		vector<CdBlockStream*> fBlockList;
+		/// block ID --> stream object in fBlockList
+		std::map<C_UInt32, CdBlockStream*> fBlockIndex;
 		SIZE64 fCodeStart;
 		CdObjClassMgr *fClassMgr;
 		bool fReadOnly;
+		C_Int64 fBytesWritten;
 
 		void _IncStreamSize(CdBlockStream &Block, const SIZE64 NewSize);
 		void _DecStreamSize(CdBlockStream &Block, const SIZE64 NewSize);
 		PdBlockStream_BlockInfo _NeedBlock(SIZE64 Size, bool Head);
+		void _MoveData(SIZE64 Src, SIZE64 Dst, SIZE64 Count);
+		/// find the stream object with ID, or return NULL
+		CdBlockStream *_FindID(TdGDSBlockID id) const;
+		/// add a new stream object to fBlockList
+		void _AddBlock(CdBlockStream *bs);
 
 	private:
 		TdGDSBlockID vNextID;
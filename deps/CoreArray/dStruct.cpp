@@ -26,6 +26,7 @@
 // If not, see <http://www.gnu.org/licenses/>.
 
 #include "dStruct.h"
+#include "dParallel.h"
 #include <memory>
 #include <algorithm>
 #include <typeinfo>
@@ -864,6 +865,8 @@ void CdAbstractArray::GetInfoSelection(const C_Int32 Start[],
 static const char *VAR_DATA = "DATA";
 static const char *VAR_DCNT = "DCNT";
 static const char *VAR_DIM  = "DIM";
+static const char *VAR_TRANS    = "TRANS";
+static const char *VAR_TRANS_OK = "TRANS_OK";
 
 static const char *ERR_ELM_SIZE      = "%s: Invalid ElmSize (%d).";
 static const char *ERR_INV_DIM_CNT   = "%s: Invalid number of dimensions (%d).";
@@ -874,6 +877,198 @@ static const char *ERR_DIM_INDEX_VAL = "Invalid %d-th dimension size: %d.";
 static const char *ERR_APPEND_SV     = "Invalid 'InSV' in 'CdAllocArray::Append'.";
 static const char *ERR_PACKED_MODE   = "Invalid packed/compression method '%s'.";
 static const char *ERR_SETELMSIZE    = "CdAllocArray::SetElmSize, Invalid parameter.";
+static const char *ERR_TRANS_ARRAY   = "The transposed copy requires a 2-D numeric array.";
+static const char *ERR_TRANS_OBJ     = "Invalid transposed copy of the array.";
+static const char *ERR_SWMR_FREE     = "%s: not allowed in the SWMR mode.";
+
+/// the buffer size used to build the transposed copy
+static const SIZE64 TRANS_BUFFER_SIZE = 64*1024*1024;
+
+/// the size of a numeric element in the memory buffer
+static ssize_t sv_numeric_size(C_SVType sv)
+{
+	switch (sv)
+	{
+		case svInt8:  case svUInt8:
+			return 1;
+		case svInt16: case svUInt16:
+			return 2;
+		case svInt32: case svUInt32: case svFloat32:
+			return 4;
+		case svInt64: case svUInt64: case svFloat64:
+			return 8;
+		default:
+			return 0;
+	}
+}
+
+/// transpose a (n1 x n0) matrix to a (n0 x n1) matrix
+template<typename T> static void trans_copy(T *Out, const T *In,
+	C_Int64 n0, C_Int64 n1)
+{
+	for (C_Int64 i=0; i < n0; i++)
+	{
+		const T *s = In + i;
+		for (C_Int64 j=0; j < n1; j++, s+=n0) *Out++ = *s;
+	}
+}
+
+static void trans_copy(void *Out, const void *In, C_Int64 n0, C_Int64 n1,
+	ssize_t ElmSize)
+{
+	switch (ElmSize)
+	{
+		case 1:
+			trans_copy((C_UInt8*)Out, (const C_UInt8*)In, n0, n1); break;
+		case 2:
+			trans_copy((C_UInt16*)Out, (const C_UInt16*)In, n0, n1); break;
+		case 4:
+			trans_copy((C_UInt32*)Out, (const C_UInt32*)In, n0, n1); break;
+		case 8:
+			trans_copy((C_UInt64*)Out, (const C_UInt64*)In, n0, n1); break;
+	}
+}
+
+/// the size of raw data compressed by a thread at a time when recompressing
+static const ssize_t RECOMPRESS_SEGMENT_SIZE = 8*1024*1024;
+/// the segments in flight per thread, ahead of the writer
+static const int RECOMPRESS_SEGMENT_AHEAD = 2;
+
+/// whether the compressed blocks of a pipe can be concatenated
+static bool pipe_random_access(CdPipeMgrItem *Pipe)
+{
+	const char *s = Pipe->Coder();
+	size_t n = strlen(s);
+	return (n > 3) && (strcmp(s + n - 3, "_ra") == 0);
+}
+
+
+namespace CoreArray
+{
+	/// Compress the segments of raw data in parallel, and write them in order
+	class COREARRAY_DLL_LOCAL CdRecompressWorker
+	{
+	public:
+		CdRecompressWorker(CdAllocator &Src, SIZE64 Size, CdPipeMgrItem *Pipe,
+			CdBufStream &Output): fSrc(Src), fOutput(Output)
+		{
+			fSize = Size;
+			fPipe = Pipe;
+			fNumSeg = (Size + RECOMPRESS_SEGMENT_SIZE - 1) /
+				RECOMPRESS_SEGMENT_SIZE;
+			fNextRead = fNextWrite = 0;
+			fMaxAhead = 1;
+			fResult.resize(fNumSeg, NULL);
+			fLength.resize(fNumSeg, 0);
+			fFailed = false;
+		}
+		~CdRecompressWorker()
+		{
+			for (size_t i=0; i < fResult.size(); i++)
+				if (fResult[i]) fResult[i]->Release();
+		}
+
+		void Run(int NumThread)
+		{
+			Parallel::CParallelBase P(NumThread);
+			fMaxAhead = RECOMPRESS_SEGMENT_AHEAD *
+				(P.nThread() > 0 ? P.nThread() : 1);
+			P.RunThreads(&CdRecompressWorker::Proc, this);
+			if (fFailed)
+				throw ErrArray(fErrMsg);
+		}
+
+	private:
+		CdAllocator &fSrc;
+		CdBufStream &fOutput;
+		SIZE64 fSize;
+		CdPipeMgrItem *fPipe;
+		C_Int64 fNumSeg, fNextRead, fNextWrite;
+		/// the maximum number of segments read but not written yet
+		C_Int64 fMaxAhead;
+		vector<CdMemoryStream*> fResult;
+		vector<SIZE64> fLength;
+		/// reading and writing share the file handle of the GDS file
+		CdThreadMutex fMutex;
+		/// signaled when the writer moves on or fails
+		CdThreadCondition fWritten;
+		bool fFailed;
+		string fErrMsg;
+
+		void Proc(CdThread *Thread, int Index)
+		{
+			vector<C_UInt8> Buffer;
+			CdPipeMgrItem *Pipe = NULL;
+			CdMemoryStream *Mem = NULL;
+			try {
+				Pipe = fPipe->New();
+				while (true)
+				{
+					C_Int64 i;
+					ssize_t n;
+					// read a segment of raw data
+					{
+						TdAutoMutex _m(&fMutex);
+						// wait if too far ahead of the writer
+						while (!fFailed && (fNextRead < fNumSeg) &&
+								(fNextRead - fNextWrite >= fMaxAhead))
+							fWritten.Wait(fMutex);
+						if (fFailed || (fNextRead >= fNumSeg)) break;
+						i = fNextRead ++;
+						SIZE64 Pos = i * RECOMPRESS_SEGMENT_SIZE;
+						n = (fSize - Pos < RECOMPRESS_SEGMENT_SIZE) ?
+							(fSize - Pos) : RECOMPRESS_SEGMENT_SIZE;
+						Buffer.resize(n);
+						fSrc.SetPosition(Pos);
+						fSrc.ReadData(&Buffer[0], n);
+					}
+					// compress it to a standalone stream
+					Mem = new CdMemoryStream;
+					Mem->AddRef();
+					{
+						TdAutoRef<CdBufStream> Buf(new CdBufStream(Mem));
+						Pipe->PushWritePipe(*Buf);
+						Buf->WriteData(&Buffer[0], n);
+						Buf->FlushWrite();
+						Pipe->ClosePipe(*Buf);
+					}
+					// write all segments ready in order
+					{
+						TdAutoMutex _m(&fMutex);
+						fResult[i] = Mem; fLength[i] = n;
+						Mem = NULL;
+						C_Int64 Start = fNextWrite;
+						while ((fNextWrite < fNumSeg) && fResult[fNextWrite])
+						{
+							_Write(fResult[fNextWrite], fLength[fNextWrite]);
+							fResult[fNextWrite]->Release();
+							fResult[fNextWrite] = NULL;
+							fNextWrite ++;
+						}
+						if (fNextWrite > Start) fWritten.Broadcast();
+					}
+				}
+			}
+			catch (exception &E) {
+				TdAutoMutex _m(&fMutex);
+				if (!fFailed) fErrMsg = E.what();
+				fFailed = true;
+				fWritten.Broadcast();
+			}
+			if (Mem) Mem->Release();
+			if (Pipe) delete Pipe;
+		}
+
+		/// copy the compressed blocks of a segment
+		void _Write(CdMemoryStream *Mem, SIZE64 Len)
+		{
+			Mem->SetPosition(0);
+			TdAutoRef<CdBufStream> Buf(new CdBufStream(Mem));
+			fPipe->PushReadPipe(*Buf);
+			fOutput.CopyFrom(*Buf->Stream(), 0, Len);
+		}
+	};
+}
 
 
 CdAllocArray::CdAllocArray(ssize_t vElmSize): CdAbstractArray()
@@ -889,12 +1084,21 @@ CdAllocArray::CdAllocArray(ssize_t vElmSize): CdAbstractArray()
 	vAllocStream = NULL;
 	vAlloc_Ptr = vCnt_Ptr = 0;
 	fNeedUpdate = false;
+	fBufSize = STREAM_BUFFER_LARGE_SIZE;
+	fTransposed = NULL;
+	fTransEnabled = fTransStale = false;
+	vTransID = 0;
 }
 
 CdAllocArray::~CdAllocArray()
 {
-	CloseWriter();
+	_CloseWriter();
 	if (fGDSStream) Synchronize();
+	if (fTransposed)
+	{
+		fTransposed->Release();
+		fTransposed = NULL;
+	}
 }
 
 bool CdAllocArray::Empty()
@@ -958,7 +1162,9 @@ void CdAllocArray::ResetDim(const C_Int32 DimLen[], int DCnt)
 	// set fDimension
 	_ResetDim(DimLen, DCnt);
 
+	_TransChanged();
 	fChanged = true;
+	_SetDirty();
 	if (fGDSStream) SaveToBlockStream();
 }
 
@@ -982,6 +1188,7 @@ void CdAllocArray::SetDLen(int I, C_Int32 Value)
 	if (pDim.DimLen != Value)
 	{
 		_CheckWritable();
+		_TransChanged();
 
 		C_Int64 S = pDim.DimElmCnt * pDim.DimLen;
 		if (fTotalCount > S)
@@ -1038,6 +1245,7 @@ void CdAllocArray::SetDLen(int I, C_Int32 Value)
 		// Notify(mcDimChanged);
 
 		fChanged = true;
+		_SetDirty();
 		if (fGDSStream) SaveToBlockStream();
 	}
 }
@@ -1108,6 +1316,11 @@ void CdAllocArray::Clear()
 
 void CdAllocArray::Synchronize()
 {
+	if (fTransposed)
+	{
+		fTransposed->fFolder = fFolder;
+		fTransposed->Synchronize();
+	}
 	CdAbstractArray::Synchronize();
 
 	if (fGDSStream && (!fGDSStream->ReadOnly()) && fNeedUpdate)
@@ -1119,6 +1332,15 @@ void CdAllocArray::Synchronize()
 }
 
 void CdAllocArray::CloseWriter()
+{
+	_CloseWriter();
+	// the transposed copy is kept stale in the SWMR mode
+	if (fTransEnabled && fGDSStream && !fGDSStream->ReadOnly() &&
+			!(GDSFile() && GDSFile()->SWMRWriter()))
+		UpdateTransposed();
+}
+
+void CdAllocArray::_CloseWriter()
 {
 	if (fAllocator.BufStream())
 	{
@@ -1130,6 +1352,7 @@ void CdAllocArray::CloseWriter()
 			{
             	fPipeInfo->ClosePipe(*fAllocator.BufStream());
 				fNeedUpdate = true;
+				_SetDirty();
 				UpdateInfo(NULL);
 
 				vAllocStream->AddRef();
@@ -1214,12 +1437,85 @@ void CdAllocArray::SetPackedMode(const char *Mode)
 	}
 }
 
+void CdAllocArray::Recompress(const char *Mode, int NumThread)
+{
+	_CheckWritable();
+	// the old stream may be still referred by the snapshots of readers
+	if (GDSFile() && GDSFile()->SWMRWriter())
+		throw ErrArray(ERR_SWMR_FREE, "Recompress");
+
+	if ((fTotalCount<=0) || (vAllocStream==NULL) || (fGDSStream==NULL))
+	{
+		SetPackedMode(Mode);
+		return;
+	}
+	if (fPipeInfo ? fPipeInfo->Equal(Mode) : (strcmp(Mode, "")==0))
+		return;
+
+	_CloseWriter();
+	Synchronize();
+
+	CdPipeMgrItem *NewPipe = dStreamPipeMgr.Match(*this, Mode);
+	if ((NewPipe==NULL) && (strcmp(Mode, "")!=0))
+		throw ErrArray(ERR_PACKED_MODE, Mode);
+
+	// write to a new block stream, the old one is kept until success
+	CdBlockCollection &Collection = fGDSStream->Collection();
+	CdBlockStream *NewStream = Collection.NewBlockStream();
+	try {
+		TdAutoRef<CdBufStream> Output(new CdBufStream(NewStream));
+		if (NewPipe)
+			NewPipe->PushWritePipe(*Output);
+
+		SIZE64 Size = AllocSize(fTotalCount);
+		if (NewPipe && (NumThread > 1) && pipe_random_access(NewPipe) &&
+			(Size > RECOMPRESS_SEGMENT_SIZE))
+		{
+			CdRecompressWorker Worker(fAllocator, Size, NewPipe, *Output);
+			Worker.Run(NumThread);
+		} else
+			fAllocator.CopyTo(*Output, 0, Size);
+
+		Output.get()->FlushWrite();
+		if (NewPipe)
+		{
+			NewPipe->ClosePipe(*Output);
+			NewPipe->GetStreamInfo(Output.get());
+		}
+	}
+	catch (...) {
+		if (NewPipe) delete NewPipe;
+		Collection.DeleteBlockStream(NewStream->ID());
+		throw;
+	}
+
+	// swap the streams
+	TdGDSBlockID OldID = vAllocStream->ID();
+	if (fPipeInfo) delete fPipeInfo;
+	fPipeInfo = NewPipe;
+	vAllocStream = NewStream;
+	vAllocID = NewStream->ID();
+	vAllocStream->SetPosition(0);
+	if (fPipeInfo)
+	{
+		fAllocator.Initialize(*vAllocStream, true, false);
+		fPipeInfo->PushReadPipe(*fAllocator.BufStream());
+	} else
+		fAllocator.Initialize(*vAllocStream, true, true);
+
+	// the header refers to the new stream after saving
+	SaveToBlockStream();
+	_SetDirty();
+	Collection.DeleteBlockStream(OldID);
+}
+
 const void *CdAllocArray::Append(const void *Buffer, ssize_t Cnt, C_SVType InSV)
 {
 	if (Cnt <= 0) return Buffer;
 	if (!COREARRAY_SV_VALID(InSV)) throw ErrArray(ERR_APPEND_SV);
 
 	// writing
+	_TransChanged();
 	_SetLargeBuffer();
 	fAllocator.SetPosition(fTotalCount*fElmSize);
 
@@ -1235,6 +1531,7 @@ const void *CdAllocArray::Append(const void *Buffer, ssize_t Cnt, C_SVType InSV)
 		R.DimLen = fTotalCount / R.DimElmCnt;
 		_SetFlushEvent();
 		fNeedUpdate = true;
+		_SetDirty();
 	}
 	return Buffer;
 }
@@ -1245,8 +1542,10 @@ void CdAllocArray::AppendIter(CdIterator &I, C_Int64 Count)
 	{
 		if ((typeid(*this) == typeid(*I.Handler)) && this->IsPrimitive())
 		{
+			_ResumeWriter();
 			if (fAllocator.BufStream())
 			{
+				_TransChanged();
 				CdAllocArray *Src = (CdAllocArray *)I.Handler;
 				Src->fAllocator.BufStream()->FlushWrite();
 				fAllocator.BufStream()->CopyFrom(
@@ -1260,6 +1559,7 @@ void CdAllocArray::AppendIter(CdIterator &I, C_Int64 Count)
 				{
 					R.DimLen = fTotalCount / R.DimElmCnt;
 					fNeedUpdate = true;
+					_SetDirty();
 				}
 
 				return;
@@ -1269,6 +1569,16 @@ void CdAllocArray::AppendIter(CdIterator &I, C_Int64 Count)
 	CdAbstractArray::AppendIter(I, Count);
 }
 
+void CdAllocArray::SetBufSize(ssize_t Size)
+{
+	if (Size <= 0)
+		Size = STREAM_BUFFER_LARGE_SIZE;
+	else if (Size < STREAM_BUFFER_SMALL_SIZE)
+		Size = STREAM_BUFFER_SMALL_SIZE;
+	// the same alignment as CdBufStream::SetBufSize
+	fBufSize = (Size >> BufStreamAlign) << BufStreamAlign;
+}
+
 void CdAllocArray::Caching()
 {
 	if (vAllocStream)
@@ -1331,12 +1641,221 @@ void CdAllocArray::GetOwnBlockStream(vector<const CdBlockStream*> &Out) const
 {
 	Out.clear();
 	if (vAllocStream) Out.push_back(vAllocStream);
+	if (fTransposed)
+	{
+		vector<const CdBlockStream*> L;
+		fTransposed->GetOwnBlockStream(L);
+		Out.insert(Out.end(), L.begin(), L.end());
+		if (fTransposed->fGDSStream) Out.push_back(fTransposed->fGDSStream);
+	}
 }
 
 void CdAllocArray::GetOwnBlockStream(vector<CdStream*> &Out)
 {
 	Out.clear();
 	if (vAllocStream) Out.push_back(vAllocStream);
+	if (fTransposed)
+	{
+		vector<CdStream*> L;
+		fTransposed->GetOwnBlockStream(L);
+		Out.insert(Out.end(), L.begin(), L.end());
+		if (fTransposed->fGDSStream) Out.push_back(fTransposed->fGDSStream);
+	}
+}
+
+void CdAllocArray::SetTransposed(bool Enable)
+{
+	if (Enable == fTransEnabled) return;
+	_CheckWritable();
+	if (Enable)
+	{
+		if ((DimCnt() != 2) || !COREARRAY_SV_NUMERIC(SVType()))
+			throw ErrArray(ERR_TRANS_ARRAY);
+		fTransEnabled = fTransStale = true;
+	} else {
+		if (fTransposed && GDSFile() && GDSFile()->SWMRWriter())
+			throw ErrArray(ERR_SWMR_FREE, "SetTransposed");
+		_FreeTransposed();
+		fTransEnabled = fTransStale = false;
+	}
+	fChanged = true;
+	_SetDirty();
+	if (fGDSStream) SaveToBlockStream();
+}
+
+void CdAllocArray::UpdateTransposed()
+{
+	if (!fTransEnabled || !fGDSStream) return;
+	if (Transposed()) return;
+	_CheckWritable();
+	if (DimCnt() != 2)
+		throw ErrArray(ERR_TRANS_ARRAY);
+	// the old copy may be still referred by the snapshots of readers
+	if (GDSFile() && GDSFile()->SWMRWriter())
+		throw ErrArray(ERR_SWMR_FREE, "UpdateTransposed");
+
+	// flush data
+	_CloseWriter();
+	_FreeTransposed();
+
+	// create a new object of the same class and the same compression
+	CdAllocArray *T = dynamic_cast<CdAllocArray*>(NewObject());
+	if (!T) throw ErrArray(ERR_TRANS_OBJ);
+	T->fFolder = fFolder;
+	T->fGDSStream = fGDSStream->Collection().NewBlockStream();
+	T->fGDSStream->AddRef();
+	T->AddRef();
+	fTransposed = T;
+	vTransID = T->fGDSStream->ID();
+
+	const C_Int32 D0 = GetDLen(0), D1 = GetDLen(1);
+	C_Int32 DLen[2] = { 0, D0 };
+	T->ResetDim(DLen, 2);
+
+	// the source is decoded only once: the panels of rows are transposed
+	// to a temporary stream, and the columns are gathered from the panels
+	const C_SVType SV = SVType();
+	const ssize_t Size = sv_numeric_size(SV);
+	if ((D0 > 0) && (D1 > 0))
+	{
+		C_Int64 R = TRANS_BUFFER_SIZE / ((C_Int64)D1 * Size);
+		if (R < 1) R = 1;
+		if (R > D0) R = D0;
+		vector<C_UInt8> Buf(R * D1 * Size), TBuf(R * D1 * Size);
+		if (R >= D0)
+		{
+			// all in memory
+			C_Int32 St[2] = { 0, 0 }, Len[2] = { D0, D1 };
+			ReadData(St, Len, &Buf[0], SV);
+			trans_copy(&TBuf[0], &Buf[0], D1, D0, Size);
+			T->Append(&TBuf[0], (C_Int64)D0 * D1, SV);
+		} else {
+			TdAutoRef<CdStream> Tmp(new CdTempStream);
+			for (C_Int64 r=0; r < D0; r += R)
+			{
+				C_Int32 n = (D0 - r < R) ? (D0 - r) : R;
+				C_Int32 St[2] = { (C_Int32)r, 0 }, Len[2] = { n, D1 };
+				ReadData(St, Len, &Buf[0], SV);
+				trans_copy(&TBuf[0], &Buf[0], D1, n, Size);
+				Tmp->SetPosition(r * D1 * Size);
+				Tmp->WriteData(&TBuf[0], (ssize_t)n * D1 * Size);
+			}
+			// a panel stores its columns contiguously
+			C_Int64 W = TRANS_BUFFER_SIZE / ((C_Int64)D0 * Size);
+			if (W < 1) W = 1;
+			if (W > D1) W = D1;
+			vector<C_UInt8> Col(W * D0 * Size);
+			Buf.resize(W * R * Size);
+			for (C_Int64 c=0; c < D1; c += W)
+			{
+				C_Int64 m = (D1 - c < W) ? (D1 - c) : W;
+				for (C_Int64 r=0; r < D0; r += R)
+				{
+					C_Int64 n = (D0 - r < R) ? (D0 - r) : R;
+					Tmp->SetPosition((r * D1 + c * n) * Size);
+					Tmp->ReadData(&Buf[0], (ssize_t)(m * n * Size));
+					for (C_Int64 j=0; j < m; j++)
+					{
+						memcpy(&Col[(j * D0 + r) * Size], &Buf[j * n * Size],
+							n * Size);
+					}
+				}
+				T->Append(&Col[0], (ssize_t)(m * D0), SV);
+			}
+		}
+	}
+	T->CloseWriter();
+	T->Synchronize();
+
+	fTransStale = false;
+	fChanged = true;
+	_SetDirty();
+	SaveToBlockStream();
+}
+
+CdAllocArray *CdAllocArray::Transposed()
+{
+	if (!fTransEnabled || fTransStale || !fTransposed) return NULL;
+	if ((fTransposed->DimCnt() != 2) || (DimCnt() != 2)) return NULL;
+	if (fTransposed->TotalCount() != fTotalCount) return NULL;
+	if ((fTransposed->GetDLen(0) != GetDLen(1)) ||
+			(fTransposed->GetDLen(1) != GetDLen(0)))
+		return NULL;
+	fTransposed->fFolder = fFolder;
+	return fTransposed;
+}
+
+void *CdAllocArray::_ReadTransposed(const C_Int32 *Start,
+	const C_Int32 *Length, const C_BOOL *const Selection[],
+	void *OutBuffer, C_SVType OutSV)
+{
+	const ssize_t Size = sv_numeric_size(OutSV);
+	if (Size <= 0) return NULL;
+	CdAllocArray *T = Transposed();
+	if (!T) return NULL;
+
+	// the spans of selected elements
+	C_Int64 First[2], Last[2], Cnt[2];
+	for (int i=0; i < 2; i++)
+	{
+		const C_BOOL *s = Selection ? Selection[i] : NULL;
+		First[i] = Last[i] = -1; Cnt[i] = 0;
+		for (C_Int32 k=0; k < Length[i]; k++)
+		{
+			if (!s || s[k])
+			{
+				if (First[i] < 0) First[i] = k;
+				Last[i] = k; Cnt[i] ++;
+			}
+			if (!s) { Last[i] = Length[i] - 1; Cnt[i] = Length[i]; break; }
+		}
+		if (Cnt[i] <= 0) return NULL;
+	}
+
+	// the number of elements to be decoded in each orientation
+	const C_Int64 D0 = GetDLen(0), D1 = GetDLen(1);
+	const C_Int64 L0 = Last[0] - First[0] + 1, L1 = Last[1] - First[1] + 1;
+	const C_Int64 Span  = (L0 - 1) * D1 + L1;
+	const C_Int64 SpanT = (L1 - 1) * D0 + L0;
+	if (SpanT >= Span) return NULL;
+
+	C_Int32 St[2] = { Start[1], Start[0] }, Len[2] = { Length[1], Length[0] };
+	vector<C_UInt8> Buf(Cnt[0] * Cnt[1] * Size);
+	if (Selection)
+	{
+		const C_BOOL *Sel[2] = { Selection[1], Selection[0] };
+		T->ReadDataEx(St, Len, Sel, &Buf[0], OutSV);
+	} else
+		T->ReadData(St, Len, &Buf[0], OutSV);
+	trans_copy(OutBuffer, &Buf[0], Cnt[0], Cnt[1], Size);
+	return (C_UInt8*)OutBuffer + Cnt[0] * Cnt[1] * Size;
+}
+
+void CdAllocArray::_FreeTransposed()
+{
+	if (fTransposed)
+	{
+		vector<const CdBlockStream*> L;
+		fTransposed->GetOwnBlockStream(L);
+		vector<TdGDSBlockID> IDs;
+		for (size_t i=0; i < L.size(); i++) IDs.push_back(L[i]->ID());
+		if (fTransposed->fGDSStream) IDs.push_back(fTransposed->fGDSStream->ID());
+		fTransposed->Release();
+		fTransposed = NULL;
+		if (fGDSStream)
+		{
+			for (size_t i=0; i < IDs.size(); i++)
+				fGDSStream->Collection().DeleteBlockStream(IDs[i]);
+		}
+	}
+	vTransID = 0;
+}
+
+void CdAllocArray::_TransInitProc(CdObjClassMgr &Sender, CdObject *Obj,
+	void *Data)
+{
+	if (dynamic_cast<CdAllocArray*>(Obj))
+		static_cast<CdAllocArray*>(Obj)->fGDSStream = (CdBlockStream*)Data;
 }
 
 void CdAllocArray::_CheckRange(const C_Int32 DimI[])
@@ -1427,11 +1946,44 @@ void CdAllocArray::Loading(CdReader &Reader, TdVersion Version)
 		fAllocator.Initialize(*vAllocStream, true, !fGDSStream->ReadOnly());
 		if (fPipeInfo)
 			fPipeInfo->PushReadPipe(*fAllocator.BufStream());
+
+		// the transposed copy
+		if (Reader.HaveProperty(VAR_TRANS))
+		{
+			C_UInt8 OK = 0;
+			Reader[VAR_TRANS] >> vTransID;
+			Reader[VAR_TRANS_OK] >> OK;
+			fTransEnabled = true;
+			fTransStale = (OK == 0);
+			if (vTransID.Get() != 0)
+			{
+				CdBlockStream *IStream = fGDSStream->Collection()[vTransID];
+				CdReader R(IStream, &Reader.Log());
+				CdObjRef *obj = fGDSStream->Collection().ClassMgr()->
+					ToObj(R, _TransInitProc, IStream, false);
+				if (!dynamic_cast<CdAllocArray*>(obj))
+				{
+					if (obj) delete obj;
+					throw ErrArray(ERR_TRANS_OBJ);
+				}
+				fTransposed = static_cast<CdAllocArray*>(obj);
+				IStream->AddRef();
+				fTransposed->AddRef();
+			}
+		}
 	}
 
 	fChanged = fNeedUpdate = false;
 }
 
+void CdAllocArray::Reloading(CdReader &Reader, TdVersion Version)
+{
+	// a compressed stream is not readable until the writer closes it
+	if (!fPipeInfo && !fTransposed)
+		Loading(Reader, Version);
+	CdAbstractArray::Reloading(Reader, Version);
+}
+
 void CdAllocArray::Saving(CdWriter &Writer)
 {
 	CdAbstractArray::Saving(Writer);
@@ -1461,6 +2013,13 @@ void CdAllocArray::Saving(CdWriter &Writer)
 		TdGDSBlockID Entry = vAllocStream->ID();
 		Writer[VAR_DATA] << Entry;
 		vAlloc_Ptr = Writer.PropPosition(VAR_DATA);
+
+		// the transposed copy
+		if (fTransEnabled)
+		{
+			Writer[VAR_TRANS] << vTransID;
+			Writer[VAR_TRANS_OK] << C_UInt8(fTransStale ? 0 : 1);
+		}
 	}
 }
 
@@ -1469,7 +2028,10 @@ void CdAllocArray::GetPipeInfo()
 	if (fAllocator.BufStream())
 	{
 		if (_GetStreamPipeInfo(fAllocator.BufStream(), false))
+		{
 			fNeedUpdate = true;
+			_SetDirty();
+		}
 	}
 }
 
@@ -1556,6 +2118,7 @@ void CdAllocArray::SetElmSize(ssize_t NewSize)
 		}
 
 		fNeedUpdate = true;
+		_SetDirty();
 	}
 }
 
@@ -1574,6 +2137,7 @@ void CdAllocArray::_SetDimAuto(int DimIndex)
 	}
 	fTotalCount = it->DimLen * LCnt;
 	fNeedUpdate = true;
+	_SetDirty();
 }
 
 void CdAllocArray::_SetSmallBuffer()
@@ -1589,15 +2153,74 @@ void CdAllocArray::_SetSmallBuffer()
 
 void CdAllocArray::_SetLargeBuffer()
 {
+	_ResumeWriter();
 	if (fAllocator.BufStream())
 	{
-		if (fAllocator.BufStream()->BufSize() != STREAM_BUFFER_LARGE_SIZE)
+		if (fAllocator.BufStream()->BufSize() != fBufSize)
 		{
-			fAllocator.BufStream()->SetBufSize(STREAM_BUFFER_LARGE_SIZE);
+			fAllocator.BufStream()->SetBufSize(fBufSize);
 		}
 	}
 }
 
+void CdAllocArray::_ResumeWriter()
+{
+	CdBufStream *Buf = fAllocator.BufStream();
+	if (!fPipeInfo || !Buf || !vAllocStream || !fGDSStream) return;
+	if (fGDSStream->ReadOnly() || fPipeInfo->WriteMode(*Buf)) return;
+	CdRA_Read *RA = dynamic_cast<CdRA_Read*>(Buf->Stream());
+	if (!RA) return;
+
+	// the incomplete last byte of a bit array is kept in the remainder,
+	// so the last block is decoded and written again
+	SIZE64 Size = AllocSize(fTotalCount);
+	bool DropLast = ((BitOf() & 0x07) != 0) &&
+		(fTotalCount * BitOf() < Size * 8);
+	vector<C_UInt8> Tail;
+	if (DropLast)
+	{
+		vector<SIZE64> RawSize, CmpSize;
+		RA->GetBlockInfo(RawSize, CmpSize);
+		if (RawSize.empty()) return;
+		Tail.resize(RawSize.back());
+		fAllocator.SetPosition(Size - Tail.size());
+		fAllocator.ReadData(&Tail[0], Tail.size());
+	}
+
+	vAllocStream->AddRef();
+	fAllocator.Free();
+	vAllocStream->SetPosition(0);
+	fAllocator.Initialize(*vAllocStream, false, true);
+	bool OK = false;
+	try {
+		OK = fPipeInfo->PushAppendPipe(*fAllocator.BufStream(), DropLast);
+	}
+	catch (...) {
+		fAllocator.Initialize(*vAllocStream, true, false);
+		fPipeInfo->PushReadPipe(*fAllocator.BufStream());
+		vAllocStream->Release();
+		throw;
+	}
+	if (!OK)
+	{
+		// not supported, keep the reading mode
+		fAllocator.Initialize(*vAllocStream, true, false);
+		fPipeInfo->PushReadPipe(*fAllocator.BufStream());
+		vAllocStream->Release();
+		return;
+	}
+	vAllocStream->Release();
+
+	if (DropLast)
+	{
+		fAllocator.SetPosition(Size - Tail.size());
+		fAllocator.WriteData(&Tail[0], Tail.size() - 1);
+		fPipeInfo->Remainder().Size = 1;
+		fPipeInfo->Remainder().Buf[0] = Tail.back();
+	} else
+		fAllocator.SetPosition(Size);
+}
+
 void CdAllocArray::_SetFlushEvent()
 {
 	fAllocator.BufStream()->OnFlush.Set(this, &CdAllocArray::UpdateInfo);
@@ -1630,10 +2253,15 @@ CdArrayRead::CdArrayRead()
 	_Have_Selection = false;
 	_Call_rData = _Margin_Call_rData = true;
 	_Margin_Buf_Need = false;
+	_Gov_ID = 0;
+	_Gov_Epoch = 0;
 }
 
 CdArrayRead::~CdArrayRead()
-{ }
+{
+	if (_Gov_ID > 0)
+		CdMemGovernor::Global().Unregister(_Gov_ID);
+}
 		
 void CdArrayRead::Init(CdAbstractArray &vObj, int vMargin, C_SVType vSVType,
 	const C_BOOL *const vSelection[], bool buf_if_need)
@@ -1753,54 +2381,15 @@ void CdArrayRead::Init(CdAbstractArray &vObj, int vMargin, C_SVType vSVType,
 			_Margin_Buf_MinorSize *= _DCntValid[i];
 
 		// determine buffer
+		_Margin_Buf_IncCnt = 0;
 		if (buf_if_need)
 		{
 			// need a memory buffer to speed up
-			_Margin_Buf_IncCnt = ARRAY_READ_MEM_BUFFER_SIZE /
-				(fElmSize * fMarginCount);
-
-			if (_Margin_Buf_IncCnt > 1)
-			{
-				if (_Margin_Buf_IncCnt > fCount)
-					_Margin_Buf_IncCnt = fCount;
-				switch (fSVType)
-				{
-				case svStrUTF8:      // UTF-8 string
-					_Margin_Buffer_UTF8.resize(
-						_Margin_Buf_IncCnt * fMarginCount);
-					_Margin_Buffer_Ptr = &_Margin_Buffer_UTF8[0];
-					break;
-				case svStrUTF16:     // UTF-16 string
-					_Margin_Buffer_UTF16.resize(
-						_Margin_Buf_IncCnt * fMarginCount);
-					_Margin_Buffer_Ptr = &_Margin_Buffer_UTF16[0];
-					break;
-				default:
-					_Margin_Buffer.resize(
-						fElmSize * _Margin_Buf_IncCnt * fMarginCount);
-					_Margin_Buffer_Ptr = &_Margin_Buffer[0];
-				}
-			} else {
-				_Margin_Buf_IncCnt = 1;
-				_Margin_Buffer.clear();
-				_Margin_Buffer_UTF8.clear();
-				_Margin_Buffer_UTF16.clear();
-				_Margin_Buffer_Ptr = NULL;
-			}
-		} else {
-			_Margin_Buf_IncCnt = 1;
-			_Margin_Buffer.clear();
-			_Margin_Buffer_UTF8.clear();
-			_Margin_Buffer_UTF16.clear();
-			_Margin_Buffer_Ptr = NULL;
-		}
-	} else {
-		_Margin_Buf_IncCnt = 1;
-		_Margin_Buffer.clear();
-		_Margin_Buffer_UTF8.clear();
-		_Margin_Buffer_UTF16.clear();
-		_Margin_Buffer_Ptr = NULL;
-	}
+			_Govern(ARRAY_READ_MEM_BUFFER_SIZE);
+		} else
+			_Govern_Release();
+	} else
+		_Govern_Release();
 }
 
 void CdArrayRead::AllocBuffer(C_Int64 buffer_size)
@@ -1814,45 +2403,77 @@ void CdArrayRead::AllocBuffer(C_Int64 buffer_size)
 	{
 		if (buffer_size < 0)
 			buffer_size = ARRAY_READ_MEM_BUFFER_SIZE;
+		_Govern(buffer_size);
+	} else
+		_Govern_Release();
+}
 
-		// need a memory buffer to speed up
-		_Margin_Buf_IncCnt = buffer_size / (fElmSize * fMarginCount);
+void CdArrayRead::_Govern(C_Int64 buffer_size)
+{
+	// no need to buffer more than the remaining margins
+	const C_Int64 Unit = fElmSize * fMarginCount;
+	C_Int64 Want = Unit * (fCount - fIndex);
+	if (Want > buffer_size) Want = buffer_size;
+	if ((Unit <= 0) || (Want < 2*Unit))
+	{
+		_Govern_Release();
+		return;
+	}
+	CdMemGovernor &G = CdMemGovernor::Global();
+	if (_Gov_ID > 0)
+		G.SetWant(_Gov_ID, Want);
+	else
+		_Gov_ID = G.Register(Want);
+	_Resize_Buffer();
+}
 
-		if (_Margin_Buf_IncCnt > 1)
+void CdArrayRead::_Govern_Release()
+{
+	if (_Gov_ID > 0)
+	{
+		CdMemGovernor::Global().Unregister(_Gov_ID);
+		_Gov_ID = 0;
+	}
+	_Margin_Buf_IncCnt = 1;
+	vector<C_UInt8>().swap(_Margin_Buffer);
+	vector<UTF8String>().swap(_Margin_Buffer_UTF8);
+	vector<UTF16String>().swap(_Margin_Buffer_UTF16);
+	_Margin_Buffer_Ptr = NULL;
+}
+
+void CdArrayRead::_Resize_Buffer()
+{
+	CdMemGovernor &G = CdMemGovernor::Global();
+	_Gov_Epoch = G.Epoch();
+	const C_Int64 Unit = fElmSize * fMarginCount;
+	C_Int64 Cnt = G.Grant(_Gov_ID, Unit) / Unit;
+	if (Cnt > fCount) Cnt = fCount;
+	if (Cnt == _Margin_Buf_IncCnt) return;
+
+	// the old buffer is released before allocating a new one
+	vector<C_UInt8>().swap(_Margin_Buffer);
+	vector<UTF8String>().swap(_Margin_Buffer_UTF8);
+	vector<UTF16String>().swap(_Margin_Buffer_UTF16);
+	_Margin_Buffer_Ptr = NULL;
+	if (Cnt > 1)
+	{
+		_Margin_Buf_IncCnt = Cnt;
+		switch (fSVType)
 		{
-			if (_Margin_Buf_IncCnt > fCount)
-				_Margin_Buf_IncCnt = fCount;
-			switch (fSVType)
-			{
-				case svStrUTF8:      // UTF-8 string
-					_Margin_Buffer_UTF8.resize(
-						_Margin_Buf_IncCnt * fMarginCount);
-					_Margin_Buffer_Ptr = &_Margin_Buffer_UTF8[0];
-					break;
-				case svStrUTF16:     // UTF-16 string
-					_Margin_Buffer_UTF16.resize(
-						_Margin_Buf_IncCnt * fMarginCount);
-					_Margin_Buffer_Ptr = &_Margin_Buffer_UTF16[0];
-					break;
-				default:
-					_Margin_Buffer.resize(
-						fElmSize * _Margin_Buf_IncCnt * fMarginCount);
-					_Margin_Buffer_Ptr = &_Margin_Buffer[0];
-			}
-		} else {
-			_Margin_Buf_IncCnt = 1;
-			_Margin_Buffer.clear();
-			_Margin_Buffer_UTF8.clear();
-			_Margin_Buffer_UTF16.clear();
-			_Margin_Buffer_Ptr = NULL;
+			case svStrUTF8:      // UTF-8 string
+				_Margin_Buffer_UTF8.resize(Cnt * fMarginCount);
+				_Margin_Buffer_Ptr = &_Margin_Buffer_UTF8[0];
+				break;
+			case svStrUTF16:     // UTF-16 string
+				_Margin_Buffer_UTF16.resize(Cnt * fMarginCount);
+				_Margin_Buffer_Ptr = &_Margin_Buffer_UTF16[0];
+				break;
+			default:
+				_Margin_Buffer.resize(fElmSize * Cnt * fMarginCount);
+				_Margin_Buffer_Ptr = &_Margin_Buffer[0];
 		}
-	} else {
+	} else
 		_Margin_Buf_IncCnt = 1;
-		_Margin_Buffer.clear();
-		_Margin_Buffer_UTF8.clear();
-		_Margin_Buffer_UTF16.clear();
-		_Margin_Buffer_Ptr = NULL;
-	}
 }
 
 void CdArrayRead::Read(void *Buffer)
@@ -1892,6 +2513,12 @@ void CdArrayRead::Read(void *Buffer)
 			// determine buffer size
 			if (_Margin_Buf_Cnt <= 0)
 			{
+				// the quota has changed since the buffer was sized
+				if ((_Gov_ID > 0) &&
+					(CdMemGovernor::Global().Epoch() != _Gov_Epoch))
+				{
+					_Resize_Buffer();
+				}
 				// determine '_Margin_Buf_Cnt' first
 				if (_Margin_Buf_IncCnt > 1)
 				{
@@ -2014,6 +2641,9 @@ void CdArrayRead::Read(void *Buffer)
 			// next ``Index'', ``MarginIndex''
 			fIndex ++;
 			fMarginIndex ++;
+			// leave the quota to other readers
+			if ((fIndex >= fCount) && (_Gov_ID > 0))
+				_Govern_Release();
 			if (_Have_Selection)
 			{
 				// skip unselected layout
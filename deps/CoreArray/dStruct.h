@@ -461,6 +461,8 @@ namespace CoreArray
         virtual void CloseWriter();
 
 		virtual void SetPackedMode(const char *Mode);
+		/// recompress into a new stream, in parallel for random-access coders
+		virtual void Recompress(const char *Mode, int NumThread);
 
 		/// append new data
 		virtual const void *Append(const void *Buffer, ssize_t Cnt, C_SVType InSV);
@@ -484,6 +486,20 @@ namespace CoreArray
 		/// the allocator
 		COREARRAY_FORCEINLINE CdAllocator &Allocator() { return fAllocator; }
 
+		/// the buffer size used when appending data
+		COREARRAY_INLINE ssize_t BufSize() const { return fBufSize; }
+		/// set the buffer size used when appending data (<= 0 for default)
+		void SetBufSize(ssize_t Size);
+
+		/// enable or disable a hidden transposed copy of a 2-D array
+		void SetTransposed(bool Enable);
+		/// return true if the transposed copy is enabled
+		COREARRAY_INLINE bool TransposedEnabled() const { return fTransEnabled; }
+		/// rebuild the transposed copy if it is outdated
+		void UpdateTransposed();
+		/// get the transposed copy, or NULL if it is unavailable or outdated
+		CdAllocArray *Transposed();
+
 
 	protected:
 
@@ -506,6 +522,15 @@ namespace CoreArray
 
 		/// update a part of data, not all; fChanged -- update all
 		bool fNeedUpdate;
+		/// the buffer size used when appending data
+		ssize_t fBufSize;
+
+		/// the transposed copy (DimLen[1] x DimLen[0])
+		CdAllocArray *fTransposed;
+		/// whether the transposed copy is maintained
+		bool fTransEnabled;
+		/// whether the transposed copy is outdated
+		bool fTransStale;
 
 		/// get the size in byte corresponding to the count 'Num'
 		virtual SIZE64 AllocSize(C_Int64 Num);
@@ -523,6 +548,7 @@ namespace CoreArray
 
 		virtual void Loading(CdReader &Reader, TdVersion Version);
 		virtual void Saving(CdWriter &Writer);
+		virtual void Reloading(CdReader &Reader, TdVersion Version);
         virtual void GetPipeInfo();
 
 		/// update info if needed
@@ -548,12 +574,30 @@ namespace CoreArray
 		void _SetDimAuto(int DimIndex);
 		void _SetSmallBuffer();
 		void _SetLargeBuffer();
+		/// reopen a closed compressed stream for appending if supported
+		void _ResumeWriter();
 		void _SetFlushEvent();
 
+		/// read via the transposed copy if it touches less data, or return NULL
+		void *_ReadTransposed(const C_Int32 *Start, const C_Int32 *Length,
+			const C_BOOL *const Selection[], void *OutBuffer, C_SVType OutSV);
+		/// mark the transposed copy outdated
+		COREARRAY_INLINE void _TransChanged()
+		{
+			if (fTransEnabled && !fTransStale)
+				{ fTransStale = true; fChanged = true; _SetDirty(); }
+		}
+
 	private:
 		TdGDSBlockID vAllocID;
 		CdBlockStream *vAllocStream;
 		SIZE64 vAlloc_Ptr, vCnt_Ptr;
+		TdGDSBlockID vTransID;
+
+		void _CloseWriter();
+		void _FreeTransposed();
+		static void _TransInitProc(CdObjClassMgr &Sender, CdObject *Obj,
+			void *Data);
 	};
 
 
@@ -637,6 +681,11 @@ namespace CoreArray
 			}
 
 			_CheckRect(Start, Length);
+			if (this->fTransposed || this->fTransEnabled)
+			{
+				void *rv = _ReadTransposed(Start, Length, NULL, OutBuffer, OutSV);
+				if (rv) return rv;
+			}
 			switch (OutSV)
 			{
 				case svInt8:
@@ -706,6 +755,12 @@ namespace CoreArray
 			}
 
 			_CheckRect(Start, Length);
+			if (this->fTransposed || this->fTransEnabled)
+			{
+				void *rv = _ReadTransposed(Start, Length, Selection,
+					OutBuffer, OutSV);
+				if (rv) return rv;
+			}
 			switch (OutSV)
 			{
 				case svInt8:
@@ -771,6 +826,7 @@ namespace CoreArray
 			}
 
 			_CheckRect(Start, Length);
+			_TransChanged();
 			switch (InSV)
 			{
 				case svInt8:
@@ -819,6 +875,7 @@ namespace CoreArray
 		virtual const void *Append(const void *Buffer, ssize_t Cnt, C_SVType InSV)
 		{
 			if (Cnt <= 0) return Buffer;
+			_TransChanged();
 			_SetLargeBuffer();
 			CdIterator I = IterEnd();
 			switch (InSV)
@@ -871,6 +928,7 @@ namespace CoreArray
 				R.DimLen = fTotalCount / R.DimElmCnt;
 				_SetFlushEvent();
 				fNeedUpdate = true;
+				_SetDirty();
 			}
 
 			return Buffer;
@@ -908,18 +966,21 @@ namespace CoreArray
 		/// set an integer
 		virtual void IterSetInteger(CdIterator &I, C_Int64 val)
 		{
+			_TransChanged();
 			ALLOC_FUNC<TYPE, C_Int64>::Write(I, &val, 1);
 		}
 
 		/// set a float number
 		virtual void IterSetFloat(CdIterator &I, double val)
 		{
+			_TransChanged();
 			ALLOC_FUNC<TYPE, double>::Write(I, &val, 1);
 		}
 
 		/// set a string
 		virtual void IterSetString(CdIterator &I, const UTF16String &val)
 		{
+			_TransChanged();
 			ALLOC_FUNC<TYPE, UTF16String>::Write(I, &val, 1);
 		}
 
@@ -997,6 +1058,7 @@ namespace CoreArray
 		virtual const void *IterWData(CdIterator &I, const void *InBuf,
 			ssize_t n, C_SVType InSV)
 		{
+			_TransChanged();
 			switch (InSV)
 			{
 				case svInt8:
@@ -1100,7 +1162,9 @@ namespace CoreArray
 	// Apply functions by margin
 	// =====================================================================
 
-	/// the size of memory buffer for reading dataset marginally, by default 1G
+	/// the maximum size of memory buffer for reading dataset marginally,
+	/// by default 1G; the buffers of all readers are limited by the budget
+	/// of CdMemGovernor::Global()
 	extern C_Int64 ARRAY_READ_MEM_BUFFER_SIZE;
 
 	/// read an array-oriented object margin by margin
@@ -1117,8 +1181,10 @@ namespace CoreArray
 			const C_BOOL *const vSelection[], bool buf_if_need=true);
 
 		/// allocate memory buffer if needed
-		/** \param  buffer_size  the size of memory buffer; if -1,
+		/** \param  buffer_size  the maximum size of memory buffer; if -1,
 		 *                       'buffer_size = ARRAY_READ_MEM_BUFFER_SIZE'
+		 *  The actual size is the quota from the memory governor, and it
+		 *  is adjusted when the quota changes.
 		 */
 		void AllocBuffer(C_Int64 buffer_size);
 
@@ -1189,6 +1255,19 @@ namespace CoreArray
 		C_Int64 _Margin_Buf_MajorCnt;
 		C_Int64 _Margin_Buf_MinorSize;
 		C_Int64 _Margin_Buf_MinorSize2;
+
+		/// the reader ID in the memory governor, 0 for none
+		int _Gov_ID;
+		/// the epoch of the memory governor when the buffer was sized
+		C_Int64 _Gov_Epoch;
+
+	private:
+		/// request a buffer up to 'buffer_size' from the memory governor
+		void _Govern(C_Int64 buffer_size);
+		/// stop requesting a buffer, and release it
+		void _Govern_Release();
+		/// resize the buffer to the current quota
+		void _Resize_Buffer();
 	};
 
 	/// read an array-oriented object margin by margin
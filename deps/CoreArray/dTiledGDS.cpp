@@ -0,0 +1,1230 @@
+// ===========================================================
+//     _/_/_/   _/_/_/  _/_/_/_/    _/_/_/_/  _/_/_/   _/_/_/
+//      _/    _/       _/             _/    _/    _/   _/   _/
+//     _/    _/       _/_/_/_/       _/    _/    _/   _/_/_/
+//    _/    _/       _/             _/    _/    _/   _/
+// _/_/_/   _/_/_/  _/_/_/_/_/     _/     _/_/_/   _/_/
+// ===========================================================
+//
+// dTiledGDS.cpp: Tiled (chunked) array in GDS format
+//
+// Copyright (C) 2020    Xiuwen Zheng
+//
+// This file is part of CoreArray.
+//
+// CoreArray is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License Version 3 as
+// published by the Free Software Foundation.
+//
+// CoreArray is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with CoreArray.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef COREARRAY_COMPILER_OPTIMIZE_FLAG
+#   define COREARRAY_COMPILER_OPTIMIZE_FLAG  3
+#endif
+
+#include "dTiledGDS.h"
+
+
+namespace CoreArray
+{
+	template<typename TClass> static CdObjRef *OnObjCreate()
+	{
+		return new TClass();
+	}
+
+	COREARRAY_DLL_LOCAL void RegisterClass_Tiled()
+	{
+		#define REG_CLASS(T, CLASS, CType, Desp)	\
+			dObjManager().AddClass(TdTraits< T >::StreamName(), \
+				OnObjCreate< CLASS >, CdObjClassMgr::CType, Desp)
+
+		// integers
+		REG_CLASS(TTileInt8,  CdTiledInt8,  ctArray, "tiled signed integer of 8 bits");
+		REG_CLASS(TTileInt16, CdTiledInt16, ctArray, "tiled signed integer of 16 bits");
+		REG_CLASS(TTileInt32, CdTiledInt32, ctArray, "tiled signed integer of 32 bits");
+		REG_CLASS(TTileInt64, CdTiledInt64, ctArray, "tiled signed integer of 64 bits");
+		REG_CLASS(TTileUInt8,  CdTiledUInt8,  ctArray, "tiled unsigned integer of 8 bits");
+		REG_CLASS(TTileUInt16, CdTiledUInt16, ctArray, "tiled unsigned integer of 16 bits");
+		REG_CLASS(TTileUInt32, CdTiledUInt32, ctArray, "tiled unsigned integer of 32 bits");
+		REG_CLASS(TTileUInt64, CdTiledUInt64, ctArray, "tiled unsigned integer of 64 bits");
+
+		// real numbers
+		REG_CLASS(TTileReal32, CdTiledReal32, ctArray, "tiled real number (32 bits)");
+		REG_CLASS(TTileReal64, CdTiledReal64, ctArray, "tiled real number (64 bits)");
+
+		#undef REG_CLASS
+	}
+}
+
+
+// ===========================================================
+
+using namespace CoreArray;
+
+static const char *VAR_DCNT  = "DCNT";
+static const char *VAR_DIM   = "DIM";
+static const char *VAR_TILE  = "TILE";
+static const char *VAR_COUNT = "COUNT";
+static const char *VAR_DATA  = "DATA";
+static const char *VAR_INDEX = "INDEX";
+
+static const char *ERR_TILE_DIM_CNT = "Invalid number of dimensions (%d) in a tiled array.";
+static const char *ERR_TILE_DIM_LEN = "Invalid length (%d) of dimension %d in a tiled array.";
+static const char *ERR_TILE_LEN = "Invalid tile length (%d) of dimension %d.";
+static const char *ERR_TILE_TOO_LARGE = "The tile is too large (%lld bytes).";
+static const char *ERR_TILE_NOT_EMPTY = "%s is not allowed when the tiled array is not empty.";
+static const char *ERR_TILE_NO_STREAM = "The tiled array should be associated with a GDS file.";
+static const char *ERR_TILE_SIZE = "Invalid tile size (%lld bytes) in the tile index.";
+static const char *ERR_TILE_SV = "Invalid SVType for a tiled array.";
+static const char *ERR_TILE_APPEND = "Invalid dimension for appending data to a tiled array.";
+static const char *ERR_TILE_POS = "Invalid position (%lld) in a tiled array.";
+static const char *ERR_PACKED_MODE = "Invalid packed/compression method '%s'.";
+
+/// the size of an entry in the tile index
+static const ssize_t TILE_ENTRY_SIZE = GDS_POS_SIZE + sizeof(C_UInt32);
+
+
+/// the size of an element in the memory buffer
+static ssize_t sv_size(C_SVType sv)
+{
+	switch (sv)
+	{
+		case svInt8:  case svUInt8:
+			return 1;
+		case svInt16: case svUInt16:
+			return 2;
+		case svInt32: case svUInt32: case svFloat32:
+			return 4;
+		case svInt64: case svUInt64: case svFloat64:
+			return 8;
+		case svStrUTF8:
+			return sizeof(UTF8String);
+		case svStrUTF16:
+			return sizeof(UTF16String);
+		default:
+			throw ErrArray(ERR_TILE_SV);
+	}
+}
+
+/// copy a box between two row-major buffers (strides in elements)
+static void box_copy(int DCnt, const C_Int64 Len[], C_UInt8 *Dst,
+	const C_Int64 DStride[], const C_UInt8 *Src, const C_Int64 SStride[],
+	ssize_t ElmSize)
+{
+	for (int i=0; i < DCnt; i++)
+		if (Len[i] <= 0) return;
+
+	const int L = DCnt - 1;
+	const size_t Size = Len[L] * ElmSize;
+	C_Int64 Idx[CdAbstractArray::MAX_ARRAY_DIM];
+	memset(Idx, 0, sizeof(C_Int64)*DCnt);
+	while (true)
+	{
+		C_Int64 d = 0, s = 0;
+		for (int i=0; i < L; i++)
+		{
+			d += Idx[i] * DStride[i];
+			s += Idx[i] * SStride[i];
+		}
+		memcpy(Dst + d*ElmSize, Src + s*ElmSize, Size);
+		// next
+		int i = L - 1;
+		for (; i >= 0; i--)
+		{
+			if (++Idx[i] < Len[i]) break;
+			Idx[i] = 0;
+		}
+		if (i < 0) break;
+	}
+}
+
+
+// =====================================================================
+// CdTiledArrayBase
+
+CdTiledArrayBase::CdTiledArrayBase(ssize_t vElmSize): CdAbstractArray(),
+	fElmSize(vElmSize)
+{
+	fDimLen.push_back(0);
+	fTileLen.push_back(TILE_DEFAULT_ELM_COUNT);
+	fTileFixed = false;
+	fTotalCount = 0;
+	fDataStream = fIndexStream = NULL;
+	fSlabRow = 0;
+	fSlabLoaded = fSlabDirty = false;
+	fCacheStamp = 0;
+	_InitGrid();
+}
+
+CdTiledArrayBase::~CdTiledArrayBase()
+{
+	if (fGDSStream) CloseWriter();
+}
+
+void CdTiledArrayBase::Assign(CdGDSObj &Source, bool Full)
+{
+	CdTiledArrayBase *src = dynamic_cast<CdTiledArrayBase*>(&Source);
+	if (src && Empty())
+	{
+		// keep the tile shape of source
+		TArrayDim Dim;
+		src->GetDim(Dim); Dim[0] = 0;
+		ResetDim(Dim, src->DimCnt());
+		SetTileDim(&src->fTileLen[0], src->fTileLen.size());
+	}
+	CdAbstractArray::Assign(Source, Full);
+}
+
+void CdTiledArrayBase::Clear()
+{
+	fTotalCount = 0;
+	fDimLen[0] = 0;
+	_ResetStorage();
+	_InitGrid();
+	fChanged = true;
+	_SetDirty();
+}
+
+bool CdTiledArrayBase::Empty()
+{
+	return (fTotalCount <= 0);
+}
+
+C_Int64 CdTiledArrayBase::TotalCount()
+{
+	return fTotalCount;
+}
+
+void CdTiledArrayBase::Synchronize()
+{
+	if (fDataStream) _FlushSlab();
+	CdAbstractArray::Synchronize();
+}
+
+void CdTiledArrayBase::CloseWriter()
+{
+	Synchronize();
+}
+
+CdIterator CdTiledArrayBase::IterBegin()
+{
+	CdIterator I;
+	I.Allocator = NULL;
+	I.Ptr = 0;
+	I.Handler = this;
+	return I;
+}
+
+CdIterator CdTiledArrayBase::IterEnd()
+{
+	CdIterator I;
+	I.Allocator = NULL;
+	I.Ptr = fTotalCount;
+	I.Handler = this;
+	return I;
+}
+
+int CdTiledArrayBase::DimCnt() const
+{
+	return fDimLen.size();
+}
+
+void CdTiledArrayBase::GetDim(C_Int32 DimLen[]) const
+{
+	for (size_t i=0; i < fDimLen.size(); i++)
+		DimLen[i] = fDimLen[i];
+}
+
+void CdTiledArrayBase::ResetDim(const C_Int32 DimLen[], int DCnt)
+{
+	if ((DCnt <= 0) || (DCnt > (int)MAX_ARRAY_DIM))
+		throw ErrArray(ERR_TILE_DIM_CNT, DCnt);
+	for (int i=0; i < DCnt; i++)
+	{
+		if (DimLen[i] < 0)
+			throw ErrArray(ERR_TILE_DIM_LEN, DimLen[i], i);
+	}
+
+	bool SameRow = (DCnt == (int)fDimLen.size());
+	for (int i=1; SameRow && (i < DCnt); i++)
+		SameRow = (DimLen[i] == fDimLen[i]);
+	C_Int64 Cnt = DimLen[0];
+	for (int i=1; i < DCnt; i++) Cnt *= DimLen[i];
+
+	if (fTotalCount > 0)
+	{
+		// only allow extending the first dimension, filled with zero
+		if (!SameRow || (Cnt < fTotalCount))
+			throw ErrArray(ERR_TILE_NOT_EMPTY, "ResetDim()");
+		if (Cnt == fTotalCount) return;
+		if (fDataStream) _FlushSlab();
+		fSlabLoaded = fSlabDirty = false;
+		fSlab.clear();
+	} else {
+		if (!SameRow || !fTileFixed)
+		{
+			// the default tile shape
+			fTileLen.resize(DCnt);
+			C_Int64 n = 1, r = fElmSize;
+			for (int i=1; i < DCnt; i++)
+			{
+				fTileLen[i] = (DimLen[i] < TILE_DEFAULT_DIM_LEN) ?
+					((DimLen[i] > 0) ? DimLen[i] : 1) : TILE_DEFAULT_DIM_LEN;
+				n *= fTileLen[i];
+				if (DimLen[i] > 0) r *= DimLen[i];
+			}
+			// limit the memory usage of pending data
+			C_Int64 t0 = TILE_DEFAULT_ELM_COUNT / n;
+			if (t0 > TILE_MAX_SLAB_SIZE / r) t0 = TILE_MAX_SLAB_SIZE / r;
+			fTileLen[0] = (t0 > 0) ? t0 : 1;
+			fTileFixed = false;
+		}
+		_ResetStorage();
+	}
+
+	fDimLen.assign(DimLen, DimLen + DCnt);
+	fTotalCount = Cnt;
+	_InitGrid();
+	fChanged = true;
+	_SetDirty();
+}
+
+C_Int32 CdTiledArrayBase::GetDLen(int I) const
+{
+	if ((I < 0) || (I >= (int)fDimLen.size()))
+		throw ErrArray(ERR_TILE_DIM_CNT, I);
+	return fDimLen[I];
+}
+
+void CdTiledArrayBase::SetDLen(int I, C_Int32 Value)
+{
+	if ((I < 0) || (I >= (int)fDimLen.size()))
+		throw ErrArray(ERR_TILE_DIM_CNT, I);
+	if (fDimLen[I] != Value)
+	{
+		TArrayDim Dim;
+		GetDim(Dim);
+		Dim[I] = Value;
+		ResetDim(Dim, fDimLen.size());
+	}
+}
+
+C_Int64 CdTiledArrayBase::TotalArrayCount()
+{
+	C_Int64 rv = 1;
+	for (size_t i=0; i < fDimLen.size(); i++)
+		rv *= fDimLen[i];
+	return rv;
+}
+
+CdIterator CdTiledArrayBase::Iterator(const C_Int32 DimIndex[])
+{
+	C_Int64 p = 0;
+	for (size_t i=0; i < fDimLen.size(); i++)
+	{
+		if ((DimIndex[i] < 0) || (DimIndex[i] > fDimLen[i]))
+			throw ErrArray(ERR_TILE_POS, (C_Int64)DimIndex[i]);
+		p = p * fDimLen[i] + DimIndex[i];
+	}
+	CdIterator I = IterBegin();
+	I.Ptr = p;
+	return I;
+}
+
+void CdTiledArrayBase::GetTileDim(C_Int32 TileLen[]) const
+{
+	for (size_t i=0; i < fTileLen.size(); i++)
+		TileLen[i] = fTileLen[i];
+}
+
+void CdTiledArrayBase::SetTileDim(const C_Int32 TileLen[], int DCnt)
+{
+	if (fTotalCount > 0)
+		throw ErrArray(ERR_TILE_NOT_EMPTY, "SetTileDim()");
+	if (DCnt != (int)fDimLen.size())
+		throw ErrArray(ERR_TILE_DIM_CNT, DCnt);
+	C_Int64 Size = fElmSize;
+	for (int i=0; i < DCnt; i++)
+	{
+		if (TileLen[i] <= 0)
+			throw ErrArray(ERR_TILE_LEN, TileLen[i], i);
+		Size *= TileLen[i];
+		if (Size > 0x7FFFFFFF)
+			throw ErrArray(ERR_TILE_TOO_LARGE, Size);
+	}
+	fTileLen.assign(TileLen, TileLen + DCnt);
+	fTileFixed = true;
+	_ResetStorage();
+	_InitGrid();
+	fChanged = true;
+	_SetDirty();
+}
+
+void *CdTiledArrayBase::ReadData(const C_Int32 *Start, const C_Int32 *Length,
+	void *OutBuffer, C_SVType OutSV)
+{
+	return ReadDataEx(Start, Length, NULL, OutBuffer, OutSV);
+}
+
+void *CdTiledArrayBase::ReadDataEx(const C_Int32 *Start, const C_Int32 *Length,
+	const C_BOOL *const Selection[], void *OutBuffer, C_SVType OutSV)
+{
+	const int D = fDimLen.size(), L = D - 1;
+	TArrayDim DStart, DLength;
+	if (!Start)
+	{
+		memset(DStart, 0, sizeof(C_Int32)*D);
+		Start = DStart;
+	}
+	if (!Length)
+	{
+		GetDim(DLength);
+		Length = DLength;
+	}
+	_CheckRect(Start, Length);
+	const ssize_t OutSize = sv_size(OutSV);
+
+	// the output offsets of each dimension, -1 for unselected
+	vector< vector<C_Int64> > OutPos(D);
+	C_Int64 OutStride = 1;
+	for (int i=L; i >= 0; i--)
+	{
+		vector<C_Int64> &M = OutPos[i];
+		const C_BOOL *s = Selection ? Selection[i] : NULL;
+		M.resize(Length[i]);
+		C_Int64 n = 0;
+		for (C_Int32 k=0; k < Length[i]; k++)
+			M[k] = (!s || s[k]) ? (n++) * OutStride : -1;
+		if (n <= 0) return OutBuffer;
+		OutStride *= n;
+	}
+
+	C_Int64 TileStride[MAX_ARRAY_DIM];
+	TileStride[L] = 1;
+	for (int i=L-1; i >= 0; i--)
+		TileStride[i] = TileStride[i+1] * fTileLen[i+1];
+
+	// the range of tiles
+	C_Int32 G0[MAX_ARRAY_DIM], G1[MAX_ARRAY_DIM], G[MAX_ARRAY_DIM];
+	C_Int32 A[MAX_ARRAY_DIM], B[MAX_ARRAY_DIM], X[MAX_ARRAY_DIM];
+	for (int i=0; i < D; i++)
+	{
+		G[i] = G0[i] = Start[i] / fTileLen[i];
+		G1[i] = (Start[i] + Length[i] - 1) / fTileLen[i];
+	}
+
+	C_UInt8 *Out = (C_UInt8*)OutBuffer;
+	const vector<C_Int64> &ML = OutPos[L];
+	while (true)
+	{
+		// the intersection of tile and the selection
+		C_Int64 t = G[0];
+		bool Valid = true;
+		for (int i=0; i < D; i++)
+		{
+			if (i > 0) t = t * fGridLen[i] + G[i];
+			C_Int32 st = G[i] * fTileLen[i];
+			A[i] = (st > Start[i]) ? st : Start[i];
+			B[i] = st + fTileLen[i];
+			if (B[i] > Start[i] + Length[i]) B[i] = Start[i] + Length[i];
+			if (Valid)
+			{
+				Valid = false;
+				const vector<C_Int64> &M = OutPos[i];
+				for (C_Int32 k=A[i]; k < B[i]; k++)
+					if (M[k - Start[i]] >= 0) { Valid = true; break; }
+			}
+		}
+
+		if (Valid)
+		{
+			const C_UInt8 *Tile = _GetTile(t);
+			const C_Int32 TL0 = G[L] * fTileLen[L];
+			for (int i=0; i < L; i++) X[i] = A[i];
+			while (true)
+			{
+				C_Int64 ob = 0, tb = 0;
+				bool ok = true;
+				for (int i=0; i < L; i++)
+				{
+					C_Int64 m = OutPos[i][X[i] - Start[i]];
+					if (m < 0) { ok = false; break; }
+					ob += m;
+					tb += (X[i] - G[i]*fTileLen[i]) * TileStride[i];
+				}
+				if (ok)
+				{
+					// runs of the selected elements in the last dimension
+					C_Int32 k = A[L];
+					while (k < B[L])
+					{
+						C_Int64 m = ML[k - Start[L]];
+						if (m < 0) { k++; continue; }
+						C_Int32 e = k + 1;
+						while ((e < B[L]) && (ML[e - Start[L]] >= 0)) e++;
+						_ReadCvt(Out + (ob + m)*OutSize,
+							Tile + (tb + k - TL0)*fElmSize, e - k, OutSV);
+						k = e;
+					}
+				}
+				// next
+				int i = L - 1;
+				for (; i >= 0; i--)
+				{
+					if (++X[i] < B[i]) break;
+					X[i] = A[i];
+				}
+				if (i < 0) break;
+			}
+		}
+
+		// next tile
+		int i = L;
+		for (; i >= 0; i--)
+		{
+			if (++G[i] <= G1[i]) break;
+			G[i] = G0[i];
+		}
+		if (i < 0) break;
+	}
+
+	return Out + OutStride*OutSize;
+}
+
+const void *CdTiledArrayBase::WriteData(const C_Int32 *Start,
+	const C_Int32 *Length, const void *InBuffer, C_SVType InSV)
+{
+	const int D = fDimLen.size(), L = D - 1;
+	TArrayDim DStart, DLength;
+	if (!Start)
+	{
+		memset(DStart, 0, sizeof(C_Int32)*D);
+		Start = DStart;
+	}
+	if (!Length)
+	{
+		GetDim(DLength);
+		Length = DLength;
+	}
+	_CheckRect(Start, Length);
+	const ssize_t InSize = sv_size(InSV);
+
+	C_Int64 InStride[MAX_ARRAY_DIM], TileStride[MAX_ARRAY_DIM];
+	C_Int64 SlabStride[MAX_ARRAY_DIM];
+	InStride[L] = TileStride[L] = SlabStride[L] = 1;
+	for (int i=L-1; i >= 0; i--)
+	{
+		InStride[i] = InStride[i+1] * Length[i+1];
+		TileStride[i] = TileStride[i+1] * fTileLen[i+1];
+		SlabStride[i] = SlabStride[i+1] * fDimLen[i+1];
+	}
+	const C_Int64 InCnt = InStride[0] * Length[0];
+	if (InCnt <= 0) return InBuffer;
+
+	C_Int32 G0[MAX_ARRAY_DIM], G1[MAX_ARRAY_DIM], G[MAX_ARRAY_DIM];
+	C_Int32 A[MAX_ARRAY_DIM], B[MAX_ARRAY_DIM], X[MAX_ARRAY_DIM];
+	for (int i=0; i < D; i++)
+	{
+		G[i] = G0[i] = Start[i] / fTileLen[i];
+		G1[i] = (Start[i] + Length[i] - 1) / fTileLen[i];
+	}
+
+	const C_UInt8 *In = (const C_UInt8*)InBuffer;
+	while (true)
+	{
+		C_Int64 t = G[0];
+		for (int i=0; i < D; i++)
+		{
+			if (i > 0) t = t * fGridLen[i] + G[i];
+			C_Int32 st = G[i] * fTileLen[i];
+			A[i] = (st > Start[i]) ? st : Start[i];
+			B[i] = st + fTileLen[i];
+			if (B[i] > Start[i] + Length[i]) B[i] = Start[i] + Length[i];
+		}
+
+		// write to the pending slab, or update the tile
+		const bool InSlab = fSlabLoaded && (G[0]*fTileLen[0] == fSlabRow);
+		C_UInt8 *Tile = InSlab ? &fSlab[0] : (C_UInt8*)_GetTile(t);
+		for (int i=0; i < L; i++) X[i] = A[i];
+		while (true)
+		{
+			C_Int64 ib = A[L] - Start[L], db;
+			if (InSlab)
+			{
+				db = A[L] - (C_Int64)fSlabRow * SlabStride[0];
+				for (int i=0; i < L; i++) db += X[i] * SlabStride[i];
+			} else {
+				db = A[L] - G[L]*fTileLen[L];
+				for (int i=0; i < L; i++)
+					db += (X[i] - G[i]*fTileLen[i]) * TileStride[i];
+			}
+			for (int i=0; i < L; i++)
+				ib += (X[i] - Start[i]) * InStride[i];
+			_WriteCvt(Tile + db*fElmSize, In + ib*InSize, B[L] - A[L], InSV);
+			// next
+			int i = L - 1;
+			for (; i >= 0; i--)
+			{
+				if (++X[i] < B[i]) break;
+				X[i] = A[i];
+			}
+			if (i < 0) break;
+		}
+		if (InSlab)
+		{
+			fSlabDirty = true;
+			_SetDirty();
+		} else
+			_PutTile(t, Tile);
+
+		// next tile
+		int i = L;
+		for (; i >= 0; i--)
+		{
+			if (++G[i] <= G1[i]) break;
+			G[i] = G0[i];
+		}
+		if (i < 0) break;
+	}
+
+	return In + InCnt*InSize;
+}
+
+const void *CdTiledArrayBase::Append(const void *Buffer, ssize_t Cnt,
+	C_SVType InSV)
+{
+	if (Cnt <= 0) return Buffer;
+	if (fRowElmCnt <= 0)
+		throw ErrArray(ERR_TILE_APPEND);
+
+	_LoadSlab();
+	const C_Int64 SlabCnt = fTileLen[0] * fRowElmCnt;
+	while (Cnt > 0)
+	{
+		C_Int64 Off = fTotalCount - (C_Int64)fSlabRow * fRowElmCnt;
+		C_Int64 n = SlabCnt - Off;
+		if (n > Cnt) n = Cnt;
+		Buffer = _WriteCvt(&fSlab[Off*fElmSize], Buffer, n, InSV);
+		fTotalCount += n;
+		Cnt -= n;
+		fSlabDirty = true;
+		_SetDirty();
+		if (Off + n >= SlabCnt)
+		{
+			// a full row of tiles
+			_FlushSlab();
+			fSlabRow += fTileLen[0];
+			memset(&fSlab[0], 0, fSlab.size());
+		}
+	}
+
+	fDimLen[0] = fTotalCount / fRowElmCnt;
+	fChanged = true;
+	_SetDirty();
+	return Buffer;
+}
+
+void CdTiledArrayBase::SetPackedMode(const char *Mode)
+{
+	_CheckWritable();
+
+	if (fPipeInfo ? (!fPipeInfo->Equal(Mode)) : true)
+	{
+		CdPipeMgrItem *Pipe = dStreamPipeMgr.Match(*this, Mode);
+		if ((Pipe==NULL) && (strcmp(Mode, "")!=0))
+			throw ErrArray(ERR_PACKED_MODE, Mode);
+
+		if (fDataStream && fIndexStream)
+		{
+			try {
+				_FlushSlab();
+				// re-encode all tiles to a temporary stream
+				TdAutoRef<CdStream> Tmp(new CdTempStream);
+				vector<TTileEntry> NewIndex(fIndex.size());
+				vector<C_UInt8> Buf(fTileElmCnt * fElmSize);
+				for (size_t i=0; i < fIndex.size(); i++)
+				{
+					_DecodeTile(fPipeInfo, fIndex[i], &Buf[0]);
+					_EncodeTile(Pipe, &Buf[0], *Tmp.get(), NewIndex[i]);
+				}
+				// replace the data and index
+				fDataStream->SetPosition(0);
+				fDataStream->SetSizeOnly(0);
+				fDataStream->CopyFrom(*Tmp.get(), 0, -1);
+				fIndex.swap(NewIndex);
+				fFree.clear();
+				fIndexStream->SetPosition(0);
+				fIndexStream->SetSizeOnly(0);
+				for (C_Int64 i=0; i < (C_Int64)fIndex.size(); i++)
+					_WriteIndex(i);
+			}
+			catch (...) {
+				if (Pipe) delete Pipe;
+				throw;
+			}
+		}
+
+		if (fPipeInfo) delete fPipeInfo;
+		fPipeInfo = Pipe;
+		// save, since PipeInfo has been changed
+		if (fGDSStream) SaveToBlockStream();
+	}
+}
+
+SIZE64 CdTiledArrayBase::GDSStreamSize()
+{
+	if (fDataStream || fIndexStream)
+	{
+		SIZE64 rv = 0;
+		if (fDataStream) rv += fDataStream->GetSize();
+		if (fIndexStream) rv += fIndexStream->GetSize();
+		return rv;
+	} else
+		return -1;
+}
+
+void CdTiledArrayBase::GetOwnBlockStream(vector<const CdBlockStream*> &Out) const
+{
+	Out.clear();
+	if (fDataStream) Out.push_back(fDataStream);
+	if (fIndexStream) Out.push_back(fIndexStream);
+}
+
+void CdTiledArrayBase::GetOwnBlockStream(vector<CdStream*> &Out)
+{
+	Out.clear();
+	if (fDataStream) Out.push_back(fDataStream);
+	if (fIndexStream) Out.push_back(fIndexStream);
+}
+
+void CdTiledArrayBase::Loading(CdReader &Reader, TdVersion Version)
+{
+	CdAbstractArray::Loading(Reader, Version);
+
+	// dimension and tile shape
+	C_UInt16 DCnt = 0;
+	Reader[VAR_DCNT] >> DCnt;
+	if ((DCnt <= 0) || (DCnt > MAX_ARRAY_DIM))
+		throw ErrArray(ERR_TILE_DIM_CNT, (int)DCnt);
+	TArrayDim Buf;
+	Reader[VAR_DIM].GetAutoArray(Buf, DCnt);
+	fDimLen.assign(Buf, Buf + DCnt);
+	Reader[VAR_TILE].GetAutoArray(Buf, DCnt);
+	fTileLen.assign(Buf, Buf + DCnt);
+	for (int i=0; i < DCnt; i++)
+	{
+		if (fTileLen[i] <= 0)
+			throw ErrArray(ERR_TILE_LEN, fTileLen[i], i);
+	}
+	fTileFixed = true;
+	TdGDSPos Cnt = 0;
+	Reader[VAR_COUNT] >> Cnt;
+	fTotalCount = Cnt;
+	_InitGrid();
+
+	// load the tile index
+	fIndex.clear();
+	fCache.clear();
+	fSlab.clear();
+	fSlabLoaded = fSlabDirty = false;
+	if (fGDSStream)
+	{
+		TdGDSBlockID ID;
+		Reader[VAR_DATA] >> ID;
+		fDataStream = fGDSStream->Collection()[ID];
+		Reader[VAR_INDEX] >> ID;
+		fIndexStream = fGDSStream->Collection()[ID];
+
+		C_Int64 n = fIndexStream->GetSize() / TILE_ENTRY_SIZE;
+		fIndex.resize(n);
+		BYTE_LE<CdStream> S(fIndexStream);
+		S.SetPosition(0);
+		for (C_Int64 i=0; i < n; i++)
+		{
+			TdGDSPos Pos; C_UInt32 Size;
+			S >> Pos >> Size;
+			fIndex[i].Pos = Pos;
+			fIndex[i].Size = Size;
+		}
+		_InitFree();
+	}
+
+	fChanged = false;
+}
+
+void CdTiledArrayBase::Saving(CdWriter &Writer)
+{
+	CdAbstractArray::Saving(Writer);
+
+	C_UInt16 D = fDimLen.size();
+	Writer[VAR_DCNT] << D;
+	Writer[VAR_DIM].NewAutoArray(&fDimLen[0], D);
+	Writer[VAR_TILE].NewAutoArray(&fTileLen[0], D);
+	Writer[VAR_COUNT] << TdGDSPos(fTotalCount);
+
+	if (fGDSStream)
+	{
+		if (!fDataStream)
+			fDataStream = fGDSStream->Collection().NewBlockStream();
+		if (!fIndexStream)
+			fIndexStream = fGDSStream->Collection().NewBlockStream();
+		TdGDSBlockID Entry = fDataStream->ID();
+		Writer[VAR_DATA] << Entry;
+		Entry = fIndexStream->ID();
+		Writer[VAR_INDEX] << Entry;
+	}
+}
+
+void CdTiledArrayBase::IterOffset(CdIterator &I, SIZE64 val)
+{
+	I.Ptr += val;
+}
+
+C_Int64 CdTiledArrayBase::IterGetInteger(CdIterator &I)
+{
+	C_Int64 v;
+	IterRData(I, &v, 1, svInt64);
+	I.Ptr --;
+	return v;
+}
+
+double CdTiledArrayBase::IterGetFloat(CdIterator &I)
+{
+	double v;
+	IterRData(I, &v, 1, svFloat64);
+	I.Ptr --;
+	return v;
+}
+
+UTF16String CdTiledArrayBase::IterGetString(CdIterator &I)
+{
+	UTF16String v;
+	IterRData(I, &v, 1, svStrUTF16);
+	I.Ptr --;
+	return v;
+}
+
+void CdTiledArrayBase::IterSetInteger(CdIterator &I, C_Int64 val)
+{
+	IterWData(I, &val, 1, svInt64);
+	I.Ptr --;
+}
+
+void CdTiledArrayBase::IterSetFloat(CdIterator &I, double val)
+{
+	IterWData(I, &val, 1, svFloat64);
+	I.Ptr --;
+}
+
+void CdTiledArrayBase::IterSetString(CdIterator &I, const UTF16String &val)
+{
+	IterWData(I, &val, 1, svStrUTF16);
+	I.Ptr --;
+}
+
+void *CdTiledArrayBase::IterRData(CdIterator &I, void *OutBuf, ssize_t n,
+	C_SVType OutSV)
+{
+	const C_Int64 SlabStart = (C_Int64)fSlabRow * fRowElmCnt;
+	while (n > 0)
+	{
+		if ((I.Ptr < 0) || (I.Ptr >= fTotalCount))
+			throw ErrArray(ERR_TILE_POS, (C_Int64)I.Ptr);
+		C_Int64 t, Off;
+		C_Int64 m = _ElmTile(I.Ptr, t, Off);
+		if (m > n) m = n;
+		if (m > fTotalCount - I.Ptr) m = fTotalCount - I.Ptr;
+		if (fSlabLoaded && (I.Ptr >= SlabStart))
+		{
+			OutBuf = _ReadCvt(OutBuf, &fSlab[(I.Ptr - SlabStart)*fElmSize],
+				m, OutSV);
+		} else {
+			OutBuf = _ReadCvt(OutBuf, _GetTile(t) + Off*fElmSize, m, OutSV);
+		}
+		I.Ptr += m;
+		n -= m;
+	}
+	return OutBuf;
+}
+
+const void *CdTiledArrayBase::IterWData(CdIterator &I, const void *InBuf,
+	ssize_t n, C_SVType InSV)
+{
+	const C_Int64 SlabStart = (C_Int64)fSlabRow * fRowElmCnt;
+	while (n > 0)
+	{
+		if ((I.Ptr < 0) || (I.Ptr >= fTotalCount))
+			throw ErrArray(ERR_TILE_POS, (C_Int64)I.Ptr);
+		C_Int64 t, Off;
+		C_Int64 m = _ElmTile(I.Ptr, t, Off);
+		if (m > n) m = n;
+		if (m > fTotalCount - I.Ptr) m = fTotalCount - I.Ptr;
+		if (fSlabLoaded && (I.Ptr >= SlabStart))
+		{
+			InBuf = _WriteCvt(&fSlab[(I.Ptr - SlabStart)*fElmSize], InBuf,
+				m, InSV);
+			fSlabDirty = true;
+			_SetDirty();
+		} else {
+			C_UInt8 *Tile = (C_UInt8*)_GetTile(t);
+			InBuf = _WriteCvt(Tile + Off*fElmSize, InBuf, m, InSV);
+			_PutTile(t, Tile);
+		}
+		I.Ptr += m;
+		n -= m;
+	}
+	return InBuf;
+}
+
+void CdTiledArrayBase::_InitGrid()
+{
+	const int D = fDimLen.size();
+	fGridLen.resize(D);
+	fGridLen[0] = (fDimLen[0] + fTileLen[0] - 1) / fTileLen[0];
+	fRowElmCnt = 1;
+	fTileElmCnt = fTileLen[0];
+	fGridRowCnt = 1;
+	for (int i=1; i < D; i++)
+	{
+		fRowElmCnt *= fDimLen[i];
+		fTileElmCnt *= fTileLen[i];
+		fGridLen[i] = (fDimLen[i] + fTileLen[i] - 1) / fTileLen[i];
+		fGridRowCnt *= fGridLen[i];
+	}
+	fSlabRow = (fRowElmCnt > 0) ?
+		(C_Int32)(fTotalCount / fRowElmCnt / fTileLen[0]) * fTileLen[0] : 0;
+}
+
+void CdTiledArrayBase::_ResetStorage()
+{
+	fIndex.clear();
+	fFree.clear();
+	fCache.clear();
+	fSlab.clear();
+	fSlabLoaded = fSlabDirty = false;
+	if (fDataStream)
+	{
+		fDataStream->SetPosition(0);
+		fDataStream->SetSizeOnly(0);
+	}
+	if (fIndexStream)
+	{
+		fIndexStream->SetPosition(0);
+		fIndexStream->SetSizeOnly(0);
+	}
+}
+
+void CdTiledArrayBase::_LoadSlab()
+{
+	if (fSlabLoaded) return;
+	fSlab.assign(fTileLen[0] * fRowElmCnt * fElmSize, 0);
+	if (fTotalCount > (C_Int64)fSlabRow * fRowElmCnt)
+	{
+		// reload the partial row of tiles
+		const C_Int64 Base = (C_Int64)(fSlabRow / fTileLen[0]) * fGridRowCnt;
+		for (C_Int64 g=0; g < fGridRowCnt; g++)
+			_SlabTile(g, (C_UInt8*)_GetTile(Base + g), false);
+	}
+	fSlabLoaded = true;
+	fSlabDirty = false;
+}
+
+void CdTiledArrayBase::_FlushSlab()
+{
+	if (!fSlabLoaded || !fSlabDirty) return;
+	fTileBuf.resize(fTileElmCnt * fElmSize);
+	const C_Int64 Base = (C_Int64)(fSlabRow / fTileLen[0]) * fGridRowCnt;
+	for (C_Int64 g=0; g < fGridRowCnt; g++)
+	{
+		_SlabTile(g, &fTileBuf[0], true);
+		_PutTile(Base + g, &fTileBuf[0]);
+	}
+	fSlabDirty = false;
+}
+
+void CdTiledArrayBase::_SlabTile(C_Int64 GridIdx, C_UInt8 *Tile, bool ToTile)
+{
+	const int D = fDimLen.size();
+	C_Int64 Len[MAX_ARRAY_DIM], TS[MAX_ARRAY_DIM], SS[MAX_ARRAY_DIM];
+	TS[D-1] = SS[D-1] = 1;
+	for (int i=D-2; i >= 0; i--)
+	{
+		TS[i] = TS[i+1] * fTileLen[i+1];
+		SS[i] = SS[i+1] * fDimLen[i+1];
+	}
+	// the grid coordinates of the non-leading dimensions
+	C_Int64 SOff = 0;
+	for (int i=D-1; i >= 1; i--)
+	{
+		C_Int64 st = (GridIdx % fGridLen[i]) * fTileLen[i];
+		GridIdx /= fGridLen[i];
+		Len[i] = fDimLen[i] - st;
+		if (Len[i] > fTileLen[i]) Len[i] = fTileLen[i];
+		SOff += st * SS[i];
+	}
+	Len[0] = fTileLen[0];
+
+	C_UInt8 *Slab = &fSlab[SOff * fElmSize];
+	if (ToTile)
+	{
+		memset(Tile, 0, fTileElmCnt * fElmSize);
+		box_copy(D, Len, Tile, TS, Slab, SS, fElmSize);
+	} else
+		box_copy(D, Len, Slab, SS, Tile, TS, fElmSize);
+}
+
+const C_UInt8 *CdTiledArrayBase::_GetTile(C_Int64 TileIdx)
+{
+	if (fSlabLoaded && (TileIdx / fGridRowCnt == fSlabRow / fTileLen[0]))
+	{
+		fTileBuf.resize(fTileElmCnt * fElmSize);
+		_SlabTile(TileIdx % fGridRowCnt, &fTileBuf[0], true);
+		return &fTileBuf[0];
+	}
+
+	// look up the cache
+	TTileCache *p = NULL;
+	for (size_t i=0; i < fCache.size(); i++)
+	{
+		TTileCache &c = fCache[i];
+		if (c.Index == TileIdx)
+		{
+			c.Stamp = ++fCacheStamp;
+			return &c.Buffer[0];
+		}
+		if (!p || (c.Stamp < p->Stamp)) p = &c;
+	}
+
+	// load the tile to a new or the least recently used cache
+	const size_t TileSize = fTileElmCnt * fElmSize;
+	size_t MaxNum = TILE_CACHE_SIZE / TileSize;
+	if (MaxNum > (size_t)TILE_CACHE_MAX_NUM) MaxNum = TILE_CACHE_MAX_NUM;
+	if (fCache.size() < MaxNum || !p)
+	{
+		if (fCache.empty()) fCache.reserve(MaxNum > 0 ? MaxNum : 1);
+		fCache.push_back(TTileCache());
+		p = &fCache.back();
+	}
+	p->Index = -1;
+	p->Buffer.resize(TileSize);
+	if (TileIdx < (C_Int64)fIndex.size())
+		_DecodeTile(fPipeInfo, fIndex[TileIdx], &p->Buffer[0]);
+	else
+		memset(&p->Buffer[0], 0, TileSize);
+	p->Index = TileIdx;
+	p->Stamp = ++fCacheStamp;
+	return &p->Buffer[0];
+}
+
+void CdTiledArrayBase::_PutTile(C_Int64 TileIdx, const C_UInt8 *Tile)
+{
+	if (!fDataStream || !fIndexStream)
+		throw ErrArray(ERR_TILE_NO_STREAM);
+
+	// encode, and replace the old tile in place if it fits
+	TTileEntry E;
+	TdAutoRef<CdMemoryStream> Mem(new CdMemoryStream);
+	_EncodeTile(fPipeInfo, Tile, *Mem.get(), E);
+	C_Int64 n = fIndex.size();
+	if (TileIdx < n)
+	{
+		// the snapshots of SWMR readers may refer to the old tile
+		if (!(GDSFile() && GDSFile()->SWMRWriter()))
+			_FreeSpace(fIndex[TileIdx].Pos, fIndex[TileIdx].Size);
+	}
+	if (E.Size > 0)
+	{
+		E.Pos = _AllocSpace(E.Size);
+		fDataStream->SetPosition(E.Pos);
+		fDataStream->WriteData(Mem->BufPointer(), E.Size);
+	}
+	if (TileIdx >= n)
+	{
+		// the missing tiles are all zero
+		TTileEntry Zero = { 0, 0 };
+		fIndex.resize(TileIdx + 1, Zero);
+		for (C_Int64 i=n; i < TileIdx; i++) _WriteIndex(i);
+	}
+	fIndex[TileIdx] = E;
+	_WriteIndex(TileIdx);
+
+	// update the cache
+	for (size_t i=0; i < fCache.size(); i++)
+	{
+		TTileCache &c = fCache[i];
+		if ((c.Index == TileIdx) && (&c.Buffer[0] != Tile))
+			memcpy(&c.Buffer[0], Tile, c.Buffer.size());
+	}
+}
+
+void CdTiledArrayBase::_DecodeTile(CdPipeMgrItem *Pipe, const TTileEntry &E,
+	C_UInt8 *Tile)
+{
+	const ssize_t TileSize = fTileElmCnt * fElmSize;
+	if (E.Size == 0)
+	{
+		memset(Tile, 0, TileSize);
+		return;
+	}
+	if (!fDataStream)
+		throw ErrArray(ERR_TILE_NO_STREAM);
+
+	if (Pipe)
+	{
+		CdMemoryStream *Mem = new CdMemoryStream(E.Size);
+		TdAutoRef<CdBufStream> Input(new CdBufStream(Mem));
+		fDataStream->SetPosition(E.Pos);
+		fDataStream->ReadData(Mem->BufPointer(), E.Size);
+		Pipe->PushReadPipe(*Input);
+		Input->ReadData(Tile, TileSize);
+	} else {
+		if ((ssize_t)E.Size != TileSize)
+			throw ErrArray(ERR_TILE_SIZE, (C_Int64)E.Size);
+		fDataStream->SetPosition(E.Pos);
+		fDataStream->ReadData(Tile, TileSize);
+	}
+}
+
+void CdTiledArrayBase::_EncodeTile(CdPipeMgrItem *Pipe, const C_UInt8 *Tile,
+	CdStream &Out, TTileEntry &E)
+{
+	const ssize_t TileSize = fTileElmCnt * fElmSize;
+	E.Pos = 0; E.Size = 0;
+
+	// an all-zero tile is not stored
+	ssize_t i = 0;
+	while ((i < TileSize) && (Tile[i] == 0)) i++;
+	if (i >= TileSize) return;
+
+	E.Pos = Out.GetSize();
+	Out.SetPosition(E.Pos);
+	if (Pipe)
+	{
+		CdMemoryStream *Mem = new CdMemoryStream;
+		TdAutoRef<CdBufStream> Output(new CdBufStream(Mem));
+		Pipe->PushWritePipe(*Output);
+		Output->WriteData(Tile, TileSize);
+		Output->FlushWrite();
+		Pipe->ClosePipe(*Output);
+		E.Size = Mem->GetSize();
+		Out.WriteData(Mem->BufPointer(), E.Size);
+	} else {
+		Out.WriteData(Tile, TileSize);
+		E.Size = TileSize;
+	}
+}
+
+void CdTiledArrayBase::_WriteIndex(C_Int64 TileIdx)
+{
+	const TTileEntry &E = fIndex[TileIdx];
+	fIndexStream->SetPosition(TileIdx * TILE_ENTRY_SIZE);
+	BYTE_LE<CdStream>(fIndexStream) << TdGDSPos(E.Pos) << E.Size;
+}
+
+void CdTiledArrayBase::_InitFree()
+{
+	// the gaps between the stored tiles
+	map<SIZE64, SIZE64> Used;
+	for (size_t i=0; i < fIndex.size(); i++)
+	{
+		if (fIndex[i].Size > 0)
+			Used[fIndex[i].Pos] = fIndex[i].Size;
+	}
+	fFree.clear();
+	SIZE64 p = 0;
+	map<SIZE64, SIZE64>::iterator it;
+	for (it=Used.begin(); it != Used.end(); it++)
+	{
+		if (it->first > p)
+			fFree[p] = it->first - p;
+		if (it->first + it->second > p)
+			p = it->first + it->second;
+	}
+	if (fDataStream && (fDataStream->GetSize() > p))
+		fFree[p] = fDataStream->GetSize() - p;
+}
+
+void CdTiledArrayBase::_FreeSpace(SIZE64 Pos, SIZE64 Size)
+{
+	if (Size <= 0) return;
+	// merge with the adjacent extents
+	map<SIZE64, SIZE64>::iterator it = fFree.lower_bound(Pos);
+	if ((it != fFree.end()) && (Pos + Size == it->first))
+	{
+		Size += it->second;
+		fFree.erase(it++);
+	}
+	if (it != fFree.begin())
+	{
+		map<SIZE64, SIZE64>::iterator p = it; p--;
+		if (p->first + p->second == Pos)
+		{
+			Pos = p->first;
+			Size += p->second;
+			fFree.erase(p);
+		}
+	}
+	fFree[Pos] = Size;
+}
+
+SIZE64 CdTiledArrayBase::_AllocSpace(SIZE64 Size)
+{
+	// the first fit
+	map<SIZE64, SIZE64>::iterator it;
+	for (it=fFree.begin(); it != fFree.end(); it++)
+	{
+		if (it->second >= Size)
+		{
+			SIZE64 Pos = it->first, Left = it->second - Size;
+			fFree.erase(it);
+			if (Left > 0) fFree[Pos + Size] = Left;
+			return Pos;
+		}
+	}
+	// extend the free extent at the end of stream, or append
+	SIZE64 End = fDataStream->GetSize();
+	if (!fFree.empty())
+	{
+		it = fFree.end(); it--;
+		if (it->first + it->second == End)
+		{
+			End = it->first;
+			fFree.erase(it);
+		}
+	}
+	return End;
+}
+
+C_Int64 CdTiledArrayBase::_ElmTile(C_Int64 Idx, C_Int64 &TileIdx,
+	C_Int64 &Offset) const
+{
+	const int D = fDimLen.size(), L = D - 1;
+	TArrayDim DI;
+	for (int i=L; i >= 1; i--)
+	{
+		DI[i] = Idx % fDimLen[i];
+		Idx /= fDimLen[i];
+	}
+	DI[0] = Idx;
+
+	TileIdx = DI[0] / fTileLen[0];
+	Offset = DI[0] % fTileLen[0];
+	for (int i=1; i < D; i++)
+	{
+		TileIdx = TileIdx * fGridLen[i] + DI[i] / fTileLen[i];
+		Offset = Offset * fTileLen[i] + DI[i] % fTileLen[i];
+	}
+
+	// the number of contiguous elements in the tile
+	C_Int64 n = fTileLen[L] - DI[L] % fTileLen[L];
+	if ((L > 0) && (n > fDimLen[L] - DI[L]))
+		n = fDimLen[L] - DI[L];
+	return n;
+}
@@ -0,0 +1,418 @@
+// ===========================================================
+//     _/_/_/   _/_/_/  _/_/_/_/    _/_/_/_/  _/_/_/   _/_/_/
+//      _/    _/       _/             _/    _/    _/   _/   _/
+//     _/    _/       _/_/_/_/       _/    _/    _/   _/_/_/
+//    _/    _/       _/             _/    _/    _/   _/
+// _/_/_/   _/_/_/  _/_/_/_/_/     _/     _/_/_/   _/_/
+// ===========================================================
+//
+// dTiledGDS.h: Tiled (chunked) array in GDS format
+//
+// Copyright (C) 2020    Xiuwen Zheng
+//
+// This file is part of CoreArray.
+//
+// CoreArray is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License Version 3 as
+// published by the Free Software Foundation.
+//
+// CoreArray is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with CoreArray.
+// If not, see <http://www.gnu.org/licenses/>.
+
+/**
+ *	\file     dTiledGDS.h
+ *	\author   Xiuwen Zheng [zhengxwen@gmail.com]
+ *	\version  1.0
+ *	\date     2020
+ *	\brief    Tiled (chunked) array in GDS format
+ *	\details  The array is split into fixed-size N-d tiles, and each tile is
+ *	          compressed independently, so that a rectangular read only
+ *	          decodes the tiles it intersects.
+**/
+
+#ifndef _HEADER_COREARRAY_TILED_GDS_
+#define _HEADER_COREARRAY_TILED_GDS_
+
+#include "dStruct.h"
+#include <vector>
+#include <map>
+
+
+namespace CoreArray
+{
+	using namespace std;
+
+	/// Tiled value type
+	/** \tparam TYPE  data type, e.g C_Int8, ...
+	**/
+	template<typename TYPE> struct COREARRAY_DLL_DEFAULT TTileVal
+	{
+		typedef TYPE TType;
+	};
+
+	typedef TTileVal<C_Int8>    TTileInt8;    ///< 8-bit tiled integer (signed int)
+	typedef TTileVal<C_UInt8>   TTileUInt8;   ///< 8-bit tiled integer (unsigned int)
+	typedef TTileVal<C_Int16>   TTileInt16;   ///< 16-bit tiled integer (signed int)
+	typedef TTileVal<C_UInt16>  TTileUInt16;  ///< 16-bit tiled integer (unsigned int)
+	typedef TTileVal<C_Int32>   TTileInt32;   ///< 32-bit tiled integer (signed int)
+	typedef TTileVal<C_UInt32>  TTileUInt32;  ///< 32-bit tiled integer (unsigned int)
+	typedef TTileVal<C_Int64>   TTileInt64;   ///< 64-bit tiled integer (signed int)
+	typedef TTileVal<C_UInt64>  TTileUInt64;  ///< 64-bit tiled integer (unsigned int)
+	typedef TTileVal<C_Float32> TTileReal32;  ///< 32-bit tiled real number
+	typedef TTileVal<C_Float64> TTileReal64;  ///< 64-bit tiled real number
+
+
+	/// Trait of tiled arrays, the same as the element type except the names
+	#define COREARRAY_TILE_TRAITS(TILE_TYPE, TYPE, NAME)  \
+		template<> struct COREARRAY_DLL_DEFAULT TdTraits<TILE_TYPE>: \
+			public TdTraits<TYPE> \
+		{ \
+			typedef TYPE ElmType; \
+			static const char *TraitName() { return StreamName()+1; } \
+			static const char *StreamName() { return NAME; } \
+		};
+
+	COREARRAY_TILE_TRAITS(TTileInt8,   C_Int8,    "dTileInt8")
+	COREARRAY_TILE_TRAITS(TTileUInt8,  C_UInt8,   "dTileUInt8")
+	COREARRAY_TILE_TRAITS(TTileInt16,  C_Int16,   "dTileInt16")
+	COREARRAY_TILE_TRAITS(TTileUInt16, C_UInt16,  "dTileUInt16")
+	COREARRAY_TILE_TRAITS(TTileInt32,  C_Int32,   "dTileInt32")
+	COREARRAY_TILE_TRAITS(TTileUInt32, C_UInt32,  "dTileUInt32")
+	COREARRAY_TILE_TRAITS(TTileInt64,  C_Int64,   "dTileInt64")
+	COREARRAY_TILE_TRAITS(TTileUInt64, C_UInt64,  "dTileUInt64")
+	COREARRAY_TILE_TRAITS(TTileReal32, C_Float32, "dTileReal32")
+	COREARRAY_TILE_TRAITS(TTileReal64, C_Float64, "dTileReal64")
+
+	#undef COREARRAY_TILE_TRAITS
+
+
+
+	// =====================================================================
+	// Tiled array of GDS format
+	// =====================================================================
+
+	/// The default number of elements in a tile
+	const C_Int64 TILE_DEFAULT_ELM_COUNT = 65536;
+	/// The default tile length of each non-leading dimension
+	const C_Int32 TILE_DEFAULT_DIM_LEN = 256;
+	/// The maximum size of the pending row of tiles
+	const C_Int64 TILE_MAX_SLAB_SIZE = 64*1024*1024;
+	/// The size of decoded tile cache
+	const C_Int64 TILE_CACHE_SIZE = 16*1024*1024;
+	/// The maximum number of tiles in the decoded tile cache
+	const int TILE_CACHE_MAX_NUM = 64;
+
+
+	/// The base class of tiled arrays
+	/** The array is stored as a grid of fixed-size tiles. The 'DATA' stream
+	 *  contains the tiles (compressed if a pipe is specified), and the
+	 *  'INDEX' stream contains the position and size of each tile in the
+	 *  row-major order of grid. Appended data is buffered in a pending row
+	 *  of tiles (slab), which is encoded when it is full or when the writer
+	 *  is closed. An all-zero tile is not stored. The space of a replaced
+	 *  tile is reused by the tiles written later.
+	**/
+	class COREARRAY_DLL_DEFAULT CdTiledArrayBase: public CdAbstractArray
+	{
+	public:
+		/// constructor
+		CdTiledArrayBase(ssize_t vElmSize);
+		/// destructor
+		virtual ~CdTiledArrayBase();
+
+		/// assignment from a GDS object
+		virtual void Assign(CdGDSObj &Source, bool Full);
+
+		/// clear the container
+		virtual void Clear();
+		/// return true, if the container is empty
+		virtual bool Empty();
+		/// return total number of elements in the container
+		virtual C_Int64 TotalCount();
+
+		/// synchronize data
+		virtual void Synchronize();
+		/// close the writing mode and sync the file
+		virtual void CloseWriter();
+
+		/// the starting iterator
+		virtual CdIterator IterBegin();
+		/// the end iterator
+		virtual CdIterator IterEnd();
+
+		/// get how many dimensions
+		virtual int DimCnt() const;
+		/// get the dimensions
+		virtual void GetDim(C_Int32 DimLen[]) const;
+		/// reset the dimensions, only allowed when the array is empty
+		virtual void ResetDim(const C_Int32 DimLen[], int DCnt);
+		/// get the length of specified dimension
+		virtual C_Int32 GetDLen(int I) const;
+		/// set the length of specified dimension
+		virtual void SetDLen(int I, C_Int32 Value);
+		/// get how many elements in total according to dimensions
+		virtual C_Int64 TotalArrayCount();
+
+		/// get the iterator corresponding to 'DimIndex'
+		virtual CdIterator Iterator(const C_Int32 DimIndex[]);
+
+		/// get the tile lengths
+		void GetTileDim(C_Int32 TileLen[]) const;
+		/// set the tile lengths, only allowed when the array is empty
+		void SetTileDim(const C_Int32 TileLen[], int DCnt);
+
+		/// read array-oriented data
+		virtual void *ReadData(const C_Int32 *Start, const C_Int32 *Length,
+			void *OutBuffer, C_SVType OutSV);
+		/// read array-oriented data from the selection
+		virtual void *ReadDataEx(const C_Int32 *Start, const C_Int32 *Length,
+			const C_BOOL *const Selection[], void *OutBuffer, C_SVType OutSV);
+		/// write array-oriented data
+		virtual const void *WriteData(const C_Int32 *Start,
+			const C_Int32 *Length, const void *InBuffer, C_SVType InSV);
+
+		/// append new data
+		virtual const void *Append(const void *Buffer, ssize_t Cnt,
+			C_SVType InSV);
+
+		/// set the compression mode, all tiles are re-encoded
+		virtual void SetPackedMode(const char *Mode);
+
+		/// get the size of data in the GDS file/stream
+		virtual SIZE64 GDSStreamSize();
+
+		/// get a list of CdBlockStream owned by this object, except fGDSStream
+		virtual void GetOwnBlockStream(vector<const CdBlockStream*> &Out) const;
+		/// get a list of CdStream owned by this object, except fGDSStream
+		virtual void GetOwnBlockStream(vector<CdStream*> &Out);
+
+		/// the number of stored tiles
+		COREARRAY_INLINE C_Int64 TileCount() const { return fIndex.size(); }
+
+	protected:
+
+		/// the position and size of a tile in the data stream
+		struct TTileEntry
+		{
+			SIZE64 Pos;     ///< the position in fDataStream
+			C_UInt32 Size;  ///< the size in byte, 0 for an all-zero tile
+		};
+
+		/// a decoded tile in memory
+		struct TTileCache
+		{
+			C_Int64 Index;   ///< tile index, -1 for unused
+			C_UInt64 Stamp;  ///< the time stamp of last access
+			vector<C_UInt8> Buffer;  ///< the decoded tile
+		};
+
+		const ssize_t fElmSize;  ///< the size of element in byte
+		vector<C_Int32> fDimLen;    ///< dimension lengths
+		vector<C_Int32> fTileLen;   ///< tile lengths of each dimension
+		vector<C_Int32> fGridLen;   ///< the number of tiles in each dimension
+		C_Int64 fTotalCount;   ///< the total number of appended elements
+		C_Int64 fRowElmCnt;    ///< the number of elements in a row
+		C_Int64 fTileElmCnt;   ///< the number of elements in a tile
+		C_Int64 fGridRowCnt;   ///< the number of tiles in a row of tiles
+
+		CdBlockStream *fDataStream;   ///< the GDS stream for tiles
+		CdBlockStream *fIndexStream;  ///< the GDS stream for tile index
+		vector<TTileEntry> fIndex;    ///< tile index
+		map<SIZE64, SIZE64> fFree;    ///< free extents (position, size) in fDataStream
+
+		vector<C_UInt8> fSlab;  ///< the pending row of tiles
+		C_Int32 fSlabRow;       ///< the starting row of fSlab
+		bool fSlabLoaded;       ///< whether fSlab contains the data
+		bool fSlabDirty;        ///< whether fSlab has not been encoded
+
+		vector<TTileCache> fCache;  ///< decoded tiles
+		C_UInt64 fCacheStamp;       ///< the current time stamp
+		vector<C_UInt8> fTileBuf;   ///< a working tile buffer
+		bool fTileFixed;  ///< whether the tile lengths are specified by user
+
+		/// convert TYPE elements to the output buffer
+		virtual void *_ReadCvt(void *OutBuf, const void *Src, ssize_t n,
+			C_SVType OutSV) = 0;
+		/// convert the input buffer to TYPE elements
+		virtual const void *_WriteCvt(void *Dst, const void *InBuf, ssize_t n,
+			C_SVType InSV) = 0;
+
+		/// loading function for serialization
+		virtual void Loading(CdReader &Reader, TdVersion Version);
+		/// saving function for serialization
+		virtual void Saving(CdWriter &Writer);
+
+		virtual void IterOffset(CdIterator &I, SIZE64 val);
+		virtual C_Int64 IterGetInteger(CdIterator &I);
+		virtual double IterGetFloat(CdIterator &I);
+		virtual UTF16String IterGetString(CdIterator &I);
+		virtual void IterSetInteger(CdIterator &I, C_Int64 val);
+		virtual void IterSetFloat(CdIterator &I, double val);
+		virtual void IterSetString(CdIterator &I, const UTF16String &val);
+		virtual void *IterRData(CdIterator &I, void *OutBuf, ssize_t n,
+			C_SVType OutSV);
+		virtual const void *IterWData(CdIterator &I, const void *InBuf,
+			ssize_t n, C_SVType InSV);
+
+	private:
+		void _InitGrid();
+		void _ResetStorage();
+		void _LoadSlab();
+		void _FlushSlab();
+		void _SlabTile(C_Int64 GridIdx, C_UInt8 *Tile, bool ToTile);
+		const C_UInt8 *_GetTile(C_Int64 TileIdx);
+		void _PutTile(C_Int64 TileIdx, const C_UInt8 *Tile);
+		void _DecodeTile(CdPipeMgrItem *Pipe, const TTileEntry &E,
+			C_UInt8 *Tile);
+		void _EncodeTile(CdPipeMgrItem *Pipe, const C_UInt8 *Tile,
+			CdStream &Out, TTileEntry &E);
+		void _WriteIndex(C_Int64 TileIdx);
+		void _InitFree();
+		void _FreeSpace(SIZE64 Pos, SIZE64 Size);
+		SIZE64 _AllocSpace(SIZE64 Size);
+		C_Int64 _ElmTile(C_Int64 Idx, C_Int64 &TileIdx, C_Int64 &Offset) const;
+	};
+
+
+	/// Container of tiled integers or real numbers
+	/** \tparam TILE_TYPE    should be TTileInt8, ..., TTileReal64
+	**/
+	template<typename TILE_TYPE>
+		class COREARRAY_DLL_DEFAULT CdTiledArray: public CdTiledArrayBase
+	{
+	public:
+		typedef TILE_TYPE ElmType;
+		typedef typename TdTraits<ElmType>::TType ElmTypeEx;
+
+		/// constructor
+		CdTiledArray(): CdTiledArrayBase(sizeof(ElmTypeEx)) { }
+
+		/// create a new CdTiledArray<TILE_TYPE> object
+		virtual CdGDSObj *NewObject()
+		{
+			return (new CdTiledArray<TILE_TYPE>)->AssignPipe(*this);
+		}
+
+		/// return a string specifying the class name in stream
+		virtual const char *dName()
+		{
+			return TdTraits<TILE_TYPE>::StreamName();
+		}
+
+		/// return a string specifying the class name
+		virtual const char *dTraitName()
+		{
+			return TdTraits<TILE_TYPE>::TraitName();
+		}
+
+		virtual C_SVType SVType()
+		{
+			return TdTraits<TILE_TYPE>::SVType;
+		}
+
+		virtual int TraitFlag()
+		{
+			return TdTraits<TILE_TYPE>::trVal;
+		}
+
+		virtual unsigned BitOf()
+		{
+			return TdTraits<TILE_TYPE>::BitOf;
+		}
+
+		virtual bool IsPrimitive()
+		{
+			return TdTraits<TILE_TYPE>::IsPrimitive;
+		}
+
+	protected:
+
+		virtual void *_ReadCvt(void *OutBuf, const void *Src, ssize_t n,
+			C_SVType OutSV)
+		{
+			const ElmTypeEx *s = (const ElmTypeEx*)Src;
+			switch (OutSV)
+			{
+				case svInt8:
+					return VAL_CONV<C_Int8, ElmTypeEx>::Cvt((C_Int8*)OutBuf, s, n);
+				case svUInt8:
+					return VAL_CONV<C_UInt8, ElmTypeEx>::Cvt((C_UInt8*)OutBuf, s, n);
+				case svInt16:
+					return VAL_CONV<C_Int16, ElmTypeEx>::Cvt((C_Int16*)OutBuf, s, n);
+				case svUInt16:
+					return VAL_CONV<C_UInt16, ElmTypeEx>::Cvt((C_UInt16*)OutBuf, s, n);
+				case svInt32:
+					return VAL_CONV<C_Int32, ElmTypeEx>::Cvt((C_Int32*)OutBuf, s, n);
+				case svUInt32:
+					return VAL_CONV<C_UInt32, ElmTypeEx>::Cvt((C_UInt32*)OutBuf, s, n);
+				case svInt64:
+					return VAL_CONV<C_Int64, ElmTypeEx>::Cvt((C_Int64*)OutBuf, s, n);
+				case svUInt64:
+					return VAL_CONV<C_UInt64, ElmTypeEx>::Cvt((C_UInt64*)OutBuf, s, n);
+				case svFloat32:
+					return VAL_CONV<C_Float32, ElmTypeEx>::Cvt((C_Float32*)OutBuf, s, n);
+				case svFloat64:
+					return VAL_CONV<C_Float64, ElmTypeEx>::Cvt((C_Float64*)OutBuf, s, n);
+				case svStrUTF8:
+					return VAL_CONV<UTF8String, ElmTypeEx>::Cvt((UTF8String*)OutBuf, s, n);
+				case svStrUTF16:
+					return VAL_CONV<UTF16String, ElmTypeEx>::Cvt((UTF16String*)OutBuf, s, n);
+				default:
+					throw ErrArray("Invalid SVType for reading a tiled array.");
+			}
+		}
+
+		virtual const void *_WriteCvt(void *Dst, const void *InBuf, ssize_t n,
+			C_SVType InSV)
+		{
+			#define WRITE_CVT(TYPE)  \
+				VAL_CONV<ElmTypeEx, TYPE>::Cvt((ElmTypeEx*)Dst, (const TYPE*)InBuf, n); \
+				return ((const TYPE*)InBuf) + n;
+
+			switch (InSV)
+			{
+				case svInt8:      WRITE_CVT(C_Int8)
+				case svUInt8:     WRITE_CVT(C_UInt8)
+				case svInt16:     WRITE_CVT(C_Int16)
+				case svUInt16:    WRITE_CVT(C_UInt16)
+				case svInt32:     WRITE_CVT(C_Int32)
+				case svUInt32:    WRITE_CVT(C_UInt32)
+				case svInt64:     WRITE_CVT(C_Int64)
+				case svUInt64:    WRITE_CVT(C_UInt64)
+				case svFloat32:   WRITE_CVT(C_Float32)
+				case svFloat64:   WRITE_CVT(C_Float64)
+				case svStrUTF8:   WRITE_CVT(UTF8String)
+				case svStrUTF16:  WRITE_CVT(UTF16String)
+				default:
+					throw ErrArray("Invalid SVType for writing a tiled array.");
+			}
+
+			#undef WRITE_CVT
+		}
+	};
+
+
+	// =====================================================================
+	// Tiled integer/real numbers in GDS files
+	// =====================================================================
+
+	typedef CdTiledArray<TTileInt8>      CdTiledInt8;
+	typedef CdTiledArray<TTileUInt8>     CdTiledUInt8;
+	typedef CdTiledArray<TTileInt16>     CdTiledInt16;
+	typedef CdTiledArray<TTileUInt16>    CdTiledUInt16;
+	typedef CdTiledArray<TTileInt32>     CdTiledInt32;
+	typedef CdTiledArray<TTileUInt32>    CdTiledUInt32;
+	typedef CdTiledArray<TTileInt64>     CdTiledInt64;
+	typedef CdTiledArray<TTileUInt64>    CdTiledUInt64;
+	typedef CdTiledArray<TTileReal32>    CdTiledReal32;
+	typedef CdTiledArray<TTileReal64>    CdTiledReal64;
+
+}
+
+#endif /* _HEADER_COREARRAY_TILED_GDS_ */
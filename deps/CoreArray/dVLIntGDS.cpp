@@ -56,6 +56,7 @@ void CdVL_Int::AppendIter(CdIterator &I, C_Int64 Count)
 	{
 		if (fAllocator.BufStream())
 		{
+			_TransChanged();
 			CdVL_Int *Src = (CdVL_Int *)I.Handler;
 			Src->Allocator().BufStream()->FlushWrite();
 
@@ -109,6 +110,7 @@ void CdVL_Int::AppendIter(CdIterator &I, C_Int64 Count)
 			{
 				R.DimLen = fTotalCount / R.DimElmCnt;
 				this->fNeedUpdate = true;
+				this->_SetDirty();
 			}
 
 			return;
@@ -248,6 +250,7 @@ void CdVL_UInt::AppendIter(CdIterator &I, C_Int64 Count)
 	{
 		if (fAllocator.BufStream())
 		{
+			_TransChanged();
 			CdVL_UInt *Src = (CdVL_UInt *)I.Handler;
 			Src->Allocator().BufStream()->FlushWrite();
 
@@ -301,6 +304,7 @@ void CdVL_UInt::AppendIter(CdIterator &I, C_Int64 Count)
 			{
 				R.DimLen = fTotalCount / R.DimElmCnt;
 				this->fNeedUpdate = true;
+				this->_SetDirty();
 			}
 
 			return;
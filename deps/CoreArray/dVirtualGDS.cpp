@@ -0,0 +1,867 @@
+// ===========================================================
+//     _/_/_/   _/_/_/  _/_/_/_/    _/_/_/_/  _/_/_/   _/_/_/
+//      _/    _/       _/             _/    _/    _/   _/   _/
+//     _/    _/       _/_/_/_/       _/    _/    _/   _/_/_/
+//    _/    _/       _/             _/    _/    _/   _/
+// _/_/_/   _/_/_/  _/_/_/_/_/     _/     _/_/_/   _/_/
+// ===========================================================
+//
+// dVirtualGDS.cpp: Virtual array concatenating nodes of several GDS files
+//
+// Copyright (C) 2020    Xiuwen Zheng
+//
+// This file is part of CoreArray.
+//
+// CoreArray is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License Version 3 as
+// published by the Free Software Foundation.
+//
+// CoreArray is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with CoreArray.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef COREARRAY_COMPILER_OPTIMIZE_FLAG
+#   define COREARRAY_COMPILER_OPTIMIZE_FLAG  3
+#endif
+
+#include "dVirtualGDS.h"
+#include "dParallel.h"
+#include <algorithm>
+
+
+namespace CoreArray
+{
+	static CdObjRef *OnVirtualArrayCreate()
+	{
+		return new CdVirtualArray();
+	}
+
+	COREARRAY_DLL_LOCAL void RegisterClass_Virtual()
+	{
+		dObjManager().AddClass("dVirtualArray", OnVirtualArrayCreate,
+			CdObjClassMgr::ctRefArray, "virtual concatenated array");
+	}
+}
+
+
+// ===========================================================
+
+using namespace CoreArray;
+using namespace CoreArray::Parallel;
+
+static const char *VAR_DCNT   = "DCNT";
+static const char *VAR_DIM    = "DIM";
+static const char *VAR_AXIS   = "AXIS";
+static const char *VAR_SVTYPE = "SVTYPE";
+static const char *VAR_TRAIT  = "TRAIT";
+static const char *VAR_BITOF  = "BITOF";
+static const char *VAR_NSHARD = "NSHARD";
+static const char *VAR_FILES  = "FILES";
+static const char *VAR_PATHS  = "PATHS";
+static const char *VAR_LENGTH = "LENGTH";
+
+static const char *ERR_VIRTUAL_DIM_CNT = "Invalid number of dimensions (%d) in a virtual array.";
+static const char *ERR_VIRTUAL_AXIS = "Invalid concatenated dimension (%d) in a virtual array.";
+static const char *ERR_VIRTUAL_READONLY = "%s is not allowed, the virtual array is read-only.";
+static const char *ERR_VIRTUAL_NOT_EMPTY = "%s is not allowed when the virtual array has more than one shard.";
+static const char *ERR_VIRTUAL_NODE = "'%s' in the GDS file '%s' is not an array node.";
+static const char *ERR_VIRTUAL_SHAPE = "'%s' in the GDS file '%s' does not match the virtual array.";
+static const char *ERR_VIRTUAL_SHARD = "Invalid shard index (%d).";
+static const char *ERR_VIRTUAL_LENGTH = "Invalid shard lengths in a virtual array.";
+static const char *ERR_VIRTUAL_TOO_LONG = "The virtual array is too long in the concatenated dimension.";
+static const char *ERR_VIRTUAL_POS = "Invalid position (%lld) in a virtual array.";
+static const char *ERR_VIRTUAL_SV = "Invalid SVType for reading a virtual array.";
+
+
+/// the size of an element in the memory buffer
+static ssize_t sv_size(C_SVType sv)
+{
+	switch (sv)
+	{
+		case svInt8:  case svUInt8:
+			return 1;
+		case svInt16: case svUInt16:
+			return 2;
+		case svInt32: case svUInt32: case svFloat32:
+			return 4;
+		case svInt64: case svUInt64: case svFloat64:
+			return 8;
+		case svStrUTF8:
+			return sizeof(UTF8String);
+		case svStrUTF16:
+			return sizeof(UTF16String);
+		default:
+			throw ErrArray(ERR_VIRTUAL_SV);
+	}
+}
+
+/// join the strings with '\n'
+static UTF8String join_str(const vector<UTF8String> &s)
+{
+	UTF8String rv;
+	for (size_t i=0; i < s.size(); i++)
+	{
+		if (i > 0) rv.push_back('\n');
+		rv.append(s[i]);
+	}
+	return rv;
+}
+
+/// split the string by '\n'
+static void split_str(const UTF8String &s, vector<UTF8String> &out, size_t n)
+{
+	out.clear();
+	size_t p = 0;
+	for (size_t i=0; i < n; i++)
+	{
+		size_t e = s.find('\n', p);
+		if (e == UTF8String::npos) e = s.size();
+		out.push_back(s.substr(p, e - p));
+		p = (e < s.size()) ? e + 1 : e;
+	}
+}
+
+
+/// the parameters of reading a shard
+struct TVirtualRead
+{
+	CdAbstractArray *Obj;   ///< the shard
+	CdAbstractArray::TArrayDim Start;   ///< the starting position in the shard
+	CdAbstractArray::TArrayDim Length;  ///< the length in the shard
+	const C_BOOL *Sel[CdAbstractArray::MAX_ARRAY_DIM];  ///< the selection
+	bool HasSel;     ///< whether Sel is used
+	C_Int64 Pos;     ///< the selected position in the concatenated dimension
+	C_Int64 Count;   ///< the selected length in the concatenated dimension
+	C_UInt8 *Out;    ///< the output buffer of the virtual array
+	C_SVType OutSV;  ///< data type of the output buffer
+	C_Int64 Outer;   ///< the number of selected elements before the axis
+	C_Int64 Inner;   ///< the number of selected elements after the axis
+	C_Int64 NAxis;   ///< the number of selected elements in the axis
+};
+
+/// read a shard into a temporary buffer, then scatter the rows
+template<typename TYPE>
+static void read_rows(const TVirtualRead &R, C_SVType SV)
+{
+	const C_Int64 Run = R.Count * R.Inner;
+	vector<TYPE> Buf(R.Outer * Run);
+	R.Obj->ReadDataEx(R.Start, R.Length, R.HasSel ? R.Sel : NULL, &Buf[0], SV);
+	TYPE *p = ((TYPE*)R.Out) + R.Pos * R.Inner;
+	for (C_Int64 j=0; j < R.Outer; j++)
+	{
+		const TYPE *s = &Buf[j * Run];
+		std::copy(s, s + Run, p);
+		p += R.NAxis * R.Inner;
+	}
+}
+
+
+// =====================================================================
+// CdVirtualArray
+
+CdVirtualArray::CdVirtualArray(): CdAbstractArray()
+{
+	fDimLen.push_back(0);
+	fAxis = 0;
+	fSVType = svCustom;
+	fTraitFlag = COREARRAY_TR_UNKNOWN;
+	fBitOf = 0;
+}
+
+CdVirtualArray::~CdVirtualArray()
+{
+	CloseShards();
+}
+
+CdGDSObj *CdVirtualArray::NewObject()
+{
+	return new CdVirtualArray;
+}
+
+const char *CdVirtualArray::dName()
+{
+	return "dVirtualArray";
+}
+
+const char *CdVirtualArray::dTraitName()
+{
+	return "VirtualArray";
+}
+
+void CdVirtualArray::Assign(CdGDSObj &Source, bool Full)
+{
+	CdVirtualArray *S = dynamic_cast<CdVirtualArray*>(&Source);
+	if (S)
+	{
+		if (Full)
+			AssignAttribute(Source);
+		CloseShards();
+		fShards = S->fShards;
+		for (size_t i=0; i < fShards.size(); i++)
+		{
+			fShards[i].File = NULL;
+			fShards[i].Obj = NULL;
+		}
+		fDimLen = S->fDimLen;
+		fAxis = S->fAxis;
+		fSVType = S->fSVType;
+		fTraitFlag = S->fTraitFlag;
+		fBitOf = S->fBitOf;
+		fErrMsg.clear();
+		fChanged = true;
+		_SetDirty();
+	} else
+		RaiseInvalidAssign("CdVirtualArray", &Source);
+}
+
+C_SVType CdVirtualArray::SVType()
+{
+	return fSVType;
+}
+
+int CdVirtualArray::TraitFlag()
+{
+	return fTraitFlag;
+}
+
+unsigned CdVirtualArray::BitOf()
+{
+	return fBitOf;
+}
+
+bool CdVirtualArray::IsPrimitive()
+{
+	return false;
+}
+
+void CdVirtualArray::Clear()
+{
+	CloseShards();
+	fShards.clear();
+	fDimLen[fAxis] = 0;
+	fChanged = true;
+	_SetDirty();
+}
+
+bool CdVirtualArray::Empty()
+{
+	return (TotalArrayCount() <= 0);
+}
+
+C_Int64 CdVirtualArray::TotalCount()
+{
+	return TotalArrayCount();
+}
+
+void CdVirtualArray::CloseWriter()
+{ }
+
+CdIterator CdVirtualArray::IterBegin()
+{
+	CdIterator I;
+	I.Allocator = NULL;
+	I.Ptr = 0;
+	I.Handler = this;
+	return I;
+}
+
+CdIterator CdVirtualArray::IterEnd()
+{
+	CdIterator I;
+	I.Allocator = NULL;
+	I.Ptr = TotalArrayCount();
+	I.Handler = this;
+	return I;
+}
+
+int CdVirtualArray::DimCnt() const
+{
+	return fDimLen.size();
+}
+
+void CdVirtualArray::GetDim(C_Int32 DimLen[]) const
+{
+	for (size_t i=0; i < fDimLen.size(); i++)
+		DimLen[i] = fDimLen[i];
+}
+
+void CdVirtualArray::ResetDim(const C_Int32 DimLen[], int DCnt)
+{
+	throw ErrArray(ERR_VIRTUAL_READONLY, "ResetDim()");
+}
+
+C_Int32 CdVirtualArray::GetDLen(int I) const
+{
+	if ((I < 0) || (I >= (int)fDimLen.size()))
+		throw ErrArray(ERR_VIRTUAL_DIM_CNT, I);
+	return fDimLen[I];
+}
+
+void CdVirtualArray::SetDLen(int I, C_Int32 Value)
+{
+	throw ErrArray(ERR_VIRTUAL_READONLY, "SetDLen()");
+}
+
+C_Int64 CdVirtualArray::TotalArrayCount()
+{
+	C_Int64 rv = 1;
+	for (size_t i=0; i < fDimLen.size(); i++)
+		rv *= fDimLen[i];
+	return rv;
+}
+
+CdIterator CdVirtualArray::Iterator(const C_Int32 DimIndex[])
+{
+	C_Int64 p = 0;
+	for (size_t i=0; i < fDimLen.size(); i++)
+	{
+		if ((DimIndex[i] < 0) || (DimIndex[i] > fDimLen[i]))
+			throw ErrArray(ERR_VIRTUAL_POS, (C_Int64)DimIndex[i]);
+		p = p * fDimLen[i] + DimIndex[i];
+	}
+	CdIterator I = IterBegin();
+	I.Ptr = p;
+	return I;
+}
+
+void *CdVirtualArray::ReadData(const C_Int32 *Start, const C_Int32 *Length,
+	void *OutBuffer, C_SVType OutSV)
+{
+	return ReadDataEx(Start, Length, NULL, OutBuffer, OutSV);
+}
+
+void *CdVirtualArray::ReadDataEx(const C_Int32 *Start, const C_Int32 *Length,
+	const C_BOOL *const Selection[], void *OutBuffer, C_SVType OutSV)
+{
+	const int D = fDimLen.size(), K = fAxis;
+	TArrayDim DStart, DLength;
+	if (!Start)
+	{
+		memset(DStart, 0, sizeof(C_Int32)*D);
+		Start = DStart;
+	}
+	if (!Length)
+	{
+		GetDim(DLength);
+		Length = DLength;
+	}
+	_CheckRect(Start, Length);
+	const ssize_t OutSize = sv_size(OutSV);
+
+	// the numbers of selected elements before, in and after the axis
+	C_Int64 Outer = 1, Inner = 1, NAxis = 0;
+	for (int i=0; i < D; i++)
+	{
+		C_Int64 n = Length[i];
+		if (Selection && Selection[i])
+		{
+			const C_BOOL *s = Selection[i];
+			n = 0;
+			for (C_Int32 k=0; k < Length[i]; k++)
+				if (s[k]) n++;
+		}
+		if (i < K)
+			Outer *= n;
+		else if (i > K)
+			Inner *= n;
+		else
+			NAxis = n;
+	}
+	const C_Int64 OutCnt = Outer * NAxis * Inner;
+	if (OutCnt <= 0) return OutBuffer;
+
+	// the shards intersecting the request, opened in the calling thread
+	vector<TVirtualRead> Tasks;
+	const C_Int32 End = Start[K] + Length[K];
+	C_Int64 Pos = 0;
+	for (int s=_FindShard(Start[K]); s < (int)fShards.size(); s++)
+	{
+		const TShard &S = fShards[s];
+		if (S.Offset >= End) break;
+		const C_Int32 a = std::max(S.Offset, Start[K]);
+		const C_Int32 b = std::min(S.Offset + S.Length, End);
+		if (a >= b) continue;
+
+		TVirtualRead R;
+		R.HasSel = false;
+		for (int i=0; i < D; i++)
+		{
+			R.Start[i] = Start[i];
+			R.Length[i] = Length[i];
+			R.Sel[i] = Selection ? Selection[i] : NULL;
+			if (R.Sel[i]) R.HasSel = true;
+		}
+		R.Start[K] = a - S.Offset;
+		R.Length[K] = b - a;
+		R.Count = b - a;
+		if (R.Sel[K])
+		{
+			R.Sel[K] += a - Start[K];
+			R.Count = 0;
+			for (C_Int32 k=0; k < b - a; k++)
+				if (R.Sel[K][k]) R.Count ++;
+			if (R.Count <= 0) continue;
+		}
+		R.Obj = _Shard(s);
+		R.Pos = Pos;
+		R.Out = (C_UInt8*)OutBuffer;
+		R.OutSV = OutSV;
+		R.Outer = Outer;
+		R.Inner = Inner;
+		R.NAxis = NAxis;
+		Pos += R.Count;
+		Tasks.push_back(R);
+	}
+
+	if (Tasks.size() == 1)
+	{
+		_ReadShardProc(NULL, 0, &Tasks);
+	} else if (!Tasks.empty())
+	{
+		CdTaskGroup Group;
+		for (int i=0; i < (int)Tasks.size(); i++)
+			Group.Run(_ReadShardProc, i, &Tasks);
+		Group.Wait();
+	}
+
+	return (C_UInt8*)OutBuffer + OutCnt * OutSize;
+}
+
+const void *CdVirtualArray::WriteData(const C_Int32 *Start,
+	const C_Int32 *Length, const void *InBuffer, C_SVType InSV)
+{
+	throw ErrArray(ERR_VIRTUAL_READONLY, "WriteData()");
+}
+
+const void *CdVirtualArray::Append(const void *Buffer, ssize_t Cnt,
+	C_SVType InSV)
+{
+	throw ErrArray(ERR_VIRTUAL_READONLY, "Append()");
+}
+
+void CdVirtualArray::SetPackedMode(const char *Mode)
+{
+	if (Mode && *Mode)
+		throw ErrArray(ERR_VIRTUAL_READONLY, "SetPackedMode()");
+}
+
+void CdVirtualArray::SetAxis(int Axis)
+{
+	if (fShards.size() > 1)
+		throw ErrArray(ERR_VIRTUAL_NOT_EMPTY, "SetAxis()");
+	if ((Axis < 0) || (Axis >= (fShards.empty() ? (int)MAX_ARRAY_DIM :
+			(int)fDimLen.size())))
+		throw ErrArray(ERR_VIRTUAL_AXIS, Axis);
+	if (Axis != fAxis)
+	{
+		fAxis = Axis;
+		if (fShards.empty())
+		{
+			fDimLen.assign(1, 0);
+			if (Axis >= 1) fDimLen.resize(Axis + 1, 0);
+		} else
+			fShards[0].Length = fDimLen[Axis];
+		fChanged = true;
+		_SetDirty();
+	}
+}
+
+void CdVirtualArray::AddShard(const UTF8String &FileName,
+	const UTF8String &Path)
+{
+	TShard S;
+	S.FileName = FileName;
+	S.Path = Path;
+	S.Length = S.Offset = 0;
+	S.File = NULL;
+	S.Obj = NULL;
+
+	CdGDSFile *File = NULL;
+	CdAbstractArray *Obj = _OpenShard(S, File);
+	try {
+		if (fShards.empty())
+		{
+			// the first shard determines the shape and data type
+			if (fAxis >= Obj->DimCnt())
+				throw ErrArray(ERR_VIRTUAL_AXIS, fAxis);
+			fDimLen.resize(Obj->DimCnt());
+			Obj->GetDim(&fDimLen[0]);
+			fDimLen[fAxis] = 0;
+			fSVType = Obj->SVType();
+			fTraitFlag = Obj->TraitFlag();
+			fBitOf = Obj->BitOf();
+			AssignAttribute(*Obj);
+		}
+		if (Obj->DimCnt() == (int)fDimLen.size())
+			S.Length = Obj->GetDLen(fAxis);
+		_CheckShard(S, Obj);
+		if ((C_Int64)fDimLen[fAxis] + S.Length > 0x7FFFFFFF)
+			throw ErrArray(ERR_VIRTUAL_TOO_LONG);
+	}
+	catch (...)
+	{
+		delete File;
+		throw;
+	}
+
+	S.Offset = fDimLen[fAxis];
+	S.File = File;
+	S.Obj = Obj;
+	fShards.push_back(S);
+	fDimLen[fAxis] += S.Length;
+	fChanged = true;
+	_SetDirty();
+}
+
+const UTF8String &CdVirtualArray::ShardFileName(int Index) const
+{
+	if ((Index < 0) || (Index >= (int)fShards.size()))
+		throw ErrArray(ERR_VIRTUAL_SHARD, Index);
+	return fShards[Index].FileName;
+}
+
+const UTF8String &CdVirtualArray::ShardPath(int Index) const
+{
+	if ((Index < 0) || (Index >= (int)fShards.size()))
+		throw ErrArray(ERR_VIRTUAL_SHARD, Index);
+	return fShards[Index].Path;
+}
+
+C_Int32 CdVirtualArray::ShardLength(int Index) const
+{
+	if ((Index < 0) || (Index >= (int)fShards.size()))
+		throw ErrArray(ERR_VIRTUAL_SHARD, Index);
+	return fShards[Index].Length;
+}
+
+bool CdVirtualArray::IsLoaded(bool Silent)
+{
+	try {
+		for (int i=0; i < (int)fShards.size(); i++)
+			_Shard(i);
+	}
+	catch (exception &E)
+	{
+		fErrMsg = E.what();
+		if (!Silent) throw;
+		return false;
+	}
+	return true;
+}
+
+void CdVirtualArray::CloseShards()
+{
+	for (size_t i=0; i < fShards.size(); i++)
+	{
+		TShard &S = fShards[i];
+		if (S.File)
+		{
+			CdGDSFile *file = S.File;
+			S.File = NULL;
+			S.Obj = NULL;
+			delete file;
+		}
+	}
+}
+
+void CdVirtualArray::Loading(CdReader &Reader, TdVersion Version)
+{
+	CdAbstractArray::Loading(Reader, Version);
+	CloseShards();
+
+	C_UInt16 DCnt = 0;
+	Reader[VAR_DCNT] >> DCnt;
+	if ((DCnt <= 0) || (DCnt > MAX_ARRAY_DIM))
+		throw ErrArray(ERR_VIRTUAL_DIM_CNT, (int)DCnt);
+	TArrayDim Buf;
+	Reader[VAR_DIM].GetAutoArray(Buf, DCnt);
+	fDimLen.assign(Buf, Buf + DCnt);
+
+	C_Int32 v = 0;
+	Reader[VAR_AXIS] >> v;
+	if ((v < 0) || (v >= DCnt))
+		throw ErrArray(ERR_VIRTUAL_AXIS, v);
+	fAxis = v;
+	Reader[VAR_SVTYPE] >> v;
+	fSVType = (C_SVType)v;
+	Reader[VAR_TRAIT] >> v;
+	fTraitFlag = v;
+	Reader[VAR_BITOF] >> v;
+	fBitOf = v;
+
+	// the list of shards
+	C_Int32 n = 0;
+	Reader[VAR_NSHARD] >> n;
+	fShards.clear();
+	if (n > 0)
+	{
+		UTF8String s;
+		vector<UTF8String> Files, Paths;
+		Reader[VAR_FILES] >> s;
+		split_str(s, Files, n);
+		Reader[VAR_PATHS] >> s;
+		split_str(s, Paths, n);
+		vector<C_Int32> Len(n);
+		Reader[VAR_LENGTH].GetAutoArray(&Len[0], n);
+
+		fShards.resize(n);
+		for (C_Int32 i=0; i < n; i++)
+		{
+			TShard &S = fShards[i];
+			S.FileName = Files[i];
+			S.Path = Paths[i];
+			S.Length = Len[i];
+			S.File = NULL;
+			S.Obj = NULL;
+		}
+	}
+	_InitOffset();
+	fErrMsg.clear();
+}
+
+void CdVirtualArray::Saving(CdWriter &Writer)
+{
+	CdAbstractArray::Saving(Writer);
+
+	C_UInt16 D = fDimLen.size();
+	Writer[VAR_DCNT] << D;
+	Writer[VAR_DIM].NewAutoArray(&fDimLen[0], D);
+	Writer[VAR_AXIS] << C_Int32(fAxis);
+	Writer[VAR_SVTYPE] << C_Int32(fSVType);
+	Writer[VAR_TRAIT] << C_Int32(fTraitFlag);
+	Writer[VAR_BITOF] << C_Int32(fBitOf);
+
+	C_Int32 n = fShards.size();
+	Writer[VAR_NSHARD] << n;
+	if (n > 0)
+	{
+		vector<UTF8String> Files, Paths;
+		vector<C_Int32> Len;
+		for (C_Int32 i=0; i < n; i++)
+		{
+			Files.push_back(fShards[i].FileName);
+			Paths.push_back(fShards[i].Path);
+			Len.push_back(fShards[i].Length);
+		}
+		Writer[VAR_FILES] << join_str(Files);
+		Writer[VAR_PATHS] << join_str(Paths);
+		Writer[VAR_LENGTH].NewAutoArray(&Len[0], n);
+	}
+}
+
+void CdVirtualArray::IterOffset(CdIterator &I, SIZE64 val)
+{
+	I.Ptr += val;
+}
+
+C_Int64 CdVirtualArray::IterGetInteger(CdIterator &I)
+{
+	C_Int64 v;
+	IterRData(I, &v, 1, svInt64);
+	I.Ptr --;
+	return v;
+}
+
+double CdVirtualArray::IterGetFloat(CdIterator &I)
+{
+	double v;
+	IterRData(I, &v, 1, svFloat64);
+	I.Ptr --;
+	return v;
+}
+
+UTF16String CdVirtualArray::IterGetString(CdIterator &I)
+{
+	UTF16String v;
+	IterRData(I, &v, 1, svStrUTF16);
+	I.Ptr --;
+	return v;
+}
+
+void CdVirtualArray::IterSetInteger(CdIterator &I, C_Int64 val)
+{
+	throw ErrArray(ERR_VIRTUAL_READONLY, "IterSetInteger()");
+}
+
+void CdVirtualArray::IterSetFloat(CdIterator &I, double val)
+{
+	throw ErrArray(ERR_VIRTUAL_READONLY, "IterSetFloat()");
+}
+
+void CdVirtualArray::IterSetString(CdIterator &I, const UTF16String &val)
+{
+	throw ErrArray(ERR_VIRTUAL_READONLY, "IterSetString()");
+}
+
+void *CdVirtualArray::IterRData(CdIterator &I, void *OutBuf, ssize_t n,
+	C_SVType OutSV)
+{
+	const int D = fDimLen.size(), L = D - 1;
+	const C_Int64 Total = TotalArrayCount();
+	while (n > 0)
+	{
+		if ((I.Ptr < 0) || (I.Ptr >= Total))
+			throw ErrArray(ERR_VIRTUAL_POS, (C_Int64)I.Ptr);
+		// the run in the last dimension
+		TArrayDim DStart, DLength;
+		C_Int64 p = I.Ptr;
+		for (int i=L; i >= 0; i--)
+		{
+			DStart[i] = p % fDimLen[i];
+			DLength[i] = 1;
+			p /= fDimLen[i];
+		}
+		C_Int64 m = fDimLen[L] - DStart[L];
+		if (m > n) m = n;
+		DLength[L] = m;
+		OutBuf = ReadDataEx(DStart, DLength, NULL, OutBuf, OutSV);
+		I.Ptr += m;
+		n -= m;
+	}
+	return OutBuf;
+}
+
+const void *CdVirtualArray::IterWData(CdIterator &I, const void *InBuf,
+	ssize_t n, C_SVType InSV)
+{
+	throw ErrArray(ERR_VIRTUAL_READONLY, "IterWData()");
+}
+
+CdAbstractArray *CdVirtualArray::_Shard(int Index)
+{
+	TShard &S = fShards[Index];
+	if (!S.Obj)
+	{
+		CdGDSFile *File = NULL;
+		CdAbstractArray *Obj = _OpenShard(S, File);
+		try {
+			_CheckShard(S, Obj);
+		}
+		catch (...)
+		{
+			delete File;
+			throw;
+		}
+		S.File = File;
+		S.Obj = Obj;
+	}
+	return S.Obj;
+}
+
+CdAbstractArray *CdVirtualArray::_OpenShard(const TShard &S,
+	CdGDSFile *&File)
+{
+	// the file name relative to the directory of the host file
+	UTF8String fn = S.FileName;
+	const bool Abs = !fn.empty() && ((fn[0]=='/') || (fn[0]=='\\') ||
+		((fn.size() > 1) && (fn[1]==':')));
+	CdGDSFile *Host = GDSFile();
+	if (Host && !Abs)
+	{
+		fn = Host->FileName();
+		int i = (int)fn.size() - 1;
+		for (; i >= 0; i--)
+		{
+			if ((fn[i]=='/') || (fn[i]=='\\'))
+				break;
+		}
+		fn.resize(i+1);
+		fn.append(S.FileName);
+	}
+
+	File = new CdGDSFile;
+	try {
+		File->LoadFile(fn.c_str(), true);
+		CdAbstractArray *Obj =
+			dynamic_cast<CdAbstractArray*>(File->Root().PathEx(S.Path));
+		if (!Obj)
+		{
+			throw ErrGDSObj(ERR_VIRTUAL_NODE, S.Path.c_str(),
+				S.FileName.c_str());
+		}
+		return Obj;
+	}
+	catch (...)
+	{
+		delete File;
+		File = NULL;
+		throw;
+	}
+}
+
+void CdVirtualArray::_CheckShard(const TShard &S, CdAbstractArray *Obj)
+{
+	bool ok = (Obj->DimCnt() == (int)fDimLen.size()) &&
+		(Obj->SVType() == fSVType);
+	for (int i=0; ok && (i < (int)fDimLen.size()); i++)
+	{
+		ok = (Obj->GetDLen(i) == ((i == fAxis) ? S.Length : fDimLen[i]));
+	}
+	if (!ok)
+	{
+		throw ErrGDSObj(ERR_VIRTUAL_SHAPE, S.Path.c_str(),
+			S.FileName.c_str());
+	}
+}
+
+void CdVirtualArray::_InitOffset()
+{
+	C_Int64 p = 0;
+	for (size_t i=0; i < fShards.size(); i++)
+	{
+		fShards[i].Offset = p;
+		p += fShards[i].Length;
+	}
+	if (p != fDimLen[fAxis])
+		throw ErrArray(ERR_VIRTUAL_LENGTH);
+}
+
+int CdVirtualArray::_FindShard(C_Int32 Pos) const
+{
+	// the first shard ending after 'Pos'
+	int lo = 0, hi = fShards.size();
+	while (lo < hi)
+	{
+		int mid = (lo + hi) / 2;
+		if (fShards[mid].Offset + fShards[mid].Length > Pos)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return lo;
+}
+
+void CdVirtualArray::_ReadShardProc(CdThread *Thread, int Index, void *Param)
+{
+	const TVirtualRead &R = (*(vector<TVirtualRead>*)Param)[Index];
+	if (R.Outer == 1)
+	{
+		// the output of shard is contiguous
+		const ssize_t OutSize = sv_size(R.OutSV);
+		R.Obj->ReadDataEx(R.Start, R.Length, R.HasSel ? R.Sel : NULL,
+			R.Out + R.Pos * R.Inner * OutSize, R.OutSV);
+		return;
+	}
+	switch (R.OutSV)
+	{
+		case svInt8:  case svUInt8:
+			read_rows<C_UInt8>(R, R.OutSV); break;
+		case svInt16: case svUInt16:
+			read_rows<C_UInt16>(R, R.OutSV); break;
+		case svInt32: case svUInt32: case svFloat32:
+			read_rows<C_UInt32>(R, R.OutSV); break;
+		case svInt64: case svUInt64: case svFloat64:
+			read_rows<C_UInt64>(R, R.OutSV); break;
+		case svStrUTF8:
+			read_rows<UTF8String>(R, R.OutSV); break;
+		case svStrUTF16:
+			read_rows<UTF16String>(R, R.OutSV); break;
+		default:
+			throw ErrArray(ERR_VIRTUAL_SV);
+	}
+}
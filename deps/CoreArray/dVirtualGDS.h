@@ -0,0 +1,205 @@
+// ===========================================================
+//     _/_/_/   _/_/_/  _/_/_/_/    _/_/_/_/  _/_/_/   _/_/_/
+//      _/    _/       _/             _/    _/    _/   _/   _/
+//     _/    _/       _/_/_/_/       _/    _/    _/   _/_/_/
+//    _/    _/       _/             _/    _/    _/   _/
+// _/_/_/   _/_/_/  _/_/_/_/_/     _/     _/_/_/   _/_/
+// ===========================================================
+//
+// dVirtualGDS.h: Virtual array concatenating nodes of several GDS files
+//
+// Copyright (C) 2020    Xiuwen Zheng
+//
+// This file is part of CoreArray.
+//
+// CoreArray is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License Version 3 as
+// published by the Free Software Foundation.
+//
+// CoreArray is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with CoreArray.
+// If not, see <http://www.gnu.org/licenses/>.
+
+/**
+ *	\file     dVirtualGDS.h
+ *	\author   Xiuwen Zheng [zhengxwen@gmail.com]
+ *	\version  1.0
+ *	\date     2020
+ *	\brief    Virtual array concatenating nodes of several GDS files
+ *	\details  Like CdGDSVirtualFolder, the linked files are stored by name
+ *	          relative to the host file and opened on demand.
+**/
+
+#ifndef _HEADER_COREARRAY_VIRTUAL_GDS_
+#define _HEADER_COREARRAY_VIRTUAL_GDS_
+
+#include "dStruct.h"
+#include <vector>
+
+
+namespace CoreArray
+{
+	using namespace std;
+
+	// =====================================================================
+	// Virtual concatenated array
+	// =====================================================================
+
+	/// Read-only array concatenating array nodes of linked GDS files
+	/** Each shard is an array node in another GDS file, and all shards have
+	 *  the same data type and the same dimensions except the concatenated
+	 *  one. The dimensions are saved in the host file, so a shard file is
+	 *  opened (read-only) only when its data is requested. A request
+	 *  spanning several shards reads the shards in parallel.
+	**/
+	class COREARRAY_DLL_DEFAULT CdVirtualArray: public CdAbstractArray
+	{
+	public:
+		/// constructor
+		CdVirtualArray();
+		/// destructor
+		virtual ~CdVirtualArray();
+
+		/// create a new CdVirtualArray object
+		virtual CdGDSObj *NewObject();
+		/// return a string specifying the class name in stream
+		virtual const char *dName();
+		/// return a string specifying the class name
+		virtual const char *dTraitName();
+
+		/// assignment from a GDS object, the shards are shared by file names
+		virtual void Assign(CdGDSObj &Source, bool Full);
+
+		virtual C_SVType SVType();
+		virtual int TraitFlag();
+		virtual unsigned BitOf();
+		virtual bool IsPrimitive();
+
+		/// clear the container, remove all shards
+		virtual void Clear();
+		/// return true, if the container is empty
+		virtual bool Empty();
+		/// return total number of elements in the container
+		virtual C_Int64 TotalCount();
+		/// nothing to close, the array is read-only
+		virtual void CloseWriter();
+
+		/// the starting iterator
+		virtual CdIterator IterBegin();
+		/// the end iterator
+		virtual CdIterator IterEnd();
+
+		/// get how many dimensions
+		virtual int DimCnt() const;
+		/// get the dimensions
+		virtual void GetDim(C_Int32 DimLen[]) const;
+		/// not allowed, the dimensions are determined by the shards
+		virtual void ResetDim(const C_Int32 DimLen[], int DCnt);
+		/// get the length of specified dimension
+		virtual C_Int32 GetDLen(int I) const;
+		/// not allowed, the dimensions are determined by the shards
+		virtual void SetDLen(int I, C_Int32 Value);
+		/// get how many elements in total according to dimensions
+		virtual C_Int64 TotalArrayCount();
+
+		/// get the iterator corresponding to 'DimIndex'
+		virtual CdIterator Iterator(const C_Int32 DimIndex[]);
+
+		/// read array-oriented data
+		virtual void *ReadData(const C_Int32 *Start, const C_Int32 *Length,
+			void *OutBuffer, C_SVType OutSV);
+		/// read array-oriented data from the selection
+		virtual void *ReadDataEx(const C_Int32 *Start, const C_Int32 *Length,
+			const C_BOOL *const Selection[], void *OutBuffer, C_SVType OutSV);
+		/// not allowed, the array is read-only
+		virtual const void *WriteData(const C_Int32 *Start,
+			const C_Int32 *Length, const void *InBuffer, C_SVType InSV);
+		/// not allowed, the array is read-only
+		virtual const void *Append(const void *Buffer, ssize_t Cnt,
+			C_SVType InSV);
+
+		/// only no compression is allowed, the shards keep their own
+		virtual void SetPackedMode(const char *Mode);
+
+		/// the concatenated dimension (from ZERO)
+		COREARRAY_INLINE int Axis() const { return fAxis; }
+		/// set the concatenated dimension, only allowed before the second shard
+		void SetAxis(int Axis);
+
+		/// append a shard, 'Path' is the array node in the file 'FileName'
+		/** \param FileName    the file name relative to the host GDS file
+		 *  \param Path        the path of array node in the linked file
+		**/
+		void AddShard(const UTF8String &FileName, const UTF8String &Path);
+
+		/// the number of shards
+		COREARRAY_INLINE int ShardCount() const { return fShards.size(); }
+		/// the file name of a shard
+		const UTF8String &ShardFileName(int Index) const;
+		/// the node path of a shard
+		const UTF8String &ShardPath(int Index) const;
+		/// the length of a shard in the concatenated dimension
+		C_Int32 ShardLength(int Index) const;
+
+		/// try to open all shards, return false if failed and 'Silent'
+		bool IsLoaded(bool Silent);
+		/// the error message of the last failure of opening a shard
+		COREARRAY_INLINE const string &ErrMsg() const { return fErrMsg; }
+		/// close all opened shard files
+		void CloseShards();
+
+	protected:
+
+		/// a linked array node
+		struct TShard
+		{
+			UTF8String FileName;  ///< the file name relative to the host
+			UTF8String Path;      ///< the node path in the linked file
+			C_Int32 Length;       ///< the length in the concatenated dimension
+			C_Int32 Offset;       ///< the starting position in the virtual array
+			CdGDSFile *File;      ///< the linked file, or NULL if not opened
+			CdAbstractArray *Obj; ///< the linked node, or NULL if not opened
+		};
+
+		vector<TShard> fShards;   ///< the list of shards
+		vector<C_Int32> fDimLen;  ///< dimension lengths
+		int fAxis;                ///< the concatenated dimension
+		C_SVType fSVType;         ///< data type of the shards
+		int fTraitFlag;           ///< trait flag of the shards
+		unsigned fBitOf;          ///< number of bits of the element type
+		string fErrMsg;           ///< the last error message
+
+		/// loading function for serialization
+		virtual void Loading(CdReader &Reader, TdVersion Version);
+		/// saving function for serialization
+		virtual void Saving(CdWriter &Writer);
+
+		virtual void IterOffset(CdIterator &I, SIZE64 val);
+		virtual C_Int64 IterGetInteger(CdIterator &I);
+		virtual double IterGetFloat(CdIterator &I);
+		virtual UTF16String IterGetString(CdIterator &I);
+		virtual void IterSetInteger(CdIterator &I, C_Int64 val);
+		virtual void IterSetFloat(CdIterator &I, double val);
+		virtual void IterSetString(CdIterator &I, const UTF16String &val);
+		virtual void *IterRData(CdIterator &I, void *OutBuf, ssize_t n,
+			C_SVType OutSV);
+		virtual const void *IterWData(CdIterator &I, const void *InBuf,
+			ssize_t n, C_SVType InSV);
+
+	private:
+		CdAbstractArray *_Shard(int Index);
+		CdAbstractArray *_OpenShard(const TShard &S, CdGDSFile *&File);
+		void _CheckShard(const TShard &S, CdAbstractArray *Obj);
+		void _InitOffset();
+		int _FindShard(C_Int32 Pos) const;
+		static void _ReadShardProc(CdThread *Thread, int Index, void *Param);
+	};
+
+}
+
+#endif /* _HEADER_COREARRAY_VIRTUAL_GDS_ */
@@ -66,11 +66,551 @@ namespace jugds
 	}
 
 
-	/// a list of GDS objects
-	COREARRAY_DLL_LOCAL vector<PdGDSObj> PKG_GDSObj_List;
+	/// reopen an evicted file in the file pool, and return the node at 'Path'
+	COREARRAY_DLL_LOCAL PdGDSObj AttachPoolNode(int PoolIdx,
+		const UTF8String &Path);
+	/// the index of the pooled file containing a node, or -1
+	COREARRAY_DLL_LOCAL int PoolIndexOf(PdGDSObj Obj);
+	/// mark a pooled file as recently used
+	COREARRAY_DLL_LOCAL void TouchPoolFile(int PoolIdx);
+
+	/// the table of GDS node handles
+	/** A handle consists of a slot index (low 24 bits) and the generation
+	 *  of that slot (7 bits), so a released handle is never confused with
+	 *  the new node reusing its slot. Free slots are chained in a list, and
+	 *  an open-addressing hash maps node pointers to their slots.
+	 *  When a pooled file is evicted, the slots of its nodes are detached:
+	 *  they keep the node paths, and are attached to the reloaded nodes on
+	 *  the next access (or forwarded to the handles of the reloaded nodes).
+	**/
+	class COREARRAY_DLL_LOCAL CNodeTable
+	{
+	public:
+		static const int SLOT_BITS = 24;
+		static const C_UInt32 SLOT_MASK = (1U << SLOT_BITS) - 1;
+		static const C_UInt32 GEN_MASK = 0x7F;
+
+		CNodeTable(): fFreeHead(-1), fCount(0) { }
+
+		/// get the handle of a GDS node, and create one if not existing
+		int Handle(PdGDSObj Obj)
+		{
+			C_Int32 i = _Lookup(Obj);
+			if (i < 0)
+			{
+				if (fFreeHead >= 0)
+				{
+					i = fFreeHead;
+					fFreeHead = fSlot[i].NextFree;
+				} else {
+					if (fSlot.size() > SLOT_MASK)
+						throw ErrGDSFmt("Too many GDS node handles.");
+					i = fSlot.size();
+					fSlot.push_back(TSlot());
+					fSlot[i].Gen = 0;
+				}
+				fSlot[i].Obj = Obj;
+				fSlot[i].NextFree = -1;
+				fSlot[i].Pool = PoolIndexOf(Obj);
+				fSlot[i].Forward = -1;
+				fSlot[i].Moved = false;
+				_Insert(Obj, i);
+			}
+			return (int)(i | (fSlot[i].Gen << SLOT_BITS));
+		}
+
+		/// get the GDS node of a handle, or NULL if the handle is invalid
+		PdGDSObj Get(int handle)
+		{
+			C_Int32 i = _Index(handle);
+			if (i < 0) return NULL;
+			TSlot &s = fSlot[i];
+			if (!s.Obj)
+			{
+				if (s.Forward >= 0)
+					return Get(s.Forward);
+				if (s.Pool >= 0)
+					_Attach(i);
+			} else if (s.Pool >= 0)
+				TouchPoolFile(s.Pool);
+			return s.Obj;
+		}
+
+		/// return true if the node of a handle has been reloaded
+		bool Moved(int handle) const
+		{
+			C_Int32 i = _Index(handle);
+			return (i >= 0) && fSlot[i].Moved;
+		}
+
+		/// release the handle of a GDS node if any
+		void Remove(PdGDSObj Obj)
+		{
+			C_Int32 i = _Lookup(Obj);
+			if (i >= 0) RemoveSlot(i);
+		}
+
+		/// the number of slots
+		COREARRAY_INLINE size_t SlotCount() const { return fSlot.size(); }
+		/// the GDS node in a slot, or NULL if the slot is free
+		COREARRAY_INLINE PdGDSObj Slot(size_t i) const { return fSlot[i].Obj; }
+
+		/// the pooled file of a detached slot, or -1
+		COREARRAY_INLINE int SlotPool(size_t i) const
+			{ return fSlot[i].Obj ? -1 : fSlot[i].Pool; }
+
+		/// release the handle in a slot
+		void RemoveSlot(size_t i)
+		{
+			TSlot &s = fSlot[i];
+			if (s.Obj || (s.Pool >= 0))
+			{
+				if (s.Obj) _Erase(s.Obj);
+				s.Obj = NULL;
+				s.Pool = s.Forward = -1;
+				s.Path.clear();
+				s.Gen = (s.Gen + 1) & GEN_MASK;
+				s.NextFree = fFreeHead;
+				fFreeHead = i;
+			}
+		}
+
+		/// detach the slot of a node in the pooled file 'PoolIdx'
+		void DetachSlot(size_t i, int PoolIdx)
+		{
+			TSlot &s = fSlot[i];
+			if (s.Obj)
+			{
+				s.Path = s.Obj->FullName();
+				_Erase(s.Obj);
+				s.Obj = NULL;
+				s.Pool = PoolIdx;
+				s.Forward = -1;
+				s.Moved = true;
+			}
+		}
+
+		/// release all handles
+		void Clear()
+		{
+			fSlot.clear(); fHash.clear();
+			fFreeHead = -1; fCount = 0;
+		}
+
+	private:
+		struct TSlot
+		{
+			PdGDSObj Obj;      ///< the GDS node, NULL for a free or detached slot
+			C_UInt32 Gen;      ///< the generation of this slot
+			C_Int32 NextFree;  ///< the next free slot, -1 for the end
+			C_Int32 Pool;      ///< the pooled file of the node, or -1
+			C_Int32 Forward;   ///< the handle of the reloaded node, or -1
+			bool Moved;        ///< whether the node has been reloaded
+			UTF8String Path;   ///< the node path of a detached slot
+		};
+
+		vector<TSlot> fSlot;    ///< the slots
+		C_Int32 fFreeHead;      ///< the first free slot
+		vector<C_Int32> fHash;  ///< node pointer to slot, -1 for empty
+		size_t fCount;          ///< the number of nodes in fHash
+
+		C_Int32 _Index(int handle) const
+		{
+			if (handle < 0) return -1;
+			size_t i = (C_UInt32)handle & SLOT_MASK;
+			if (i >= fSlot.size()) return -1;
+			if (fSlot[i].Gen != ((C_UInt32)handle >> SLOT_BITS)) return -1;
+			return i;
+		}
+
+		void _Attach(C_Int32 i)
+		{
+			// reloading may evict other files, but never adds slots
+			PdGDSObj Obj = AttachPoolNode(fSlot[i].Pool, fSlot[i].Path);
+			TSlot &s = fSlot[i];
+			if (!Obj) return;
+			C_Int32 j = _Lookup(Obj);
+			if (j >= 0)
+			{
+				// the reloaded node has got another handle
+				s.Forward = (int)(j | (fSlot[j].Gen << SLOT_BITS));
+			} else {
+				s.Obj = Obj;
+				_Insert(Obj, i);
+			}
+			s.Path.clear();
+		}
+
+		static size_t _Hash(PdGDSObj Obj)
+		{
+			size_t h = (size_t)Obj >> 4;
+			return h ^ (h >> 16) ^ (h * 0x9E3779B1U);
+		}
 
-	/// mapping from GDS objects to indices
-	COREARRAY_DLL_LOCAL map<PdGDSObj, int> PKG_GDSObj_Map;
+		C_Int32 _Lookup(PdGDSObj Obj) const
+		{
+			if (fHash.empty()) return -1;
+			const size_t mask = fHash.size() - 1;
+			for (size_t k = _Hash(Obj) & mask; ; k = (k + 1) & mask)
+			{
+				C_Int32 i = fHash[k];
+				if (i < 0) return -1;
+				if (fSlot[i].Obj == Obj) return i;
+			}
+		}
+
+		void _Insert(PdGDSObj Obj, C_Int32 idx)
+		{
+			if (2*(fCount + 1) > fHash.size())
+			{
+				// rebuild, at most half full
+				size_t sz = fHash.empty() ? 1024 : 2*fHash.size();
+				fHash.assign(sz, -1);
+				fCount = 0;
+				for (size_t i=0; i < fSlot.size(); i++)
+					if (fSlot[i].Obj && ((C_Int32)i != idx)) _Place(i);
+			}
+			_Place(idx);
+		}
+
+		void _Place(C_Int32 idx)
+		{
+			const size_t mask = fHash.size() - 1;
+			size_t k = _Hash(fSlot[idx].Obj) & mask;
+			while (fHash[k] >= 0) k = (k + 1) & mask;
+			fHash[k] = idx;
+			fCount ++;
+		}
+
+		void _Erase(PdGDSObj Obj)
+		{
+			const size_t mask = fHash.size() - 1;
+			size_t k = _Hash(Obj) & mask;
+			while (fSlot[fHash[k]].Obj != Obj) k = (k + 1) & mask;
+			// backward-shift deletion for linear probing
+			size_t j = k;
+			for (;;)
+			{
+				j = (j + 1) & mask;
+				if (fHash[j] < 0) break;
+				size_t h = _Hash(fSlot[fHash[j]].Obj) & mask;
+				if (((j > k) && ((h <= k) || (h > j))) ||
+					((j < k) && ((h <= k) && (h > j))))
+				{
+					fHash[k] = fHash[j];
+					k = j;
+				}
+			}
+			fHash[k] = -1;
+			fCount --;
+		}
+	};
+
+	/// the handles of GDS objects used in Julia
+	COREARRAY_DLL_LOCAL CNodeTable PKG_GDSObj_Table;
+
+	/// get the handle of a GDS node, and create one if not existing
+	COREARRAY_DLL_LOCAL int GetNodeHandle(PdGDSObj Obj)
+	{
+		return PKG_GDSObj_Table.Handle(Obj);
+	}
+
+	/// get the GDS node of a handle, or NULL if the handle is invalid
+	COREARRAY_DLL_LOCAL PdGDSObj GetHandleNode(int Handle)
+	{
+		return PKG_GDSObj_Table.Get(Handle);
+	}
+
+	/// return true if the node of a handle has been reloaded from the pool
+	COREARRAY_DLL_LOCAL bool IsMovedHandle(int Handle)
+	{
+		return PKG_GDSObj_Table.Moved(Handle);
+	}
+
+
+	/// the pool of GDS files opened on demand
+	/** Many files can be registered, but only the most recently used ones
+	 *  (up to MaxOpen) keep their OS handles and loaded trees. An evicted
+	 *  file is synchronized (if writable) and closed, and it is reopened
+	 *  when it or one of its nodes is accessed. Eviction is deferred while
+	 *  the pool is locked, e.g., during a call using several nodes.
+	**/
+	class COREARRAY_DLL_LOCAL CFilePool
+	{
+	public:
+		CFilePool(): fMaxOpen(PKG_DEFAULT_NUM_POOL_FILES), fNumOpen(0),
+			fClock(0), fLock(0) { }
+
+		/// register a file, and return its index in the pool
+		int Open(const char *FileName, bool ReadOnly)
+		{
+			int i;
+			if (!fFree.empty())
+			{
+				i = fFree.back();
+				fFree.pop_back();
+			} else {
+				i = fList.size();
+				fList.push_back(TEntry());
+			}
+			TEntry &E = fList[i];
+			E.FileName = FileName;
+			E.ReadOnly = ReadOnly;
+			E.File = NULL;
+			E.Stamp = 0;
+			E.Used = true;
+			try {
+				File(i);
+			} catch (...) {
+				E.Used = false;
+				fFree.push_back(i);
+				throw;
+			}
+			return i;
+		}
+
+		/// get the file (reopened if evicted)
+		PdGDSFile File(int i)
+		{
+			if (!IsValid(i))
+				throw ErrGDSFmt("The GDS file has been closed, or invalid.");
+			TEntry &E = fList[i];
+			E.Stamp = ++fClock;
+			if (!E.File)
+			{
+				_Trim(fMaxOpen - 1, i);
+				PdGDSFile file = new CdGDSFile;
+				try {
+					file->LoadFileFork(E.FileName.c_str(), E.ReadOnly);
+				} catch (...) {
+					delete file;
+					throw;
+				}
+				E.File = file;
+				fNumOpen ++;
+			}
+			return E.File;
+		}
+
+		/// mark an opened file as recently used
+		COREARRAY_INLINE void Touch(int i)
+		{
+			if (IsValid(i) && fList[i].File)
+				fList[i].Stamp = ++fClock;
+		}
+
+		/// close a file, and release the handles of its nodes
+		void Close(int i)
+		{
+			if (!IsValid(i)) return;
+			TEntry &E = fList[i];
+			for (size_t k=0; k < PKG_GDSObj_Table.SlotCount(); k++)
+			{
+				if ((PKG_GDSObj_Table.SlotPool(k) == i) ||
+					(E.File && (_SlotFile(k) == E.File)))
+				{
+					PKG_GDSObj_Table.RemoveSlot(k);
+				}
+			}
+			PdGDSFile file = E.File;
+			E.File = NULL;
+			E.Used = false;
+			E.FileName.clear();
+			fFree.push_back(i);
+			if (file)
+			{
+				fNumOpen --;
+				delete file;
+			}
+		}
+
+		/// close all files
+		void Clear()
+		{
+			for (size_t i=0; i < fList.size(); i++)
+			{
+				if (fList[i].File)
+				{
+					try { delete fList[i].File; }
+					catch (...) { }
+					fList[i].File = NULL;
+				}
+			}
+			fList.clear(); fFree.clear();
+			fNumOpen = 0;
+		}
+
+		/// whether 'i' is a registered file
+		COREARRAY_INLINE bool IsValid(int i) const
+			{ return (i >= 0) && (i < (int)fList.size()) && fList[i].Used; }
+		/// the index of an opened file, or -1
+		int Find(PdGDSFile file) const
+		{
+			for (size_t i=0; i < fList.size(); i++)
+				if (fList[i].Used && (fList[i].File == file)) return i;
+			return -1;
+		}
+		/// the index of a file name, or -1
+		int Find(const char *FileName) const
+		{
+			for (size_t i=0; i < fList.size(); i++)
+				if (fList[i].Used && (fList[i].FileName == FileName)) return i;
+			return -1;
+		}
+
+		/// the maximum number of opened files
+		COREARRAY_INLINE int MaxOpen() const { return fMaxOpen; }
+		/// set the maximum number of opened files
+		void SetMaxOpen(int n)
+		{
+			if (n < 1)
+				throw ErrGDSFmt("The number of opened files should be >= 1.");
+			fMaxOpen = n;
+			_Trim(fMaxOpen, -1);
+		}
+		/// the number of opened files
+		COREARRAY_INLINE int NumOpen() const { return fNumOpen; }
+
+		/// defer eviction
+		void Lock() { fLock ++; }
+		/// allow eviction, and evict the files over the limit
+		void Unlock()
+		{
+			if (--fLock == 0)
+			{
+				try { _Trim(fMaxOpen, -1); }
+				catch (...) { }
+			}
+		}
+
+	private:
+		struct TEntry
+		{
+			string FileName;  ///< the file name
+			bool ReadOnly;    ///< read-only mode
+			PdGDSFile File;   ///< the opened file, or NULL if evicted
+			C_UInt64 Stamp;   ///< the time stamp of last access
+			bool Used;        ///< whether the entry is used
+		};
+
+		vector<TEntry> fList;  ///< the registered files
+		vector<int> fFree;     ///< the unused entries
+		int fMaxOpen;          ///< the maximum number of opened files
+		int fNumOpen;          ///< the number of opened files
+		C_UInt64 fClock;       ///< the current time stamp
+		int fLock;             ///< the lock count
+
+		/// the GDS file of a node handle (the host file for a virtual folder)
+		static PdGDSFile _SlotFile(size_t k)
+		{
+			PdGDSObj Obj = PKG_GDSObj_Table.Slot(k);
+			if (!Obj) return NULL;
+			while (Obj->Folder()) Obj = Obj->Folder();
+			return Obj->GDSFile();
+		}
+
+		/// evict the least recently used files until at most 'n' are opened
+		void _Trim(int n, int keep)
+		{
+			if (fLock > 0) return;
+			while (fNumOpen > n)
+			{
+				int k = -1;
+				for (size_t i=0; i < fList.size(); i++)
+				{
+					const TEntry &E = fList[i];
+					if (E.File && ((int)i != keep) &&
+						((k < 0) || (E.Stamp < fList[k].Stamp)))
+						k = i;
+				}
+				if (k < 0) break;
+				_Evict(k);
+			}
+		}
+
+		/// close an opened file, and detach the handles of its nodes
+		void _Evict(int i)
+		{
+			TEntry &E = fList[i];
+			PdGDSFile file = E.File;
+			if (!E.ReadOnly) file->SyncFile();
+			for (size_t k=0; k < PKG_GDSObj_Table.SlotCount(); k++)
+			{
+				if (_SlotFile(k) == file)
+					PKG_GDSObj_Table.DetachSlot(k, i);
+			}
+			E.File = NULL;
+			fNumOpen --;
+			delete file;
+		}
+	};
+
+	/// the pool of GDS files opened on demand
+	COREARRAY_DLL_LOCAL CFilePool PKG_File_Pool;
+
+	COREARRAY_DLL_LOCAL PdGDSObj AttachPoolNode(int PoolIdx,
+		const UTF8String &Path)
+	{
+		if (!PKG_File_Pool.IsValid(PoolIdx)) return NULL;
+		return PKG_File_Pool.File(PoolIdx)->Root().PathEx(Path);
+	}
+
+	COREARRAY_DLL_LOCAL int PoolIndexOf(PdGDSObj Obj)
+	{
+		if (PKG_File_Pool.NumOpen() <= 0) return -1;
+		while (Obj->Folder()) Obj = Obj->Folder();
+		PdGDSFile file = Obj->GDSFile();
+		return file ? PKG_File_Pool.Find(file) : -1;
+	}
+
+	COREARRAY_DLL_LOCAL void TouchPoolFile(int PoolIdx)
+	{
+		PKG_File_Pool.Touch(PoolIdx);
+	}
+
+	/// register a file in the pool, and return its file ID
+	COREARRAY_DLL_LOCAL int FilePoolOpen(const char *FileName, bool ReadOnly)
+	{
+		return PKG_MAX_NUM_GDS_FILES + PKG_File_Pool.Open(FileName, ReadOnly);
+	}
+
+	/// close a file in the pool
+	COREARRAY_DLL_LOCAL void FilePoolClose(int file_id)
+	{
+		PKG_File_Pool.Close(file_id - PKG_MAX_NUM_GDS_FILES);
+	}
+
+	/// whether a file name has been registered in the pool
+	COREARRAY_DLL_LOCAL bool FilePoolHas(const char *FileName)
+	{
+		return PKG_File_Pool.Find(FileName) >= 0;
+	}
+
+	/// set the maximum number of opened files in the pool if n > 0,
+	/// and return the maximum number
+	COREARRAY_DLL_LOCAL int FilePoolMaxOpen(int n)
+	{
+		if (n > 0) PKG_File_Pool.SetMaxOpen(n);
+		return PKG_File_Pool.MaxOpen();
+	}
+
+	/// the number of opened files in the pool
+	COREARRAY_DLL_LOCAL int FilePoolNumOpen()
+	{
+		return PKG_File_Pool.NumOpen();
+	}
+
+	/// defer the eviction of pooled files
+	COREARRAY_DLL_LOCAL void FilePoolLock()
+	{
+		PKG_File_Pool.Lock();
+	}
+
+	/// allow the eviction of pooled files
+	COREARRAY_DLL_LOCAL void FilePoolUnlock()
+	{
+		PKG_File_Pool.Unlock();
+	}
 
 
 	/// initialization and finalization
@@ -81,14 +621,13 @@ namespace jugds
 		CInitObject()
 		{
 			memset(PKG_GDS_Files, 0, sizeof(PKG_GDS_Files));
-			PKG_GDSObj_List.reserve(1024);
 		}
 
 		/// finalization
 		~CInitObject()
 		{
-			PKG_GDSObj_Map.clear();
-			PKG_GDSObj_Map.clear();
+			PKG_GDSObj_Table.Clear();
+			PKG_File_Pool.Clear();
 
 			for (int i=0; i < PKG_MAX_NUM_GDS_FILES; i++)
 			{
@@ -120,13 +659,21 @@ extern "C"
 static const char *ERR_WRITE_ONLY =
 	"Writable only and please call 'readmode()' before reading.";
 
+// interned attribute names
+static const CdObjAttr::TdKey ATTR_R_LOGICAL("R.logical");
+static const CdObjAttr::TdKey ATTR_R_CLASS("R.class");
+static const CdObjAttr::TdKey ATTR_R_LEVELS("R.levels");
+
 
 // ===========================================================================
 // Python objects
 
 COREARRAY_DLL_EXPORT PdGDSFile GDS_ID2File(int file_id)
 {
-	if ((file_id < 0) || (file_id >= PKG_MAX_NUM_GDS_FILES))
+	// a pooled file, reopened if it has been evicted
+	if (file_id >= PKG_MAX_NUM_GDS_FILES)
+		return PKG_File_Pool.File(file_id - PKG_MAX_NUM_GDS_FILES);
+	if (file_id < 0)
 		throw ErrGDSFmt("The GDS file ID (%d) is invalid.", file_id);
 
 	PdGDSFile file = PKG_GDS_Files[file_id];
@@ -146,16 +693,17 @@ COREARRAY_DLL_EXPORT PdGDSFolder GDS_ID2FileRoot(int file_id)
 
 COREARRAY_DLL_EXPORT C_BOOL GDS_Is_RLogical(PdGDSObj Obj)
 {
-	return Obj->Attribute().HasName("R.logical");
+	return Obj->Attribute().HasName(ATTR_R_LOGICAL);
 }
 
 
 COREARRAY_DLL_EXPORT C_BOOL GDS_Is_RFactor(PdGDSObj Obj)
 {
-	if (Obj->Attribute().HasName("R.class") &&
-		Obj->Attribute().HasName("R.levels"))
+	CdObjAttr &Attr = Obj->Attribute();
+	int i = Attr.IndexName(ATTR_R_CLASS);
+	if ((i >= 0) && Attr.HasName(ATTR_R_LEVELS))
 	{
-		return (Obj->Attribute()["R.class"].GetStr8() == "factor");
+		return (Attr[i].GetStr8() == "factor");
 	} else
 		return false;
 }
@@ -268,7 +816,7 @@ COREARRAY_DLL_EXPORT jl_array_t* GDS_JArray_Read(PdAbstractArray Obj,
 		{
 			// it is an R factor
 			int nlevels = 0;
-			CdAny &attr = Obj->Attribute()["R.levels"];
+			CdAny &attr = Obj->Attribute()[ATTR_R_LEVELS];
 			if (attr.IsString())
 				nlevels = 1;
 			else if (attr.IsArray())
@@ -450,19 +998,25 @@ COREARRAY_DLL_EXPORT PdGDSFile GDS_File_Open(const char *FileName,
 
 COREARRAY_DLL_EXPORT void GDS_File_Close(PdGDSFile File)
 {
+	int pool_idx = PKG_File_Pool.Find(File);
+	if (pool_idx >= 0)
+	{
+		PKG_File_Pool.Close(pool_idx);
+		return;
+	}
+
 	int gds_idx = GetFileIndex(File, false);
 	if (gds_idx >= 0)
 	{
 		PKG_GDS_Files[gds_idx] = NULL;
 
-		// delete GDS objects in PKG_GDSObj_Map and PKG_GDSObj_Map
-		vector<PdGDSObj>::iterator p = PKG_GDSObj_List.begin();
-		for (; p != PKG_GDSObj_List.end(); p++)
+		// release the handles of GDS objects in the file
+		for (size_t i=0; i < PKG_GDSObj_Table.SlotCount(); i++)
 		{
-			if (*p != NULL)
+			PdGDSObj Obj = PKG_GDSObj_Table.Slot(i);
+			if (Obj != NULL)
 			{
 				// for a virtual folder
-				PdGDSObj Obj = *p;
 				PdGDSFolder Folder = Obj->Folder();
 				while (Folder != NULL)
 				{
@@ -471,10 +1025,7 @@ COREARRAY_DLL_EXPORT void GDS_File_Close(PdGDSFile File)
 				}
 				// Obj is the root, and then get the GDS file
 				if (Obj->GDSFile() == File)
-				{
-					PKG_GDSObj_Map.erase(*p);
-					*p = NULL;
-				}
+					PKG_GDSObj_Table.RemoveSlot(i);
 			}
 		}
 	}
@@ -504,20 +1055,15 @@ COREARRAY_DLL_EXPORT void GDS_Node_Delete(PdGDSObj Node, C_BOOL Force)
 {
 	if (Node != NULL)
 	{
-		vector<C_BOOL> DeleteArray;
+		vector<size_t> DeleteArray;
 		if (dynamic_cast<CdGDSAbsFolder*>(Node))
 		{
-			DeleteArray.resize(PKG_GDSObj_Map.size(), false);
-			size_t idx = 0;
-			vector<PdGDSObj>::iterator p = PKG_GDSObj_List.begin();
-			for (; p != PKG_GDSObj_List.end(); p++)
+			CdGDSAbsFolder *Dir = static_cast<CdGDSAbsFolder*>(Node);
+			for (size_t i=0; i < PKG_GDSObj_Table.SlotCount(); i++)
 			{
-				if (*p != NULL)
-				{
-					if (static_cast<CdGDSAbsFolder*>(Node)->HasChild(*p, true))
-						DeleteArray[idx] = true;
-				}
-				idx ++;
+				PdGDSObj Obj = PKG_GDSObj_Table.Slot(i);
+				if (Obj && Dir->HasChild(Obj, true))
+					DeleteArray.push_back(i);
 			}
 		}
 
@@ -526,27 +1072,10 @@ COREARRAY_DLL_EXPORT void GDS_Node_Delete(PdGDSObj Node, C_BOOL Force)
 		else
 			throw ErrGDSFmt("Can not delete the root.");
 
-		// delete GDS objects in PKG_GDSObj_Map and PKG_GDSObj_Map
-		vector<PdGDSObj>::iterator p = PKG_GDSObj_List.begin();
-		for (; p != PKG_GDSObj_List.end(); p++)
-			if (*p == Node) *p = NULL;
-		PKG_GDSObj_Map.erase(Node);
-
-		if (!DeleteArray.empty())
-		{
-			size_t idx = 0;
-			vector<C_BOOL>::iterator p = DeleteArray.begin();
-			for (; p != DeleteArray.end(); p++)
-			{
-				if (*p)
-				{
-					PdGDSObj &Obj = PKG_GDSObj_List[idx];
-					PKG_GDSObj_Map.erase(Obj);
-					Obj = NULL;
-				}
-				idx ++;
-			}
-		}
+		// release the handles of the deleted GDS objects
+		PKG_GDSObj_Table.Remove(Node);
+		for (size_t i=0; i < DeleteArray.size(); i++)
+			PKG_GDSObj_Table.RemoveSlot(DeleteArray[i]);
 	}
 }
 
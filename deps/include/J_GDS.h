@@ -94,6 +94,9 @@ extern "C" {
 	/// the maximum number of GDS files
 	#define PKG_MAX_NUM_GDS_FILES    1024
 
+	/// the default number of opened files in the file pool
+	#define PKG_DEFAULT_NUM_POOL_FILES    128
+
 	/// the maximun number of dimensions in GDS array (it has been specified in the library)
 	#define GDS_MAX_NUM_DIMENSION    256
 
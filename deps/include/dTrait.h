@@ -70,6 +70,7 @@ namespace CoreArray
 	#define COREARRAY_TR_STRING                  (COREARRAY_TR_STRING_FLAG | 0)
 	#define COREARRAY_TR_FIXED_LEN_STRING        (COREARRAY_TR_STRING_FLAG | 1)
 	#define COREARRAY_TR_VARIABLE_LEN_STRING     (COREARRAY_TR_STRING_FLAG | 2)
+	#define COREARRAY_TR_DICT_STRING             (COREARRAY_TR_STRING_FLAG | 3)
 
 
 
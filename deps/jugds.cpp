@@ -24,14 +24,22 @@
 #include <string>
 #include <set>
 #include <map>
+#include <algorithm>
 
 
 namespace jugds
 {
 	extern PdGDSFile PKG_GDS_Files[];
-	extern vector<PdGDSObj> PKG_GDSObj_List;
-	extern map<PdGDSObj, int> PKG_GDSObj_Map;
+	extern int GetNodeHandle(PdGDSObj Obj);
+	extern PdGDSObj GetHandleNode(int Handle);
 	extern int GetFileIndex(PdGDSFile file, bool throw_error=true);
+	extern bool IsMovedHandle(int Handle);
+	extern int FilePoolOpen(const char *FileName, bool ReadOnly);
+	extern void FilePoolClose(int file_id);
+	extern bool FilePoolHas(const char *FileName);
+	extern int FilePoolMaxOpen(int n);
+	extern void FilePoolLock();
+	extern void FilePoolUnlock();
 
 
 	/// initialization and finalization
@@ -117,6 +125,15 @@ namespace jugds
 			ClassMap["sp.uint16"] = TdTraits< TSpUInt16 >::StreamName();
 			ClassMap["sp.uint32"] = TdTraits< TSpUInt32 >::StreamName();
 			ClassMap["sp.uint64"] = TdTraits< TSpUInt64 >::StreamName();
+			ClassMap["tile.int"]   = TdTraits< TTileInt32 >::StreamName();
+			ClassMap["tile.int8"]  = TdTraits< TTileInt8 >::StreamName();
+			ClassMap["tile.int16"] = TdTraits< TTileInt16 >::StreamName();
+			ClassMap["tile.int32"] = TdTraits< TTileInt32 >::StreamName();
+			ClassMap["tile.int64"] = TdTraits< TTileInt64 >::StreamName();
+			ClassMap["tile.uint8"]  = TdTraits< TTileUInt8 >::StreamName();
+			ClassMap["tile.uint16"] = TdTraits< TTileUInt16 >::StreamName();
+			ClassMap["tile.uint32"] = TdTraits< TTileUInt32 >::StreamName();
+			ClassMap["tile.uint64"] = TdTraits< TTileUInt64 >::StreamName();
 
 
 			// ==============================================================
@@ -134,6 +151,9 @@ namespace jugds
 			ClassMap["sp.real"]    = TdTraits< TSpReal64 >::StreamName();
 			ClassMap["sp.real32"]  = TdTraits< TSpReal32 >::StreamName();
 			ClassMap["sp.real64"]  = TdTraits< TSpReal64 >::StreamName();
+			ClassMap["tile.real"]    = TdTraits< TTileReal64 >::StreamName();
+			ClassMap["tile.real32"]  = TdTraits< TTileReal32 >::StreamName();
+			ClassMap["tile.real64"]  = TdTraits< TTileReal64 >::StreamName();
 
 
 			// ==============================================================
@@ -147,6 +167,9 @@ namespace jugds
 			ClassMap["fstring"  ] = TdTraits< FIXED_LEN<C_UTF8>  >::StreamName();
 			ClassMap["fstring16"] = TdTraits< FIXED_LEN<C_UTF16> >::StreamName();
 			ClassMap["fstring32"] = TdTraits< FIXED_LEN<C_UTF32> >::StreamName();
+			ClassMap["dstring"  ] = TdTraits< DICT_STRING<C_UTF8>  >::StreamName();
+			ClassMap["dstring16"] = TdTraits< DICT_STRING<C_UTF16> >::StreamName();
+			ClassMap["dstring32"] = TdTraits< DICT_STRING<C_UTF32> >::StreamName();
 
 
 			// ==============================================================
@@ -179,6 +202,297 @@ using namespace CoreArray;
 using namespace jugds;
 
 
+/// read the codes and dictionary of a dictionary-encoded string
+template<typename TYPE>
+static jl_array_t* read_dict(CdDictStr<TYPE> *Obj, const C_Int32 *Start,
+	const C_Int32 *Length)
+{
+	CdAbstractArray::TArrayDim St, Cnt;
+	if (Start == NULL)
+	{
+		memset(St, 0, sizeof(St));
+		Start = St;
+	}
+	if (Length == NULL)
+	{
+		Obj->GetDim(Cnt);
+		Length = Cnt;
+	}
+
+	// load the dictionary before allocating any Julia object
+	const vector<typename CdDictStr<TYPE>::TType> &D = Obj->Dictionary();
+
+	// create the array of codes
+	int ndim = Obj->DimCnt();
+	jl_value_t *atype = jl_apply_array_type((jl_value_t*)jl_uint32_type, ndim);
+	jl_array_t *codes = NULL, *dict = NULL, *rv_ans = NULL;
+	switch (ndim)
+	{
+		case 1:
+			codes = jl_alloc_array_1d(atype, Length[0]);
+			break;
+		case 2:
+			codes = jl_alloc_array_2d(atype, Length[1], Length[0]);
+			break;
+		case 3:
+			codes = jl_alloc_array_3d(atype, Length[2], Length[1], Length[0]);
+			break;
+		default:
+			throw ErrGDSFmt("The current implementation does not support more than 3 dims. Please asks the author to extend the function.");
+	}
+	JL_GC_PUSH3(&codes, &dict, &rv_ans);
+	Obj->ReadCode(Start, Length, NULL, (C_UInt32*)jl_array_data(codes));
+
+	// create the dictionary
+	atype = jl_apply_array_type((jl_value_t*)jl_string_type, 1);
+	dict = jl_alloc_array_1d(atype, D.size());
+	void **p = (void**)jl_array_data(dict);
+	for (size_t i=0; i < D.size(); i++)
+	{
+		UTF8String s = VAL_CONVERT(UTF8String,
+			typename CdDictStr<TYPE>::TType, D[i]);
+		p[i] = jl_pchar_to_string(s.c_str(), s.size());
+		jl_gc_wb(dict, p[i]);
+	}
+
+	// output
+	atype = jl_apply_array_type((jl_value_t*)jl_any_type, 1);
+	rv_ans = jl_alloc_array_1d(atype, 2);
+	p = (void**)jl_array_data(rv_ans);
+	p[0] = codes; jl_gc_wb(rv_ans, codes);
+	p[1] = dict;  jl_gc_wb(rv_ans, dict);
+	JL_GC_POP();
+	return rv_ans;
+}
+
+
+/// Recompress groups of GDS nodes, one group per thread
+class CdRecompressNodes
+{
+public:
+	CdRecompressNodes(vector< vector<CdGDSObjPipe*> > &groups,
+		const char *mode, int nthread): Groups(groups), Mode(mode)
+	{
+		NumThread = nthread;
+		Next = 0;
+		Failed = false;
+	}
+
+	void Run()
+	{
+		int n = (int)Groups.size();
+		int nt = (NumThread < n) ? NumThread : n;
+		if (nt < 1) nt = 1;
+		// the threads left are used to compress the blocks of each node
+		NodeThread = NumThread / nt;
+		if (NodeThread < 1) NodeThread = 1;
+		CoreArray::Parallel::CParallelBase P(nt);
+		P.RunThreads(&CdRecompressNodes::Proc, this);
+		if (Failed)
+			throw ErrGDSFmt(ErrMsg);
+	}
+
+private:
+	vector< vector<CdGDSObjPipe*> > &Groups;
+	const char *Mode;
+	int NumThread, NodeThread;
+	size_t Next;
+	CdThreadMutex Mutex;
+	bool Failed;
+	string ErrMsg;
+
+	void Proc(CdThread *Thread, int Index)
+	{
+		try {
+			while (true)
+			{
+				size_t i;
+				{
+					TdAutoMutex _m(&Mutex);
+					if (Failed || (Next >= Groups.size())) break;
+					i = Next ++;
+				}
+				vector<CdGDSObjPipe*> &G = Groups[i];
+				for (size_t j=0; j < G.size(); j++)
+					G[j]->Recompress(Mode, NodeThread);
+			}
+		}
+		catch (exception &E) {
+			TdAutoMutex _m(&Mutex);
+			if (!Failed) ErrMsg = E.what();
+			Failed = true;
+		}
+	}
+};
+
+
+/// The function applied to a block of data in parallel, buf[i] is the data
+/// of the i-th node, and the returned pointer is passed to the collector
+typedef void* (*TApplyFunc)(int thread, C_Int64 start, int count,
+	void *const *buf, void *param);
+/// The collector of block results, called by one thread at a time
+typedef void (*TCollectFunc)(C_Int64 start, int count, void *result,
+	void *param);
+
+/// A parallel queue whose threads all run in the thread pool, so the Julia
+/// callbacks are never called by the calling Julia thread which waits in a
+/// GC-safe region (a callback allocating may start a GC)
+class CdApplyQueue: public CoreArray::Parallel::CParallelQueueEx
+{
+public:
+	CdApplyQueue(int nThread): CParallelQueueEx(nThread)
+		{ SetPoolOnly(true); }
+protected:
+	C_Int8 fGCState;
+	virtual void BeginWait() { fGCState = (jl_gc_safe_enter)(); }
+	virtual void EndWait() { (jl_gc_safe_leave)(fGCState); }
+};
+
+/// Apply a function over the blocks of aligned nodes in a thread pool, the
+/// blocks are decoded in order by one thread at a time since the nodes may
+/// share a stream, and the function runs on the decoded blocks in parallel
+class CdApplyBlocks
+{
+public:
+	CdApplyBlocks(vector<CdAbstractArray*> &nodes, vector<int> &margin,
+		vector<C_SVType> &sv, C_Int64 blocksize, TApplyFunc fun,
+		TCollectFunc collect, void *param, bool ordered):
+		Nodes(nodes), Margin(margin), SV(sv)
+	{
+		BlockSize = blocksize;
+		Fun = fun; Collect = collect; Param = param;
+		Ordered = ordered;
+		NextRead = 0;
+		Failed = false;
+		// the length of margin, and the size of a margin unit
+		MarginLen = -1;
+		for (size_t i=0; i < Nodes.size(); i++)
+		{
+			CdAbstractArray::TArrayDim D;
+			Nodes[i]->GetDim(D);
+			C_Int64 n = 1;
+			for (int j=0; j < Nodes[i]->DimCnt(); j++)
+				if (j != Margin[i]) n *= D[j];
+			UnitSize.push_back(n);
+			if (MarginLen < 0)
+				MarginLen = D[Margin[i]];
+			else if (MarginLen != D[Margin[i]])
+				throw ErrGDSFmt("The nodes are not aligned along the margin.");
+		}
+		if (MarginLen < 0) MarginLen = 0;
+	}
+
+	void Run(int nthread)
+	{
+		if (nthread < 1) nthread = 1;
+		C_Int64 NumBlock = (MarginLen + BlockSize - 1) / BlockSize;
+		// one block at a time for each thread, to decode the blocks in order
+		CdApplyQueue P(nthread);
+		P.RunThreads<CdApplyBlocks, C_Int64, void*, TThreadData>(NumBlock,
+			4*nthread, 1, &CdApplyBlocks::Proc, &CdApplyBlocks::Queue,
+			&CdApplyBlocks::InitThread, this, 0);
+		if (Failed)
+			throw ErrGDSFmt(ErrMsg);
+	}
+
+private:
+	/// the buffers of a thread
+	struct TThreadData
+	{
+		int Index;
+		vector< vector<C_UInt8> > Buffer;
+		vector<void*> Ptr;
+	};
+
+	vector<CdAbstractArray*> &Nodes;
+	vector<int> &Margin;
+	vector<C_SVType> &SV;
+	vector<C_Int64> UnitSize;
+	C_Int64 MarginLen, BlockSize;
+	TApplyFunc Fun;
+	TCollectFunc Collect;
+	void *Param;
+	bool Ordered;
+	/// the block to be decoded next
+	C_Int64 NextRead;
+	CdThreadMutex ReadMutex, CollectMutex;
+	CdThreadCondition ReadCond;
+	bool Failed;
+	string ErrMsg;
+
+	void InitThread(TThreadData &Data, CdThread *Thread, int Index)
+	{
+		Data.Index = Index;
+		Data.Buffer.resize(Nodes.size());
+		Data.Ptr.resize(Nodes.size());
+		for (size_t i=0; i < Nodes.size(); i++)
+		{
+			Data.Buffer[i].resize(UnitSize[i] * BlockSize * SVType_Size(SV[i]));
+			Data.Ptr[i] = Data.Buffer[i].empty() ? NULL : &Data.Buffer[i][0];
+		}
+	}
+
+	void Proc(const C_Int64 &Block, void *&Out, TThreadData &Data)
+	{
+		Out = NULL;
+		C_Int64 st = Block * BlockSize;
+		int cnt = (int)std::min(BlockSize, MarginLen - st);
+		{
+			TdAutoMutex _m(&ReadMutex);
+			while (NextRead < Block) ReadCond.Wait(ReadMutex);
+			try {
+				if (!Failed)
+				{
+					for (size_t i=0; i < Nodes.size(); i++)
+					{
+						CdAbstractArray::TArrayDim DS, DL;
+						Nodes[i]->GetDim(DL);
+						memset(DS, 0, sizeof(DS));
+						DS[Margin[i]] = st; DL[Margin[i]] = cnt;
+						Nodes[i]->ReadData(DS, DL, Data.Ptr[i], SV[i]);
+					}
+				}
+			}
+			catch (exception &E) {
+				if (!Failed) ErrMsg = E.what();
+				Failed = true;
+			}
+			NextRead = Block + 1;
+			ReadCond.Broadcast();
+		}
+		if (Failed) return;
+		Out = (*Fun)(Data.Index, st, cnt, &Data.Ptr[0], Param);
+		if (!Ordered && Collect)
+		{
+			TdAutoMutex _m(&CollectMutex);
+			(*Collect)(st, cnt, Out, Param);
+		}
+	}
+
+	void Queue(const C_Int64 &Block, void **Out, size_t n)
+	{
+		if (!Ordered || !Collect || Failed) return;
+		for (size_t i=0; i < n; i++)
+		{
+			C_Int64 st = (Block + i) * BlockSize;
+			int cnt = (int)std::min(BlockSize, MarginLen - st);
+			(*Collect)(st, cnt, Out[i], Param);
+		}
+	}
+
+	static size_t SVType_Size(C_SVType sv)
+	{
+		switch (sv)
+		{
+			case svInt8:  case svUInt8:   return 1;
+			case svInt16: case svUInt16:  return 2;
+			case svInt32: case svUInt32: case svFloat32:  return 4;
+			default:  return 8;
+		}
+	}
+};
+
+
 extern "C"
 {
 
@@ -190,6 +504,9 @@ static const char *ERR_READ_ONLY =
 static const char *ERR_NO_DATA =
 	"There is no data field.";
 
+// interned attribute names
+static const CdObjAttr::TdKey ATTR_R_INVISIBLE("R.invisible");
+
 
 // ----------------------------------------------------------------------------
 // Internal functions
@@ -219,36 +536,47 @@ static string fmt_size(double b)
 }
 
 
+/// convert a string to C_SVType, return false if it is invalid
+static bool str_to_sv(const char *cvt, C_SVType &sv)
+{
+	if (strcmp(cvt, "") == 0)
+		sv = svCustom;
+	else if (strcmp(cvt, "int8") == 0)
+		sv = svInt8;
+	else if (strcmp(cvt, "uint8") == 0)
+		sv = svUInt8;
+	else if (strcmp(cvt, "int16") == 0)
+		sv = svInt16;
+	else if (strcmp(cvt, "uint16") == 0)
+		sv = svUInt16;
+	else if (strcmp(cvt, "int32") == 0)
+		sv = svInt32;
+	else if (strcmp(cvt, "uint32") == 0)
+		sv = svUInt32;
+	else if (strcmp(cvt, "int64") == 0)
+		sv = svInt64;
+	else if (strcmp(cvt, "uint64") == 0)
+		sv = svUInt64;
+	else if (strcmp(cvt, "float32") == 0)
+		sv = svFloat32;
+	else if (strcmp(cvt, "float64") == 0)
+		sv = svFloat64;
+	else if (strcmp(cvt, "utf8") == 0)
+		sv = svStrUTF8;
+	else if (strcmp(cvt, "utf16") == 0)
+		sv = svStrUTF16;
+	else
+		return false;
+	return true;
+}
+
+
 /// convert "(CdGDSObj*)  -->  PyObject*"
 static void set_obj(CdGDSObj *Obj, int &outidx)
 {
-	static const char *ERR_OBJLIST = "Internal error in GDS node list.";
-
 	if (!Obj)
 		throw ErrGDSFmt("Invalid GDS object [NULL].");
-
-	map<PdGDSObj, int>::iterator it = PKG_GDSObj_Map.find(Obj);
-	if (it != PKG_GDSObj_Map.end())
-	{
-		outidx = it->second;
-		if ((outidx < 0) || (outidx >= (int)PKG_GDSObj_Map.size()))
-			throw ErrGDSFmt(ERR_OBJLIST);
-		if (PKG_GDSObj_List[outidx] != Obj)
-			throw ErrGDSFmt(ERR_OBJLIST);
-	} else {
-		vector<PdGDSObj>::iterator it =
-			find(PKG_GDSObj_List.begin(), PKG_GDSObj_List.end(),
-			(PdGDSObj)NULL);
-		if (it != PKG_GDSObj_List.end())
-		{
-			outidx = it - PKG_GDSObj_List.begin();
-			*it = Obj;
-		} else {
-			outidx = PKG_GDSObj_List.size();
-			PKG_GDSObj_List.push_back(Obj);
-		}
-		PKG_GDSObj_Map[Obj] = outidx;
-	}
+	outidx = GetNodeHandle(Obj);
 }
 
 static CdGDSObj* get_obj(int idx, void *ptr_int)
@@ -260,14 +588,115 @@ static CdGDSObj* get_obj(int idx, void *ptr_int)
 
 	CdGDSObj *ptr = (CdGDSObj *)ptr_int;
 	// check
-	if ((idx < 0) || (idx >= (int)PKG_GDSObj_List.size()))
-		throw ErrGDSFmt(ERR_GDS_OBJ);
-	if (ptr == NULL)
+	if ((idx < 0) || (ptr == NULL))
 		throw ErrGDSFmt(ERR_GDS_OBJ);
-	if (PKG_GDSObj_List[idx] != ptr)
+	// the node of a pooled file may have been reloaded at another address
+	CdGDSObj *Obj = GetHandleNode(idx);
+	if (!Obj || ((Obj != ptr) && !IsMovedHandle(idx)))
 		throw ErrGDSFmt(ERR_GDS_OBJ2);
 
-	return ptr;
+	return Obj;
+}
+
+
+/// defer the eviction of pooled files in a call using several nodes
+class CFilePoolLock
+{
+public:
+	CFilePoolLock() { FilePoolLock(); }
+	~CFilePoolLock() { FilePoolUnlock(); }
+};
+
+
+/// the maximum number of entries in the path cache of 'gdsnIndex'
+static const size_t PATH_CACHE_MAX_SIZE = 65536;
+
+/// the path cache of 'gdsnIndex', (folder handle, path) --> node handle
+static map< pair<int, string>, int > PathCache;
+
+/// return true if 'Obj' is still located at 'path' relative to 'Dir'
+static bool path_cache_valid(CdGDSObj *Dir, const string &path, CdGDSObj *Obj)
+{
+	const char *s = path.c_str();
+	const char *p = s + path.size();
+	while (p > s)
+	{
+		const char *e = p;
+		while ((p > s) && (*(p-1) != '/')) p --;
+		if (!Obj || (Obj->Name() != UTF8String(p, e)))
+			return false;
+		Obj = Obj->Folder();
+		if (p > s) p --;  // skip '/'
+	}
+	return (Obj == Dir);
+}
+
+/// whether a path can be cached (no empty components)
+static bool path_cacheable(const char *path)
+{
+	if (*path == 0) return false;
+	for (const char *p = path; *p; p++)
+	{
+		if ((*p == '/') && ((p == path) || (*(p+1) == '/') || (*(p+1) == 0)))
+			return false;
+	}
+	return true;
+}
+
+/// check the arguments 'start' and 'count' for reading
+static void get_start_count(CdAbstractArray *Obj, jl_array_t *start,
+	jl_array_t *count, CdAbstractArray::TArrayDim dm_st,
+	CdAbstractArray::TArrayDim dm_cnt, C_Int32 *&pDS, C_Int32 *&pDL)
+{
+	// check the argument 'start'
+	int dm_st_n = jl_array_len(start);
+	if (dm_st_n > (int)CdAbstractArray::MAX_ARRAY_DIM)
+		throw ErrGDSFmt("The length of 'start' is invalid.");
+	{
+		C_Int64 *p = (C_Int64*)jl_array_data(start);
+		for (int i=0; i < dm_st_n; i++) dm_st[i] = p[i];
+	}
+
+	// check the argument 'count'
+	int dm_cnt_n = jl_array_len(count);
+	if (dm_cnt_n > (int)CdAbstractArray::MAX_ARRAY_DIM)
+		throw ErrGDSFmt("The length of 'count' is invalid.");
+	{
+		C_Int64 *p = (C_Int64*)jl_array_data(count);
+		for (int i=0; i < dm_cnt_n; i++) dm_cnt[i] = p[i];
+	}
+
+	if ((dm_st_n==0 && dm_cnt_n>0) || (dm_st_n>0 && dm_cnt_n==0))
+		throw ErrGDSFmt("'start' and 'count' should be both None.");
+
+	pDS = pDL = NULL;
+	if (dm_st_n>0 && dm_cnt_n>0)
+	{
+		int Len = Obj->DimCnt();
+		CdAbstractArray::TArrayDim DCnt;
+		Obj->GetDim(DCnt);
+
+		if (dm_st_n != Len)
+			throw ErrGDSFmt("The length of 'start' is invalid.");
+		for (int i=0; i < Len; i++)
+		{
+			if ((dm_st[i] < 0) || (dm_st[i] >= DCnt[i]))
+				throw ErrGDSFmt("'start' is invalid.");
+		}
+		pDS = dm_st;
+
+		if (dm_cnt_n != Len)
+			throw ErrGDSFmt("The length of 'count' is invalid.");
+		for (int i=0; i < Len; i++)
+		{
+			C_Int32 &v = dm_cnt[i];
+			if (v == -1)
+				v = DCnt[i] - dm_st[i];
+			if ((v <= 0) || ((dm_st[i]+v) >= DCnt[i]))
+				throw ErrGDSFmt("'count' is invalid.");
+		}
+		pDL = dm_cnt;
+	}
 }
 
 
@@ -295,6 +724,8 @@ JL_DLLEXPORT int gdsCreateGDS(const char *fn, C_BOOL allow_dup)
 					}
 				}
 			}
+			if (FilePoolHas(fn))
+				throw ErrGDSFmt("The file '%s' has been opened.", fn);
 		}
 		CdGDSFile *file = GDS_File_Create(fn);
 		file_id = GetFileIndex(file);
@@ -322,6 +753,8 @@ JL_DLLEXPORT int gdsOpenGDS(const char *fn, C_BOOL readonly, C_BOOL allow_dup)
 					}
 				}
 			}
+			if (FilePoolHas(fn))
+				throw ErrGDSFmt("The file '%s' has been opened.", fn);
 		}
 		CdGDSFile *file = GDS_File_Open(fn, readonly, true);
 		file_id = GetFileIndex(file);
@@ -330,22 +763,82 @@ JL_DLLEXPORT int gdsOpenGDS(const char *fn, C_BOOL readonly, C_BOOL allow_dup)
 }
 
 
+/// Register an existing GDS file in the file pool, it is opened on demand
+/// and closed when it is the least recently used one over the limit
+JL_DLLEXPORT int gdsOpenPooled(const char *fn, C_BOOL readonly,
+	C_BOOL allow_dup)
+{
+	int file_id = -1;
+	COREARRAY_TRY
+		if (!allow_dup)
+		{
+			UTF8String FName = UTF8Text(fn);
+			for (int i=0; i < PKG_MAX_NUM_GDS_FILES; i++)
+			{
+				if (PKG_GDS_Files[i] && (PKG_GDS_Files[i]->FileName() == FName))
+					throw ErrGDSFmt("The file '%s' has been opened.", fn);
+			}
+			if (FilePoolHas(fn))
+				throw ErrGDSFmt("The file '%s' has been opened.", fn);
+		}
+		file_id = FilePoolOpen(fn, readonly);
+	COREARRAY_CATCH
+	return file_id;
+}
+
+
+/// Set the maximum number of opened files in the file pool if n > 0,
+/// and return the maximum number
+JL_DLLEXPORT int gdsFilePool(int n)
+{
+	int rv = 0;
+	COREARRAY_TRY
+		rv = FilePoolMaxOpen(n);
+	COREARRAY_CATCH
+	return rv;
+}
+
+
 /// Close the GDS file
 JL_DLLEXPORT void gdsCloseGDS(int file_id)
 {
 	COREARRAY_TRY
-		if (file_id >= 0)
+		if (file_id >= PKG_MAX_NUM_GDS_FILES)
+			FilePoolClose(file_id);
+		else if (file_id >= 0)
 			GDS_File_Close(GDS_ID2File(file_id));
 	COREARRAY_CATCH
 }
 
 
-/// Synchronize the GDS file
-JL_DLLEXPORT void gdsSyncGDS(int file_id)
+/// Synchronize the GDS file, return the number of bytes written
+JL_DLLEXPORT C_Int64 gdsSyncGDS(int file_id)
 {
+	C_Int64 nbytes = 0;
 	COREARRAY_TRY
-		GDS_ID2File(file_id)->SyncFile();
+		nbytes = GDS_ID2File(file_id)->SyncFile();
 	COREARRAY_CATCH
+	return nbytes;
+}
+
+
+/// Start the single-writer/multiple-reader mode
+JL_DLLEXPORT void gdsStartSWMR(int file_id)
+{
+	COREARRAY_TRY
+		GDS_ID2File(file_id)->StartSWMR();
+	COREARRAY_CATCH
+}
+
+
+/// Load the latest snapshot published by a SWMR writer
+JL_DLLEXPORT C_BOOL gdsRefreshSWMR(int file_id)
+{
+	C_BOOL rv = 0;
+	COREARRAY_TRY
+		rv = GDS_ID2File(file_id)->RefreshSWMR() ? 1 : 0;
+	COREARRAY_CATCH
+	return rv;
 }
 
 
@@ -387,6 +880,92 @@ JL_DLLEXPORT void gdsTidyUp(const char *fn, C_BOOL verbose)
 }
 
 
+/// Clean up the fragments of a GDS file in place
+JL_DLLEXPORT void gdsCompact(const char *fn, C_BOOL punch_hole, C_BOOL verbose)
+{
+	COREARRAY_TRY
+		CdGDSFile file(fn, CdGDSFile::dmOpenReadWrite);
+		C_Int64 old_s = file.GetFileSize();
+		if (verbose)
+		{
+			printf("Clean up the fragments of GDS file in place:\n");
+			printf("    open the file '%s' (%s)\n", fn, fmt_size(old_s).c_str());
+			printf("    # of fragments: %d\n", file.GetNumOfFragment());
+			fflush(stdout);
+		}
+		file.CompactFile(punch_hole);
+		if (verbose)
+		{
+			C_Int64 new_s = file.GetFileSize();
+			printf("    truncated (%s, reduced: %s)\n",
+				fmt_size(new_s).c_str(), fmt_size(old_s-new_s).c_str());
+			printf("    # of fragments: %d\n", file.GetNumOfFragment());
+			fflush(stdout);
+		}
+	COREARRAY_CATCH
+}
+
+
+/// Set the number of worker threads in the process-wide thread pool if
+/// nworker >= 0, and return the number of workers
+JL_DLLEXPORT int gdsThreadPool(int nworker)
+{
+	int rv = 0;
+	COREARRAY_TRY
+		CoreArray::Parallel::CdThreadPool &Pool =
+			CoreArray::Parallel::CdThreadPool::Global();
+		if (nworker >= 0)
+			Pool.SetNumWorker(nworker);
+		rv = Pool.NumWorker();
+	COREARRAY_CATCH
+	return rv;
+}
+
+
+/// Set the memory budget for reading buffers and caches if budget > 0, and
+/// 'stat' returns the budget, the reserved bytes, the allocated bytes and
+/// the number of readers
+JL_DLLEXPORT void gdsMemBudget(C_Int64 budget, C_Int64 *stat)
+{
+	COREARRAY_TRY
+		CdMemGovernor &G = CdMemGovernor::Global();
+		if (budget > 0)
+			G.SetBudget(budget);
+		stat[0] = G.Budget();
+		stat[1] = G.Reserved();
+		stat[2] = G.Used();
+		stat[3] = G.NumReader();
+	COREARRAY_CATCH
+}
+
+
+/// Use the shared cache of decoded blocks 'name' (created with 'size' bytes
+/// if not existing) if name is not empty, or stop using it otherwise;
+/// 'remove' removes the name from the system, and 'stat' returns the size,
+/// the numbers of hits, misses and added blocks
+JL_DLLEXPORT void gdsBlockCache(const char *name, C_Int64 size,
+	C_BOOL remove, C_Int64 *stat)
+{
+	COREARRAY_TRY
+		if (name && *name)
+		{
+			string nm = (name[0] == '/') ? string(name) : string("/") + name;
+			CdBlockCache *C = CdBlockCache::Current();
+			if (!C || (C->Name() != nm))
+				CdBlockCache::Open(name, size);
+			if (remove)
+				CdBlockCache::Unlink(name);
+		} else
+			CdBlockCache::Close();
+		CdBlockCache *C = CdBlockCache::Current();
+		stat[0] = C ? C->Size() : 0;
+		stat[1] = C ? C->NumHit() : 0;
+		stat[2] = C ? C->NumMiss() : 0;
+		stat[3] = C ? C->NumAdd() : 0;
+	COREARRAY_CATCH
+}
+
+
 /// Get the root of a GDS file
 JL_DLLEXPORT int gdsRoot(int file_id, PdGDSObj *PObj)
 {
@@ -427,7 +1006,7 @@ JL_DLLEXPORT jl_array_t* gdsnListName(int node_id, PdGDSObj node,
 						List.push_back(RawText(Obj->Name()));
 					} else {
 						if (!Obj->GetHidden() &&
-							!Obj->Attribute().HasName("R.invisible"))
+							!Obj->Attribute().HasName(ATTR_R_INVISIBLE))
 						{
 							List.push_back(RawText(Obj->Name()));
 						}
@@ -463,12 +1042,39 @@ JL_DLLEXPORT int gdsnIndex(int node_id, PdGDSObj node, const char *path,
 		CdGDSAbsFolder *Dir = dynamic_cast<CdGDSAbsFolder*>(Obj);
 		if (Dir)
 		{
+			// check the path cache first
+			const bool cacheable = path_cacheable(path);
+			pair<int, string> key;
+			if (cacheable)
+			{
+				key.first = node_id; key.second = path;
+				map< pair<int, string>, int >::iterator it = PathCache.find(key);
+				if (it != PathCache.end())
+				{
+					CdGDSObj *p = GetHandleNode(it->second);
+					if (p && path_cache_valid(Obj, key.second, p))
+					{
+						idx = it->second;
+						*PObj = p;
+						return idx;
+					}
+					PathCache.erase(it);
+				}
+			}
+
 			Obj = Dir->PathEx(path);
 			if (!Obj && !silent)
 				throw ErrGDSObj("No such GDS node \"%s\"!", path);
 			if (Obj)
+			{
 				set_obj(Obj, idx);
-			else
+				if (cacheable)
+				{
+					if (PathCache.size() >= PATH_CACHE_MAX_SIZE)
+						PathCache.clear();
+					PathCache[key] = idx;
+				}
+			} else
 				idx = -1;
 			*PObj = Obj;
 		} else {
@@ -506,6 +1112,197 @@ JL_DLLEXPORT void gdsnRename(int node_id, PdGDSObj node, const char *newname)
 }
 
 
+/// Add a new GDS node with the storage mode and compression method
+JL_DLLEXPORT int gdsnAddArray(int node_id, PdGDSObj node, const char *name,
+	const char *storage, jl_array_t *valdim, const char *compress,
+	C_BOOL replace, PdGDSObj *PObj)
+{
+	int idx = -1;
+	COREARRAY_TRY
+
+		CdGDSObj *Obj = get_obj(node_id, node);
+		CdGDSAbsFolder *Dir = dynamic_cast<CdGDSAbsFolder*>(Obj);
+		if (!Dir)
+			throw ErrGDSFmt(ERR_NOT_FOLDER);
+
+		// the class name of storage
+		map<const char*, const char*, CInitNameObject::strCmp>::iterator it =
+			Init.ClassMap.find(storage);
+		if (it == Init.ClassMap.end())
+			throw ErrGDSFmt("Not support: storage = '%s'.", storage);
+
+		// the dimension, the last one in Julia is the first one in GDS
+		int ndim = jl_array_len(valdim);
+		if (ndim > (int)CdAbstractArray::MAX_ARRAY_DIM)
+			throw ErrGDSFmt("The length of 'valdim' is invalid.");
+		CdAbstractArray::TArrayDim DLen;
+		{
+			C_Int64 *p = (C_Int64*)jl_array_data(valdim);
+			for (int i=0; i < ndim; i++)
+			{
+				if ((p[i] < 0) || (p[i] > INT_MAX))
+					throw ErrGDSFmt("'valdim' is invalid.");
+				DLen[ndim-i-1] = p[i];
+			}
+		}
+
+		// the existing node
+		CdGDSObj *Old = Dir->ObjItemEx(name);
+		if (Old && !replace)
+			throw ErrGDSFmt("The GDS node \"%s\" exists.", name);
+
+		// create a new node, which is configured before the existing node is
+		// replaced, so an invalid argument keeps the existing data
+		CdGDSObj *vObj;
+		bool IsFolder = (strcmp(it->second, "$FOLDER$") == 0);
+		if (IsFolder)
+		{
+			vObj = new CdGDSFolder;
+		} else {
+			CdObjClassMgr::TdOnObjCreate OnCreate =
+				dObjManager().NameToClass(it->second);
+			if (!OnCreate)
+				throw ErrGDSFmt("Not support: storage = '%s'.", storage);
+			CdObjRef *ref = OnCreate();
+			vObj = dynamic_cast<CdGDSObj*>(ref);
+			if (!vObj)
+			{
+				delete ref;
+				throw ErrGDSFmt("Not support: storage = '%s'.", storage);
+			}
+			// the compression method is saved when the node is inserted
+			try {
+				if (dynamic_cast<CdContainer*>(vObj))
+					static_cast<CdContainer*>(vObj)->SetPackedMode(compress);
+			} catch (...) {
+				delete vObj;
+				throw;
+			}
+		}
+
+		// replace the existing node at the same position
+		int index = -1;
+		if (Old)
+		{
+			index = Dir->IndexObj(Old);
+			try {
+				GDS_Node_Delete(Old, true);
+			} catch (...) {
+				delete vObj;
+				throw;
+			}
+		}
+		Dir->InsertObj(index, name, vObj);
+
+		if (!IsFolder)
+		{
+			if ((ndim > 0) && dynamic_cast<CdAbstractArray*>(vObj))
+				static_cast<CdAbstractArray*>(vObj)->ResetDim(DLen, ndim);
+			if (strcmp(storage, "logical") == 0)
+				vObj->Attribute().Add("R.logical");
+		}
+
+		set_obj(vObj, idx);
+		*PObj = vObj;
+
+	COREARRAY_CATCH
+	return idx;
+}
+
+
+/// Set the tile lengths of an empty tiled array, the last one in Julia is
+/// the first one in GDS
+JL_DLLEXPORT void gdsnSetTileDim(int node_id, PdGDSObj node,
+	jl_array_t *tiledim)
+{
+	COREARRAY_TRY
+		CdTiledArrayBase *Obj =
+			dynamic_cast<CdTiledArrayBase*>(get_obj(node_id, node));
+		if (!Obj)
+			throw ErrGDSFmt("The GDS node should be a tiled array.");
+		int ndim = jl_array_len(tiledim);
+		if (ndim != Obj->DimCnt())
+			throw ErrGDSFmt("The length of 'tiledim' should be %d.",
+				Obj->DimCnt());
+		CdAbstractArray::TArrayDim TLen;
+		C_Int64 *p = (C_Int64*)jl_array_data(tiledim);
+		for (int i=0; i < ndim; i++)
+		{
+			if ((p[i] <= 0) || (p[i] > INT_MAX))
+				throw ErrGDSFmt("'tiledim' is invalid.");
+			TLen[ndim-i-1] = p[i];
+		}
+		Obj->SetTileDim(TLen, ndim);
+	COREARRAY_CATCH
+}
+
+
+/// Add a virtual array concatenating array nodes of other GDS files
+/** 'dim' is the concatenated dimension in Julia (from ONE), or 0 for the
+ *  last one; 'files' are relative to the directory of the host file
+**/
+JL_DLLEXPORT int gdsnAddVirtual(int node_id, PdGDSObj node, const char *name,
+	int n, const char *const *files, const char *const *paths, int dim,
+	C_BOOL replace, PdGDSObj *PObj)
+{
+	int idx = -1;
+	COREARRAY_TRY
+
+		CdGDSObj *Obj = get_obj(node_id, node);
+		CdGDSAbsFolder *Dir = dynamic_cast<CdGDSAbsFolder*>(Obj);
+		if (!Dir)
+			throw ErrGDSFmt(ERR_NOT_FOLDER);
+		if (n <= 0)
+			throw ErrGDSFmt("No GDS node to be concatenated.");
+
+		// the existing node
+		CdGDSObj *Old = Dir->ObjItemEx(name);
+		if (Old && !replace)
+			throw ErrGDSFmt("The GDS node \"%s\" exists.", name);
+
+		// create a new node, the shards are opened to check their shapes;
+		// it is placed before the existing node under a temporary name, and
+		// the existing node is replaced only if all shards are valid
+		int index = -1;
+		UTF8String vName = name;
+		if (Old)
+		{
+			index = Dir->IndexObj(Old);
+			do {
+				vName.append("~");
+			} while (Dir->ObjItemEx(vName));
+		}
+		CdVirtualArray *vObj = new CdVirtualArray;
+		Dir->InsertObj(index, vName, vObj);
+		try {
+			vObj->AddShard(files[0], paths[0]);
+			if (dim > 0)
+			{
+				int nd = vObj->DimCnt();
+				if (dim > nd)
+					throw ErrGDSFmt("'dim' should be between 1 and %d.", nd);
+				vObj->SetAxis(nd - dim);
+			}
+			for (int i=1; i < n; i++)
+				vObj->AddShard(files[i], paths[i]);
+		} catch (...) {
+			GDS_Node_Delete(vObj, true);
+			throw;
+		}
+		if (Old)
+		{
+			GDS_Node_Delete(Old, true);
+			vObj->SetName(name);
+		}
+
+		set_obj(vObj, idx);
+		*PObj = vObj;
+
+	COREARRAY_CATCH
+	return idx;
+}
+
+
 /// Get the description of a GDS node
 JL_DLLEXPORT jl_array_t* gdsnDesp(int node_id, PdGDSObj node,
 	jl_array_t *dim, double *cratio, C_Int64 *size, C_BOOL *good, C_BOOL *hidden)
@@ -598,6 +1395,10 @@ JL_DLLEXPORT jl_array_t* gdsnDesp(int node_id, PdGDSObj node,
 		{
 			CdGDSVirtualFolder *v = (CdGDSVirtualFolder*)Obj;
 			*good = v->IsLoaded(true) ? 1 : 0;
+		} else if (dynamic_cast<CdVirtualArray*>(Obj))
+		{
+			CdVirtualArray *v = (CdVirtualArray*)Obj;
+			*good = v->IsLoaded(true) ? 1 : 0;
 		} else if (dynamic_cast<CdGDSUnknown*>(Obj))
 		{
 			*good = 0;
@@ -606,7 +1407,7 @@ JL_DLLEXPORT jl_array_t* gdsnDesp(int node_id, PdGDSObj node,
 
 		// hidden
 		*hidden = Obj->GetHidden() ||
-			Obj->Attribute().HasName("R.invisible");
+			Obj->Attribute().HasName(ATTR_R_INVISIBLE);
 
 		// message
 		string msg;
@@ -615,6 +1416,9 @@ JL_DLLEXPORT jl_array_t* gdsnDesp(int node_id, PdGDSObj node,
 			CdGDSVirtualFolder *v = (CdGDSVirtualFolder*)Obj;
 			v->IsLoaded(true);
 			msg = v->ErrMsg().c_str();
+		} else if (dynamic_cast<CdVirtualArray*>(Obj))
+		{
+			msg = ((CdVirtualArray*)Obj)->ErrMsg();
 		}
 
 		jl_value_t *atype = jl_apply_array_type((jl_value_t*)jl_string_type, 1);
@@ -654,95 +1458,315 @@ JL_DLLEXPORT jl_array_t* gdsnRead(int node_id, PdGDSObj node,
 {
 	// check the argument 'cvt'
 	C_SVType sv;
-	if (strcmp(cvt, "") == 0)
-		sv = svCustom;
-	else if (strcmp(cvt, "int8") == 0)
-		sv = svInt8;
-	else if (strcmp(cvt, "uint8") == 0)
-		sv = svUInt8;
-	else if (strcmp(cvt, "int16") == 0)
-		sv = svInt16;
-	else if (strcmp(cvt, "uint16") == 0)
-		sv = svUInt16;
-	else if (strcmp(cvt, "int32") == 0)
-		sv = svInt32;
-	else if (strcmp(cvt, "uint32") == 0)
-		sv = svUInt32;
-	else if (strcmp(cvt, "int64") == 0)
-		sv = svInt64;
-	else if (strcmp(cvt, "uint64") == 0)
-		sv = svUInt64;
-	else if (strcmp(cvt, "float32") == 0)
-		sv = svFloat32;
-	else if (strcmp(cvt, "float64") == 0)
-		sv = svFloat64;
-	else if (strcmp(cvt, "utf8") == 0)
-		sv = svStrUTF8;
-	else if (strcmp(cvt, "utf16") == 0)
-		sv = svStrUTF16;
-	else
+	if (!str_to_sv(cvt, sv))
 		jl_error("Invalid 'cvt'.");
 
-	// check the argument 'start'
-	CdAbstractArray::TArrayDim dm_st;
-	int dm_st_n = jl_array_len(start);
-	{
-		C_Int64 *p = (C_Int64*)jl_array_data(start);
-		for (int i=0; i < dm_st_n; i++) dm_st[i] = p[i];
-	}
+	COREARRAY_TRY
 
-	// check the argument 'count'
-	CdAbstractArray::TArrayDim dm_cnt;
-	int dm_cnt_n = jl_array_len(count);
-	{
-		C_Int64 *p = (C_Int64*)jl_array_data(count);
-		for (int i=0; i < dm_cnt_n; i++) dm_cnt[i] = p[i];
-	}
+		CdGDSObj *obj = get_obj(node_id, node);
+		CdAbstractArray *Obj = dynamic_cast<CdAbstractArray*>(obj);
+		if (Obj == NULL)
+			throw ErrGDSFmt(ERR_NO_DATA);
 
-	if ((dm_st_n==0 && dm_cnt_n>0) || (dm_st_n>0 && dm_cnt_n==0))
-		jl_error("'start' and 'count' should be both None.");
+		CdAbstractArray::TArrayDim dm_st, dm_cnt;
+		C_Int32 *pDS=NULL, *pDL=NULL;
+		get_start_count(Obj, start, count, dm_st, dm_cnt, pDS, pDL);
 
+		return GDS_JArray_Read(Obj, pDS, pDL, NULL, sv);
+
+	COREARRAY_CATCH
+	return NULL;
+}
 
+/// Read the codes and dictionary from a dictionary-encoded string node
+JL_DLLEXPORT jl_array_t* gdsnReadDict(int node_id, PdGDSObj node,
+	jl_array_t *start, jl_array_t *count)
+{
 	COREARRAY_TRY
 
-		CdGDSObj *obj = get_obj(node_id, node);
-		CdAbstractArray *Obj = dynamic_cast<CdAbstractArray*>(obj);
-		if (Obj == NULL)
+		CdGDSObj *Obj = get_obj(node_id, node);
+		CdAbstractArray *Arr = dynamic_cast<CdAbstractArray*>(Obj);
+		if (Arr == NULL)
 			throw ErrGDSFmt(ERR_NO_DATA);
 
+		CdAbstractArray::TArrayDim dm_st, dm_cnt;
 		C_Int32 *pDS=NULL, *pDL=NULL;
-		if (dm_st_n>0 && dm_cnt_n>0)
+		get_start_count(Arr, start, count, dm_st, dm_cnt, pDS, pDL);
+
+		if (dynamic_cast<CdDStr8*>(Obj))
+			return read_dict((CdDStr8*)Obj, pDS, pDL);
+		else if (dynamic_cast<CdDStr16*>(Obj))
+			return read_dict((CdDStr16*)Obj, pDS, pDL);
+		else if (dynamic_cast<CdDStr32*>(Obj))
+			return read_dict((CdDStr32*)Obj, pDS, pDL);
+		else
+			throw ErrGDSFmt("It is not a dictionary-encoded string.");
+
+	COREARRAY_CATCH
+	return NULL;
+}
+
+
+/// Return the code unit width (1, 2 or 4 bytes) of a fixed-length string node
+JL_DLLEXPORT int gdsnFStrUnit(int node_id, PdGDSObj node)
+{
+	int unit = 0;
+	COREARRAY_TRY
+		CdGDSObj *Obj = get_obj(node_id, node);
+		if (dynamic_cast<CdFStr8*>(Obj))
+			unit = 1;
+		else if (dynamic_cast<CdFStr16*>(Obj))
+			unit = 2;
+		else if (dynamic_cast<CdFStr32*>(Obj))
+			unit = 4;
+		else
+			throw ErrGDSFmt("It is not a fixed-length string.");
+	COREARRAY_CATCH
+	return unit;
+}
+
+
+/// Read the raw bytes of a fixed-length string node as a byte matrix
+JL_DLLEXPORT jl_array_t* gdsnReadFStrRaw(int node_id, PdGDSObj node,
+	jl_array_t *start, jl_array_t *count)
+{
+	COREARRAY_TRY
+
+		CdGDSObj *Obj = get_obj(node_id, node);
+		if (!dynamic_cast<CdFStr8*>(Obj) && !dynamic_cast<CdFStr16*>(Obj) &&
+				!dynamic_cast<CdFStr32*>(Obj))
+			throw ErrGDSFmt("It is not a fixed-length string.");
+		CdAllocArray *Arr = static_cast<CdAllocArray*>(Obj);
+
+		CdAbstractArray::TArrayDim dm_st, dm_cnt;
+		C_Int32 *pDS=NULL, *pDL=NULL;
+		get_start_count(Arr, start, count, dm_st, dm_cnt, pDS, pDL);
+		if (pDL == NULL)
 		{
-			int Len = Obj->DimCnt();
-			CdAbstractArray::TArrayDim DCnt;
-			Obj->GetDim(DCnt);
+			Arr->GetDim(dm_cnt);
+			pDL = dm_cnt;
+		}
 
-			if (dm_st_n != Len)
-				throw ErrGDSFmt("The length of 'start' is invalid.");
-			for (int i=0; i < Len; i++)
-			{
-				if ((dm_st[i] < 0) || (dm_st[i] >= DCnt[i]))
-					throw ErrGDSFmt("'start' is invalid.");
-			}
-			pDS = dm_st;
+		// create a UInt8 array (width x n) or (width x n2 x n1)
+		jl_value_t *atype;
+		jl_array_t *rv_ans;
+		size_t width = Arr->ElmSize();
+		switch (Arr->DimCnt())
+		{
+			case 1:
+				atype = jl_apply_array_type((jl_value_t*)jl_uint8_type, 2);
+				rv_ans = jl_alloc_array_2d(atype, width, pDL[0]);
+				break;
+			case 2:
+				atype = jl_apply_array_type((jl_value_t*)jl_uint8_type, 3);
+				rv_ans = jl_alloc_array_3d(atype, width, pDL[1], pDL[0]);
+				break;
+			default:
+				throw ErrGDSFmt("The current implementation does not support more than 2 dims.");
+		}
+		C_UInt8 *p = (C_UInt8*)jl_array_data(rv_ans);
+
+		// read
+		if (dynamic_cast<CdFStr8*>(Obj))
+			((CdFStr8*)Obj)->ReadRaw(pDS, pDL, NULL, p);
+		else if (dynamic_cast<CdFStr16*>(Obj))
+			((CdFStr16*)Obj)->ReadRaw(pDS, pDL, NULL, p);
+		else
+			((CdFStr32*)Obj)->ReadRaw(pDS, pDL, NULL, p);
+
+		return rv_ans;
+
+	COREARRAY_CATCH
+	return NULL;
+}
+
+
+
+/// Append numeric data to a GDS node, the buffer is passed through
+JL_DLLEXPORT void gdsnAppend(int node_id, PdGDSObj node, const void *ptr,
+	C_Int64 n, const char *cvt)
+{
+	C_SVType sv;
+	if (!str_to_sv(cvt, sv) || !COREARRAY_SV_NUMERIC(sv))
+		jl_error("Invalid 'cvt'.");
+
+	COREARRAY_TRY
+		CdGDSObj *Obj = get_obj(node_id, node);
+		CdAbstractArray *Arr = dynamic_cast<CdAbstractArray*>(Obj);
+		if (Arr == NULL)
+			throw ErrGDSFmt(ERR_NO_DATA);
+		Arr->Append(ptr, n, sv);
+	COREARRAY_CATCH
+}
+
+
+/// Append strings to a GDS node given the pointers and lengths of strings
+JL_DLLEXPORT void gdsnAppendStr(int node_id, PdGDSObj node,
+	const char *const *ptr, const C_Int64 *len, C_Int64 n)
+{
+	static const ssize_t NUM_STR_BUFFER = 4096;
 
-			if (dm_cnt_n != Len)
-				throw ErrGDSFmt("The length of 'count' is invalid.");
-			for (int i=0; i < Len; i++)
+	COREARRAY_TRY
+		CdGDSObj *Obj = get_obj(node_id, node);
+		CdAbstractArray *Arr = dynamic_cast<CdAbstractArray*>(Obj);
+		if (Arr == NULL)
+			throw ErrGDSFmt(ERR_NO_DATA);
+
+		vector<UTF8String> Buf(n < NUM_STR_BUFFER ? n : NUM_STR_BUFFER);
+		while (n > 0)
+		{
+			ssize_t m = (n < NUM_STR_BUFFER) ? n : NUM_STR_BUFFER;
+			for (ssize_t i=0; i < m; i++)
+				Buf[i].assign(ptr[i], len[i]);
+			Arr->Append(&Buf[0], m, svStrUTF8);
+			ptr += m; len += m; n -= m;
+		}
+	COREARRAY_CATCH
+}
+
+
+/// Close the writing mode of a GDS node, and compress the remaining data
+JL_DLLEXPORT void gdsnReadMode(int node_id, PdGDSObj node)
+{
+	COREARRAY_TRY
+		CdGDSObj *Obj = get_obj(node_id, node);
+		CdContainer *Cont = dynamic_cast<CdContainer*>(Obj);
+		if (Cont == NULL)
+			throw ErrGDSFmt(ERR_NO_DATA);
+		Cont->CloseWriter();
+	COREARRAY_CATCH
+}
+
+
+/// Set the buffer size used when appending data to a GDS node
+JL_DLLEXPORT void gdsnSetBufSize(int node_id, PdGDSObj node, C_Int64 size)
+{
+	COREARRAY_TRY
+		CdGDSObj *Obj = get_obj(node_id, node);
+		CdAllocArray *Arr = dynamic_cast<CdAllocArray*>(Obj);
+		if (Arr == NULL)
+			throw ErrGDSFmt(ERR_NO_DATA);
+		Arr->SetBufSize(size);
+	COREARRAY_CATCH
+}
+
+
+/// Enable or disable the transposed copy of a 2-D numeric GDS node, and
+/// rebuild the copy if 'update' and it is stale
+JL_DLLEXPORT void gdsnSetTransposed(int node_id, PdGDSObj node,
+	C_BOOL enable, C_BOOL update)
+{
+	COREARRAY_TRY
+		CdGDSObj *Obj = get_obj(node_id, node);
+		CdAllocArray *Arr = dynamic_cast<CdAllocArray*>(Obj);
+		if (Arr == NULL)
+			throw ErrGDSFmt(ERR_NO_DATA);
+		Arr->SetTransposed(enable);
+		if (enable && update)
+			Arr->UpdateTransposed();
+	COREARRAY_CATCH
+}
+
+
+/// Return whether a GDS node has an up-to-date transposed copy (1), a stale
+/// one (0), or no transposed copy (-1)
+JL_DLLEXPORT int gdsnTransposed(int node_id, PdGDSObj node)
+{
+	int rv = -1;
+	COREARRAY_TRY
+		CdGDSObj *Obj = get_obj(node_id, node);
+		CdAllocArray *Arr = dynamic_cast<CdAllocArray*>(Obj);
+		if (Arr && Arr->TransposedEnabled())
+			rv = Arr->Transposed() ? 1 : 0;
+	COREARRAY_CATCH
+	return rv;
+}
+
+
+/// Recompress GDS nodes, and the nodes in different files are processed
+/// concurrently since a GDS file allows only one writer
+JL_DLLEXPORT void gdsnRecompress(int n, const int *node_id,
+	const PdGDSObj *node, const char *compress, int nthread)
+{
+	COREARRAY_TRY
+		CFilePoolLock Lock;
+		vector<CdGDSFile*> Files;
+		vector< vector<CdGDSObjPipe*> > Groups;
+		for (int i=0; i < n; i++)
+		{
+			CdGDSObj *Obj = get_obj(node_id[i], node[i]);
+			CdGDSObjPipe *Pipe = dynamic_cast<CdGDSObjPipe*>(Obj);
+			if (Pipe == NULL)
+				throw ErrGDSFmt(ERR_NO_DATA);
+			size_t k = find(Files.begin(), Files.end(), Obj->GDSFile()) -
+				Files.begin();
+			if (k >= Files.size())
 			{
-				int &v = dm_cnt[i];
-				if (v == -1)
-					v = DCnt[i] - dm_st[i];
-				if ((v <= 0) || ((dm_st[i]+v) >= DCnt[i]))
-					throw ErrGDSFmt("'count' is invalid.");
+				Files.push_back(Obj->GDSFile());
+				Groups.resize(k + 1);
 			}
-			pDL = dm_cnt;
+			Groups[k].push_back(Pipe);
 		}
+		CdRecompressNodes Work(Groups, compress, nthread);
+		Work.Run();
+	COREARRAY_CATCH
+}
 
-		return GDS_JArray_Read(Obj, pDS, pDL, NULL, sv);
 
+
+/// Apply a function over the blocks of aligned nodes in parallel, margin[i]
+/// is the dimension (starting from 1) of node i that blocks are taken along,
+/// and collect is called in the order of blocks if ordered
+JL_DLLEXPORT void gdsnApplyBlock(int n, const int *node_id,
+	const PdGDSObj *node, const int *margin, const char *const *cvt,
+	C_Int64 blocksize, int nthread, C_BOOL ordered, TApplyFunc fun,
+	TCollectFunc collect, void *param)
+{
+	COREARRAY_TRY
+		if (!fun)
+			throw ErrGDSFmt("'fun' should not be NULL.");
+		if (blocksize < 1)
+			throw ErrGDSFmt("'blocksize' should be > 0.");
+		CFilePoolLock Lock;
+		vector<CdAbstractArray*> Nodes(n);
+		vector<int> Margin(n);
+		vector<C_SVType> SV(n);
+		for (int i=0; i < n; i++)
+		{
+			CdAbstractArray *Obj = dynamic_cast<CdAbstractArray*>(
+				get_obj(node_id[i], node[i]));
+			if (Obj == NULL)
+				throw ErrGDSFmt(ERR_NO_DATA);
+			int nd = Obj->DimCnt();
+			if ((margin[i] < 1) || (margin[i] > nd))
+				throw ErrGDSFmt("Invalid margin (%d).", margin[i]);
+			// the dimensions in Julia are in reverse order
+			Margin[i] = nd - margin[i];
+			C_SVType sv;
+			if (!str_to_sv(cvt[i], sv))
+				throw ErrGDSFmt("Invalid 'cvt'.");
+			if (sv == svCustom)
+			{
+				if (GDS_Is_RLogical(Obj))
+					sv = svInt8;
+				else {
+					sv = Obj->SVType();
+					if (sv == svCustomInt)
+						sv = svInt64;
+					else if (sv == svCustomUInt)
+						sv = svUInt64;
+					else if (sv == svCustomFloat)
+						sv = svFloat64;
+				}
+			}
+			if (!COREARRAY_SV_NUMERIC(sv))
+				throw ErrGDSFmt("Only numeric data can be applied to.");
+			Nodes[i] = Obj; SV[i] = sv;
+		}
+		CdApplyBlocks Work(Nodes, Margin, SV, blocksize, fun, collect, param,
+			ordered != 0);
+		Work.Run(nthread);
 	COREARRAY_CATCH
-	return NULL;
 }
 
 
@@ -808,10 +1832,11 @@ JL_DLLEXPORT jl_value_t* any2obj(CdAny &Obj)
 }
 
 /// Get the attribute(s) of a GDS node with an index
-JL_DLLEXPORT jl_value_t* gdsnGetAttrIdx(int node_id, PdGDSObj Obj, int idx)
+JL_DLLEXPORT jl_value_t* gdsnGetAttrIdx(int node_id, PdGDSObj node, int idx)
 {
 	jl_value_t *rv_ans = NULL;
 	COREARRAY_TRY
+		CdGDSObj *Obj = get_obj(node_id, node);
 		if ((1 <= idx) && (idx <= (int)Obj->Attribute().Count()))
 		{
 			rv_ans = any2obj(Obj->Attribute()[idx-1]);
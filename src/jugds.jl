@@ -27,8 +27,14 @@ import DataStructures: OrderedDict
 export type_gdsfile, type_gdsnode,
 	gds_get_include,
 	create_gds, open_gds, close_gds, sync_gds, cleanup_gds,
+	swmr_gds, refresh_gds, threadpool_gds, filepool_gds, blockcache_gds,
+	membudget_gds,
 	root_gdsn, name_gdsn, rename_gdsn, ls_gdsn, index_gdsn, getfolder_gdsn,
-	delete_gdsn, objdesp_gdsn, read_gdsn,
+	add_gdsn, addvirtual_gdsn, delete_gdsn, objdesp_gdsn, read_gdsn, readdict_gdsn,
+	append_gdsn, readmode_gdsn, setbufsize_gdsn, recompress_gdsn,
+	transpose_gdsn, transposed_gdsn,
+	applyblock_gdsn,
+	type_fstrraw, readfstr_gdsn, bytes_fstr,
 	put_attr_gdsn, get_attr_gdsn, delete_attr_gdsn
 
 
@@ -109,6 +115,38 @@ struct type_infogdsn
 end
 
 
+# Fixed-length strings as a byte matrix (width x n), column i holds the
+# zero-padded bytes of the i-th string stored in code units of 'unit' bytes
+# (1: UTF-8, 2: UTF-16, 4: UTF-32, little-endian)
+struct type_fstrraw <: AbstractVector{String}
+	data::Matrix{UInt8}
+	unit::Int
+end
+type_fstrraw(data::Matrix{UInt8}) = type_fstrraw(data, 1)
+Base.size(x::type_fstrraw) = (size(x.data, 2),)
+Base.IndexStyle(::Type{type_fstrraw}) = IndexLinear()
+# the bytes of the i-th string without padding (no allocation), trailing
+# zero code units are removed as a whole
+function bytes_fstr(x::type_fstrraw, i::Integer)
+	u = x.unit
+	n = size(x.data, 1) - size(x.data, 1) % u
+	while n > 0 && all(iszero, view(x.data, (n-u+1):n, i))
+		n -= u
+	end
+	return view(x.data, 1:n, i)
+end
+function Base.getindex(x::type_fstrraw, i::Int)
+	b = copy(bytes_fstr(x, i))
+	if x.unit == 2
+		return transcode(String, ltoh.(reinterpret(UInt16, b)))
+	elseif x.unit == 4
+		return String(Char.(ltoh.(reinterpret(UInt32, b))))
+	else
+		return String(b)
+	end
+end
+
+
 
 ####  Internal Functions  ####
 
@@ -149,6 +187,7 @@ Open an existing file of CoreArray Genomic Data Structure (GDS) for reading or w
 * `filename::String`: the file name of a new GDS file to be created
 * `readonly::Bool=true`: if true, the file is opened read-only; otherwise, it is allowed to write data to the file
 * `allow_dup::Bool=false`: if true, it is allowed to open a GDS file with read-only mode when it has been opened in the same session
+* `pooled::Bool=false`: if true, the file is registered in the file pool, and it is closed when it is not recently used (see `filepool_gds`) and reopened on access
 # Examples
 ```julia
 fn = joinpath(Pkg.dir(), "jugds", "demo", "data", "ceu_exon.gds")
@@ -157,9 +196,15 @@ f
 close_gds(f)
 ```
 """
-function open_gds(filename::String, readonly::Bool=true, allow_dup::Bool=false)
-	id = ccall((:gdsOpenGDS, LibCoreArray), Cint, (Cstring, Bool, Bool),
-		filename, readonly, allow_dup)
+function open_gds(filename::String, readonly::Bool=true, allow_dup::Bool=false;
+		pooled::Bool=false)
+	if pooled
+		id = ccall((:gdsOpenPooled, LibCoreArray), Cint, (Cstring, Bool, Bool),
+			filename, readonly, allow_dup)
+	else
+		id = ccall((:gdsOpenGDS, LibCoreArray), Cint, (Cstring, Bool, Bool),
+			filename, readonly, allow_dup)
+	end
 	return type_gdsfile(filename, id, readonly)
 end
 
@@ -180,21 +225,90 @@ function close_gds(file::type_gdsfile)
 end
 
 
-# Synchronize the GDS file
+# Synchronize the GDS file, only the modified nodes are saved, and return
+# the number of bytes written
 function sync_gds(file::type_gdsfile)
-	ccall((:gdsSyncGDS, LibCoreArray), Cvoid, (Cint,), file.id)
+	return ccall((:gdsSyncGDS, LibCoreArray), Int64, (Cint,), file.id)
+end
+
+
+# Start the single-writer/multiple-reader (SWMR) mode on a writable file,
+# each sync_gds publishes a snapshot for the readers; deleting nodes is not
+# allowed in this mode
+function swmr_gds(file::type_gdsfile)
+	ccall((:gdsStartSWMR, LibCoreArray), Cvoid, (Cint,), file.id)
 	return nothing
 end
 
 
-# Clean up fragments of a GDS file
-function cleanup_gds(filename::String, verbose::Bool=true)
-	id = ccall((:gdsTidyUp, LibCoreArray), Cint, (Cstring, Bool),
-		filename, verbose)
+# Load the latest snapshot published by a SWMR writer into a read-only file,
+# return false if there is no newer snapshot; the loaded nodes are updated
+# in place (uncompressed arrays get the new dimensions); the snapshots are
+# invalidated when the writer closes the file, so reopen it to see the rest
+function refresh_gds(file::type_gdsfile)
+	return ccall((:gdsRefreshSWMR, LibCoreArray), Bool, (Cint,), file.id)
+end
+
+
+# Clean up fragments of a GDS file, 'inplace=true' moves the data at the end
+# of file into free space and truncates the file instead of rewriting it to
+# a temporary file, and 'punch_hole=true' releases the remaining free space
+function cleanup_gds(filename::String, verbose::Bool=true;
+		inplace::Bool=false, punch_hole::Bool=false)
+	if inplace
+		ccall((:gdsCompact, LibCoreArray), Cvoid, (Cstring, Bool, Bool),
+			filename, punch_hole, verbose)
+	else
+		ccall((:gdsTidyUp, LibCoreArray), Cvoid, (Cstring, Bool),
+			filename, verbose)
+	end
 	return nothing
 end
 
 
+# Set the number of worker threads shared by all parallel operations if
+# nworker >= 0, and return the number of workers in the pool
+function threadpool_gds(nworker::Integer=-1)
+	return Int(ccall((:gdsThreadPool, LibCoreArray), Cint, (Cint,), nworker))
+end
+
+
+# Set the maximum number of pooled files kept open if maxopen > 0, and return
+# the maximum number; the least recently used ones are closed over the limit
+function filepool_gds(maxopen::Integer=-1)
+	return Int(ccall((:gdsFilePool, LibCoreArray), Cint, (Cint,), maxopen))
+end
+
+
+# Set the memory budget (in bytes) of this process for the buffers of
+# marginal reading and the shared block cache if budget > 0; the readers
+# share the budget and resize their buffers when readers come and go;
+# return the budget, the bytes reserved by caches, the bytes allocated by
+# readers and the number of readers
+function membudget_gds(budget::Integer=-1)
+	st = zeros(Int64, 4)
+	ccall((:gdsMemBudget, LibCoreArray), Cvoid, (Int64, Ptr{Int64}),
+		budget, st)
+	return (budget=st[1], reserved=st[2], used=st[3], readers=st[4])
+end
+
+
+# Share decoded blocks of compressed data among local processes through the
+# shared memory segment 'name', which is created with 'size' bytes if not
+# existing; only files opened read-only are cached, an empty name stops
+# using the cache, and 'remove=true' removes the name from the system (the
+# processes using it are not affected); return the size of the cache and
+# the numbers of hits, misses and added blocks by all processes; the
+# cache counts against the memory budget of this process (membudget_gds)
+function blockcache_gds(name::String="", size::Integer=256*1024^2;
+		remove::Bool=false)
+	st = zeros(Int64, 4)
+	ccall((:gdsBlockCache, LibCoreArray), Cvoid,
+		(Cstring, Int64, Bool, Ptr{Int64}), name, size, remove, st)
+	return (size=st[1], hit=st[2], miss=st[3], add=st[4])
+end
+
+
 
 ####  GDS Node  ####
 
@@ -251,6 +365,85 @@ function rename_gdsn(obj::type_gdsnode, newname::String)
 end
 
 
+# The default storage mode and the 'cvt' type of a Julia element type
+storage_type(::Type{Bool}) = ("logical", "int8")
+storage_type(::Type{Int8}) = ("int8", "int8")
+storage_type(::Type{UInt8}) = ("uint8", "uint8")
+storage_type(::Type{Int16}) = ("int16", "int16")
+storage_type(::Type{UInt16}) = ("uint16", "uint16")
+storage_type(::Type{Int32}) = ("int32", "int32")
+storage_type(::Type{UInt32}) = ("uint32", "uint32")
+storage_type(::Type{Int64}) = ("int64", "int64")
+storage_type(::Type{UInt64}) = ("uint64", "uint64")
+storage_type(::Type{Float32}) = ("float32", "float32")
+storage_type(::Type{Float64}) = ("float64", "float64")
+storage_type(::Type{<:AbstractString}) = ("string", "utf8")
+storage_type(::Type{T}) where T =
+	error("Not support the element type: ", T, ".")
+
+
+# Add a new GDS node, the last dimension of 'valdim' is extended by appending;
+# 'tiledim' specifies the tile lengths of a tiled storage ("tile.*")
+function add_gdsn(obj::Union{type_gdsfile, type_gdsnode}, name::String,
+		val=nothing; storage::String="", valdim::Vector{Int64}=Int64[],
+		tiledim::Vector{Int64}=Int64[], compress::String="",
+		closezip::Bool=false, replace::Bool=false)
+	if isa(obj, type_gdsfile)
+		obj = root_gdsn(obj)
+	end
+	if storage == ""
+		val === nothing && error("'storage' should be specified.")
+		storage = storage_type(eltype(val))[1]
+	end
+	if isempty(valdim) && val !== nothing && ndims(val) > 1
+		valdim = Int64[size(val)...]
+		valdim[end] = 0
+	end
+	p = Ref{Ptr{Cvoid}}(C_NULL)
+	id = ccall((:gdsnAddArray, LibCoreArray), Cint,
+		(Cint, Ptr{Cvoid}, Cstring, Cstring, Vector{Int64}, Cstring, Bool,
+		Ref{Ptr{Cvoid}}),
+		obj.id, obj.ptr, name, storage, valdim, compress, replace, p)
+	node = type_gdsnode(id, p[])
+	if !isempty(tiledim)
+		ccall((:gdsnSetTileDim, LibCoreArray), Cvoid,
+			(Cint, Ptr{Cvoid}, Vector{Int64}), node.id, node.ptr, tiledim)
+	end
+	if val !== nothing
+		append_gdsn(node, val)
+		closezip && readmode_gdsn(node)
+	end
+	return node
+end
+
+
+# Add a read-only node concatenating the array nodes 'paths' of the GDS files
+# 'files' (relative to the directory of the host file) along the dimension
+# 'dim' (0 for the last one), the linked files are opened when reading
+function addvirtual_gdsn(obj::Union{type_gdsfile, type_gdsnode}, name::String,
+		files::Vector{String}, paths::Union{String, Vector{String}};
+		dim::Integer=0, replace::Bool=false)
+	if isa(obj, type_gdsfile)
+		obj = root_gdsn(obj)
+	end
+	if isa(paths, String)
+		paths = fill(paths, length(files))
+	end
+	length(paths) == length(files) ||
+		error("'files' and 'paths' should have the same length.")
+	p = Ref{Ptr{Cvoid}}(C_NULL)
+	id = GC.@preserve files paths begin
+		ccall((:gdsnAddVirtual, LibCoreArray), Cint,
+			(Cint, Ptr{Cvoid}, Cstring, Cint, Ptr{Ptr{UInt8}}, Ptr{Ptr{UInt8}},
+			Cint, Bool, Ref{Ptr{Cvoid}}),
+			obj.id, obj.ptr, name, length(files),
+			Ptr{UInt8}[ pointer(s) for s in files ],
+			Ptr{UInt8}[ pointer(s) for s in paths ], dim, replace, p)
+	end
+	return type_gdsnode(id, p[])
+end
+
+
 # Get the descritpion of a specified node
 function objdesp_gdsn(obj::type_gdsnode)
 	dm = Int64[]
@@ -276,6 +469,160 @@ function read_gdsn(obj::type_gdsnode, start::Vector{Int64}=Vector{Int64}(),
 end
 
 
+# Read the codes and dictionary of a dictionary-encoded string node
+# (e.g., "dstring"); code 0 is an empty string and code i refers to dict[i],
+# so that a PooledArray or CategoricalArray can be built without strings
+function readdict_gdsn(obj::type_gdsnode, start::Vector{Int64}=Vector{Int64}(),
+		count::Vector{Int64}=Vector{Int64}())
+	p = ccall((:gdsnReadDict, LibCoreArray), Ptr{Cvoid},
+		(Cint, Ptr{Cvoid}, Vector{Int64}, Vector{Int64}),
+		obj.id, obj.ptr, start, count)
+	s = unsafe_pointer_to_objref(p)
+	return (s[1], s[2])
+end
+
+
+# Read a fixed-length string node (e.g., "fstring") as raw bytes, returning
+# type_fstrraw for a vector or a UInt8 array (width x n2 x n1) for a matrix
+function readfstr_gdsn(obj::type_gdsnode, start::Vector{Int64}=Vector{Int64}(),
+		count::Vector{Int64}=Vector{Int64}())
+	p = ccall((:gdsnReadFStrRaw, LibCoreArray), Ptr{Cvoid},
+		(Cint, Ptr{Cvoid}, Vector{Int64}, Vector{Int64}),
+		obj.id, obj.ptr, start, count)
+	s = unsafe_pointer_to_objref(p)
+	if ndims(s) == 2
+		u = ccall((:gdsnFStrUnit, LibCoreArray), Cint, (Cint, Ptr{Cvoid}),
+			obj.id, obj.ptr)
+		return type_fstrraw(s, u)
+	end
+	return s
+end
+
+
+
+# Append data to a GDS node, numeric buffers are passed to the node directly;
+# a closed node compressed with random access (e.g., "ZIP_RA") is reopened and
+# new blocks are added after the existing ones
+function append_gdsn(obj::type_gdsnode,
+		val::Array{<:Union{Bool, Int8, UInt8, Int16, UInt16, Int32, UInt32,
+		Int64, UInt64, Float32, Float64}})
+	cvt = storage_type(eltype(val))[2]
+	GC.@preserve val begin
+		ccall((:gdsnAppend, LibCoreArray), Cvoid,
+			(Cint, Ptr{Cvoid}, Ptr{Cvoid}, Int64, Cstring),
+			obj.id, obj.ptr, pointer(val), length(val), cvt)
+	end
+	return obj
+end
+
+function append_gdsn(obj::type_gdsnode, val::Array{String})
+	len = Int64[ sizeof(s) for s in val ]
+	GC.@preserve val begin
+		ptr = Ptr{UInt8}[ pointer(s) for s in val ]
+		ccall((:gdsnAppendStr, LibCoreArray), Cvoid,
+			(Cint, Ptr{Cvoid}, Ptr{Ptr{UInt8}}, Ptr{Int64}, Int64),
+			obj.id, obj.ptr, ptr, len, length(val))
+	end
+	return obj
+end
+
+function append_gdsn(obj::type_gdsnode, val::AbstractArray)
+	v = collect(val)
+	isa(v, Array) && typeof(v) != typeof(val) ||
+		error("Not support the type: ", typeof(val), ".")
+	return append_gdsn(obj, v)
+end
+
+append_gdsn(obj::type_gdsnode, val::Union{Number, AbstractString}) =
+	append_gdsn(obj, [val])
+
+
+# Close the writing mode and finish the compression of a GDS node
+function readmode_gdsn(obj::type_gdsnode)
+	ccall((:gdsnReadMode, LibCoreArray), Cvoid, (Cint, Ptr{Cvoid}),
+		obj.id, obj.ptr)
+	return obj
+end
+
+
+# Set the buffer size (in bytes) used when appending data to a GDS node,
+# a block not less than the buffer size is written through without copying
+function setbufsize_gdsn(obj::type_gdsnode, size::Integer=0)
+	ccall((:gdsnSetBufSize, LibCoreArray), Cvoid, (Cint, Ptr{Cvoid}, Int64),
+		obj.id, obj.ptr, size)
+	return obj
+end
+
+
+# Keep a transposed copy of a 2-D numeric GDS node, so reading a small range
+# of the first dimension (in Julia) decodes less data; the copy becomes stale
+# when the node is modified, and it is rebuilt when the writing mode is
+# closed or 'update=true'; 'enable=false' removes the copy
+function transpose_gdsn(obj::type_gdsnode, enable::Bool=true;
+		update::Bool=true)
+	ccall((:gdsnSetTransposed, LibCoreArray), Cvoid,
+		(Cint, Ptr{Cvoid}, Bool, Bool), obj.id, obj.ptr, enable, update)
+	return obj
+end
+
+
+# Return whether a GDS node has an up-to-date transposed copy, or 'nothing'
+# if the transposed copy is not enabled
+function transposed_gdsn(obj::type_gdsnode)
+	rv = ccall((:gdsnTransposed, LibCoreArray), Cint, (Cint, Ptr{Cvoid}),
+		obj.id, obj.ptr)
+	return rv < 0 ? nothing : (rv > 0)
+end
+
+
+# Recompress GDS nodes with a new compression method (e.g., "LZ4_RA"), and
+# the data is written to a new stream which replaces the old one on success;
+# the nodes in different files are processed concurrently, and the blocks of
+# a random-access compressed node are compressed in parallel
+function recompress_gdsn(obj::Vector{type_gdsnode}, compress::String="";
+		nthread::Integer=Sys.CPU_THREADS)
+	ccall((:gdsnRecompress, LibCoreArray), Cvoid,
+		(Cint, Ptr{Cint}, Ptr{Ptr{Cvoid}}, Cstring, Cint),
+		length(obj), Cint[ x.id for x in obj ],
+		Ptr{Cvoid}[ x.ptr for x in obj ], compress, nthread)
+	return obj
+end
+
+recompress_gdsn(obj::type_gdsnode, compress::String="";
+	nthread::Integer=Sys.CPU_THREADS) =
+	recompress_gdsn([obj], compress; nthread=nthread)[1]
+
+
+# Apply a C function (e.g., from @cfunction) over the blocks of aligned GDS
+# nodes in native threads, 'margin[i]' is the dimension of the i-th node
+# along which the blocks of 'blocksize' are taken; the blocks are decoded
+# once and
+#     fun(thread::Cint, start::Int64, count::Cint, buf::Ptr{Ptr{Cvoid}},
+#         param::Ptr{Cvoid})::Ptr{Cvoid}
+# is called on the decoded data in parallel, then
+#     collect(start::Int64, count::Cint, result::Ptr{Cvoid}, param::Ptr{Cvoid})
+# is called by one thread at a time (in the order of blocks if 'ordered'),
+# 'start' is 0-based; both functions run in the pool threads not started by
+# Julia (a Julia @cfunction requires Julia >= 1.9, otherwise use pure C
+# functions) while the calling thread waits in a GC-safe region, unless the
+# pool has no worker (see threadpool_gds)
+function applyblock_gdsn(obj::Vector{type_gdsnode}, margin::Vector{<:Integer},
+		fun::Ptr{Cvoid}, collect::Ptr{Cvoid}=C_NULL, param::Ptr{Cvoid}=C_NULL;
+		blocksize::Integer=1024, nthread::Integer=Sys.CPU_THREADS,
+		ordered::Bool=true, cvt::Vector{String}=fill("", length(obj)))
+	GC.@preserve cvt begin
+		ptr = Ptr{UInt8}[ pointer(s) for s in cvt ]
+		ccall((:gdsnApplyBlock, LibCoreArray), Cvoid,
+			(Cint, Ptr{Cint}, Ptr{Ptr{Cvoid}}, Ptr{Cint}, Ptr{Ptr{UInt8}},
+			Int64, Cint, Bool, Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}),
+			length(obj), Cint[ x.id for x in obj ],
+			Ptr{Cvoid}[ x.ptr for x in obj ], Cint.(margin), ptr, blocksize,
+			nthread, ordered, fun, collect, param)
+	end
+	return nothing
+end
+
+
 
 ####  GDS Attributes  ####
 